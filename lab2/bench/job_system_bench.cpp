@@ -0,0 +1,84 @@
+// Scaling benchmark for the job system: frustum culls and transforms a large
+// synthetic city with 1 to N threads and reports the speedup over one thread.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <core/job_system.h>
+#include <core/frustum.h>
+#include <core/benchmark.h>
+#include <core/profiler.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Box {
+	glm::vec3 position;
+	glm::vec3 scale;
+};
+
+static double RunFrames(const std::vector<Box>& boxes, const glm::mat4& vp, std::vector<glm::mat4>& mvps,
+	std::vector<unsigned char>& visible, int frames) {
+	Frustum frustum(vp);
+	uint64_t start = ProfilerNow();
+	for (int frame = 0; frame < frames; ++frame) {
+		JobCounter counter;
+		JobParallelFor(boxes.size(), 1024, [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				visible[i] = frustum.intersectsBox(boxes[i].position, boxes[i].scale);
+				if (!visible[i]) continue;
+				glm::mat4 model = glm::translate(glm::mat4(1.0f), boxes[i].position);
+				model = glm::scale(model, boxes[i].scale);
+				mvps[i] = vp * model;
+			}
+		}, &counter);
+		JobWait(&counter);
+	}
+	return (ProfilerNow() - start) * 1e-6 / frames;
+}
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 1000000;
+	int frames = 20;
+	int maxThreads = static_cast<int>(std::thread::hardware_concurrency());
+	if (maxThreads <= 0) maxThreads = 1;
+
+	// Same layout rules as the demo city, tiled out to the requested size
+	std::vector<Box> boxes(count);
+	int side = 1;
+	while (static_cast<size_t>(side) * side < count) ++side;
+	srand(1);
+	for (size_t i = 0; i < count; ++i) {
+		float height = 50.0f + static_cast<float>(rand() % 60);
+		boxes[i].scale = glm::vec3(16.0f, height, 16.0f);
+		boxes[i].position = glm::vec3((i % side) * 60.0f - side * 30.0f, height / 2.0f - 50.0f, (i / side) * 60.0f - side * 30.0f);
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 5000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0, 100, 600), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	glm::mat4 vp = projection * view;
+	std::vector<glm::mat4> mvps(count);
+	std::vector<unsigned char> visible(count);
+
+	printf("Culling and transforming %zu boxes, %d frames per run\n", count, frames);
+	printf("threads   ms/frame   speedup\n");
+	double baseline = 0.0;
+	for (int threads = 1; threads <= maxThreads; ++threads) {
+		JobSystemInit(threads);
+		RunFrames(boxes, vp, mvps, visible, 2);		// Warm up caches and worker threads
+		double ms = RunFrames(boxes, vp, mvps, visible, frames);
+		JobSystemShutdown();
+
+		if (threads == 1) baseline = ms;
+		printf("%7d   %8.3f   %7.2fx\n", threads, ms, baseline / ms);
+		BenchmarkSet("job_system", "threads_" + std::to_string(threads) + "_ms", ms);
+		BenchmarkSet("job_system", "threads_" + std::to_string(threads) + "_speedup", baseline / ms);
+	}
+
+	BenchmarkSet("job_system", "boxes", static_cast<double>(count));
+	BenchmarkWriteJson("job_system_bench.json");
+	return 0;
+}
@@ -0,0 +1,81 @@
+// Compares the per-object glm transform path that Building::render used with
+// the cached-world SIMD batch kernel, at 100k instances by default.
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <core/transform_batch.h>
+#include <core/benchmark.h>
+#include <core/profiler.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+int main(int argc, char** argv) {
+	size_t count = argc > 1 ? static_cast<size_t>(atol(argv[1])) : 100000;
+	const int iterations = 50;
+
+	std::vector<glm::vec3> positions(count), scales(count);
+	std::vector<glm::mat4> world(count);
+	srand(1);
+	for (size_t i = 0; i < count; ++i) {
+		float height = 50.0f + static_cast<float>(rand() % 60);
+		positions[i] = glm::vec3((i % 300) * 60.0f, height / 2.0f - 50.0f, (i / 300) * 60.0f);
+		scales[i] = glm::vec3(16.0f, height, 16.0f);
+		world[i] = glm::scale(glm::translate(glm::mat4(1.0f), positions[i]), scales[i]);
+	}
+
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0, 100, 600), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+	glm::mat4 vp = projection * view;
+
+	std::vector<float> reference(count * 16), batched(count * 16);
+
+	// Per object: build the model matrix and multiply every frame, as before
+	uint64_t start = ProfilerNow();
+	for (int it = 0; it < iterations; ++it) {
+		for (size_t i = 0; i < count; ++i) {
+			glm::mat4 modelMatrix = glm::mat4(1.0f);
+			modelMatrix = glm::translate(modelMatrix, positions[i]);
+			modelMatrix = glm::scale(modelMatrix, scales[i]);
+			glm::mat4 mvp = vp * modelMatrix;
+			memcpy(&reference[i * 16], &mvp[0][0], sizeof(mvp));
+		}
+	}
+	double perObjectMs = (ProfilerNow() - start) * 1e-6 / iterations;
+
+	start = ProfilerNow();
+	for (int it = 0; it < iterations; ++it) {
+		TransformBatchMVPReference(vp, world.data(), nullptr, count, batched.data());
+	}
+	double cachedMs = (ProfilerNow() - start) * 1e-6 / iterations;
+
+	start = ProfilerNow();
+	for (int it = 0; it < iterations; ++it) {
+		TransformBatchMVP(vp, world.data(), nullptr, count, batched.data());
+	}
+	double simdMs = (ProfilerNow() - start) * 1e-6 / iterations;
+
+	float maxError = 0.0f;
+	for (size_t i = 0; i < count * 16; ++i) {
+		float error = std::fabs(reference[i] - batched[i]) / (1.0f + std::fabs(reference[i]));
+		if (error > maxError) maxError = error;
+	}
+
+	printf("%zu instances, %d iterations\n", count, iterations);
+	printf("glm per object      %8.3f ms\n", perObjectMs);
+	printf("glm cached world    %8.3f ms  %5.2fx\n", cachedMs, perObjectMs / cachedMs);
+	printf("SIMD cached world   %8.3f ms  %5.2fx\n", simdMs, perObjectMs / simdMs);
+	printf("max relative error  %g\n", maxError);
+
+	BenchmarkSet("transform", "instances", static_cast<double>(count));
+	BenchmarkSet("transform", "glm_per_object_ms", perObjectMs);
+	BenchmarkSet("transform", "glm_cached_ms", cachedMs);
+	BenchmarkSet("transform", "simd_cached_ms", simdMs);
+	BenchmarkSet("transform", "max_relative_error", maxError);
+	BenchmarkWriteJson("transform_bench.json");
+	return maxError < 1e-5f ? 0 : 1;
+}
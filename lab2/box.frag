@@ -5,50 +5,47 @@ in vec3 worldPosition;
 in vec3 worldNormal; 
 
 in vec2 uv;
+in vec2 slotUV;
+flat in vec2 slot;
 
 uniform sampler2D textureSampler;
 
-out vec3 finalColor;
-
-uniform vec3 lightPosition;
-uniform vec3 lightIntensity;
-uniform float exposure;
+// Unique per-building texturing from the virtual texture instead of the
+// shared facade textures
+uniform bool useVirtualTexture;
 
 in vec4 lightSpacePosition; // for shadow mapping
-uniform sampler2D shadowMap; // for shadow mapping
-
-float CalcShadowFactor() {
-    vec3 Coords = lightSpacePosition.xyz / lightSpacePosition.w;
 
-    // Transform to [0, 1] range for all coordinates
-    Coords = Coords * 0.5 + 0.5;
-
-    // Early exit for fragments outside the light frustum
-    if (Coords.z > 1.0) return 1.0;
-
-    // Retrieve depth from shadow map
-    float Depth = texture(shadowMap, Coords.xy).r;
-    float bias = 0.0025;
+// Compiled twice: as the forward pass, and with GBUFFER defined as the
+// geometry pass of the deferred renderer. The material is the same in both.
+#ifdef GBUFFER
+layout(location = 0) out vec4 gbufferAlbedo;
+layout(location = 1) out vec2 gbufferNormal;
+#else
+out vec3 finalColor;
+#endif
 
-    // Compare depths with bias
-    return (Coords.z >= Depth + bias) ? 0.5 : 1.0;
-}
+#include "lighting.glsl"
+#include "virtual_texture.glsl"
 
 void main()
 {
-	vec3 N = normalize(worldNormal);
-    vec3 L = normalize(lightPosition - worldPosition);
-    vec3 BRDF = color / 3.14159;
-    float cosine = max(dot(N, L), 0);
-    vec3 lightSourceIrradiance = lightIntensity / (4 * 3.14159 * pow(length(lightPosition - worldPosition), 2.0));
-    vec3 diffuse = BRDF * cosine * lightSourceIrradiance; 
-    vec3 mapped = diffuse * exposure; // Apply exposure before tone mapping
-
-    // for shadow mapping
-    float shadow = CalcShadowFactor();  
-    mapped = mapped * shadow;
-
-    vec3 toneMapping = mapped / (1 + mapped);
-	vec4 texColor = texture(textureSampler, uv);  // Perform texture lookup using UV coordinates
-    finalColor = pow(toneMapping, vec3(1 / 2.2)) + texColor.rgb;            // Modulate the RGB components of the texture color with the vertex color
+	vec4 texColor;
+	if (useVirtualTexture) {
+		vec2 address = VirtualAddress(slotUV, slot);
+		texColor = SampleVirtual(address, VirtualMip(address));
+	}
+	else {
+		texColor = texture(textureSampler, uv);  // Perform texture lookup using UV coordinates
+	}
+    vec3 albedo = color * pow(texColor.rgb, vec3(2.2)); // Facade textures are stored in sRGB
+
+#ifdef GBUFFER
+    gbufferAlbedo = vec4(pow(albedo, vec3(1.0 / 2.2)), 1.0);
+    gbufferNormal = EncodeOctahedral(normalize(worldNormal));
+#else
+    // Linear radiance into the HDR target; exposure, tone mapping and gamma
+    // are applied once per pixel in the post pass
+    finalColor = ShadeSurface(albedo, worldNormal, gl_FragCoord.z, lightSpacePosition);
+#endif
 }
\ No newline at end of file
@@ -12,21 +12,43 @@ out vec2 uv;    // Pass UV to fragment shader
 out vec3 worldPosition;
 out vec3 worldNormal;
 
-// Matrix for vertex transformation
-uniform mat4 MVP;
+// Position in the building's virtual texture slot
+layout(location = 8) in vec2 vertexSlotUV;
+
+#ifdef GPU_CULLED
+#include "gpu_culled.glsl"
+#else
+// Per-instance transform, a constant attribute for non-instanced draws
+layout(location = 4) in mat4 instanceMVP;
+
+// The slot itself per instance
+layout(location = 9) in vec2 instanceSlot;
+#endif
+out vec2 slotUV;
+flat out vec2 slot;
+
+// The depth pre-pass in depth.vert must produce the same depth bit for bit
+invariant gl_Position;
 
 uniform mat4 lightSpaceTransformMatrix; // for shadow mapping
 out vec4 lightSpacePosition; // for shadow mapping
 
 void main() {
     // Transform vertex
-    gl_Position =  MVP * vec4(vertexPosition, 1);
+#ifdef GPU_CULLED
+    gl_Position = CulledInstancePosition(vertexPosition);
+    slot = CulledInstanceSlot();
+#else
+    gl_Position =  instanceMVP * vec4(vertexPosition, 1);
+    slot = instanceSlot;
+#endif
     
     // Pass vertex color to the fragment shader
     color = vertexColor;
 
     // Pass UV to the fragment shader
     uv = vertexUV;
+    slotUV = vertexSlotUV;
 
     worldPosition = vertexPosition;
     worldNormal = vertexNormal;
@@ -0,0 +1,65 @@
+#include "asset_archive.h"
+
+#include <cstdio>
+#include <cstring>
+
+uint64_t AssetNameHash(const char* name, size_t length) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; ++i) {
+		hash ^= (uint8_t)name[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool AssetArchive::open(const char* path) {
+	close();
+	if (!file.open(path)) return false;
+
+	const AssetArchiveHeader* candidate = (const AssetArchiveHeader*)file.data;
+	bool valid = file.size >= sizeof(AssetArchiveHeader) &&
+		memcmp(candidate->magic, kAssetArchiveMagic, sizeof(kAssetArchiveMagic)) == 0 &&
+		candidate->version == kAssetArchiveVersion && candidate->fileSize == file.size &&
+		candidate->indexOffset + (uint64_t)candidate->entryCount * sizeof(AssetArchiveEntry) <= file.size &&
+		candidate->namesOffset <= file.size;
+	if (!valid) {
+		printf("Asset archive %s is invalid or from another version.\n", path);
+		file.close();
+		return false;
+	}
+
+	header = candidate;
+	entries = (const AssetArchiveEntry*)(file.data + header->indexOffset);
+	names = (const char*)(file.data + header->namesOffset);
+	return true;
+}
+
+void AssetArchive::close() {
+	file.close();
+	header = nullptr;
+	entries = nullptr;
+	names = nullptr;
+}
+
+bool AssetArchive::find(const char* name, const uint8_t*& data, size_t& size) const {
+	if (!header) return false;
+	size_t length = strlen(name);
+	uint64_t hash = AssetNameHash(name, length);
+
+	// First entry with this hash, then every entry sharing it
+	uint32_t low = 0, high = header->entryCount;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		if (entries[middle].nameHash < hash) low = middle + 1;
+		else high = middle;
+	}
+	for (uint32_t i = low; i < header->entryCount && entries[i].nameHash == hash; ++i) {
+		const AssetArchiveEntry& entry = entries[i];
+		if (entry.nameLength != length || memcmp(names + entry.nameOffset, name, length) != 0) continue;
+		if (entry.offset + entry.size > file.size) return false;
+		data = file.data + entry.offset;
+		size = (size_t)entry.size;
+		return true;
+	}
+	return false;
+}
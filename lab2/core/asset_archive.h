@@ -0,0 +1,59 @@
+#ifndef _ASSET_ARCHIVE_H_
+#define _ASSET_ARCHIVE_H_
+
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Packed asset archive, written by tools/asset_packer and read through a
+// memory mapping.
+//
+// Layout, little-endian throughout:
+//   AssetArchiveHeader
+//   entryCount AssetArchiveEntry, sorted by name hash
+//   names, each NUL-terminated
+//   file contents, each starting on a kAssetAlignment boundary
+// A lookup hashes the name, binary searches the index and compares the
+// stored name to rule out collisions. Contents are aligned so a view can be
+// read in place as an array of any basic type.
+
+const char kAssetArchiveMagic[8] = { 'L', '2', 'A', 'S', 'S', 'E', 'T', 'S' };
+const uint32_t kAssetArchiveVersion = 1;
+const uint64_t kAssetAlignment = 64;
+
+struct AssetArchiveHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t entryCount;
+	uint64_t indexOffset;
+	uint64_t namesOffset;
+	uint64_t fileSize;			// Catches truncated copies
+};
+
+struct AssetArchiveEntry {
+	uint64_t nameHash;
+	uint64_t offset;
+	uint64_t size;
+	uint32_t nameOffset;		// From namesOffset
+	uint32_t nameLength;
+};
+
+// 64-bit FNV-1a of a name as given; names use forward slashes
+uint64_t AssetNameHash(const char* name, size_t length);
+
+struct AssetArchive {
+	MappedFile file;
+	const AssetArchiveHeader* header = nullptr;
+	const AssetArchiveEntry* entries = nullptr;
+	const char* names = nullptr;
+
+	// Maps the archive and checks its header and index bounds
+	bool open(const char* path);
+	void close();
+
+	// Points data at the file's bytes inside the mapping
+	bool find(const char* name, const uint8_t*& data, size_t& size) const;
+};
+
+#endif
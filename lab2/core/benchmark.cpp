@@ -0,0 +1,41 @@
+#include "benchmark.h"
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+namespace {
+
+std::mutex benchmarkMutex;
+std::map<std::string, std::map<std::string, double>> sections;
+
+} // namespace
+
+void BenchmarkSet(const std::string& section, const std::string& key, double value) {
+	std::lock_guard<std::mutex> lock(benchmarkMutex);
+	sections[section][key] = value;
+}
+
+bool BenchmarkWriteJson(const char* path) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		printf("Failed to open benchmark file %s\n", path);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(benchmarkMutex);
+	fprintf(file, "{\n");
+	size_t sectionIndex = 0;
+	for (auto& section : sections) {
+		fprintf(file, "  \"%s\": {\n", section.first.c_str());
+		size_t keyIndex = 0;
+		for (auto& entry : section.second) {
+			fprintf(file, "    \"%s\": %.6g%s\n", entry.first.c_str(), entry.second,
+				++keyIndex < section.second.size() ? "," : "");
+		}
+		fprintf(file, "  }%s\n", ++sectionIndex < sections.size() ? "," : "");
+	}
+	fprintf(file, "}\n");
+	fclose(file);
+	return true;
+}
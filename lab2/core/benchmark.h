@@ -0,0 +1,13 @@
+#ifndef _BENCHMARK_H_
+#define _BENCHMARK_H_
+
+#include <string>
+
+// Summary numbers collected over a run, written out as one JSON document
+// of the form { "section": { "key": value, ... }, ... } when the app exits.
+
+void BenchmarkSet(const std::string& section, const std::string& key, double value);
+
+bool BenchmarkWriteJson(const char* path);
+
+#endif
@@ -0,0 +1,228 @@
+#include "city_scene.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+static_assert(sizeof(CityBuilding) == 32, "CityBuilding is stored as is");
+static_assert(sizeof(CityChunk) == 32, "CityChunk is stored as is");
+static_assert(sizeof(glm::mat4) == 64 && sizeof(glm::vec2) == 8, "glm types are stored as is");
+
+namespace {
+
+uint64_t AlignUp(uint64_t offset) {
+	return (offset + kCitySceneAlignment - 1) & ~(kCitySceneAlignment - 1);
+}
+
+bool ArrayFits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t fileSize) {
+	return offset % kCitySceneAlignment == 0 && offset <= fileSize && count <= (fileSize - offset) / elementSize;
+}
+
+uint32_t FindOrAdd(std::vector<std::string>& names, const std::string& name) {
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (names[i] == name) return (uint32_t)i;
+	}
+	names.push_back(name);
+	return (uint32_t)(names.size() - 1);
+}
+
+} // namespace
+
+bool CityScene::open(const char* path) {
+	close();
+	if (!file.open(path)) {
+		printf("Failed to open city scene %s.\n", path);
+		return false;
+	}
+	if (!attach(file.data, file.size, path)) {
+		file.close();
+		return false;
+	}
+	return true;
+}
+
+bool CityScene::adopt(std::vector<uint8_t>&& bytes) {
+	close();
+	storage = std::move(bytes);
+	if (!attach(storage.data(), storage.size(), "in memory")) {
+		storage.clear();
+		return false;
+	}
+	return true;
+}
+
+bool CityScene::attach(const uint8_t* data, size_t size, const char* name) {
+	const CitySceneHeader* candidate = (const CitySceneHeader*)data;
+	bool valid = size >= sizeof(CitySceneHeader) &&
+		memcmp(candidate->magic, kCitySceneMagic, sizeof(kCitySceneMagic)) == 0 &&
+		candidate->version == kCitySceneVersion && candidate->fileSize == size;
+	if (valid) {
+		uint64_t buildings = candidate->buildingCount;
+		valid = ArrayFits(candidate->buildingsOffset, buildings, sizeof(CityBuilding), size) &&
+			ArrayFits(candidate->worldOffset, buildings, sizeof(glm::mat4), size) &&
+			ArrayFits(candidate->slotsOffset, buildings, sizeof(glm::vec2), size) &&
+			ArrayFits(candidate->chunksOffset, candidate->chunkCount, sizeof(CityChunk), size) &&
+			candidate->namesOffset <= size;
+	}
+	if (!valid) {
+		printf("City scene %s is invalid or from another version.\n", name);
+		return false;
+	}
+
+	// Names are few; the chunk table is small and every chunk must stay
+	// inside the buildings, so both are checked up front. Buildings are not.
+	const char* names = (const char*)(data + candidate->namesOffset);
+	const char* namesEnd = (const char*)(data + size);
+	uint32_t nameCount = candidate->meshCount + candidate->materialCount;
+	for (uint32_t i = 0; i < nameCount; ++i) {
+		const char* end = (const char*)memchr(names, 0, namesEnd - names);
+		if (!end) {
+			printf("City scene %s has truncated names.\n", name);
+			meshNames.clear();
+			materialNames.clear();
+			return false;
+		}
+		(i < candidate->meshCount ? meshNames : materialNames).push_back(std::string(names, end));
+		names = end + 1;
+	}
+	const CityChunk* chunkArray = (const CityChunk*)(data + candidate->chunksOffset);
+	for (uint32_t i = 0; i < candidate->chunkCount; ++i) {
+		if ((uint64_t)chunkArray[i].first + chunkArray[i].count > candidate->buildingCount) {
+			printf("City scene %s has a chunk outside its buildings.\n", name);
+			meshNames.clear();
+			materialNames.clear();
+			return false;
+		}
+	}
+
+	header = candidate;
+	buildings = (const CityBuilding*)(data + header->buildingsOffset);
+	world = (const glm::mat4*)(data + header->worldOffset);
+	slots = (const glm::vec2*)(data + header->slotsOffset);
+	chunks = chunkArray;
+	buildingCount = header->buildingCount;
+	chunkCount = header->chunkCount;
+	return true;
+}
+
+void CityScene::close() {
+	file.close();
+	storage.clear();
+	header = nullptr;
+	buildings = nullptr;
+	world = nullptr;
+	slots = nullptr;
+	chunks = nullptr;
+	buildingCount = 0;
+	chunkCount = 0;
+	meshNames.clear();
+	materialNames.clear();
+}
+
+uint32_t CitySceneBuilder::mesh(const std::string& name) {
+	return FindOrAdd(meshNames, name);
+}
+
+uint32_t CitySceneBuilder::material(const std::string& name) {
+	return FindOrAdd(materialNames, name);
+}
+
+void CitySceneBuilder::add(const glm::vec3& position, const glm::vec3& scale, uint32_t material, uint32_t mesh,
+	const glm::vec2& slot) {
+	CityBuilding building;
+	building.position = position;
+	building.material = material;
+	building.scale = scale;
+	building.mesh = mesh;
+	buildings.push_back(building);
+	slots.push_back(slot);
+}
+
+void CitySceneBuilder::serialize(std::vector<uint8_t>& bytes, float chunkSize, size_t maxChunkBuildings) const {
+	// Order by grid cell, row by row, keeping the given order within a cell
+	struct Cell {
+		int64_t key;
+		uint32_t building;
+	};
+	std::vector<Cell> order(buildings.size());
+	for (size_t i = 0; i < buildings.size(); ++i) {
+		int64_t x = (int64_t)std::floor(buildings[i].position.x / chunkSize);
+		int64_t z = (int64_t)std::floor(buildings[i].position.z / chunkSize);
+		order[i].key = (z << 32) + (x & 0xffffffff);
+		order[i].building = (uint32_t)i;
+	}
+	std::stable_sort(order.begin(), order.end(), [](const Cell& a, const Cell& b) { return a.key < b.key; });
+
+	std::vector<CityChunk> chunks;
+	for (size_t i = 0; i < order.size(); ++i) {
+		const CityBuilding& building = buildings[order[i].building];
+		glm::vec3 low = building.position - building.scale;
+		glm::vec3 high = building.position + building.scale;
+		if (chunks.empty() || order[i].key != order[i - 1].key || chunks.back().count >= maxChunkBuildings) {
+			CityChunk chunk;
+			chunk.boundsMin = low;
+			chunk.first = (uint32_t)i;
+			chunk.boundsMax = high;
+			chunk.count = 0;
+			chunks.push_back(chunk);
+		}
+		CityChunk& chunk = chunks.back();
+		chunk.boundsMin = glm::min(chunk.boundsMin, low);
+		chunk.boundsMax = glm::max(chunk.boundsMax, high);
+		++chunk.count;
+	}
+
+	std::string names;
+	for (const std::string& name : meshNames) names.append(name.c_str(), name.size() + 1);
+	for (const std::string& name : materialNames) names.append(name.c_str(), name.size() + 1);
+
+	CitySceneHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kCitySceneMagic, sizeof(kCitySceneMagic));
+	header.version = kCitySceneVersion;
+	header.buildingCount = (uint32_t)buildings.size();
+	header.chunkCount = (uint32_t)chunks.size();
+	header.meshCount = (uint32_t)meshNames.size();
+	header.materialCount = (uint32_t)materialNames.size();
+	header.buildingsOffset = AlignUp(sizeof(CitySceneHeader));
+	header.worldOffset = AlignUp(header.buildingsOffset + buildings.size() * sizeof(CityBuilding));
+	header.slotsOffset = AlignUp(header.worldOffset + buildings.size() * sizeof(glm::mat4));
+	header.chunksOffset = AlignUp(header.slotsOffset + buildings.size() * sizeof(glm::vec2));
+	header.namesOffset = AlignUp(header.chunksOffset + chunks.size() * sizeof(CityChunk));
+	header.fileSize = header.namesOffset + names.size();
+
+	bytes.assign((size_t)header.fileSize, 0);
+	memcpy(bytes.data(), &header, sizeof(header));
+	CityBuilding* outBuildings = (CityBuilding*)(bytes.data() + header.buildingsOffset);
+	glm::mat4* outWorld = (glm::mat4*)(bytes.data() + header.worldOffset);
+	glm::vec2* outSlots = (glm::vec2*)(bytes.data() + header.slotsOffset);
+	for (size_t i = 0; i < order.size(); ++i) {
+		const CityBuilding& building = buildings[order[i].building];
+		outBuildings[i] = building;
+		outWorld[i] = glm::scale(glm::translate(glm::mat4(1.0f), building.position), building.scale);
+		outSlots[i] = slots[order[i].building];
+	}
+	if (!chunks.empty()) {
+		memcpy(bytes.data() + header.chunksOffset, chunks.data(), chunks.size() * sizeof(CityChunk));
+	}
+	if (!names.empty()) {
+		memcpy(bytes.data() + header.namesOffset, names.data(), names.size());
+	}
+}
+
+bool CitySceneBuilder::write(const char* path, float chunkSize, size_t maxChunkBuildings) const {
+	std::vector<uint8_t> bytes;
+	serialize(bytes, chunkSize, maxChunkBuildings);
+	FILE* file = fopen(path, "wb");
+	if (!file) {
+		printf("Cannot write %s.\n", path);
+		return false;
+	}
+	bool written = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	written = fclose(file) == 0 && written;
+	if (!written) printf("Failed writing %s.\n", path);
+	return written;
+}
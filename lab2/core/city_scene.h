@@ -0,0 +1,112 @@
+#ifndef _CITY_SCENE_H_
+#define _CITY_SCENE_H_
+
+#include <glm/glm.hpp>
+#include "mapped_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary city layout, used in place from a memory mapping.
+//
+// Layout, little-endian throughout:
+//   CitySceneHeader
+//   buildingCount CityBuilding, sorted by chunk
+//   buildingCount world matrices, column-major glm::mat4
+//   buildingCount virtual texture slot origins, glm::vec2 in slots
+//   chunkCount CityChunk
+//   mesh names then material names, each NUL-terminated
+// Every array starts on a kCitySceneAlignment boundary, so opening a scene
+// only checks the header and points the arrays into the mapping: nothing is
+// parsed or copied per building, and pages are read as culling first touches
+// them. The world matrices are stored rather than rebuilt so the transform
+// kernel can read them straight from the file.
+//
+// Chunks are contiguous runs of buildings with their bounds, for culling
+// whole blocks of the city before looking at the buildings inside.
+
+const char kCitySceneMagic[8] = { 'L', '2', 'C', 'I', 'T', 'Y', 0, 0 };
+const uint32_t kCitySceneVersion = 1;
+const uint64_t kCitySceneAlignment = 64;
+
+struct CityBuilding {
+	glm::vec3 position;		// Centre of the box
+	uint32_t material;		// Into the material names
+	glm::vec3 scale;		// Half extent of the box in each axis
+	uint32_t mesh;			// Into the mesh names
+};
+
+struct CityChunk {
+	glm::vec3 boundsMin;
+	uint32_t first;			// Into the buildings
+	glm::vec3 boundsMax;
+	uint32_t count;
+};
+
+struct CitySceneHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t buildingCount;
+	uint32_t chunkCount;
+	uint32_t meshCount;
+	uint32_t materialCount;
+	uint32_t reserved;
+	uint64_t buildingsOffset;
+	uint64_t worldOffset;
+	uint64_t slotsOffset;
+	uint64_t chunksOffset;
+	uint64_t namesOffset;
+	uint64_t fileSize;			// Catches truncated copies
+};
+
+// Read-only view of a scene, either mapped from a file or built in memory
+struct CityScene {
+	MappedFile file;
+	std::vector<uint8_t> storage;		// Scenes built in memory only
+	const CitySceneHeader* header = nullptr;
+	const CityBuilding* buildings = nullptr;
+	const glm::mat4* world = nullptr;
+	const glm::vec2* slots = nullptr;
+	const CityChunk* chunks = nullptr;
+	size_t buildingCount = 0;
+	size_t chunkCount = 0;
+	std::vector<std::string> meshNames;
+	std::vector<std::string> materialNames;
+
+	CityScene() {}
+	CityScene(const CityScene&) = delete;
+	CityScene& operator=(const CityScene&) = delete;
+
+	// Maps a scene file and checks its header and array bounds
+	bool open(const char* path);
+	// Takes over a serialized scene, as from CitySceneBuilder::serialize
+	bool adopt(std::vector<uint8_t>&& bytes);
+	void close();
+
+private:
+	bool attach(const uint8_t* data, size_t size, const char* name);
+};
+
+// Collects buildings in any order and lays them out as a scene
+struct CitySceneBuilder {
+	std::vector<std::string> meshNames;
+	std::vector<std::string> materialNames;
+	std::vector<CityBuilding> buildings;
+	std::vector<glm::vec2> slots;		// Indexed like buildings
+
+	// Returns the index of the name, adding it if new
+	uint32_t mesh(const std::string& name);
+	uint32_t material(const std::string& name);
+
+	void add(const glm::vec3& position, const glm::vec3& scale, uint32_t material, uint32_t mesh,
+		const glm::vec2& slot);
+
+	// Groups the buildings into chunks of at most chunkSize world units on a
+	// side and maxChunkBuildings buildings, and writes the whole file image
+	void serialize(std::vector<uint8_t>& bytes, float chunkSize = 512.0f, size_t maxChunkBuildings = 1024) const;
+	bool write(const char* path, float chunkSize = 512.0f, size_t maxChunkBuildings = 1024) const;
+};
+
+#endif
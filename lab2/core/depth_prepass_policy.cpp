@@ -0,0 +1,74 @@
+#include "depth_prepass_policy.h"
+#include "profiler.h"
+
+#include <cstdio>
+
+namespace {
+
+const int kSettleFrames = 6;			// GPU timings lag about four frames behind
+const int kProbeFrames = 30;
+const int kProbeInterval = 300;
+const float kMinOverdraw = 1.1f;		// Below this there is too little to save to try
+const float kSwitchFraction = 0.95f;	// The probed choice must win by this much
+
+} // namespace
+
+void DepthPrepassPolicy::setMode(DepthPrepassMode newMode) {
+	mode = newMode;
+	active = mode == DEPTH_PREPASS_ON;
+	framesInState = 0;
+	probing = false;
+}
+
+bool DepthPrepassPolicy::update(float opaqueMs, float measuredOverdraw) {
+	if (measuredOverdraw > 0.0f) overdraw = measuredOverdraw;
+
+	bool wanted = active;
+	if (mode == DEPTH_PREPASS_OFF) {
+		wanted = false;
+	}
+	else if (mode == DEPTH_PREPASS_ON) {
+		wanted = true;
+	}
+	else {
+		++framesInState;
+		// Skip the frames still in flight from before the last switch
+		if (framesInState > kSettleFrames && opaqueMs > 0.0f) {
+			float& cost = costMs[active ? 1 : 0];
+			cost = cost == 0.0f ? opaqueMs : cost * 0.9f + opaqueMs * 0.1f;
+		}
+
+		if (probing) {
+			if (framesInState >= kSettleFrames + kProbeFrames) {
+				probing = false;
+				// Return to the previous choice unless the probed one is clearly cheaper
+				wanted = costMs[active ? 1 : 0] < costMs[active ? 0 : 1] * kSwitchFraction ? active : !active;
+				printf("Depth pre-pass: %.3f ms without, %.3f ms with, overdraw %.2f, %s\n",
+					costMs[0], costMs[1], overdraw, wanted ? "on" : "off");
+			}
+		}
+		else if (framesInState >= kProbeInterval) {
+			if (!active && overdraw > 0.0f && overdraw < kMinOverdraw) {
+				framesInState = 0;
+			}
+			else {
+				probing = true;
+				wanted = !active;
+			}
+		}
+	}
+
+	if (wanted == active) return false;
+	active = wanted;
+	framesInState = 0;
+	ProfilerRecordMarker(active ? "Depth pre-pass on" : "Depth pre-pass off");
+	return true;
+}
+
+const char* DepthPrepassPolicy::modeName() const {
+	switch (mode) {
+	case DEPTH_PREPASS_AUTO: return "auto";
+	case DEPTH_PREPASS_OFF: return "off";
+	default: return "on";
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef _DEPTH_PREPASS_POLICY_H_
+#define _DEPTH_PREPASS_POLICY_H_
+
+enum DepthPrepassMode {
+	DEPTH_PREPASS_AUTO,
+	DEPTH_PREPASS_OFF,
+	DEPTH_PREPASS_ON,
+	DEPTH_PREPASS_MODE_COUNT
+};
+
+// Decides whether the opaque pass gets a depth-only pre-pass.
+//
+// The pre-pass pays off only when the hidden fragments it saves cost more to
+// shade than drawing the geometry a second time. In auto mode the policy keeps
+// a smoothed cost of the opaque pass, pre-pass included, for both choices: it
+// runs the current one and every few seconds probes the other for a short
+// stretch, then keeps whichever was cheaper. The last measured overdraw gates
+// the probe, since with hardly any hidden fragments there is nothing to save.
+struct DepthPrepassPolicy {
+	DepthPrepassMode mode = DEPTH_PREPASS_AUTO;
+	bool active = false;			// Whether this frame runs the pre-pass
+
+	// Fragments that pass the depth test without the pre-pass per fragment
+	// shaded with it, only measurable while it runs. 0 until measured.
+	float overdraw = 0.0f;
+	float costMs[2] = { 0.0f, 0.0f };	// Smoothed opaque cost without and with the pre-pass
+	int framesInState = 0;
+	bool probing = false;
+
+	void setMode(DepthPrepassMode newMode);
+
+	// Feeds one frame's opaque pass time and overdraw, either 0 when not
+	// measured. Returns true when the pre-pass is switched on or off.
+	bool update(float opaqueMs, float measuredOverdraw);
+
+	const char* modeName() const;
+};
+
+#endif
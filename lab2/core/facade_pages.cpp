@@ -0,0 +1,189 @@
+#include "facade_pages.h"
+#include "virtual_page_table.h"
+#include "vfs.h"
+
+#include <stb/stb_image.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const float kWallWidth = 0.25f;		// Of the slot, per wall
+const float kWallHeight = 0.75f;
+const float kRepeats = 5.0f;		// Photo repeats down a wall, as in the shared UVs
+
+uint32_t Hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+float Hash01(uint32_t seed, uint32_t a, uint32_t b = 0) {
+	return (Hash(seed ^ Hash(a ^ Hash(b))) & 0xffffff) / 16777215.0f;
+}
+
+// Smoothly interpolated noise in [0, 1], one random value per integer
+float ValueNoise(float x, uint32_t seed, uint32_t channel) {
+	float cell = std::floor(x);
+	float t = x - cell;
+	t = t * t * (3.0f - 2.0f * t);
+	float a = Hash01(seed, channel, (uint32_t)(int)cell);
+	float b = Hash01(seed, channel, (uint32_t)(int)cell + 1);
+	return a + (b - a) * t;
+}
+
+// The same over a grid of integers
+float ValueNoise(float x, float y, uint32_t seed, uint32_t channel) {
+	float row = std::floor(y);
+	float t = y - row;
+	t = t * t * (3.0f - 2.0f * t);
+	float a = ValueNoise(x, seed, Hash(channel) ^ (uint32_t)(int)row);
+	float b = ValueNoise(x, seed, Hash(channel) ^ (uint32_t)((int)row + 1));
+	return a + (b - a) * t;
+}
+
+// Bilinear fetch with wrapping, coordinates in texels
+void SampleWrapped(const FacadePageSource::Image& image, float x, float y, float* rgb) {
+	float fx = std::floor(x), fy = std::floor(y);
+	float tx = x - fx, ty = y - fy;
+	int x0 = ((int)fx % image.width + image.width) % image.width;
+	int y0 = ((int)fy % image.height + image.height) % image.height;
+	int x1 = (x0 + 1) % image.width, y1 = (y0 + 1) % image.height;
+	const uint8_t* p00 = &image.pixels[((size_t)y0 * image.width + x0) * 3];
+	const uint8_t* p10 = &image.pixels[((size_t)y0 * image.width + x1) * 3];
+	const uint8_t* p01 = &image.pixels[((size_t)y1 * image.width + x0) * 3];
+	const uint8_t* p11 = &image.pixels[((size_t)y1 * image.width + x1) * 3];
+	for (int c = 0; c < 3; ++c) {
+		float top = p00[c] + (p10[c] - p00[c]) * tx;
+		float bottom = p01[c] + (p11[c] - p01[c]) * tx;
+		rgb[c] = (top + (bottom - top) * ty) / 255.0f;
+	}
+}
+
+} // namespace
+
+void FacadePageSource::load(const char* const* paths, int count) {
+	images.assign(count, std::vector<Image>());
+	for (int i = 0; i < count; ++i) {
+		Image image;
+		int channels;
+		AssetView file;
+		uint8_t* pixels = NULL;
+		if (VfsRead(paths[i], file)) {
+			pixels = stbi_load_from_memory(file.data, (int)file.size, &image.width, &image.height, &channels, 3);
+		}
+		if (pixels) {
+			image.pixels.assign(pixels, pixels + (size_t)image.width * image.height * 3);
+			stbi_image_free(pixels);
+		}
+		else {
+			std::cout << "Failed to load texture " << paths[i] << std::endl;
+			image.width = image.height = 1;
+			image.pixels.assign(3, 128);
+		}
+		images[i].push_back(image);
+
+		// 2 x 2 box filter down to 1 x 1, repeating the last row or column of odd sizes
+		while (images[i].back().width > 1 || images[i].back().height > 1) {
+			const Image& source = images[i].back();
+			Image level;
+			level.width = std::max(1, source.width / 2);
+			level.height = std::max(1, source.height / 2);
+			level.pixels.resize((size_t)level.width * level.height * 3);
+			for (int y = 0; y < level.height; ++y) {
+				int y0 = std::min(2 * y, source.height - 1), y1 = std::min(2 * y + 1, source.height - 1);
+				for (int x = 0; x < level.width; ++x) {
+					int x0 = std::min(2 * x, source.width - 1), x1 = std::min(2 * x + 1, source.width - 1);
+					for (int c = 0; c < 3; ++c) {
+						int sum = source.pixels[((size_t)y0 * source.width + x0) * 3 + c] +
+							source.pixels[((size_t)y0 * source.width + x1) * 3 + c] +
+							source.pixels[((size_t)y1 * source.width + x0) * 3 + c] +
+							source.pixels[((size_t)y1 * source.width + x1) * 3 + c];
+						level.pixels[((size_t)y * level.width + x) * 3 + c] = (uint8_t)((sum + 2) / 4);
+					}
+				}
+			}
+			images[i].push_back(std::move(level));
+		}
+	}
+}
+
+void FacadePageSource::addSlot(int textureIndex, unsigned int seed) {
+	Slot slot;
+	slot.textureIndex = textureIndex;
+	slot.seed = seed;
+	for (int c = 0; c < 3; ++c) {
+		slot.tint[c] = 0.82f + 0.36f * Hash01(seed, 1, c);
+	}
+	slots.push_back(slot);
+}
+
+void FacadePageSource::generate(int mip, int pageX, int pageY, uint8_t* rgba) const {
+	int slotX = (pageX << mip) / kSlotPages;
+	int slotY = (pageY << mip) / kSlotPages;
+	size_t slotIndex = (size_t)slotY * kSlotsPerSide + slotX;
+	if (slotIndex >= slots.size() || images.empty()) {
+		std::fill(rgba, rgba + kPhysicalPageSize * kPhysicalPageSize * 4, (uint8_t)128);
+		return;
+	}
+	const Slot& slot = slots[slotIndex];
+	const std::vector<Image>& chain = images[slot.textureIndex];
+
+	// Photo mip closest to one source texel per page texel
+	float scale = (float)(1 << mip);
+	float slotTexels = (float)(kSlotPages * kPageTexels);
+	float wallTexelsX = slotTexels * kWallWidth / scale;
+	float repeatTexelsY = slotTexels * kWallHeight / kRepeats / scale;
+	float ratio = std::max(chain[0].width / wallTexelsX, chain[0].height / repeatTexelsY);
+	int sourceMip = std::min(std::max((int)std::floor(std::log2(ratio) + 0.5f), 0), (int)chain.size() - 1);
+	const Image& source = chain[sourceMip];
+
+	for (int j = 0; j < kPhysicalPageSize; ++j) {
+		float y = ((pageY * kPageTexels + j - kPageBorder + 0.5f) * scale) / slotTexels - slotY;
+		y = std::min(std::max(y, 0.0f), 0.99999f);
+		for (int i = 0; i < kPhysicalPageSize; ++i) {
+			float x = ((pageX * kPageTexels + i - kPageBorder + 0.5f) * scale) / slotTexels - slotX;
+			x = std::min(std::max(x, 0.0f), 0.99999f);
+
+			float rgb[3];
+			if (y < kWallHeight) {
+				int wall = (int)(x / kWallWidth);
+				float u = x / kWallWidth - wall;
+				float v = y / kWallHeight * kRepeats;
+				int repeat = (int)v;
+				SampleWrapped(source, u * source.width - 0.5f, (v - repeat) * source.height - 0.5f, rgb);
+
+				// Each wall and each storey band a little lighter or darker, and
+				// grime streaks that get heavier toward the street
+				float shade = 0.94f + 0.12f * Hash01(slot.seed, 2 + wall) + 0.08f * (Hash01(slot.seed, 8 + wall, repeat) - 0.5f);
+				float grime = ValueNoise(u * 24.0f, slot.seed, 16 + wall) * 0.35f * (v / kRepeats) * (v / kRepeats);
+				for (int c = 0; c < 3; ++c) {
+					rgb[c] *= slot.tint[c] * shade * (1.0f - grime);
+				}
+			}
+			else {
+				// Gravel roof inside a concrete parapet; the bottom is never seen
+				float u = x / kWallWidth;
+				float v = (y - kWallHeight) / (1.0f - kWallHeight);
+				float gravel = 0.36f + 0.06f * ValueNoise(u * 6.0f, v * 6.0f, slot.seed, 3) +
+					0.06f * ValueNoise(u * 96.0f, v * 96.0f, slot.seed, 4);
+				float edge = std::min(std::min(u, 1.0f - u), std::min(v, 1.0f - v));
+				float value = u < 1.0f && edge < 0.03f ? 0.55f : gravel;
+				for (int c = 0; c < 3; ++c) {
+					rgb[c] = value * (0.5f + 0.5f * slot.tint[c]);
+				}
+			}
+
+			uint8_t* texel = rgba + ((size_t)j * kPhysicalPageSize + i) * 4;
+			for (int c = 0; c < 3; ++c) {
+				texel[c] = (uint8_t)std::min(std::max(rgb[c] * 255.0f + 0.5f, 0.0f), 255.0f);
+			}
+			texel[3] = 255;
+		}
+	}
+}
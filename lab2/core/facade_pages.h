@@ -0,0 +1,48 @@
+#ifndef _FACADE_PAGES_H_
+#define _FACADE_PAGES_H_
+
+#include <cstdint>
+#include <vector>
+
+// Unique building texturing for the virtual texture, generated page by page.
+//
+// Each building owns one slot of the virtual address space. Its four walls
+// sit side by side over the top three quarters of the slot, in the order of
+// the box's faces, each a quarter wide and repeating its facade photo five
+// times down its height like the shared textures do. The roof takes the
+// first quarter of the bottom row. Every building gets its own tint and
+// weathering on top of its photo, and a gravel roof with a parapet, so no two
+// buildings look the same while the sources stay six images.
+//
+// Generation only reads the source images and slots, so any number of pages
+// can be generated on worker threads at once.
+struct FacadePageSource {
+	// RGB8 mip chain of one facade photo, mip 0 first
+	struct Image {
+		int width;
+		int height;
+		std::vector<uint8_t> pixels;
+	};
+
+	struct Slot {
+		int textureIndex;
+		float tint[3];
+		unsigned int seed;
+	};
+
+	std::vector<std::vector<Image>> images;
+	std::vector<Slot> slots;		// Indexed like the virtual texture's slots
+
+	// Decodes the photos and builds their mip chains. A missing file becomes a
+	// mid grey image, reported on std::cout.
+	void load(const char* const* paths, int count);
+
+	// Adds the next slot, textured from one of the photos
+	void addSlot(int textureIndex, unsigned int seed);
+
+	// Writes one physical page of RGBA8, borders included, for the virtual
+	// page at mip, x, y
+	void generate(int mip, int pageX, int pageY, uint8_t* rgba) const;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "frame_pipeline.h"
+#include "profiler.h"
+
+FramePipeline::~FramePipeline() {
+	stop();
+}
+
+void FramePipeline::start(FrameBuildFunction build, bool pipelined) {
+	this->build = build;
+	this->pipelined = pipelined;
+	quit = false;
+	worker = std::thread(&FramePipeline::workerLoop, this);
+}
+
+void FramePipeline::stop() {
+	if (!worker.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void FramePipeline::setPipelined(bool pipelined) {
+	waitForWorker();
+	backReady = false;
+	this->pipelined = pipelined;
+}
+
+void FramePipeline::waitForWorker() {
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [this] { return !jobQueued && !jobRunning; });
+}
+
+const FramePacket& FramePipeline::beginFrame(const CameraState& camera) {
+	if (!pipelined) {
+		PROFILE_ZONE("Build frame packet");
+		packets[front].frameIndex = nextFrame++;
+		packets[front].inputTime = camera.inputTime;
+		build(camera, packets[front]);
+		return packets[front];
+	}
+
+	{
+		PROFILE_ZONE("Wait for frame packet");
+		waitForWorker();
+	}
+
+	if (backReady) {
+		front = 1 - front;
+	}
+	else {
+		// Nothing in flight yet, so build this frame inline to prime the pipeline
+		packets[front].frameIndex = nextFrame++;
+		packets[front].inputTime = camera.inputTime;
+		build(camera, packets[front]);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pendingCamera = camera;
+		jobQueued = true;
+	}
+	backReady = true;
+	wake.notify_one();
+
+	return packets[front];
+}
+
+void FramePipeline::workerLoop() {
+	ProfilerSetThreadName("Frame pipeline");
+	for (;;) {
+		CameraState camera;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return jobQueued || quit; });
+			if (quit) return;
+			camera = pendingCamera;
+			jobQueued = false;
+			jobRunning = true;
+		}
+
+		{
+			PROFILE_ZONE("Build frame packet");
+			FramePacket& packet = packets[1 - front];
+			packet.frameIndex = nextFrame++;
+			packet.inputTime = camera.inputTime;
+			build(camera, packet);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobRunning = false;
+		}
+		finished.notify_all();
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef _FRAME_PIPELINE_H_
+#define _FRAME_PIPELINE_H_
+
+#include <glm/glm.hpp>
+#include "light_clusters.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Camera inputs sampled on the GL thread and handed to the scene stage
+struct CameraState {
+	glm::vec3 eye;
+	glm::vec3 lookat;
+	glm::vec3 up;
+	glm::mat4 projectionMatrix;
+	float drawDistance = 0.0f;		// Objects farther than this are culled, 0 for no limit
+	unsigned int lightCount = 0;	// Point lights to cluster, from the start of the scene's list
+	float viewportHeight = 0.0f;	// Pixels, for projected texture detail
+	bool meshletCulling = true;		// Cull close-up buildings meshlet by meshlet
+	bool gpuCulling = false;		// Leave object culling to the GPU
+	uint64_t inputTime = 0;			// ProfilerNow() when the input behind the camera was sampled
+};
+
+// A run of entries in FramePacket::visible that share one draw state, such as
+// a texture, and can be submitted as a single instanced draw
+struct FrameBatch {
+	unsigned int key;
+	unsigned int first;
+	unsigned int count;
+};
+
+// A run of elements of some array
+struct FrameRange {
+	unsigned int first = 0;
+	unsigned int count = 0;
+};
+
+// How much detail one texture needs this frame, over every visible object
+// that uses it
+struct TextureRequest {
+	float pixelsPerRepeat = 0.0f;	// Most screen pixels one repeat of the texture spans
+	float screenArea = 0.0f;		// Approximate pixels covered, 0 when unused
+};
+
+// Everything the GL thread needs to submit one frame. Once handed over it is
+// never written again until it comes back around as the back buffer.
+struct FramePacket {
+	unsigned long long frameIndex = 0;
+	uint64_t inputTime = 0;					// Of the camera it was built from, a frame back when pipelined
+	glm::mat4 viewMatrix;
+	glm::mat4 projectionMatrix;
+	glm::mat4 viewProjection;
+	std::vector<unsigned int> visible;		// Indices of objects to draw, grouped by batch
+	std::vector<FrameBatch> batches;
+	unsigned int culled = 0;
+	std::vector<FrameRange> meshletDraws;	// Indexed like visible: the run of meshletRanges to draw, if any
+	std::vector<FrameRange> meshletRanges;	// Index buffer ranges that survived meshlet culling
+	unsigned int meshletsTested = 0;
+	unsigned int meshletsCulled = 0;
+	bool gpuCulled = false;					// Objects are culled on the GPU, visible and batches stay empty
+	LightClusters lights;
+	std::vector<TextureRequest> textureRequests;	// Indexed by texture
+};
+
+typedef std::function<void(const CameraState& camera, FramePacket& packet)> FrameBuildFunction;
+
+// Two-stage frame pipeline. A worker thread builds the packet for frame N+1
+// while the GL thread submits frame N, handing off through two packets. The
+// cost is one frame of extra latency between input and what is drawn; with
+// pipelining off the packet is built inline before submission instead.
+class FramePipeline {
+public:
+	~FramePipeline();
+
+	void start(FrameBuildFunction build, bool pipelined);
+	void stop();
+
+	// Returns the packet to submit this frame and queues the build of the next
+	// one from the given camera. The returned packet stays valid until the
+	// next call.
+	const FramePacket& beginFrame(const CameraState& camera);
+
+	void setPipelined(bool pipelined);
+	bool isPipelined() const { return pipelined; }
+
+private:
+	void workerLoop();
+	void waitForWorker();
+
+	FrameBuildFunction build;
+	FramePacket packets[2];
+	int front = 0;
+	bool pipelined = false;
+	bool backReady = false;		// The back packet holds a finished build
+	unsigned long long nextFrame = 0;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	CameraState pendingCamera;
+	bool jobQueued = false;
+	bool jobRunning = false;
+	bool quit = false;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef _FRUSTUM_H_
+#define _FRUSTUM_H_
+
+#include <glm/glm.hpp>
+
+// View frustum as six inward-facing planes (xyz = normal, w = distance),
+// extracted from a view-projection matrix.
+struct Frustum {
+	glm::vec4 planes[6];
+
+	explicit Frustum(const glm::mat4& viewProjection) {
+		glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		planes[0] = row3 + row0;	// Left
+		planes[1] = row3 - row0;	// Right
+		planes[2] = row3 + row1;	// Bottom
+		planes[3] = row3 - row1;	// Top
+		planes[4] = row3 + row2;	// Near
+		planes[5] = row3 - row2;	// Far
+		for (int i = 0; i < 6; ++i) {
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+		}
+	}
+
+	// Conservative test of an axis-aligned box given by its centre and half extents
+	bool intersectsBox(const glm::vec3& center, const glm::vec3& halfExtent) const {
+		for (int i = 0; i < 6; ++i) {
+			glm::vec3 normal(planes[i]);
+			float radius = glm::dot(halfExtent, glm::abs(normal));
+			if (glm::dot(normal, center) + planes[i].w < -radius) return false;
+		}
+		return true;
+	}
+
+	bool intersectsSphere(const glm::vec3& center, float radius) const {
+		for (int i = 0; i < 6; ++i) {
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius) return false;
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "job_system.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct WorkerQueue {
+	std::mutex mutex;
+	std::deque<PendingJob> jobs;
+};
+
+// Queue 0 belongs to the thread that called JobSystemInit
+std::vector<std::unique_ptr<WorkerQueue>> queues;
+std::vector<std::thread> workers;
+std::vector<std::string> workerNames;
+std::atomic<bool> running(false);
+std::atomic<int> queuedJobs(0);
+
+std::mutex sleepMutex;
+std::condition_variable sleepCondition;
+
+thread_local int localQueue = -1;
+
+int CurrentQueue() {
+	// Threads outside the system (e.g. the frame pipeline) share the main queue
+	return localQueue >= 0 ? localQueue : 0;
+}
+
+void Push(PendingJob job) {
+	WorkerQueue& queue = *queues[CurrentQueue()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+	}
+	queuedJobs.fetch_add(1, std::memory_order_release);
+	sleepCondition.notify_one();
+}
+
+bool TryPop(PendingJob& job) {
+	int self = CurrentQueue();
+	int count = static_cast<int>(queues.size());
+
+	// Own queue newest first, then steal the oldest job from everyone else
+	for (int i = 0; i < count; ++i) {
+		WorkerQueue& queue = *queues[(self + i) % count];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty()) continue;
+		if (i == 0) {
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else {
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
+
+// Counter updates happen under its mutex so that a waiter, which takes the
+// mutex once after seeing zero, can never free the counter while Signal still
+// holds it.
+void Signal(JobCounter* counter) {
+	std::vector<PendingJob> ready;
+	{
+		std::lock_guard<std::mutex> lock(counter->continuationMutex);
+		if (counter->value.load(std::memory_order_relaxed) == 1) ready.swap(counter->continuations);
+		counter->value.fetch_sub(1, std::memory_order_release);
+	}
+	for (auto& job : ready) {
+		if (running) Push(std::move(job));
+		else {
+			job.job();
+			if (job.signal) Signal(job.signal);
+		}
+	}
+}
+
+void Execute(PendingJob& job) {
+	job.job();
+	if (job.signal) Signal(job.signal);
+}
+
+void WorkerLoop(int index) {
+	localQueue = index;
+	ProfilerSetThreadName(workerNames[index].c_str());
+	while (running.load(std::memory_order_acquire)) {
+		PendingJob job;
+		if (TryPop(job)) {
+			Execute(job);
+			continue;
+		}
+		// The timeout covers a push that lands between the check and the wait
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		sleepCondition.wait_for(lock, std::chrono::milliseconds(1), [] {
+			return queuedJobs.load(std::memory_order_acquire) > 0 || !running.load(std::memory_order_acquire);
+		});
+	}
+}
+
+} // namespace
+
+void JobSystemInit(int threadCount) {
+	if (running) return;
+	if (threadCount <= 0) {
+		threadCount = static_cast<int>(std::thread::hardware_concurrency());
+		if (threadCount <= 0) threadCount = 1;
+	}
+
+	queues.clear();
+	workerNames.clear();
+	for (int i = 0; i < threadCount; ++i) {
+		queues.emplace_back(new WorkerQueue());
+		workerNames.push_back(i == 0 ? "Main" : "Worker " + std::to_string(i));
+	}
+	localQueue = 0;
+	running = true;
+	for (int i = 1; i < threadCount; ++i) {
+		workers.emplace_back(WorkerLoop, i);
+	}
+}
+
+void JobSystemShutdown() {
+	if (!running) return;
+
+	// Finish whatever is still queued before the workers go away
+	PendingJob job;
+	while (TryPop(job)) Execute(job);
+
+	running = false;
+	sleepCondition.notify_all();
+	for (auto& worker : workers) worker.join();
+	workers.clear();
+	queues.clear();
+	localQueue = -1;
+}
+
+int JobSystemThreadCount() {
+	return running ? static_cast<int>(queues.size()) : 1;
+}
+
+void JobRun(Job job, JobCounter* signal, JobCounter* dependsOn) {
+	if (signal) {
+		std::lock_guard<std::mutex> lock(signal->continuationMutex);
+		signal->value.fetch_add(1, std::memory_order_relaxed);
+	}
+	PendingJob pending = { std::move(job), signal };
+
+	if (dependsOn) {
+		std::unique_lock<std::mutex> lock(dependsOn->continuationMutex);
+		if (!dependsOn->done()) {
+			dependsOn->continuations.push_back(std::move(pending));
+			return;
+		}
+	}
+
+	// Without workers everything runs inline on the caller
+	if (!running) Execute(pending);
+	else Push(std::move(pending));
+}
+
+void JobParallelFor(size_t count, size_t minChunk, std::function<void(size_t begin, size_t end)> body,
+	JobCounter* signal, JobCounter* dependsOn) {
+	if (count == 0) return;
+	size_t target = static_cast<size_t>(JobSystemThreadCount()) * 4;
+	size_t chunk = (count + target - 1) / target;
+	if (chunk < minChunk) chunk = minChunk;
+	if (chunk == 0) chunk = 1;
+
+	for (size_t begin = 0; begin < count; begin += chunk) {
+		size_t end = begin + chunk < count ? begin + chunk : count;
+		JobRun([body, begin, end] { body(begin, end); }, signal, dependsOn);
+	}
+}
+
+void JobWait(JobCounter* counter) {
+	while (!counter->done()) {
+		PendingJob job;
+		if (running && TryPop(job)) Execute(job);
+		else std::this_thread::yield();
+	}
+	// Let the final Signal release the counter before the caller may destroy it
+	std::lock_guard<std::mutex> lock(counter->continuationMutex);
+}
@@ -0,0 +1,60 @@
+#ifndef _JOB_SYSTEM_H_
+#define _JOB_SYSTEM_H_
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Work-stealing job system.
+//
+// Every worker, and the thread that called JobSystemInit, owns a deque. A
+// thread pushes and pops its own jobs at the back (newest first, warm in
+// cache) and steals from the front of other deques when it runs dry.
+// JobWait never blocks idle: the waiting thread keeps running jobs until the
+// counter it waits on reaches zero, so the main thread helps out instead of
+// sleeping.
+
+typedef std::function<void()> Job;
+
+struct JobCounter;
+
+struct PendingJob {
+	Job job;
+	JobCounter* signal;
+};
+
+// Counts outstanding jobs. Jobs may be scheduled to start only once a counter
+// reaches zero, which is how dependencies between batches are expressed. A
+// counter should not be reused until the jobs depending on it have started.
+struct JobCounter {
+	std::atomic<int> value;
+	std::mutex continuationMutex;
+	std::vector<PendingJob> continuations;	// Held back until value reaches zero
+
+	JobCounter() : value(0) {}
+	bool done() const { return value.load(std::memory_order_acquire) == 0; }
+};
+
+// Starts threadCount - 1 workers; 0 means one per hardware thread
+void JobSystemInit(int threadCount = 0);
+void JobSystemShutdown();
+
+// Worker threads plus the calling thread
+int JobSystemThreadCount();
+
+// Queues a job. The signal counter, if any, is incremented now and decremented
+// when the job finishes. With dependsOn, the job is held back until that
+// counter reaches zero.
+void JobRun(Job job, JobCounter* signal = nullptr, JobCounter* dependsOn = nullptr);
+
+// Splits [0, count) into chunks of at least minChunk items, about four per
+// thread so stealing can balance uneven chunks, and runs body(begin, end) on
+// each. Returns immediately; wait on the counter for completion.
+void JobParallelFor(size_t count, size_t minChunk, std::function<void(size_t begin, size_t end)> body,
+	JobCounter* signal, JobCounter* dependsOn = nullptr);
+
+// Runs queued jobs on the calling thread until the counter reaches zero
+void JobWait(JobCounter* counter);
+
+#endif
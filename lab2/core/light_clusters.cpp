@@ -0,0 +1,188 @@
+#include "light_clusters.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#include <bitset>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LAB2_CLUSTERS_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+
+const float kClusterNear = 5.0f;		// Everything closer shares the first slice
+const int kTileSlices = kClusterX * kClusterY;
+
+// Tile boundary planes through the eye, padded to a multiple of four. The
+// signed distance of a view-space point to plane i is x * along[i] + z * depth[i],
+// positive on the side of higher tile indices.
+struct TilePlanes {
+	alignas(16) float along[20];
+	alignas(16) float depth[20];
+	int count;
+
+	void build(int tiles, float tanHalfFov) {
+		count = tiles + 1;
+		for (int i = 0; i < 20; ++i) {
+			float ndc = -1.0f + 2.0f * (i < count ? i : count - 1) / tiles;
+			float slope = ndc * tanHalfFov;
+			float inverseLength = 1.0f / std::sqrt(1.0f + slope * slope);
+			along[i] = inverseLength;
+			depth[i] = slope * inverseLength;
+		}
+	}
+
+	// Bit i set when plane i's distance to (u, z) is greater than threshold
+	unsigned int greaterMask(float u, float z, float threshold) const {
+		unsigned int mask = 0;
+#if LAB2_CLUSTERS_SSE
+		const __m128 vu = _mm_set1_ps(u);
+		const __m128 vz = _mm_set1_ps(z);
+		const __m128 vt = _mm_set1_ps(threshold);
+		for (int i = 0; i < count; i += 4) {
+			__m128 d = _mm_add_ps(_mm_mul_ps(vu, _mm_load_ps(along + i)), _mm_mul_ps(vz, _mm_load_ps(depth + i)));
+			mask |= static_cast<unsigned int>(_mm_movemask_ps(_mm_cmpgt_ps(d, vt))) << i;
+		}
+#else
+		for (int i = 0; i < count; ++i) {
+			if (u * along[i] + z * depth[i] > threshold) mask |= 1u << i;
+		}
+#endif
+		return mask & ((1u << count) - 1);
+	}
+
+	// First and last tile a sphere of the given radius can overlap. Distances
+	// fall monotonically with the plane index, so the tiles are a contiguous
+	// run and counting planes is enough.
+	void tileRange(float u, float z, float radius, int& first, int& last) const {
+		int tiles = count - 1;
+		unsigned int beyond = greaterMask(u, z, radius);			// Sphere wholly past plane i
+		unsigned int reaches = greaterMask(u, z, -radius - 1e-6f);	// Sphere not wholly before plane i
+		unsigned int upper = ((1u << tiles) - 1) << 1;				// Planes 1 to tiles
+		unsigned int lower = (1u << tiles) - 1;						// Planes 0 to tiles - 1
+		first = static_cast<int>(std::bitset<32>(beyond & upper).count());
+		last = static_cast<int>(std::bitset<32>(reaches & lower).count()) - 1;
+	}
+};
+
+int DepthSlice(float depth, float scale, float bias) {
+	if (depth <= kClusterNear) return 0;
+	int slice = static_cast<int>(std::log(depth) * scale + bias);
+	return slice < 0 ? 0 : (slice >= kClusterZ ? kClusterZ - 1 : slice);
+}
+
+} // namespace
+
+void LightClustersBuild(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+	const PointLight* lights, size_t count, LightClusters& clusters) {
+	PROFILE_ZONE("Light clusters");
+
+	float nearPlane = projectionMatrix[3][2] / (projectionMatrix[2][2] - 1.0f);
+	float farPlane = projectionMatrix[3][2] / (projectionMatrix[2][2] + 1.0f);
+	clusters.depthScale = kClusterZ / std::log(farPlane / kClusterNear);
+	clusters.depthBias = -clusters.depthScale * std::log(kClusterNear);
+
+	TilePlanes columns, rows;
+	columns.build(kClusterX, 1.0f / projectionMatrix[0][0]);
+	rows.build(kClusterY, 1.0f / projectionMatrix[1][1]);
+
+	// Transform every light to view space and find its block of clusters
+	std::vector<PointLight> transformed(count);
+	std::vector<int> bounds(count * 6);
+	float depthScale = clusters.depthScale, depthBias = clusters.depthBias;
+	JobCounter binning;
+	JobParallelFor(count, 512, [&](size_t begin, size_t end) {
+		for (size_t i = begin; i < end; ++i) {
+			PointLight light = lights[i];
+			light.position = glm::vec3(viewMatrix * glm::vec4(light.position, 1.0f));
+			transformed[i] = light;
+
+			int* b = &bounds[i * 6];
+			float depth = -light.position.z;
+			if (depth + light.radius < nearPlane || depth - light.radius > farPlane) {
+				b[0] = 1; b[1] = 0;
+				continue;
+			}
+			if (depth < light.radius) {
+				// The sphere reaches behind the eye, where the plane tests do not hold
+				b[0] = 0; b[1] = kClusterX - 1;
+				b[2] = 0; b[3] = kClusterY - 1;
+			}
+			else {
+				columns.tileRange(light.position.x, light.position.z, light.radius, b[0], b[1]);
+				rows.tileRange(light.position.y, light.position.z, light.radius, b[2], b[3]);
+			}
+			b[4] = DepthSlice(depth - light.radius, depthScale, depthBias);
+			b[5] = DepthSlice(depth + light.radius, depthScale, depthBias);
+		}
+	}, &binning);
+	JobWait(&binning);
+
+	// Keep only the lights that touch the frustum
+	clusters.viewLights.clear();
+	clusters.bounds.clear();
+	for (size_t i = 0; i < count; ++i) {
+		const int* b = &bounds[i * 6];
+		if (b[0] > b[1] || b[2] > b[3]) continue;
+		clusters.viewLights.push_back(transformed[i]);
+		clusters.bounds.insert(clusters.bounds.end(), b, b + 6);
+	}
+
+	// Each slice owns its clusters, so slices fill in parallel without sharing
+	size_t visible = clusters.viewLights.size();
+	clusters.sliceIndices.resize(kClusterZ);
+	clusters.sliceRanges.resize(kClusterCount * 2);
+	JobCounter filling;
+	JobParallelFor(kClusterZ, 1, [&](size_t begin, size_t end) {
+		for (size_t slice = begin; slice < end; ++slice) {
+			unsigned int counts[kTileSlices] = {};
+			int s = static_cast<int>(slice);
+			for (size_t i = 0; i < visible; ++i) {
+				const int* b = &clusters.bounds[i * 6];
+				if (s < b[4] || s > b[5]) continue;
+				for (int y = b[2]; y <= b[3]; ++y) {
+					for (int x = b[0]; x <= b[1]; ++x) ++counts[y * kClusterX + x];
+				}
+			}
+
+			unsigned int* ranges = &clusters.sliceRanges[slice * kTileSlices * 2];
+			unsigned int offset = 0;
+			for (int tile = 0; tile < kTileSlices; ++tile) {
+				ranges[tile * 2] = offset;
+				ranges[tile * 2 + 1] = 0;
+				offset += counts[tile];
+			}
+
+			std::vector<unsigned int>& indices = clusters.sliceIndices[slice];
+			indices.resize(offset);
+			for (size_t i = 0; i < visible; ++i) {
+				const int* b = &clusters.bounds[i * 6];
+				if (s < b[4] || s > b[5]) continue;
+				for (int y = b[2]; y <= b[3]; ++y) {
+					for (int x = b[0]; x <= b[1]; ++x) {
+						unsigned int* range = &ranges[(y * kClusterX + x) * 2];
+						indices[range[0] + range[1]++] = static_cast<unsigned int>(i);
+					}
+				}
+			}
+		}
+	}, &filling);
+	JobWait(&filling);
+
+	// Concatenate the slices into one index list
+	clusters.ranges.resize(kClusterCount * 2);
+	clusters.indices.clear();
+	for (int slice = 0; slice < kClusterZ; ++slice) {
+		unsigned int base = static_cast<unsigned int>(clusters.indices.size());
+		const unsigned int* ranges = &clusters.sliceRanges[slice * kTileSlices * 2];
+		unsigned int* out = &clusters.ranges[slice * kTileSlices * 2];
+		for (int tile = 0; tile < kTileSlices; ++tile) {
+			out[tile * 2] = base + ranges[tile * 2];
+			out[tile * 2 + 1] = ranges[tile * 2 + 1];
+		}
+		const std::vector<unsigned int>& indices = clusters.sliceIndices[slice];
+		clusters.indices.insert(clusters.indices.end(), indices.begin(), indices.end());
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef _LIGHT_CLUSTERS_H_
+#define _LIGHT_CLUSTERS_H_
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Clustered light assignment for forward shading.
+//
+// The view frustum is cut into kClusterX by kClusterY screen tiles and
+// kClusterZ depth slices spaced exponentially, so near slices are thin and far
+// ones deep. Every point light is tested against the tile boundary planes to
+// find the block of clusters its sphere can touch, and its index is appended
+// to each of them. A fragment then only loops over the lights of its own
+// cluster.
+
+const int kClusterX = 16;
+const int kClusterY = 9;
+const int kClusterZ = 24;
+const int kClusterCount = kClusterX * kClusterY * kClusterZ;
+
+struct PointLight {
+	glm::vec3 position;
+	float radius;			// Contribution is windowed to zero at this distance
+	glm::vec3 color;		// Intensity, in the same units as the main light
+	float padding;
+};
+
+struct LightClusters {
+	// Lights that touch the frustum, in view space, ready for upload as
+	// two RGBA32F texels each: position and radius, then colour
+	std::vector<PointLight> viewLights;
+
+	// Per cluster: first entry in indices and number of lights
+	std::vector<unsigned int> ranges;			// 2 * kClusterCount
+	std::vector<unsigned int> indices;			// Into viewLights
+
+	// Maps view depth to a slice: slice = log(depth) * scale + bias
+	float depthScale = 0.0f;
+	float depthBias = 0.0f;
+
+	// Scratch kept between builds to avoid reallocating
+	std::vector<int> bounds;					// x0, x1, y0, y1, z0, z1 per view light
+	std::vector<std::vector<unsigned int>> sliceIndices;
+	std::vector<unsigned int> sliceRanges;
+};
+
+// Builds the clusters of one view. The projection must be a symmetric
+// perspective; near and far are read back from it. Runs on the job system.
+void LightClustersBuild(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+	const PointLight* lights, size_t count, LightClusters& clusters);
+
+#endif
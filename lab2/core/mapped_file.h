@@ -0,0 +1,29 @@
+#ifndef _MAPPED_FILE_H_
+#define _MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file. Pages are faulted in on first
+// touch, so opening costs the same whatever the file size, and the mapping
+// is shared with the OS file cache instead of being copied into the process.
+struct MappedFile {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+
+	MappedFile() {}
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	// Returns false, and leaves the object closed, if the file cannot be
+	// opened or is empty
+	bool open(const char* path);
+	void close();
+};
+
+#endif
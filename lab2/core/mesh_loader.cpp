@@ -0,0 +1,827 @@
+#include "mesh_loader.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Triangles indexing separate attribute arrays, as both formats store them
+struct MeshSource {
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::ivec3> corners;	// Position, uv and normal index, -1 when absent; three per triangle
+};
+
+// Box faces in the order of Building's arrays
+enum BoxFace { kFront, kBack, kLeft, kRight, kTop, kBottom };
+
+BoxFace DominantFace(const glm::vec3& normal) {
+	glm::vec3 a = glm::abs(normal);
+	if (a.y >= a.x && a.y >= a.z) return normal.y > 0.0f ? kTop : kBottom;
+	if (a.x >= a.z) return normal.x > 0.0f ? kRight : kLeft;
+	return normal.z > 0.0f ? kFront : kBack;
+}
+
+// Facade and slot coordinates of a point of the canonical box on one of its
+// faces, matching the box's own uv_buffer_data and slot_uv_buffer_data
+void ProjectBoxFace(BoxFace face, const glm::vec3& position, glm::vec2& uv, glm::vec2& slotUV) {
+	glm::vec3 p = glm::clamp(0.5f * (position + 1.0f), 0.0f, 1.0f);
+	float v = 1.0f - p.y;
+	float u;
+	switch (face) {
+	case kFront: u = p.x; slotUV = glm::vec2(0.25f * u, 0.75f * v); break;
+	case kBack: u = 1.0f - p.x; slotUV = glm::vec2(0.25f + 0.25f * u, 0.75f * v); break;
+	case kLeft: u = p.z; slotUV = glm::vec2(0.5f + 0.25f * u, 0.75f * v); break;
+	case kRight: u = 1.0f - p.z; slotUV = glm::vec2(0.75f + 0.25f * u, 0.75f * v); break;
+	case kTop: uv = glm::vec2(0.0f); slotUV = glm::vec2(0.25f * p.x, 0.75f + 0.25f * p.z); return;
+	default: uv = glm::vec2(0.0f); slotUV = glm::vec2(0.25f + 0.25f * p.x, 0.75f + 0.25f * p.z); return;
+	}
+	// Facades repeat five times up a wall
+	uv = glm::vec2(u, 5.0f * v);
+}
+
+uint64_t HashVertex(const MeshVertex& vertex) {
+	uint32_t words[sizeof(MeshVertex) / 4];
+	memcpy(words, &vertex, sizeof(words));
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t word : words) {
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// Fits the source into the canonical box, builds every corner in parallel,
+// then merges equal corners in first-seen order
+bool BuildMesh(const MeshSource& source, const char* name, MeshData& mesh) {
+	size_t cornerCount = source.corners.size();
+	if (cornerCount == 0 || source.positions.empty()) {
+		printf("Mesh %s has no triangles.\n", name);
+		return false;
+	}
+
+	glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+	for (const glm::vec3& position : source.positions) {
+		low = glm::min(low, position);
+		high = glm::max(high, position);
+	}
+	glm::vec3 center = 0.5f * (low + high);
+	glm::vec3 halfExtent = 0.5f * (high - low);
+	for (int axis = 0; axis < 3; ++axis) {
+		if (!(halfExtent[axis] > 0.0f)) halfExtent[axis] = 1.0f;
+	}
+	glm::vec3 inverseHalfExtent = 1.0f / halfExtent;
+
+	std::vector<MeshVertex> corners(cornerCount);
+	std::vector<uint64_t> hashes(cornerCount);
+	std::atomic<bool> badIndex(false);
+	int positionCount = (int)source.positions.size();
+	int uvCount = (int)source.uvs.size();
+	int normalCount = (int)source.normals.size();
+
+	JobCounter building;
+	JobParallelFor(cornerCount / 3, 4096, [&](size_t begin, size_t end) {
+		for (size_t t = begin; t < end; ++t) {
+			const glm::ivec3* corner = &source.corners[t * 3];
+			bool valid = true;
+			for (int k = 0; k < 3; ++k) {
+				valid = valid && corner[k].x >= 0 && corner[k].x < positionCount && corner[k].y >= -1 &&
+					corner[k].y < uvCount && corner[k].z >= -1 && corner[k].z < normalCount;
+			}
+			if (!valid) {
+				badIndex = true;
+				continue;
+			}
+
+			glm::vec3 p[3];
+			for (int k = 0; k < 3; ++k) {
+				p[k] = (source.positions[corner[k].x] - center) * inverseHalfExtent;
+			}
+			glm::vec3 faceNormal = glm::cross(p[1] - p[0], p[2] - p[0]);
+			float length = glm::length(faceNormal);
+			faceNormal = length > 0.0f ? faceNormal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			BoxFace face = DominantFace(faceNormal);
+
+			for (int k = 0; k < 3; ++k) {
+				MeshVertex& vertex = corners[t * 3 + k];
+				vertex.position = p[k];
+				vertex.normal = faceNormal;
+				if (corner[k].z >= 0) {
+					// Normals scale by the inverse of the positions' scale
+					glm::vec3 normal = source.normals[corner[k].z] * halfExtent;
+					float normalLength = glm::length(normal);
+					if (normalLength > 0.0f) vertex.normal = normal / normalLength;
+				}
+				ProjectBoxFace(face, p[k], vertex.uv, vertex.slotUV);
+				if (corner[k].y >= 0) vertex.uv = source.uvs[corner[k].y];
+				hashes[t * 3 + k] = HashVertex(vertex);
+			}
+		}
+	}, &building);
+	JobWait(&building);
+	if (badIndex) {
+		printf("Mesh %s has an index out of range.\n", name);
+		return false;
+	}
+
+	// Open addressing; the top hash bits double as a cheap check before memcmp
+	struct Entry {
+		uint32_t vertex;
+		uint32_t check;
+	};
+	const uint32_t kEmpty = 0xffffffffu;
+	size_t tableSize = 16;
+	while (tableSize < cornerCount * 2) tableSize <<= 1;
+	std::vector<Entry> table(tableSize, Entry{ kEmpty, 0 });
+	size_t mask = tableSize - 1;
+
+	mesh.vertices.clear();
+	mesh.vertices.reserve(cornerCount / 3);
+	mesh.indices.resize(cornerCount);
+	for (size_t i = 0; i < cornerCount; ++i) {
+		uint64_t hash = hashes[i];
+		uint32_t check = (uint32_t)(hash >> 32);
+		size_t slot = (size_t)hash & mask;
+		while (true) {
+			Entry& entry = table[slot];
+			if (entry.vertex == kEmpty) {
+				entry.vertex = (uint32_t)mesh.vertices.size();
+				entry.check = check;
+				mesh.vertices.push_back(corners[i]);
+				break;
+			}
+			if (entry.check == check &&
+				memcmp(&mesh.vertices[entry.vertex], &corners[i], sizeof(MeshVertex)) == 0) break;
+			slot = (slot + 1) & mask;
+		}
+		mesh.indices[i] = table[slot].vertex;
+	}
+	return true;
+}
+
+// OBJ
+
+const char* SkipSpace(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t')) ++p;
+	return p;
+}
+
+bool ParseFloat(const char*& p, const char* end, float& value) {
+	p = SkipSpace(p, end);
+	if (p < end && *p == '+') ++p;
+	std::from_chars_result result = std::from_chars(p, end, value);
+	if (result.ec != std::errc()) return false;
+	p = result.ptr;
+	return true;
+}
+
+bool ParseInt(const char*& p, const char* end, int& value) {
+	std::from_chars_result result = std::from_chars(p, end, value);
+	if (result.ec != std::errc()) return false;
+	p = result.ptr;
+	return true;
+}
+
+// One line-aligned piece of the file. The first pass counts what it holds,
+// which gives every chunk its place in the shared arrays for the second.
+struct ObjChunk {
+	const char* begin;
+	const char* end;
+	size_t positions = 0, uvs = 0, normals = 0, triangles = 0;
+	size_t positionBase = 0, uvBase = 0, normalBase = 0, triangleBase = 0;
+	const char* badLine = nullptr;
+};
+
+enum ObjStatement { kObjOther, kObjPosition, kObjUV, kObjNormal, kObjFace };
+
+ObjStatement ClassifyObjLine(const char*& p, const char* end) {
+	p = SkipSpace(p, end);
+	if (end - p < 2) return kObjOther;
+	bool spaceAfter1 = p[1] == ' ' || p[1] == '\t';
+	bool spaceAfter2 = end - p >= 3 && (p[2] == ' ' || p[2] == '\t');
+	ObjStatement statement = kObjOther;
+	if (p[0] == 'v' && spaceAfter1) statement = kObjPosition;
+	else if (p[0] == 'v' && p[1] == 't' && spaceAfter2) statement = kObjUV;
+	else if (p[0] == 'v' && p[1] == 'n' && spaceAfter2) statement = kObjNormal;
+	else if (p[0] == 'f' && spaceAfter1) statement = kObjFace;
+	p += statement == kObjUV || statement == kObjNormal ? 2 : 1;
+	return statement;
+}
+
+size_t CountFaceCorners(const char* p, const char* end) {
+	size_t count = 0;
+	while (true) {
+		p = SkipSpace(p, end);
+		if (p >= end || *p == '\r' || *p == '#') return count;
+		++count;
+		while (p < end && *p != ' ' && *p != '\t' && *p != '\r') ++p;
+	}
+}
+
+void CountObjChunk(ObjChunk& chunk) {
+	for (const char* line = chunk.begin; line < chunk.end;) {
+		const char* lineEnd = (const char*)memchr(line, '\n', chunk.end - line);
+		if (!lineEnd) lineEnd = chunk.end;
+		const char* p = line;
+		switch (ClassifyObjLine(p, lineEnd)) {
+		case kObjPosition: ++chunk.positions; break;
+		case kObjUV: ++chunk.uvs; break;
+		case kObjNormal: ++chunk.normals; break;
+		case kObjFace: {
+			size_t corners = CountFaceCorners(p, lineEnd);
+			if (corners >= 3) chunk.triangles += corners - 2;
+			break;
+		}
+		default: break;
+		}
+		line = lineEnd + 1;
+	}
+}
+
+// Turns a one-based or negative OBJ index into a zero-based one, -1 if absent
+int ResolveObjIndex(int index, size_t countSoFar) {
+	if (index > 0) return index - 1;
+	if (index < 0) return (int)countSoFar + index;
+	return -2;		// Zero is invalid and fails the range check
+}
+
+void ParseObjChunk(ObjChunk& chunk, MeshSource& source) {
+	size_t positions = 0, uvs = 0, normals = 0, triangles = 0;
+	std::vector<glm::ivec3> polygon;
+	for (const char* line = chunk.begin; line < chunk.end && !chunk.badLine;) {
+		const char* lineEnd = (const char*)memchr(line, '\n', chunk.end - line);
+		if (!lineEnd) lineEnd = chunk.end;
+		const char* p = line;
+		bool ok = true;
+		switch (ClassifyObjLine(p, lineEnd)) {
+		case kObjPosition: {
+			glm::vec3& position = source.positions[chunk.positionBase + positions++];
+			ok = ParseFloat(p, lineEnd, position.x) && ParseFloat(p, lineEnd, position.y) &&
+				ParseFloat(p, lineEnd, position.z);
+			break;
+		}
+		case kObjUV: {
+			glm::vec2& uv = source.uvs[chunk.uvBase + uvs++];
+			ok = ParseFloat(p, lineEnd, uv.x) && ParseFloat(p, lineEnd, uv.y);
+			// OBJ puts t = 0 at the bottom of the image, GL as stb loads it at the top
+			uv.y = 1.0f - uv.y;
+			break;
+		}
+		case kObjNormal: {
+			glm::vec3& normal = source.normals[chunk.normalBase + normals++];
+			ok = ParseFloat(p, lineEnd, normal.x) && ParseFloat(p, lineEnd, normal.y) &&
+				ParseFloat(p, lineEnd, normal.z);
+			break;
+		}
+		case kObjFace: {
+			// p, p/t, p//n or p/t/n per corner
+			polygon.clear();
+			while (ok) {
+				p = SkipSpace(p, lineEnd);
+				if (p >= lineEnd || *p == '\r' || *p == '#') break;
+				int value;
+				glm::ivec3 corner(0, -1, -1);
+				ok = ParseInt(p, lineEnd, value);
+				corner.x = ResolveObjIndex(value, chunk.positionBase + positions);
+				if (ok && p < lineEnd && *p == '/') {
+					++p;
+					if (p < lineEnd && *p != '/') {
+						ok = ParseInt(p, lineEnd, value);
+						corner.y = ResolveObjIndex(value, chunk.uvBase + uvs);
+						// Present but before the first one, rather than absent
+						ok = ok && corner.y >= 0;
+					}
+					if (ok && p < lineEnd && *p == '/') {
+						++p;
+						ok = ParseInt(p, lineEnd, value);
+						corner.z = ResolveObjIndex(value, chunk.normalBase + normals);
+						ok = ok && corner.z >= 0;
+					}
+				}
+				polygon.push_back(corner);
+			}
+			// Fan triangulation, fine for the convex polygons modelling tools write
+			for (size_t k = 2; ok && k < polygon.size(); ++k) {
+				glm::ivec3* out = &source.corners[(chunk.triangleBase + triangles++) * 3];
+				out[0] = polygon[0];
+				out[1] = polygon[k - 1];
+				out[2] = polygon[k];
+			}
+			break;
+		}
+		default: break;
+		}
+		if (!ok) chunk.badLine = line;
+		line = lineEnd + 1;
+	}
+}
+
+// glTF
+
+// Just enough JSON for the glTF scene description
+struct JsonValue {
+	enum Type { Null, Bool, Number, String, Array, Object };
+	Type type = Null;
+	double number = 0.0;
+	std::string string;
+	std::vector<JsonValue> items;
+	std::vector<std::pair<std::string, JsonValue>> members;
+
+	const JsonValue* get(const char* key) const {
+		if (type != Object) return nullptr;
+		for (const auto& member : members) {
+			if (member.first == key) return &member.second;
+		}
+		return nullptr;
+	}
+	const JsonValue* at(size_t index) const {
+		return type == Array && index < items.size() ? &items[index] : nullptr;
+	}
+	double numberOr(const char* key, double fallback) const {
+		const JsonValue* value = get(key);
+		return value && value->type == Number ? value->number : fallback;
+	}
+	int indexOr(const char* key, int fallback) const { return (int)numberOr(key, fallback); }
+};
+
+bool ParseJson(const char*& p, const char* end, JsonValue& value, int depth);
+
+const char* SkipJsonSpace(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+	return p;
+}
+
+bool ParseJsonString(const char*& p, const char* end, std::string& out) {
+	if (p >= end || *p != '"') return false;
+	++p;
+	out.clear();
+	while (p < end && *p != '"') {
+		char c = *p++;
+		if (c == '\\') {
+			if (p >= end) return false;
+			char escape = *p++;
+			switch (escape) {
+			case 'n': c = '\n'; break;
+			case 't': c = '\t'; break;
+			case 'r': c = '\r'; break;
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'u':
+				// Names outside ASCII are not looked up, so they need not survive
+				if (end - p < 4) return false;
+				p += 4;
+				c = '?';
+				break;
+			default: c = escape; break;
+			}
+		}
+		out += c;
+	}
+	if (p >= end) return false;
+	++p;
+	return true;
+}
+
+bool ParseJson(const char*& p, const char* end, JsonValue& value, int depth) {
+	p = SkipJsonSpace(p, end);
+	if (p >= end || depth > 64) return false;
+	if (*p == '{') {
+		value.type = JsonValue::Object;
+		p = SkipJsonSpace(p + 1, end);
+		if (p < end && *p == '}') {
+			++p;
+			return true;
+		}
+		while (true) {
+			std::pair<std::string, JsonValue> member;
+			p = SkipJsonSpace(p, end);
+			if (!ParseJsonString(p, end, member.first)) return false;
+			p = SkipJsonSpace(p, end);
+			if (p >= end || *p++ != ':') return false;
+			if (!ParseJson(p, end, member.second, depth + 1)) return false;
+			value.members.push_back(std::move(member));
+			p = SkipJsonSpace(p, end);
+			if (p >= end) return false;
+			if (*p == '}') {
+				++p;
+				return true;
+			}
+			if (*p++ != ',') return false;
+		}
+	}
+	if (*p == '[') {
+		value.type = JsonValue::Array;
+		p = SkipJsonSpace(p + 1, end);
+		if (p < end && *p == ']') {
+			++p;
+			return true;
+		}
+		while (true) {
+			value.items.emplace_back();
+			if (!ParseJson(p, end, value.items.back(), depth + 1)) return false;
+			p = SkipJsonSpace(p, end);
+			if (p >= end) return false;
+			if (*p == ']') {
+				++p;
+				return true;
+			}
+			if (*p++ != ',') return false;
+		}
+	}
+	if (*p == '"') {
+		value.type = JsonValue::String;
+		return ParseJsonString(p, end, value.string);
+	}
+	if (end - p >= 4 && memcmp(p, "true", 4) == 0) {
+		value.type = JsonValue::Bool;
+		value.number = 1.0;
+		p += 4;
+		return true;
+	}
+	if (end - p >= 5 && memcmp(p, "false", 5) == 0) {
+		value.type = JsonValue::Bool;
+		p += 5;
+		return true;
+	}
+	if (end - p >= 4 && memcmp(p, "null", 4) == 0) {
+		p += 4;
+		return true;
+	}
+	value.type = JsonValue::Number;
+	std::from_chars_result result = std::from_chars(p, end, value.number);
+	if (result.ec != std::errc()) return false;
+	p = result.ptr;
+	return true;
+}
+
+// A typed view of one accessor's elements inside the binary chunk
+struct GlbAccessor {
+	const uint8_t* data = nullptr;
+	size_t count = 0;
+	size_t stride = 0;
+	int componentType = 0;
+	int components = 0;
+	bool normalized = false;
+
+	float component(size_t element, int c) const {
+		const uint8_t* at = data + element * stride;
+		switch (componentType) {
+		case 5126: {
+			float value;
+			memcpy(&value, at + c * 4, 4);
+			return value;
+		}
+		case 5121: return normalized ? at[c] / 255.0f : at[c];
+		case 5120: return normalized ? std::max((int8_t)at[c] / 127.0f, -1.0f) : (int8_t)at[c];
+		case 5123: case 5122: {
+			uint16_t bits;
+			memcpy(&bits, at + c * 2, 2);
+			if (componentType == 5122) return normalized ? std::max((int16_t)bits / 32767.0f, -1.0f) : (int16_t)bits;
+			return normalized ? bits / 65535.0f : bits;
+		}
+		default: return 0.0f;
+		}
+	}
+	uint32_t index(size_t element) const {
+		const uint8_t* at = data + element * stride;
+		if (componentType == 5121) return at[0];
+		if (componentType == 5123) {
+			uint16_t value;
+			memcpy(&value, at, 2);
+			return value;
+		}
+		uint32_t value;
+		memcpy(&value, at, 4);
+		return value;
+	}
+};
+
+int ComponentBytes(int componentType) {
+	switch (componentType) {
+	case 5120: case 5121: return 1;
+	case 5122: case 5123: return 2;
+	case 5125: case 5126: return 4;
+	default: return 0;
+	}
+}
+
+int TypeComponents(const std::string& type) {
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	return 0;
+}
+
+bool ResolveAccessor(const JsonValue& document, int index, const uint8_t* bin, size_t binSize, GlbAccessor& out) {
+	const JsonValue* accessors = document.get("accessors");
+	const JsonValue* accessor = accessors ? accessors->at(index) : nullptr;
+	if (!accessor || accessor->get("sparse")) return false;
+	const JsonValue* views = document.get("bufferViews");
+	const JsonValue* view = views ? views->at(accessor->indexOr("bufferView", -1)) : nullptr;
+	const JsonValue* type = accessor->get("type");
+	if (!view || !type || view->indexOr("buffer", 0) != 0) return false;
+
+	out.componentType = accessor->indexOr("componentType", 0);
+	out.components = TypeComponents(type->string);
+	out.count = (size_t)accessor->numberOr("count", 0);
+	const JsonValue* normalized = accessor->get("normalized");
+	out.normalized = normalized && normalized->number != 0.0;
+	size_t elementBytes = (size_t)ComponentBytes(out.componentType) * out.components;
+	out.stride = (size_t)view->numberOr("byteStride", 0);
+	if (out.stride == 0) out.stride = elementBytes;
+
+	size_t viewOffset = (size_t)view->numberOr("byteOffset", 0);
+	size_t viewLength = (size_t)view->numberOr("byteLength", 0);
+	size_t offset = (size_t)accessor->numberOr("byteOffset", 0);
+	if (elementBytes == 0 || viewOffset > binSize || viewLength > binSize - viewOffset) return false;
+	// Written so that no term can wrap around for a hostile count or stride
+	if (out.count > 0 && (offset > viewLength || elementBytes > viewLength - offset ||
+		out.count - 1 > (viewLength - offset - elementBytes) / out.stride)) return false;
+	out.data = bin + viewOffset + offset;
+	return true;
+}
+
+glm::mat4 NodeMatrix(const JsonValue& node) {
+	glm::mat4 matrix(1.0f);
+	const JsonValue* values = node.get("matrix");
+	if (values && values->items.size() == 16) {
+		for (int i = 0; i < 16; ++i) matrix[i / 4][i % 4] = (float)values->items[i].number;
+		return matrix;
+	}
+	const JsonValue* translation = node.get("translation");
+	const JsonValue* rotation = node.get("rotation");
+	const JsonValue* scale = node.get("scale");
+	if (translation && translation->items.size() == 3) {
+		matrix = glm::translate(matrix, glm::vec3((float)translation->items[0].number,
+			(float)translation->items[1].number, (float)translation->items[2].number));
+	}
+	if (rotation && rotation->items.size() == 4) {
+		// glTF stores x, y, z, w; glm's constructor takes w first
+		glm::quat q((float)rotation->items[3].number, (float)rotation->items[0].number,
+			(float)rotation->items[1].number, (float)rotation->items[2].number);
+		matrix = matrix * glm::mat4_cast(q);
+	}
+	if (scale && scale->items.size() == 3) {
+		matrix = glm::scale(matrix, glm::vec3((float)scale->items[0].number, (float)scale->items[1].number,
+			(float)scale->items[2].number));
+	}
+	return matrix;
+}
+
+void CollectMeshInstances(const JsonValue& document, int nodeIndex, const glm::mat4& parent, int depth,
+	std::vector<std::pair<int, glm::mat4>>& instances) {
+	const JsonValue* nodes = document.get("nodes");
+	const JsonValue* node = nodes ? nodes->at(nodeIndex) : nullptr;
+	if (!node || depth > 64) return;
+	glm::mat4 world = parent * NodeMatrix(*node);
+	int mesh = node->indexOr("mesh", -1);
+	if (mesh >= 0) instances.push_back(std::make_pair(mesh, world));
+	const JsonValue* children = node->get("children");
+	if (!children) return;
+	for (const JsonValue& child : children->items) {
+		CollectMeshInstances(document, (int)child.number, world, depth + 1, instances);
+	}
+}
+
+} // namespace
+
+bool MeshLoadObj(const uint8_t* data, size_t size, const char* name, MeshData& mesh) {
+	PROFILE_ZONE("OBJ parse");
+	const char* text = (const char*)data;
+	const char* textEnd = text + size;
+
+	// Pieces of at least 256 KB, about four per thread, each ending on a line break
+	size_t pieces = std::max<size_t>(1, std::min<size_t>(size / (256 * 1024), (size_t)JobSystemThreadCount() * 4));
+	std::vector<ObjChunk> chunks(pieces);
+	const char* begin = text;
+	for (size_t i = 0; i < pieces; ++i) {
+		const char* end = i + 1 == pieces ? textEnd : text + size / pieces * (i + 1);
+		if (end < begin) end = begin;
+		const char* lineBreak = (const char*)memchr(end, '\n', textEnd - end);
+		end = lineBreak ? lineBreak + 1 : textEnd;
+		chunks[i].begin = begin;
+		chunks[i].end = end;
+		begin = end;
+	}
+
+	JobCounter counting;
+	JobParallelFor(pieces, 1, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) CountObjChunk(chunks[i]);
+	}, &counting);
+	JobWait(&counting);
+
+	MeshSource source;
+	size_t positions = 0, uvs = 0, normals = 0, triangles = 0;
+	for (ObjChunk& chunk : chunks) {
+		chunk.positionBase = positions;
+		chunk.uvBase = uvs;
+		chunk.normalBase = normals;
+		chunk.triangleBase = triangles;
+		positions += chunk.positions;
+		uvs += chunk.uvs;
+		normals += chunk.normals;
+		triangles += chunk.triangles;
+	}
+	source.positions.resize(positions);
+	source.uvs.resize(uvs);
+	source.normals.resize(normals);
+	source.corners.resize(triangles * 3);
+
+	JobCounter parsing;
+	JobParallelFor(pieces, 1, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; ++i) ParseObjChunk(chunks[i], source);
+	}, &parsing);
+	JobWait(&parsing);
+
+	for (const ObjChunk& chunk : chunks) {
+		if (!chunk.badLine) continue;
+		const char* lineEnd = (const char*)memchr(chunk.badLine, '\n', textEnd - chunk.badLine);
+		int length = (int)std::min<ptrdiff_t>((lineEnd ? lineEnd : textEnd) - chunk.badLine, 80);
+		printf("Mesh %s: cannot parse \"%.*s\"\n", name, length, chunk.badLine);
+		return false;
+	}
+	return BuildMesh(source, name, mesh);
+}
+
+bool MeshLoadGlb(const uint8_t* data, size_t size, const char* name, MeshData& mesh) {
+	PROFILE_ZONE("glTF parse");
+	// 12 byte header, then chunks of length, type and data; JSON first, then BIN
+	uint32_t header[3];
+	if (size < 20) {
+		printf("Mesh %s is not a binary glTF.\n", name);
+		return false;
+	}
+	memcpy(header, data, 12);
+	if (header[0] != 0x46546C67u || header[1] != 2 || header[2] > size) {
+		printf("Mesh %s is not a version 2 binary glTF.\n", name);
+		return false;
+	}
+	size = header[2];
+
+	const char* json = nullptr;
+	size_t jsonSize = 0;
+	const uint8_t* bin = nullptr;
+	size_t binSize = 0;
+	for (size_t offset = 12; offset + 8 <= size;) {
+		uint32_t chunk[2];
+		memcpy(chunk, data + offset, 8);
+		if (chunk[0] > size - offset - 8) break;
+		if (chunk[1] == 0x4E4F534Au && !json) {
+			json = (const char*)data + offset + 8;
+			jsonSize = chunk[0];
+		}
+		else if (chunk[1] == 0x004E4942u && !bin) {
+			bin = data + offset + 8;
+			binSize = chunk[0];
+		}
+		offset += 8 + ((chunk[0] + 3) & ~3u);
+	}
+
+	JsonValue document;
+	const char* p = json;
+	if (!json || !ParseJson(p, json + jsonSize, document, 0) || document.type != JsonValue::Object) {
+		printf("Mesh %s has no readable glTF JSON.\n", name);
+		return false;
+	}
+
+	// Meshes placed by the default scene, or every mesh once when there is none
+	std::vector<std::pair<int, glm::mat4>> instances;
+	const JsonValue* scenes = document.get("scenes");
+	const JsonValue* scene = scenes ? scenes->at(document.indexOr("scene", 0)) : nullptr;
+	const JsonValue* roots = scene ? scene->get("nodes") : nullptr;
+	if (roots) {
+		for (const JsonValue& root : roots->items) {
+			CollectMeshInstances(document, (int)root.number, glm::mat4(1.0f), 0, instances);
+		}
+	}
+	else if (const JsonValue* meshes = document.get("meshes")) {
+		for (size_t i = 0; i < meshes->items.size(); ++i) instances.push_back(std::make_pair((int)i, glm::mat4(1.0f)));
+	}
+
+	// Resolve every primitive first so the arrays can be sized once
+	struct Primitive {
+		glm::mat4 world;
+		GlbAccessor position, normal, uv, indices;
+		bool hasNormals, hasUVs, indexed;
+	};
+	std::vector<Primitive> work;
+	const JsonValue* meshes = document.get("meshes");
+	for (const auto& instance : instances) {
+		const JsonValue* gltfMesh = meshes ? meshes->at(instance.first) : nullptr;
+		const JsonValue* primitives = gltfMesh ? gltfMesh->get("primitives") : nullptr;
+		if (!primitives) continue;
+		for (const JsonValue& primitive : primitives->items) {
+			const JsonValue* attributes = primitive.get("attributes");
+			if (primitive.indexOr("mode", 4) != 4 || !attributes) continue;
+			Primitive item;
+			item.world = instance.second;
+			if (!ResolveAccessor(document, attributes->indexOr("POSITION", -1), bin, binSize, item.position) ||
+				item.position.components != 3) {
+				printf("Mesh %s has a primitive without readable positions.\n", name);
+				return false;
+			}
+			item.hasNormals = ResolveAccessor(document, attributes->indexOr("NORMAL", -1), bin, binSize, item.normal) &&
+				item.normal.components == 3 && item.normal.count == item.position.count;
+			item.hasUVs = ResolveAccessor(document, attributes->indexOr("TEXCOORD_0", -1), bin, binSize, item.uv) &&
+				item.uv.components == 2 && item.uv.count == item.position.count;
+			item.indexed = primitive.get("indices") != nullptr;
+			if (item.indexed && (!ResolveAccessor(document, primitive.indexOr("indices", -1), bin, binSize,
+				item.indices) || item.indices.components != 1 || (item.indices.componentType != 5121 &&
+				item.indices.componentType != 5123 && item.indices.componentType != 5125))) {
+				printf("Mesh %s has unreadable indices.\n", name);
+				return false;
+			}
+			work.push_back(item);
+		}
+	}
+
+	MeshSource source;
+	size_t vertexTotal = 0, uvTotal = 0, normalTotal = 0, cornerTotal = 0;
+	for (const Primitive& item : work) {
+		vertexTotal += item.position.count;
+		if (item.hasUVs) uvTotal += item.position.count;
+		if (item.hasNormals) normalTotal += item.position.count;
+		cornerTotal += (item.indexed ? item.indices.count : item.position.count) / 3 * 3;
+	}
+	source.positions.resize(vertexTotal);
+	source.uvs.resize(uvTotal);
+	source.normals.resize(normalTotal);
+	source.corners.resize(cornerTotal);
+
+	// Every primitive writes its own ranges, so all of them are copied and
+	// transformed at once
+	JobCounter copying;
+	size_t vertexBase = 0, uvBase = 0, normalBase = 0, cornerBase = 0;
+	for (const Primitive& item : work) {
+		size_t vertexCount = item.position.count;
+		size_t cornerCount = (item.indexed ? item.indices.count : vertexCount) / 3 * 3;
+		glm::mat4 world = item.world;
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+		GlbAccessor position = item.position, normal = item.normal, uv = item.uv, indices = item.indices;
+		glm::vec3* positions = source.positions.data() + vertexBase;
+		glm::vec3* normals = item.hasNormals ? source.normals.data() + normalBase : nullptr;
+		glm::vec2* uvs = item.hasUVs ? source.uvs.data() + uvBase : nullptr;
+		JobParallelFor(vertexCount, 8192, [=](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				glm::vec4 p(position.component(i, 0), position.component(i, 1), position.component(i, 2), 1.0f);
+				positions[i] = glm::vec3(world * p);
+				if (normals) {
+					normals[i] = normalMatrix * glm::vec3(normal.component(i, 0), normal.component(i, 1),
+						normal.component(i, 2));
+				}
+				if (uvs) uvs[i] = glm::vec2(uv.component(i, 0), uv.component(i, 1));
+			}
+		}, &copying);
+
+		glm::ivec3* corners = source.corners.data() + cornerBase;
+		int firstVertex = (int)vertexBase;
+		int firstUV = item.hasUVs ? (int)uvBase : -1;
+		int firstNormal = item.hasNormals ? (int)normalBase : -1;
+		bool indexed = item.indexed;
+		JobParallelFor(cornerCount, 8192, [=](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; ++i) {
+				size_t vertex = indexed ? indices.index(i) : i;
+				if (vertex >= vertexCount) {
+					corners[i] = glm::ivec3(-1);		// Fails the range check
+					continue;
+				}
+				corners[i] = glm::ivec3(firstVertex + (int)vertex, firstUV < 0 ? -1 : firstUV + (int)vertex,
+					firstNormal < 0 ? -1 : firstNormal + (int)vertex);
+			}
+		}, &copying);
+
+		vertexBase += vertexCount;
+		if (item.hasUVs) uvBase += vertexCount;
+		if (item.hasNormals) normalBase += vertexCount;
+		cornerBase += cornerCount;
+	}
+	JobWait(&copying);
+	return BuildMesh(source, name, mesh);
+}
+
+bool MeshLoad(const uint8_t* data, size_t size, const char* name, MeshData& mesh, MeshLoadStats* stats) {
+	uint64_t start = ProfilerNow();
+	bool loaded = size >= 4 && memcmp(data, "glTF", 4) == 0 ? MeshLoadGlb(data, size, name, mesh) :
+		MeshLoadObj(data, size, name, mesh);
+	if (stats) {
+		stats->bytes = size;
+		stats->corners = mesh.indices.size();
+		stats->milliseconds = (ProfilerNow() - start) * 1e-6;
+	}
+	return loaded;
+}
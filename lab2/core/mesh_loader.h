@@ -0,0 +1,54 @@
+#ifndef _MESH_LOADER_H_
+#define _MESH_LOADER_H_
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Building model import from Wavefront OBJ and binary glTF (.glb).
+//
+// Output is ready to upload: one interleaved vertex array in the layout the
+// building shaders read, and 32-bit triangle indices. Corners are built in
+// parallel on the job system, OBJ text is split at line boundaries and parsed
+// in parallel with std::from_chars, and identical vertices are merged through
+// a hash table, keeping the order they first appear in.
+//
+// Models are fitted to the canonical box, [-1, 1] on every axis, so a
+// building's scale places a model exactly where its box would stand. The
+// virtual texture slot coordinates are projected like the box's faces: each
+// triangle takes the wall or roof its normal faces most. Models without
+// texture coordinates get facade coordinates projected the same way. Models
+// without normals get flat ones.
+
+// Attribute locations 0, 3, 2 and 8 of box.vert
+struct MeshVertex {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 uv;
+	glm::vec2 slotUV;
+};
+
+struct MeshData {
+	std::vector<MeshVertex> vertices;
+	std::vector<uint32_t> indices;
+};
+
+struct MeshLoadStats {
+	size_t bytes = 0;				// Of the source file
+	size_t corners = 0;				// Triangle corners before merging
+	double milliseconds = 0.0;
+
+	double megabytesPerSecond() const { return milliseconds > 0.0 ? bytes / 1048576.0 / (milliseconds * 1e-3) : 0.0; }
+};
+
+// Parses a model held in memory, such as a VFS view. The format is told by
+// the glTF magic, anything else is read as OBJ. Returns false, printing why,
+// on malformed input or a model without triangles. Needs the job system.
+bool MeshLoad(const uint8_t* data, size_t size, const char* name, MeshData& mesh, MeshLoadStats* stats = nullptr);
+
+bool MeshLoadObj(const uint8_t* data, size_t size, const char* name, MeshData& mesh);
+bool MeshLoadGlb(const uint8_t* data, size_t size, const char* name, MeshData& mesh);
+
+#endif
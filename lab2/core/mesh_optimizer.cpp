@@ -0,0 +1,478 @@
+#include "mesh_optimizer.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Triangles around each vertex, as offsets into one shared array
+struct TriangleAdjacency {
+	std::vector<uint32_t> offsets;		// vertexCount + 1
+	std::vector<uint32_t> triangles;
+
+	void build(const uint32_t* indices, size_t indexCount, size_t vertexCount) {
+		offsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; ++i) ++offsets[indices[i] + 1];
+		for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] += offsets[v];
+		triangles.resize(indexCount);
+		std::vector<uint32_t> next(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; ++i) {
+			triangles[next[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	uint32_t count(uint32_t vertex) const { return offsets[vertex + 1] - offsets[vertex]; }
+	const uint32_t* begin(uint32_t vertex) const { return triangles.data() + offsets[vertex]; }
+	const uint32_t* end(uint32_t vertex) const { return triangles.data() + offsets[vertex + 1]; }
+};
+
+// Symmetric 4x4 error matrix of a set of planes, scaled by the area of the
+// triangles that contributed them
+struct Quadric {
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+
+	void add(const Quadric& q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a11 += q.a11; a12 += q.a12; a22 += q.a22;
+		b0 += q.b0; b1 += q.b1; b2 += q.b2;
+		c += q.c;
+		weight += q.weight;
+	}
+
+	// Mean squared distance of p from the planes
+	double error(const glm::vec3& p) const {
+		double x = p.x, y = p.y, z = p.z;
+		double e = a00 * x * x + a11 * y * y + a22 * z * z + 2.0 * (a01 * x * y + a02 * x * z + a12 * y * z) +
+			2.0 * (b0 * x + b1 * y + b2 * z) + c;
+		return weight > 0.0 ? std::fabs(e) / weight : 0.0;
+	}
+};
+
+Quadric TriangleQuadric(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+	glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+	double length = glm::length(normal);
+	Quadric q;
+	memset(&q, 0, sizeof(q));
+	if (length == 0.0) return q;
+	normal /= length;
+	double area = 0.5 * length;
+	double d = -glm::dot(normal, glm::dvec3(p0));
+	q.a00 = area * normal.x * normal.x;
+	q.a01 = area * normal.x * normal.y;
+	q.a02 = area * normal.x * normal.z;
+	q.a11 = area * normal.y * normal.y;
+	q.a12 = area * normal.y * normal.z;
+	q.a22 = area * normal.z * normal.z;
+	q.b0 = area * normal.x * d;
+	q.b1 = area * normal.y * d;
+	q.b2 = area * normal.z * d;
+	q.c = area * d * d;
+	q.weight = area;
+	return q;
+}
+
+struct PositionHash {
+	size_t operator()(const glm::vec3& p) const {
+		// Adding zero folds -0 into 0, which compares equal to it
+		glm::vec3 folded = p + glm::vec3(0.0f);
+		uint32_t words[3];
+		memcpy(words, &folded, sizeof(words));
+		return (words[0] * 73856093u) ^ (words[1] * 19349663u) ^ (words[2] * 83492791u);
+	}
+};
+
+uint64_t EdgeKey(uint32_t a, uint32_t b) {
+	return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+}
+
+// Vertices that may move: ones alone at their position, so no seam splits
+// there, and away from borders and non-manifold edges
+std::vector<unsigned char> FindLockedVertices(const uint32_t* indices, size_t indexCount,
+	const MeshVertex* vertices, size_t vertexCount) {
+	std::vector<uint32_t> positionOf(vertexCount);
+	std::vector<uint32_t> sharing(vertexCount, 0);
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> first;
+	first.reserve(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		positionOf[v] = first.emplace(vertices[v].position, static_cast<uint32_t>(v)).first->second;
+		++sharing[positionOf[v]];
+	}
+
+	std::unordered_map<uint64_t, uint32_t> edgeUses;
+	edgeUses.reserve(indexCount);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		for (int e = 0; e < 3; ++e) {
+			++edgeUses[EdgeKey(positionOf[indices[i + e]], positionOf[indices[i + (e + 1) % 3]])];
+		}
+	}
+	std::vector<unsigned char> lockedPosition(vertexCount, 0);
+	for (const auto& edge : edgeUses) {
+		if (edge.second != 2) {
+			lockedPosition[edge.first >> 32] = 1;
+			lockedPosition[edge.first & 0xffffffff] = 1;
+		}
+	}
+
+	std::vector<unsigned char> locked(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		locked[v] = sharing[positionOf[v]] > 1 || lockedPosition[positionOf[v]];
+	}
+	return locked;
+}
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	double error;
+};
+
+// Whether moving from onto to keeps every remaining triangle around from
+// facing the way it did
+bool CollapseKeepsOrientation(const Collapse& collapse, const uint32_t* indices, const MeshVertex* vertices,
+	const TriangleAdjacency& adjacency) {
+	const glm::vec3& target = vertices[collapse.to].position;
+	for (const uint32_t* t = adjacency.begin(collapse.from); t != adjacency.end(collapse.from); ++t) {
+		const uint32_t* triangle = indices + *t * 3;
+		if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) continue;
+		glm::vec3 before[3], after[3];
+		for (int k = 0; k < 3; ++k) {
+			before[k] = vertices[triangle[k]].position;
+			after[k] = triangle[k] == collapse.from ? target : before[k];
+		}
+		glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+		glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+		if (glm::dot(normalBefore, normalAfter) <= 0.0f) return false;
+	}
+	return true;
+}
+
+} // namespace
+
+MeshCacheStats MeshAnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+	unsigned int cacheSize) {
+	MeshCacheStats stats;
+	stats.triangles = indexCount / 3;
+	// FIFO by timestamps: a vertex is cached while fewer than cacheSize
+	// misses have happened since its own
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<unsigned char> seen(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	for (size_t i = 0; i < indexCount; ++i) {
+		uint32_t v = indices[i];
+		if (timestamp - cacheTime[v] > cacheSize) {
+			cacheTime[v] = timestamp++;
+			++stats.transformed;
+		}
+		if (!seen[v]) {
+			seen[v] = 1;
+			++stats.vertices;
+		}
+	}
+	return stats;
+}
+
+void MeshOptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+	unsigned int cacheSize) {
+	size_t triangleCount = indexCount / 3;
+	TriangleAdjacency adjacency;
+	adjacency.build(indices, triangleCount * 3, vertexCount);
+
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) liveTriangles[v] = adjacency.count(static_cast<uint32_t>(v));
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<unsigned char> emitted(triangleCount, 0);
+	std::vector<uint32_t> deadEnd;		// Recently used vertices, to resume from when a fan runs out
+	std::vector<uint32_t> candidates;
+	uint32_t timestamp = cacheSize + 1;
+	size_t cursor = 0;		// Vertices before this have no triangles left
+	size_t written = 0;
+
+	auto nextInInputOrder = [&]() -> int64_t {
+		while (cursor < vertexCount && liveTriangles[cursor] == 0) ++cursor;
+		return cursor < vertexCount ? static_cast<int64_t>(cursor) : -1;
+	};
+
+	int64_t fanning = nextInInputOrder();
+	while (fanning >= 0) {
+		candidates.clear();
+		uint32_t center = static_cast<uint32_t>(fanning);
+		for (const uint32_t* t = adjacency.begin(center); t != adjacency.end(center); ++t) {
+			if (emitted[*t]) continue;
+			emitted[*t] = 1;
+			for (int k = 0; k < 3; ++k) {
+				uint32_t v = indices[*t * 3 + k];
+				destination[written++] = v;
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+				if (timestamp - cacheTime[v] > cacheSize) cacheTime[v] = timestamp++;
+			}
+		}
+
+		// Prefer the candidate that will still be cached after its own fan
+		// is emitted, and of those the one that has been cached longest
+		int64_t best = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates) {
+			if (liveTriangles[v] == 0) continue;
+			int64_t priority = 0;
+			uint32_t age = timestamp - cacheTime[v];
+			if (age + 2 * liveTriangles[v] <= cacheSize) priority = age;
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				best = v;
+			}
+		}
+		if (best < 0) {
+			while (!deadEnd.empty()) {
+				uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0) {
+					best = v;
+					break;
+				}
+			}
+		}
+		if (best < 0) best = nextInInputOrder();
+		fanning = best;
+	}
+}
+
+void MeshOptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+	const MeshVertex* vertices, size_t vertexCount, float threshold) {
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0) return;
+
+	// Clusters are simulated from a cold cache, as any of them may follow any
+	// other once sorted. A cluster ends where the cache had to start over
+	// anyway, or once it has paid for its cold start, its ACMR within
+	// threshold of the input's.
+	double limit = MeshAnalyzeVertexCache(indices, indexCount, vertexCount).acmr() * threshold;
+	std::vector<uint32_t> clusterStarts;
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	uint32_t timestamp = kMeshCacheSize + 1;
+	size_t clusterTransformed = 0, clusterTriangles = 0;
+	auto countMisses = [&](size_t t) {
+		int misses = 0;
+		for (int k = 0; k < 3; ++k) {
+			uint32_t v = indices[t * 3 + k];
+			if (timestamp - cacheTime[v] > kMeshCacheSize) {
+				cacheTime[v] = timestamp++;
+				++misses;
+			}
+		}
+		return misses;
+	};
+	for (size_t t = 0; t < triangleCount; ++t) {
+		bool soft = clusterTriangles > 0 && (double)clusterTransformed / clusterTriangles <= limit;
+		if (t == 0 || soft) {
+			clusterStarts.push_back(static_cast<uint32_t>(t));
+			clusterTransformed = 0;
+			clusterTriangles = 0;
+			timestamp += kMeshCacheSize + 1;
+		}
+		int misses = countMisses(t);
+		if (misses == 3 && clusterTriangles > 0) {
+			clusterStarts.push_back(static_cast<uint32_t>(t));
+			clusterTransformed = 0;
+			clusterTriangles = 0;
+		}
+		clusterTransformed += misses;
+		++clusterTriangles;
+	}
+	clusterStarts.push_back(static_cast<uint32_t>(triangleCount));
+
+	// Area weighted centres and normals of the mesh and of each cluster
+	size_t clusterCount = clusterStarts.size() - 1;
+	std::vector<glm::vec3> clusterCenters(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusterCount, glm::vec3(0.0f));
+	glm::vec3 meshCenter(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; ++c) {
+		float clusterArea = 0.0f;
+		for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+			const glm::vec3& p0 = vertices[indices[t * 3]].position;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float area = glm::length(normal);
+			glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+			clusterCenters[c] += center * area;
+			clusterNormals[c] += normal;
+			clusterArea += area;
+		}
+		meshCenter += clusterCenters[c];
+		meshArea += clusterArea;
+		if (clusterArea > 0.0f) clusterCenters[c] /= clusterArea;
+	}
+	if (meshArea > 0.0f) meshCenter /= meshArea;
+
+	std::vector<float> sortKeys(clusterCount);
+	std::vector<uint32_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; ++c) {
+		float length = glm::length(clusterNormals[c]);
+		sortKeys[c] = length > 0.0f ? glm::dot(clusterCenters[c] - meshCenter, clusterNormals[c] / length) : 0.0f;
+		order[c] = static_cast<uint32_t>(c);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	size_t written = 0;
+	for (uint32_t c : order) {
+		size_t count = (clusterStarts[c + 1] - clusterStarts[c]) * 3;
+		memcpy(destination + written, indices + clusterStarts[c] * 3, count * sizeof(uint32_t));
+		written += count;
+	}
+}
+
+void MeshOptimizeVertexFetch(MeshData& mesh) {
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+	std::vector<MeshVertex> vertices;
+	vertices.reserve(mesh.vertices.size());
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == unused) {
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+size_t MeshSimplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const MeshVertex* vertices,
+	size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError) {
+	std::vector<uint32_t> current(indices, indices + indexCount / 3 * 3);
+	std::vector<unsigned char> locked = FindLockedVertices(current.data(), current.size(), vertices, vertexCount);
+
+	std::vector<Quadric> quadrics(vertexCount);
+	memset(quadrics.data(), 0, vertexCount * sizeof(Quadric));
+	for (size_t i = 0; i < current.size(); i += 3) {
+		Quadric q = TriangleQuadric(vertices[current[i]].position, vertices[current[i + 1]].position,
+			vertices[current[i + 2]].position);
+		for (int k = 0; k < 3; ++k) quadrics[current[i + k]].add(q);
+	}
+
+	double errorLimit = (double)targetError * targetError;
+	double largestError = 0.0;
+	TriangleAdjacency adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<unsigned char> touched(vertexCount);
+
+	// Each pass collapses the cheapest edges that do not share a triangle
+	// neighbourhood, so every decision sees up to date geometry
+	while (current.size() > targetIndexCount) {
+		adjacency.build(current.data(), current.size(), vertexCount);
+		collapses.clear();
+		for (size_t i = 0; i < current.size(); i += 3) {
+			for (int e = 0; e < 3; ++e) {
+				uint32_t a = current[i + e], b = current[i + (e + 1) % 3];
+				if (locked[a] && locked[b]) continue;
+				Collapse best = { 0, 0, 0.0 };
+				double bestError = -1.0;
+				for (int direction = 0; direction < 2; ++direction) {
+					uint32_t from = direction ? b : a, to = direction ? a : b;
+					if (locked[from]) continue;
+					Quadric q = quadrics[from];
+					q.add(quadrics[to]);
+					double error = q.error(vertices[to].position);
+					if (bestError < 0.0 || error < bestError) {
+						bestError = error;
+						best = { from, to, error };
+					}
+				}
+				if (bestError >= 0.0 && bestError <= errorLimit) collapses.push_back(best);
+			}
+		}
+		if (collapses.empty()) break;
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+		for (size_t v = 0; v < vertexCount; ++v) remap[v] = static_cast<uint32_t>(v);
+		std::fill(touched.begin(), touched.end(), 0);
+		// An interior collapse removes two triangles
+		size_t triangles = current.size() / 3;
+		size_t collapsed = 0;
+		for (const Collapse& collapse : collapses) {
+			if (triangles * 3 <= targetIndexCount) break;
+			if (touched[collapse.from] || touched[collapse.to]) continue;
+			if (!CollapseKeepsOrientation(collapse, current.data(), vertices, adjacency)) continue;
+
+			remap[collapse.from] = collapse.to;
+			for (const uint32_t* t = adjacency.begin(collapse.from); t != adjacency.end(collapse.from); ++t) {
+				for (int k = 0; k < 3; ++k) touched[current[*t * 3 + k]] = 1;
+			}
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			largestError = std::max(largestError, collapse.error);
+			triangles = triangles > 2 ? triangles - 2 : 0;
+			++collapsed;
+		}
+		if (collapsed == 0) break;
+
+		size_t kept = 0;
+		for (size_t i = 0; i < current.size(); i += 3) {
+			uint32_t a = remap[current[i]], b = remap[current[i + 1]], c = remap[current[i + 2]];
+			if (a == b || b == c || a == c) continue;
+			current[kept++] = a;
+			current[kept++] = b;
+			current[kept++] = c;
+		}
+		current.resize(kept);
+	}
+
+	std::copy(current.begin(), current.end(), destination);
+	if (resultError) *resultError = static_cast<float>(std::sqrt(largestError));
+	return current.size();
+}
+
+void MeshOptimize(MeshData& mesh, std::vector<MeshLod>& lods, MeshOptimizeStats* stats, int maxLods) {
+	uint64_t start = ProfilerNow();
+	size_t vertexCount = mesh.vertices.size();
+	MeshCacheStats before = MeshAnalyzeVertexCache(mesh.indices.data(), mesh.indices.size(), vertexCount);
+
+	// Each level halves the one before within twice its error, and the chain
+	// stops once simplification no longer pays
+	std::vector<std::vector<uint32_t>> levels(1, mesh.indices);
+	std::vector<float> errors(1, 0.0f);
+	for (int lod = 1; lod < maxLods; ++lod) {
+		const std::vector<uint32_t>& previous = levels.back();
+		std::vector<uint32_t> simplified(previous.size());
+		float error = 0.0f;
+		size_t target = previous.size() / 6 * 3;
+		size_t count = MeshSimplify(simplified.data(), previous.data(), previous.size(), mesh.vertices.data(),
+			vertexCount, target, 0.01f * (1 << lod), &error);
+		if (count == 0 || count > previous.size() * 9 / 10) break;
+		simplified.resize(count);
+		levels.push_back(std::move(simplified));
+		errors.push_back(errors.back() + error);
+	}
+
+	lods.clear();
+	mesh.indices.clear();
+	std::vector<uint32_t> cacheOrdered;
+	for (size_t lod = 0; lod < levels.size(); ++lod) {
+		const std::vector<uint32_t>& level = levels[lod];
+		cacheOrdered.resize(level.size());
+		MeshOptimizeVertexCache(cacheOrdered.data(), level.data(), level.size(), vertexCount);
+		MeshLod range = { static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(level.size()),
+			errors[lod] };
+		mesh.indices.resize(mesh.indices.size() + level.size());
+		MeshOptimizeOverdraw(mesh.indices.data() + range.firstIndex, cacheOrdered.data(), cacheOrdered.size(),
+			mesh.vertices.data(), vertexCount);
+		lods.push_back(range);
+	}
+
+	// The full detail level comes first, so it decides the vertex order
+	MeshOptimizeVertexFetch(mesh);
+
+	if (stats) {
+		stats->before = before;
+		stats->after = MeshAnalyzeVertexCache(mesh.indices.data(), lods[0].indexCount, mesh.vertices.size());
+		stats->milliseconds = (ProfilerNow() - start) * 1e-6;
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef _MESH_OPTIMIZER_H_
+#define _MESH_OPTIMIZER_H_
+
+#include "mesh_loader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Load-time optimisation of indexed triangle meshes for the GPU.
+//
+// Each pass works on plain index arrays and can be used alone; MeshOptimize
+// runs them all in the usual order:
+//   simplification builds a chain of coarser index buffers over the same
+//   vertices, each level halving the triangles within an error bound;
+//   every level is reordered for the post-transform vertex cache (Tipsify);
+//   then its cache-friendly clusters are sorted outside-in to cut overdraw;
+//   finally the vertices are renumbered in the order the indices first use
+//   them, so fetches walk the vertex buffer forwards.
+//
+// Cache statistics come from a FIFO cache simulation: ACMR is transformed
+// vertices per triangle, 0.5 at best for large regular meshes and 3 at
+// worst; ATVR is transformed vertices per vertex, 1 at best.
+
+const unsigned int kMeshCacheSize = 16;		// Post-transform cache entries assumed
+const int kMaxMeshLods = 4;
+
+struct MeshCacheStats {
+	size_t transformed = 0;		// Cache misses
+	size_t triangles = 0;
+	size_t vertices = 0;		// Distinct vertices referenced
+
+	double acmr() const { return triangles ? (double)transformed / triangles : 0.0; }
+	double atvr() const { return vertices ? (double)transformed / vertices : 0.0; }
+
+	void add(const MeshCacheStats& other) {
+		transformed += other.transformed;
+		triangles += other.triangles;
+		vertices += other.vertices;
+	}
+};
+
+// One level of detail: a range of the mesh's index buffer
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;			// Largest distance moved, in the mesh's [-1, 1] units
+};
+
+struct MeshOptimizeStats {
+	MeshCacheStats before;		// Of the full detail level, as loaded
+	MeshCacheStats after;
+	double milliseconds = 0.0;
+};
+
+MeshCacheStats MeshAnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+	unsigned int cacheSize = kMeshCacheSize);
+
+// Tipsify (Sander, Nehab and Barczak 2007): fans around the vertex most
+// likely to still be cached. Destination may not alias indices.
+void MeshOptimizeVertexCache(uint32_t* destination, const uint32_t* indices, size_t indexCount, size_t vertexCount,
+	unsigned int cacheSize = kMeshCacheSize);
+
+// Sorts clusters of a cache-optimised index buffer by how far out they face
+// from the mesh's centre, so outer surfaces are drawn first. Clusters are
+// split further where that keeps ACMR within threshold times the input's.
+void MeshOptimizeOverdraw(uint32_t* destination, const uint32_t* indices, size_t indexCount,
+	const MeshVertex* vertices, size_t vertexCount, float threshold = 1.05f);
+
+// Renumbers vertices in first use order, in place, dropping unused ones
+void MeshOptimizeVertexFetch(MeshData& mesh);
+
+// Quadric edge collapse towards targetIndexCount, never moving the surface
+// more than targetError. Vertices on borders and attribute seams stay put,
+// and collapses only ever merge into existing vertices, so the result indexes
+// the same vertex buffer. Returns the index count written to destination.
+size_t MeshSimplify(uint32_t* destination, const uint32_t* indices, size_t indexCount, const MeshVertex* vertices,
+	size_t vertexCount, size_t targetIndexCount, float targetError, float* resultError = nullptr);
+
+// Runs every pass: mesh.indices becomes the levels of detail back to back,
+// as described by lods, and the vertices are renumbered for fetching
+void MeshOptimize(MeshData& mesh, std::vector<MeshLod>& lods, MeshOptimizeStats* stats = nullptr,
+	int maxLods = kMaxMeshLods);
+
+#endif
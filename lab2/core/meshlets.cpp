@@ -0,0 +1,97 @@
+#include "meshlets.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace {
+
+// Sphere around the box of the meshlet's corners, and the cone around the
+// unit normals of its triangles
+void ComputeBounds(const MeshData& mesh, Meshlet& meshlet) {
+	const uint32_t* indices = mesh.indices.data() + meshlet.firstIndex;
+	glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+	for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+		low = glm::min(low, mesh.vertices[indices[i]].position);
+		high = glm::max(high, mesh.vertices[indices[i]].position);
+	}
+	meshlet.center = 0.5f * (low + high);
+	float radiusSquared = 0.0f;
+	for (uint32_t i = 0; i < meshlet.indexCount; ++i) {
+		glm::vec3 offset = mesh.vertices[indices[i]].position - meshlet.center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+	meshlet.radius = std::sqrt(radiusSquared);
+
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.indexCount / 3);
+	glm::vec3 axis(0.0f);
+	for (uint32_t i = 0; i + 2 < meshlet.indexCount; i += 3) {
+		const glm::vec3& p0 = mesh.vertices[indices[i]].position;
+		glm::vec3 normal = glm::cross(mesh.vertices[indices[i + 1]].position - p0,
+			mesh.vertices[indices[i + 2]].position - p0);
+		float length = glm::length(normal);
+		if (length == 0.0f) continue;
+		normals.push_back(normal / length);
+		axis += normals.back();
+	}
+	float axisLength = glm::length(axis);
+	meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : glm::vec3(0.0f, 0.0f, 1.0f);
+	float minimumDot = axisLength > 0.0f ? 1.0f : -1.0f;
+	for (const glm::vec3& normal : normals) {
+		minimumDot = std::min(minimumDot, glm::dot(normal, meshlet.coneAxis));
+	}
+	// Past 90 degrees some triangle faces every eye position
+	meshlet.coneCutoff = minimumDot <= 0.0f ? 1.0f : std::sqrt(1.0f - minimumDot * minimumDot);
+}
+
+} // namespace
+
+void MeshletBuild(const MeshData& mesh, uint32_t firstIndex, uint32_t indexCount, std::vector<Meshlet>& meshlets) {
+	// Greedy scan in triangle order: a meshlet ends when the next triangle
+	// would take it past either limit, or would face more than 90 degrees from
+	// the meshlet's average and leave its cone unable to cull anything
+	std::vector<uint32_t> lastMeshlet(mesh.vertices.size(), ~0u);
+	uint32_t meshletId = 0;
+	uint32_t vertices = 0;
+	uint32_t start = firstIndex;
+	glm::vec3 facing(0.0f);
+	uint32_t end = firstIndex + indexCount / 3 * 3;
+	for (uint32_t i = firstIndex; i < end; i += 3) {
+		const uint32_t* triangle = mesh.indices.data() + i;
+		uint32_t added = 0;
+		for (int k = 0; k < 3; ++k) {
+			if (lastMeshlet[triangle[k]] != meshletId) ++added;
+		}
+		const glm::vec3& p0 = mesh.vertices[triangle[0]].position;
+		glm::vec3 normal = glm::cross(mesh.vertices[triangle[1]].position - p0, mesh.vertices[triangle[2]].position - p0);
+		bool full = vertices + added > kMeshletMaxVertices || (i - start) / 3 >= kMeshletMaxTriangles;
+		bool turns = i > start && glm::dot(facing, normal) < 0.0f;
+		if (full || turns) {
+			Meshlet meshlet;
+			meshlet.firstIndex = start;
+			meshlet.indexCount = i - start;
+			ComputeBounds(mesh, meshlet);
+			meshlets.push_back(meshlet);
+			++meshletId;
+			vertices = 0;
+			start = i;
+			facing = glm::vec3(0.0f);
+		}
+		for (int k = 0; k < 3; ++k) {
+			if (lastMeshlet[triangle[k]] != meshletId) {
+				lastMeshlet[triangle[k]] = meshletId;
+				++vertices;
+			}
+		}
+		float length = glm::length(normal);
+		if (length > 0.0f) facing += normal / length;
+	}
+	if (end > start) {
+		Meshlet meshlet;
+		meshlet.firstIndex = start;
+		meshlet.indexCount = end - start;
+		ComputeBounds(mesh, meshlet);
+		meshlets.push_back(meshlet);
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef _MESHLETS_H_
+#define _MESHLETS_H_
+
+#include <glm/glm.hpp>
+#include "mesh_loader.h"
+
+#include <cstdint>
+#include <vector>
+
+// Meshlets: small runs of a mesh's triangles with their own bounds, culled on
+// the CPU so close-up views only submit the parts of a building that can be
+// seen. Without mesh shaders a meshlet is a contiguous range of the index
+// buffer, cut from the cache-optimised triangle order, whose locality keeps
+// the ranges compact; the survivors are drawn with glMultiDrawElements.
+//
+// Each meshlet carries a bounding sphere for frustum culling and a normal
+// cone, the average facing of its triangles and how far they spread, for
+// rejecting meshlets that face entirely away from the eye.
+
+const uint32_t kMeshletMaxVertices = 64;
+const uint32_t kMeshletMaxTriangles = 124;
+
+struct Meshlet {
+	glm::vec3 center;		// Bounding sphere, in mesh space
+	float radius;
+	glm::vec3 coneAxis;
+	float coneCutoff;		// Sine of the cone's half angle, 1 when the cone is too wide to cull
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+// Splits the index range [firstIndex, firstIndex + indexCount) of the mesh,
+// appending to meshlets
+void MeshletBuild(const MeshData& mesh, uint32_t firstIndex, uint32_t indexCount, std::vector<Meshlet>& meshlets);
+
+// True when every triangle of the meshlet faces away from the eye, given in
+// mesh space. Facing is preserved by affine transforms, so testing there is
+// exact for scaled buildings too.
+inline bool MeshletFacesAway(const Meshlet& meshlet, const glm::vec3& eye) {
+	glm::vec3 toCenter = meshlet.center - eye;
+	return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+}
+
+#endif
@@ -0,0 +1,507 @@
+#include "path_tracer.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LAB2_TRACE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const float kPi = 3.14159265f;
+const int kBins = 16;
+const int kMaxLeafBoxes = 4;
+const int kStackSize = 64;
+const int kTileSize = 16;
+const float kSurfaceOffset = 1e-3f;		// Lifts bounce and shadow rays off the surface they leave
+
+float Area(const glm::vec3& low, const glm::vec3& high) {
+	glm::vec3 d = high - low;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+glm::vec3 Centroid(const BoxBvh::Box& box) {
+	return 0.5f * (box.low + box.high);
+}
+
+struct Bin {
+	glm::vec3 low = glm::vec3(FLT_MAX);
+	glm::vec3 high = glm::vec3(-FLT_MAX);
+	int count = 0;
+};
+
+// Splits boxes [first, first + count) under a new node, returning its index
+uint32_t Subdivide(BoxBvh& bvh, uint32_t first, uint32_t count) {
+	uint32_t index = static_cast<uint32_t>(bvh.nodes.size());
+	bvh.nodes.push_back(BoxBvh::Node());
+	glm::vec3 low(FLT_MAX), high(-FLT_MAX), centroidLow(FLT_MAX), centroidHigh(-FLT_MAX);
+	for (uint32_t i = first; i < first + count; ++i) {
+		const BoxBvh::Box& box = bvh.boxes[i];
+		low = glm::min(low, box.low);
+		high = glm::max(high, box.high);
+		centroidLow = glm::min(centroidLow, Centroid(box));
+		centroidHigh = glm::max(centroidHigh, Centroid(box));
+	}
+	BoxBvh::Node& node = bvh.nodes[index];
+	node.low = low;
+	node.high = high;
+	node.offset = first;
+	node.count = static_cast<uint16_t>(count);
+	node.axis = 0;
+
+	glm::vec3 extent = centroidHigh - centroidLow;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	if (count <= 2 || extent[axis] <= 0.0f) {
+		if (count <= kMaxLeafBoxes) return index;
+	}
+
+	// Cost of each split between bins, in box tests weighted by the chance a
+	// ray through the parent enters the child
+	int split = kBins / 2;
+	float bestCost = FLT_MAX;
+	if (extent[axis] > 0.0f) {
+		Bin bins[kBins];
+		float scale = kBins / extent[axis];
+		for (uint32_t i = first; i < first + count; ++i) {
+			const BoxBvh::Box& box = bvh.boxes[i];
+			int b = std::min(static_cast<int>((Centroid(box)[axis] - centroidLow[axis]) * scale), kBins - 1);
+			bins[b].low = glm::min(bins[b].low, box.low);
+			bins[b].high = glm::max(bins[b].high, box.high);
+			++bins[b].count;
+		}
+		float rightArea[kBins];
+		int rightCount[kBins];
+		Bin right;
+		for (int b = kBins - 1; b > 0; --b) {
+			right.low = glm::min(right.low, bins[b].low);
+			right.high = glm::max(right.high, bins[b].high);
+			right.count += bins[b].count;
+			rightArea[b] = right.count ? Area(right.low, right.high) : 0.0f;
+			rightCount[b] = right.count;
+		}
+		Bin left;
+		for (int b = 1; b < kBins; ++b) {
+			left.low = glm::min(left.low, bins[b - 1].low);
+			left.high = glm::max(left.high, bins[b - 1].high);
+			left.count += bins[b - 1].count;
+			if (left.count == 0 || rightCount[b] == 0) continue;
+			float cost = Area(left.low, left.high) * left.count + rightArea[b] * rightCount[b];
+			if (cost < bestCost) {
+				bestCost = cost;
+				split = b;
+			}
+		}
+		if (count <= kMaxLeafBoxes && bestCost >= Area(low, high) * count) return index;
+	}
+
+	uint32_t middle = first;
+	if (bestCost < FLT_MAX) {
+		float scale = kBins / extent[axis];
+		float lowCentroid = centroidLow[axis];
+		BoxBvh::Box* begin = bvh.boxes.data() + first;
+		BoxBvh::Box* end = begin + count;
+		middle = static_cast<uint32_t>(std::partition(begin, end, [&](const BoxBvh::Box& box) {
+			return std::min(static_cast<int>((Centroid(box)[axis] - lowCentroid) * scale), kBins - 1) < split;
+		}) - bvh.boxes.data());
+	}
+	if (middle == first || middle == first + count) {
+		// Identical centroids: halve by count
+		middle = first + count / 2;
+		std::nth_element(bvh.boxes.begin() + first, bvh.boxes.begin() + middle, bvh.boxes.begin() + first + count,
+			[axis](const BoxBvh::Box& a, const BoxBvh::Box& b) { return Centroid(a)[axis] < Centroid(b)[axis]; });
+	}
+
+	Subdivide(bvh, first, middle - first);
+	uint32_t second = Subdivide(bvh, middle, first + count - middle);
+	BoxBvh::Node& parent = bvh.nodes[index];
+	parent.offset = second;
+	parent.count = 0;
+	parent.axis = static_cast<uint16_t>(axis);
+	return index;
+}
+
+// Entry distance of the ray into the box, if it enters before tMax
+bool Slab(const glm::vec3& low, const glm::vec3& high, const TraceRay& ray, float tMax, float& tEnter) {
+	glm::vec3 t0 = (low - ray.origin) * ray.inverse;
+	glm::vec3 t1 = (high - ray.origin) * ray.inverse;
+	glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+	tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+	float tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+	return tEnter <= tExit;
+}
+
+// The flat ground under the whole city
+void IntersectGround(const TraceRay& ray, float height, TraceHit& hit) {
+	if (ray.direction.y >= 0.0f || ray.origin.y <= height) return;
+	float t = (height - ray.origin.y) / ray.direction.y;
+	if (t < hit.t) {
+		hit.t = t;
+		hit.building = kTraceGround;
+	}
+}
+
+// PCG hash, for seeding and stepping each pixel's random sequence
+uint32_t Hash(uint32_t value) {
+	uint32_t state = value * 747796405u + 2891336453u;
+	uint32_t word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+	return (word >> 22) ^ word;
+}
+
+struct Random {
+	uint32_t state;
+	float next() {
+		state = Hash(state);
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+};
+
+// Cosine weighted, so the diffuse BRDF over the pdf leaves just the albedo
+glm::vec3 SampleHemisphere(const glm::vec3& normal, Random& random) {
+	float r = std::sqrt(random.next());
+	float phi = 2.0f * kPi * random.next();
+	glm::vec3 tangent = std::fabs(normal.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	tangent = glm::normalize(glm::cross(tangent, normal));
+	glm::vec3 bitangent = glm::cross(normal, tangent);
+	return r * std::cos(phi) * tangent + r * std::sin(phi) * bitangent + std::sqrt(std::max(1.0f - r * r, 0.0f)) * normal;
+}
+
+} // namespace
+
+TraceRay::TraceRay(const glm::vec3& origin, const glm::vec3& direction, float tMax)
+	: origin(origin), direction(direction), tMax(tMax) {
+	for (int i = 0; i < 3; ++i) {
+		float d = std::fabs(direction[i]) > 1e-20f ? direction[i] : 1e-20f;
+		inverse[i] = 1.0f / d;
+	}
+}
+
+void BoxBvh::build(const CityBuilding* buildings, size_t count) {
+	boxes.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		boxes[i].low = buildings[i].position - buildings[i].scale;
+		boxes[i].high = buildings[i].position + buildings[i].scale;
+		boxes[i].building = static_cast<uint32_t>(i);
+		boxes[i].padding = 0;
+	}
+	nodes.clear();
+	if (count == 0) return;
+	nodes.reserve(count * 2);
+	Subdivide(*this, 0, static_cast<uint32_t>(count));
+}
+
+TraceHit BoxBvh::intersect(const TraceRay& ray) const {
+	TraceHit hit = { ray.tMax, kTraceMiss };
+	if (nodes.empty()) return hit;
+	uint32_t stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		float tEnter;
+		if (!Slab(node.low, node.high, ray, hit.t, tEnter)) continue;
+		if (node.count) {
+			for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+				if (Slab(boxes[i].low, boxes[i].high, ray, hit.t, tEnter) && tEnter < hit.t) {
+					hit.t = tEnter;
+					hit.building = boxes[i].building;
+				}
+			}
+			continue;
+		}
+		uint32_t first = static_cast<uint32_t>(&node - nodes.data()) + 1;
+		// Nearer child on top
+		if (ray.direction[node.axis] < 0.0f) {
+			stack[top++] = first;
+			stack[top++] = node.offset;
+		}
+		else {
+			stack[top++] = node.offset;
+			stack[top++] = first;
+		}
+	}
+	return hit;
+}
+
+bool BoxBvh::occluded(const TraceRay& ray) const {
+	if (nodes.empty()) return false;
+	uint32_t stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		float tEnter;
+		if (!Slab(node.low, node.high, ray, ray.tMax, tEnter)) continue;
+		if (node.count) {
+			for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+				if (Slab(boxes[i].low, boxes[i].high, ray, ray.tMax, tEnter)) return true;
+			}
+			continue;
+		}
+		stack[top++] = node.offset;
+		stack[top++] = static_cast<uint32_t>(&node - nodes.data()) + 1;
+	}
+	return false;
+}
+
+#if LAB2_TRACE_SSE
+
+void BoxBvh::intersect4(const TraceRay* rays, TraceHit* hits) const {
+	for (int k = 0; k < 4; ++k) {
+		hits[k].t = rays[k].tMax;
+		hits[k].building = kTraceMiss;
+	}
+	if (nodes.empty()) return;
+
+	// Structure of arrays, one lane per ray
+	__m128 ox = _mm_setr_ps(rays[0].origin.x, rays[1].origin.x, rays[2].origin.x, rays[3].origin.x);
+	__m128 oy = _mm_setr_ps(rays[0].origin.y, rays[1].origin.y, rays[2].origin.y, rays[3].origin.y);
+	__m128 oz = _mm_setr_ps(rays[0].origin.z, rays[1].origin.z, rays[2].origin.z, rays[3].origin.z);
+	__m128 ix = _mm_setr_ps(rays[0].inverse.x, rays[1].inverse.x, rays[2].inverse.x, rays[3].inverse.x);
+	__m128 iy = _mm_setr_ps(rays[0].inverse.y, rays[1].inverse.y, rays[2].inverse.y, rays[3].inverse.y);
+	__m128 iz = _mm_setr_ps(rays[0].inverse.z, rays[1].inverse.z, rays[2].inverse.z, rays[3].inverse.z);
+	__m128 t = _mm_setr_ps(hits[0].t, hits[1].t, hits[2].t, hits[3].t);
+	__m128i building = _mm_set1_epi32(static_cast<int>(kTraceMiss));
+	__m128 zero = _mm_setzero_ps();
+
+	// Entry distances of the four rays into a box, and which of them enter
+	// before their current hit
+	auto slab = [&](const glm::vec3& low, const glm::vec3& high, __m128& tEnter) {
+		__m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(low.x), ox), ix);
+		__m128 x1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(high.x), ox), ix);
+		__m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(low.y), oy), iy);
+		__m128 y1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(high.y), oy), iy);
+		__m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(low.z), oz), iz);
+		__m128 z1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(high.z), oz), iz);
+		tEnter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), zero));
+		__m128 tExit = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), t));
+		return _mm_cmple_ps(tEnter, tExit);
+	};
+
+	uint32_t stack[kStackSize];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const Node& node = nodes[stack[--top]];
+		__m128 tEnter;
+		if (!_mm_movemask_ps(slab(node.low, node.high, tEnter))) continue;
+		if (node.count) {
+			for (uint32_t i = node.offset; i < node.offset + node.count; ++i) {
+				__m128 hit = slab(boxes[i].low, boxes[i].high, tEnter);
+				hit = _mm_and_ps(hit, _mm_cmplt_ps(tEnter, t));
+				if (!_mm_movemask_ps(hit)) continue;
+				t = _mm_or_ps(_mm_and_ps(hit, tEnter), _mm_andnot_ps(hit, t));
+				__m128i hitMask = _mm_castps_si128(hit);
+				building = _mm_or_si128(_mm_and_si128(hitMask, _mm_set1_epi32(static_cast<int>(boxes[i].building))),
+					_mm_andnot_si128(hitMask, building));
+			}
+			continue;
+		}
+		// The rays of a packet head the same way, so the first decides the order
+		uint32_t first = static_cast<uint32_t>(&node - nodes.data()) + 1;
+		if (rays[0].direction[node.axis] < 0.0f) {
+			stack[top++] = first;
+			stack[top++] = node.offset;
+		}
+		else {
+			stack[top++] = node.offset;
+			stack[top++] = first;
+		}
+	}
+
+	float tOut[4];
+	uint32_t buildingOut[4];
+	_mm_storeu_ps(tOut, t);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(buildingOut), building);
+	for (int k = 0; k < 4; ++k) {
+		if (buildingOut[k] == kTraceMiss) continue;
+		hits[k].t = tOut[k];
+		hits[k].building = buildingOut[k];
+	}
+}
+
+#else
+
+void BoxBvh::intersect4(const TraceRay* rays, TraceHit* hits) const {
+	for (int k = 0; k < 4; ++k) {
+		hits[k] = intersect(rays[k]);
+	}
+}
+
+#endif
+
+void PathTracer::initialize(const CityScene& city, const PathTraceSettings& settings) {
+	this->city = &city;
+	this->settings = settings;
+	materials.resize(city.materialNames.size(), nullptr);
+	uint64_t start = ProfilerNow();
+	bvh.build(city.buildings, city.buildingCount);
+	buildMs = (ProfilerNow() - start) * 1e-6;
+	reset();
+}
+
+void PathTracer::reset() {
+	accumulation.assign(static_cast<size_t>(settings.width) * settings.height, glm::vec3(0.0f));
+	passes = 0;
+	rays = 0;
+	renderMs = 0.0;
+}
+
+namespace {
+
+// Normal and albedo where a ray hit a building, with the box mesh's facade
+// mapping: u once across each side, v five times up it, roofs and floors
+// taking the texel at the origin
+void BuildingSurface(const PathTracer& tracer, uint32_t index, const glm::vec3& position, glm::vec3& normal,
+	glm::vec3& albedo) {
+	const CityBuilding& building = tracer.city->buildings[index];
+	glm::vec3 local = (position - building.position) / building.scale;
+	glm::vec3 magnitude = glm::abs(local);
+	int axis = magnitude.x >= magnitude.y && magnitude.x >= magnitude.z ? 0 : (magnitude.y >= magnitude.z ? 1 : 2);
+	normal = glm::vec3(0.0f);
+	normal[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+
+	glm::vec2 uv(0.0f);
+	if (axis != 1) {
+		float across = axis == 2 ? local.x * normal.z : -local.z * normal.x;
+		uv = glm::vec2((across + 1.0f) * 0.5f, (1.0f - local.y) * 0.5f * 5.0f);
+	}
+	const SoftTexture* texture = building.material < tracer.materials.size() ? tracer.materials[building.material] : nullptr;
+	albedo = texture ? texture->sample(uv, 0.0f) : glm::vec3(0.5f);
+}
+
+TraceHit Trace(const PathTracer& tracer, const TraceRay& ray) {
+	TraceHit hit = tracer.bvh.intersect(ray);
+	IntersectGround(ray, tracer.settings.groundHeight, hit);
+	return hit;
+}
+
+// Radiance arriving along a ray that has already been traced to hit
+glm::vec3 ShadePath(const PathTracer& tracer, TraceRay ray, TraceHit hit, Random& random, unsigned long long& rays) {
+	const PathTraceSettings& settings = tracer.settings;
+	glm::vec3 throughput(1.0f), radiance(0.0f);
+	for (int bounce = 0;; ++bounce) {
+		if (hit.building == kTraceMiss) {
+			radiance += throughput * settings.skyRadiance;
+			break;
+		}
+		glm::vec3 position = ray.origin + ray.direction * hit.t;
+		glm::vec3 normal, albedo;
+		if (hit.building == kTraceGround) {
+			normal = glm::vec3(0.0f, 1.0f, 0.0f);
+			albedo = settings.groundAlbedo;
+		}
+		else {
+			BuildingSurface(tracer, hit.building, position, normal, albedo);
+		}
+		glm::vec3 origin = position + normal * kSurfaceOffset;
+
+		// The point light, as in box.frag but shadowed
+		glm::vec3 toLight = settings.lightPosition - origin;
+		float distanceSquared = glm::dot(toLight, toLight);
+		float distance = std::sqrt(distanceSquared);
+		float cosine = glm::dot(normal, toLight) / distance;
+		if (cosine > 0.0f) {
+			++rays;
+			if (!tracer.bvh.occluded(TraceRay(origin, toLight / distance, distance))) {
+				glm::vec3 irradiance = settings.lightIntensity / (4.0f * kPi * distanceSquared);
+				radiance += throughput * albedo / kPi * cosine * irradiance;
+			}
+		}
+
+		if (bounce == settings.maxBounces) break;
+		throughput *= albedo;
+		ray = TraceRay(origin, SampleHemisphere(normal, random), FLT_MAX);
+		hit = Trace(tracer, ray);
+		++rays;
+	}
+	return radiance;
+}
+
+} // namespace
+
+void PathTracer::renderPass() {
+	PROFILE_ZONE("Path trace pass");
+	uint64_t start = ProfilerNow();
+	int width = settings.width, height = settings.height;
+	int tilesX = (width + kTileSize - 1) / kTileSize;
+	int tilesY = (height + kTileSize - 1) / kTileSize;
+
+	glm::vec3 forward = glm::normalize(settings.lookat - settings.eye);
+	glm::vec3 right = glm::normalize(glm::cross(forward, settings.up));
+	glm::vec3 up = glm::cross(right, forward);
+	float tanHalf = std::tan(glm::radians(settings.fovDegrees) * 0.5f);
+	glm::vec3 pixelRight = right * (2.0f * tanHalf / height);
+	glm::vec3 pixelDown = -up * (2.0f * tanHalf / height);
+	glm::vec3 corner = forward - pixelRight * (width * 0.5f) - pixelDown * (height * 0.5f);
+
+	std::atomic<unsigned long long> passRays(0);
+	int pass = passes;
+	JobCounter done;
+	JobParallelFor(static_cast<size_t>(tilesX) * tilesY, 1, [&](size_t begin, size_t end) {
+		unsigned long long tileRays = 0;
+		for (size_t tile = begin; tile < end; ++tile) {
+			int tileX = static_cast<int>(tile % tilesX) * kTileSize;
+			int tileY = static_cast<int>(tile / tilesX) * kTileSize;
+			for (int y = tileY; y < std::min(tileY + kTileSize, height); y += 2) {
+				for (int x = tileX; x < std::min(tileX + kTileSize, width); x += 2) {
+					// A 2 x 2 quad of jittered primary rays; lanes past the edge
+					// repeat a pixel inside and are dropped
+					TraceRay primary[4];
+					TraceHit hits[4];
+					Random random[4];
+					int pixels[4];
+					for (int k = 0; k < 4; ++k) {
+						int px = std::min(x + (k & 1), width - 1), py = std::min(y + (k >> 1), height - 1);
+						pixels[k] = py * width + px;
+						random[k].state = Hash(static_cast<uint32_t>(pixels[k]) ^ Hash(static_cast<uint32_t>(pass)));
+						float jx = px + random[k].next(), jy = py + random[k].next();
+						primary[k] = TraceRay(settings.eye, glm::normalize(corner + pixelRight * jx + pixelDown * jy), FLT_MAX);
+					}
+					bvh.intersect4(primary, hits);
+					for (int k = 0; k < 4; ++k) {
+						if ((k & 1 && x + 1 >= width) || (k >> 1 && y + 1 >= height)) continue;
+						IntersectGround(primary[k], settings.groundHeight, hits[k]);
+						++tileRays;
+						accumulation[pixels[k]] += ShadePath(*this, primary[k], hits[k], random[k], tileRays);
+					}
+				}
+			}
+		}
+		passRays += tileRays;
+	}, &done);
+	JobWait(&done);
+
+	++passes;
+	rays += passRays;
+	renderMs += (ProfilerNow() - start) * 1e-6;
+}
+
+void PathTracer::resolve(std::vector<uint8_t>& rgb) const {
+	rgb.resize(accumulation.size() * 3);
+	float scale = passes > 0 ? settings.exposure / passes : 0.0f;
+	for (size_t i = 0; i < accumulation.size(); ++i) {
+		for (int c = 0; c < 3; ++c) {
+			float mapped = accumulation[i][c] * scale;
+			float display = std::pow(mapped / (1.0f + mapped), 1.0f / 2.2f);
+			rgb[i * 3 + c] = static_cast<uint8_t>(std::min(display, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+}
+
+void PathTraceFrameCity(const CityScene& city, PathTraceSettings& settings) {
+	if (city.chunkCount == 0) return;
+	glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+	for (size_t c = 0; c < city.chunkCount; ++c) {
+		low = glm::min(low, city.chunks[c].boundsMin);
+		high = glm::max(high, city.chunks[c].boundsMax);
+	}
+	float extent = std::max(high.x - low.x, high.z - low.z) * 0.5f;
+	settings.lookat = glm::vec3((low.x + high.x) * 0.5f, low.y, (low.z + high.z) * 0.5f);
+	settings.eye = settings.lookat + glm::vec3(0.0f, high.y - low.y + extent * 1.2f, extent * 1.2f);
+}
@@ -0,0 +1,120 @@
+#ifndef _PATH_TRACER_H_
+#define _PATH_TRACER_H_
+
+#include <glm/glm.hpp>
+#include "city_scene.h"
+#include "soft_raster.h"
+
+#include <cstdint>
+#include <vector>
+
+// Reference path tracer for the city, for checking the rasterizers' lighting
+// and approximations such as levels of detail against ground truth, and for
+// stills.
+//
+// Every building is traced as its box, through a bounding volume hierarchy
+// built with the binned surface area heuristic. Primary rays go through it in
+// packets of four, 2 x 2 pixels, with SSE; bounces and shadow rays, which
+// scatter, go one at a time. Tiles are rendered in parallel on the job
+// system, and each pass adds one sample per pixel to the accumulation, so a
+// render can be written out at any point and keeps converging.
+//
+// Lighting is box.frag's point light, with shadows, and a sky whose uniform
+// radiance is the rasterizer's ambient term: an unoccluded roof gets the same
+// ambient either way, so differences come from occlusion and light bouncing
+// between the buildings and off the ground, a flat diffuse plane.
+
+const uint32_t kTraceMiss = ~0u;
+const uint32_t kTraceGround = ~0u - 1;
+
+struct TraceRay {
+	glm::vec3 origin;
+	glm::vec3 direction;
+	glm::vec3 inverse;		// Of the direction, with no infinities
+	float tMax;
+
+	TraceRay() {}
+	TraceRay(const glm::vec3& origin, const glm::vec3& direction, float tMax);
+};
+
+struct TraceHit {
+	float t;
+	uint32_t building;		// Or kTraceMiss or kTraceGround
+};
+
+struct BoxBvh {
+	struct Box {
+		glm::vec3 low;
+		uint32_t building;
+		glm::vec3 high;
+		uint32_t padding;
+	};
+	// The first child of an inner node directly follows it
+	struct Node {
+		glm::vec3 low;
+		uint32_t offset;		// First box of a leaf, or the second child
+		glm::vec3 high;
+		uint16_t count;			// Boxes in a leaf, 0 for inner nodes
+		uint16_t axis;			// Of the split, for visiting the nearer child first
+	};
+	std::vector<Box> boxes;		// In leaf order
+	std::vector<Node> nodes;
+
+	void build(const CityBuilding* buildings, size_t count);
+
+	// Nearest box hit closer than the ray's tMax, kTraceMiss if none
+	TraceHit intersect(const TraceRay& ray) const;
+	// Same for four rays at once, faster when they travel together
+	void intersect4(const TraceRay* rays, TraceHit* hits) const;
+	// Any box hit closer than tMax
+	bool occluded(const TraceRay& ray) const;
+};
+
+struct PathTraceSettings {
+	int width = 1024;
+	int height = 768;
+	glm::vec3 eye = glm::vec3(600.0f, 100.0f, 0.0f);
+	glm::vec3 lookat = glm::vec3(0.0f);
+	glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+	float fovDegrees = 45.0f;		// Vertical, as in the viewer
+	int maxBounces = 3;
+	glm::vec3 lightPosition = glm::vec3(0.0f);
+	glm::vec3 lightIntensity = glm::vec3(0.0f);
+	glm::vec3 skyRadiance = glm::vec3(0.0f);
+	float groundHeight = 0.0f;
+	glm::vec3 groundAlbedo = glm::vec3(0.2f);
+	float exposure = 36.0f;
+};
+
+// Points the camera down at the middle of the city from above its tallest
+// building, south of centre, far enough back to take in most of it. Leaves
+// the settings alone for an empty scene.
+void PathTraceFrameCity(const CityScene& city, PathTraceSettings& settings);
+
+struct PathTracer {
+	PathTraceSettings settings;
+	const CityScene* city = nullptr;
+	std::vector<const SoftTexture*> materials;	// Per city material, null for plain grey
+	BoxBvh bvh;
+	double buildMs = 0.0;
+
+	std::vector<glm::vec3> accumulation;	// Sum of the samples, top row first
+	int passes = 0;
+	unsigned long long rays = 0;			// Traced so far, primary, bounce and shadow
+	double renderMs = 0.0;					// Spent in passes so far
+
+	// Builds the hierarchy and clears the accumulation
+	void initialize(const CityScene& city, const PathTraceSettings& settings);
+	void reset();
+
+	// Adds one sample to every pixel
+	void renderPass();
+
+	// The average so far through the post pass's exposure, tone mapping and
+	// gamma, as RGB8 rows, top first
+	void resolve(std::vector<uint8_t>& rgb) const;
+
+	double raysPerSecond() const { return renderMs > 0.0 ? rays / (renderMs * 1e-3) : 0.0; }
+};
+
+#endif
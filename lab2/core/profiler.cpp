@@ -0,0 +1,198 @@
+#include "profiler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+std::atomic<bool> gProfilerEnabled(true);
+
+namespace {
+
+struct ZoneEvent {
+	const char* name;
+	uint64_t start;
+	uint64_t end;		// 0 for markers, which ProfilerNow never returns
+};
+
+// Power of two so the write index can be masked instead of wrapped.
+const uint64_t kEventsPerThread = 1 << 16;
+const uint64_t kFrameHistory = 1 << 10;
+
+struct ThreadBuffer {
+	ZoneEvent events[kEventsPerThread];
+	std::atomic<uint64_t> head;		// Total events ever written, only advanced by the owner
+	int threadId;
+	std::string threadName;
+
+	ThreadBuffer() : head(0), threadId(0) {}
+};
+
+std::mutex buffersMutex;	// Guards registration and the thread names, never taken per zone
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+thread_local ThreadBuffer* localBuffer = nullptr;
+
+// Frame start times are written by the main thread only
+uint64_t frameStarts[kFrameHistory];
+std::atomic<uint64_t> frameCount(0);
+uint64_t currentFrameStart = 0;
+
+float frameBudgetMs = 0.0f;
+int hitchFramesToDump = 8;
+uint64_t nextHitchDumpFrame = 0;
+int hitchDumpsWritten = 0;
+const int kMaxHitchDumps = 16;
+
+ThreadBuffer* GetThreadBuffer() {
+	if (localBuffer == nullptr) {
+		std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		buffer->threadId = static_cast<int>(buffers.size());
+		localBuffer = buffer.get();
+		buffers.push_back(std::move(buffer));
+	}
+	return localBuffer;
+}
+
+void WriteEscaped(FILE* file, const char* text) {
+	for (const char* c = text; *c; ++c) {
+		if (*c == '"' || *c == '\\') fputc('\\', file);
+		fputc(*c, file);
+	}
+}
+
+} // namespace
+
+uint64_t ProfilerNow() {
+	static const auto origin = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::steady_clock::now() - origin;
+	// Never return 0 so a zone can use it as the "not recording" marker
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) + 1;
+}
+
+void ProfilerRecordZone(const char* name, uint64_t start, uint64_t end) {
+	ThreadBuffer* buffer = GetThreadBuffer();
+	uint64_t index = buffer->head.load(std::memory_order_relaxed);
+	ZoneEvent& event = buffer->events[index & (kEventsPerThread - 1)];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	buffer->head.store(index + 1, std::memory_order_release);
+}
+
+void ProfilerRecordMarker(const char* name) {
+	if (!gProfilerEnabled.load(std::memory_order_relaxed)) return;
+	ProfilerRecordZone(name, ProfilerNow(), 0);
+}
+
+void ProfilerSetThreadName(const char* name) {
+	ThreadBuffer* buffer = GetThreadBuffer();
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	buffer->threadName = name;
+}
+
+void ProfilerSetFrameBudget(float budgetMs, int framesToDump) {
+	frameBudgetMs = budgetMs;
+	hitchFramesToDump = framesToDump > 0 ? framesToDump : 1;
+}
+
+void ProfilerBeginFrame() {
+	currentFrameStart = ProfilerNow();
+	uint64_t frame = frameCount.load(std::memory_order_relaxed);
+	frameStarts[frame & (kFrameHistory - 1)] = currentFrameStart;
+}
+
+void ProfilerEndFrame() {
+	uint64_t end = ProfilerNow();
+	uint64_t frame = frameCount.load(std::memory_order_relaxed);
+	if (gProfilerEnabled.load(std::memory_order_relaxed)) {
+		ProfilerRecordZone("Frame", currentFrameStart, end);
+	}
+	frameCount.store(frame + 1, std::memory_order_release);
+
+	// Automatic hitch capture, rate limited so a slow machine does not fill the disk
+	float frameMs = (end - currentFrameStart) * 1e-6f;
+	if (frameBudgetMs > 0.0f && frameMs > frameBudgetMs &&
+		gProfilerEnabled.load(std::memory_order_relaxed) &&
+		frame >= nextHitchDumpFrame &&
+		hitchDumpsWritten < kMaxHitchDumps) {
+		nextHitchDumpFrame = frame + hitchFramesToDump;
+		++hitchDumpsWritten;
+
+		std::string path = "hitch_frame" + std::to_string(frame) + ".json";
+		if (ProfilerDumpTrace(path.c_str(), hitchFramesToDump)) {
+			printf("Frame %llu took %.2f ms (budget %.2f ms), trace written to %s\n",
+				static_cast<unsigned long long>(frame), frameMs, frameBudgetMs, path.c_str());
+		}
+	}
+}
+
+bool ProfilerDumpTrace(const char* path, int lastFrames) {
+	uint64_t since = 0;
+	uint64_t frames = frameCount.load(std::memory_order_acquire);
+	if (lastFrames > 0 && frames > 0) {
+		uint64_t count = static_cast<uint64_t>(lastFrames);
+		if (count > kFrameHistory - 1) count = kFrameHistory - 1;
+		uint64_t first = frames > count ? frames - count : 0;
+		since = frameStarts[first & (kFrameHistory - 1)];
+	}
+
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		printf("Failed to open trace file %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n");
+	bool first = true;
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	std::vector<ZoneEvent> snapshot;
+	for (auto& buffer : buffers) {
+		if (!buffer->threadName.empty()) {
+			fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"",
+				first ? "" : ",\n", buffer->threadId);
+			WriteEscaped(file, buffer->threadName.c_str());
+			fprintf(file, "\"}}");
+			first = false;
+		}
+
+		// Copy the live window, then drop whatever the owner overwrote during the
+		// copy. Event head shares a slot with head - kEventsPerThread and may be
+		// half written, as head is only published after the write, so neither
+		// window keeps that slot.
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t begin = head + 1 > kEventsPerThread ? head + 1 - kEventsPerThread : 0;
+		snapshot.clear();
+		for (uint64_t i = begin; i < head; ++i) {
+			snapshot.push_back(buffer->events[i & (kEventsPerThread - 1)]);
+		}
+		uint64_t headAfter = buffer->head.load(std::memory_order_acquire);
+		uint64_t valid = headAfter + 1 > kEventsPerThread ? headAfter + 1 - kEventsPerThread : 0;
+
+		for (uint64_t i = begin; i < head; ++i) {
+			if (i < valid) continue;
+			const ZoneEvent& event = snapshot[i - begin];
+			bool marker = event.end == 0;
+			if ((marker ? event.start : event.end) < since) continue;
+			fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+			WriteEscaped(file, event.name);
+			if (marker) {
+				fprintf(file, "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":0,\"tid\":%d,\"ts\":%.3f}",
+					buffer->threadId, event.start * 1e-3);
+			}
+			else {
+				fprintf(file, "\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					buffer->threadId, event.start * 1e-3, (event.end - event.start) * 1e-3);
+			}
+			first = false;
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,64 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include <atomic>
+#include <cstdint>
+
+// Scoped CPU profiling zones.
+//
+// Every thread that opens a zone gets its own fixed-size ring buffer of
+// events. Only the owning thread ever writes to it, so recording a zone is
+// two clock reads and a store with no locks. Dumps read the rings from any
+// thread and may lose the few events that are being overwritten at that
+// moment, which is fine for a trace.
+//
+// Build with LAB2_PROFILER=0 to compile the zones out entirely. When compiled
+// in but disabled at runtime, a zone costs one relaxed atomic load.
+
+#ifndef LAB2_PROFILER
+#define LAB2_PROFILER 1
+#endif
+
+extern std::atomic<bool> gProfilerEnabled;
+
+uint64_t ProfilerNow();		// Nanoseconds on a monotonic clock
+
+void ProfilerRecordZone(const char* name, uint64_t start, uint64_t end);
+
+// Records an instant event at the current time, for decisions and state
+// changes that are worth seeing in the trace. The name must outlive the dump.
+void ProfilerRecordMarker(const char* name);
+void ProfilerSetThreadName(const char* name);
+
+// Frame boundaries, called from the main loop. EndFrame triggers an automatic
+// dump of the last frames whenever a frame exceeds the configured budget.
+void ProfilerBeginFrame();
+void ProfilerEndFrame();
+void ProfilerSetFrameBudget(float budgetMs, int framesToDump);
+
+// Writes every buffered event (or only those from the last N frames when
+// lastFrames > 0) as Chrome trace JSON, viewable in chrome://tracing or Perfetto.
+bool ProfilerDumpTrace(const char* path, int lastFrames = 0);
+
+struct ProfileScope {
+	const char* name;
+	uint64_t start;
+
+	explicit ProfileScope(const char* name) : name(name), start(0) {
+		if (gProfilerEnabled.load(std::memory_order_relaxed)) start = ProfilerNow();
+	}
+
+	~ProfileScope() {
+		if (start != 0) ProfilerRecordZone(name, start, ProfilerNow());
+	}
+};
+
+#if LAB2_PROFILER
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_ZONE(name) ProfileScope PROFILE_CONCAT(profileZone, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) ((void)0)
+#endif
+
+#endif
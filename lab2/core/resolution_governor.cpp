@@ -0,0 +1,83 @@
+#include "resolution_governor.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <cstdio>
+
+namespace {
+
+const int kSettleFrames = 6;			// GPU timings lag about four frames behind
+const float kMaxStep = 0.1f;
+const float kTargetFraction = 0.9f;		// Aim a little under the budget
+const float kHeadroomFraction = 0.7f;	// Below this the scale may grow
+const int kOverloadFrames = 60;
+const int kHeadroomFrames = 180;
+
+const float kDrawDistanceScale[ResolutionGovernor::kQualityLevels] = { 1.0f, 0.8f, 0.6f };
+const float kTextureLodBias[ResolutionGovernor::kQualityLevels] = { 0.0f, 0.5f, 1.0f };
+
+float Clamp(float value, float low, float high) {
+	return value < low ? low : (value > high ? high : value);
+}
+
+} // namespace
+
+bool ResolutionGovernor::update(float gpuMs) {
+	if (gpuMs <= 0.0f) return false;
+	smoothedMs = smoothedMs == 0.0f ? gpuMs : smoothedMs * 0.8f + gpuMs * 0.2f;
+	if (!enabled) return false;
+
+	++framesSinceChange;
+	bool overloaded = smoothedMs > budgetMs;
+	bool headroom = smoothedMs < budgetMs * kHeadroomFraction;
+	overloadedFrames = overloaded ? overloadedFrames + 1 : 0;
+	headroomFrames = headroom ? headroomFrames + 1 : 0;
+
+	// Secondary knobs only move once resolution alone has run out of room
+	if (scale <= minScale && overloadedFrames >= kOverloadFrames && qualityLevel < kQualityLevels - 1) {
+		++qualityLevel;
+		overloadedFrames = 0;
+		framesSinceChange = 0;
+		ProfilerRecordMarker("Quality down");
+		printf("Governor: %.2f ms over %.2f ms budget at minimum scale, quality level %d\n",
+			smoothedMs, budgetMs, qualityLevel);
+		return true;
+	}
+	if (scale >= maxScale && headroomFrames >= kHeadroomFrames && qualityLevel > 0) {
+		--qualityLevel;
+		headroomFrames = 0;
+		framesSinceChange = 0;
+		ProfilerRecordMarker("Quality up");
+		printf("Governor: %.2f ms with headroom at full scale, quality level %d\n", smoothedMs, qualityLevel);
+		return true;
+	}
+
+	if (framesSinceChange < kSettleFrames) return false;
+	if (!overloaded && !headroom) return false;
+
+	float target = scale * std::sqrt(budgetMs * kTargetFraction / smoothedMs);
+	float next = Clamp(Clamp(target, scale - kMaxStep, scale + kMaxStep), minScale, maxScale);
+	if (std::fabs(next - scale) < 0.01f) return false;
+
+	ProfilerRecordMarker(next < scale ? "Resolution down" : "Resolution up");
+	scale = next;
+	framesSinceChange = 0;
+	return true;
+}
+
+void ResolutionGovernor::reset() {
+	scale = maxScale;
+	qualityLevel = 0;
+	smoothedMs = 0.0f;
+	framesSinceChange = 0;
+	overloadedFrames = 0;
+	headroomFrames = 0;
+}
+
+float ResolutionGovernor::drawDistanceScale() const {
+	return kDrawDistanceScale[qualityLevel];
+}
+
+float ResolutionGovernor::textureLodBias() const {
+	return kTextureLodBias[qualityLevel];
+}
@@ -0,0 +1,39 @@
+#ifndef _RESOLUTION_GOVERNOR_H_
+#define _RESOLUTION_GOVERNOR_H_
+
+// Keeps GPU frame time under a budget by scaling the render resolution.
+//
+// Pixel cost goes roughly with the square of the scale, so each step aims for
+// scale * sqrt(target / measured), limited in size and spaced out by a few
+// frames because GPU timings arrive that many frames late. When the scale is
+// pinned at its minimum and the frame is still over budget for a sustained
+// stretch, the quality level drops; when the scale is back at its maximum with
+// plenty of headroom for long enough, it comes back up. Every decision is
+// recorded as a profiler marker.
+struct ResolutionGovernor {
+	static const int kQualityLevels = 3;
+
+	bool enabled = true;
+	float budgetMs = 14.0f;
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+
+	float scale = 1.0f;
+	int qualityLevel = 0;			// 0 is full quality
+
+	float smoothedMs = 0.0f;
+	int framesSinceChange = 0;
+	int overloadedFrames = 0;
+	int headroomFrames = 0;
+
+	// Feeds one frame's GPU time. Returns true when the scale or the quality
+	// level changed.
+	bool update(float gpuMs);
+	void reset();
+
+	// Secondary knobs for the current quality level
+	float drawDistanceScale() const;	// Fraction of the far plane beyond which objects are culled
+	float textureLodBias() const;
+};
+
+#endif
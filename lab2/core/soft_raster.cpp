@@ -0,0 +1,490 @@
+#include "soft_raster.h"
+#include "job_system.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LAB2_RASTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+const float kPi = 3.14159265f;
+const int kGammaSteps = 4096;
+const uint32_t kNoTriangle = ~0u;
+
+// Decoding of sRGB texels, the pow(texColor, 2.2) of box.frag
+struct SrgbTable {
+	float linear[256];
+	SrgbTable() {
+		for (int i = 0; i < 256; ++i) linear[i] = std::pow(i / 255.0f, 2.2f);
+	}
+};
+
+// Gamma of the post pass over tone mapped values in [0, 1]
+struct GammaTable {
+	uint8_t encoded[kGammaSteps];
+	GammaTable() {
+		for (int i = 0; i < kGammaSteps; ++i) {
+			encoded[i] = static_cast<uint8_t>(std::pow(i / (kGammaSteps - 1.0f), 1.0f / 2.2f) * 255.0f + 0.5f);
+		}
+	}
+};
+
+const SrgbTable& Srgb() {
+	static const SrgbTable table;
+	return table;
+}
+
+const GammaTable& Gamma() {
+	static const GammaTable table;
+	return table;
+}
+
+int Wrap(int i, int size) {
+	if (i >= 0 && i < size) return i;
+	i %= size;
+	return i < 0 ? i + size : i;
+}
+
+uint32_t PackDisplay(const glm::vec3& c) {
+	const GammaTable& gamma = Gamma();
+	uint32_t packed = 0xff000000u;
+	for (int i = 0; i < 3; ++i) {
+		float value = glm::clamp(c[i], 0.0f, 1.0f);
+		packed |= static_cast<uint32_t>(gamma.encoded[static_cast<int>(value * (kGammaSteps - 1) + 0.5f)]) << (8 * i);
+	}
+	return packed;
+}
+
+struct ClipVertex {
+	glm::vec4 position;
+	float attributes[kSoftAttributes];
+};
+
+ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, float t) {
+	ClipVertex v;
+	v.position = a.position + (b.position - a.position) * t;
+	for (int k = 0; k < kSoftAttributes; ++k) {
+		v.attributes[k] = a.attributes[k] + (b.attributes[k] - a.attributes[k]) * t;
+	}
+	return v;
+}
+
+// Sutherland-Hodgman against the near plane, z >= -w. Returns the vertices
+// of the clipped polygon, at most four.
+int ClipNear(const ClipVertex* in, ClipVertex* out) {
+	int count = 0;
+	for (int i = 0; i < 3; ++i) {
+		const ClipVertex& a = in[i];
+		const ClipVertex& b = in[(i + 1) % 3];
+		float da = a.position.z + a.position.w;
+		float db = b.position.z + b.position.w;
+		if (da >= 0.0f) out[count++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f)) out[count++] = Lerp(a, b, da / (da - db));
+	}
+	return count;
+}
+
+// Plane through three values at the vertices, evaluated at integer pixel
+// coordinates for the pixel centres
+void SetPlane(const float* x, const float* y, float f0, float f1, float f2, float inverseArea, float* plane) {
+	float a = ((f1 - f0) * (y[2] - y[0]) - (f2 - f0) * (y[1] - y[0])) * inverseArea;
+	float b = ((f2 - f0) * (x[1] - x[0]) - (f1 - f0) * (x[2] - x[0])) * inverseArea;
+	plane[0] = a;
+	plane[1] = b;
+	plane[2] = f0 - a * (x[0] - 0.5f) - b * (y[0] - 0.5f);
+}
+
+float EvaluatePlane(const float* plane, float x, float y) {
+	return plane[0] * x + plane[1] * y + plane[2];
+}
+
+// Narrows [x0, x1] on row y to where every edge can be non-negative, with a
+// pixel of slack for rounding; the edge tests decide the exact pixels
+void RowSpan(const SoftTriangle& triangle, float y, int& x0, int& x1) {
+	for (int i = 0; i < 3; ++i) {
+		const float* edge = triangle.edges[i];
+		float value = edge[1] * y + edge[2];
+		if (edge[0] > 0.0f) {
+			float low = -value / edge[0] - 1.0f;
+			if (low > x0) x0 = low < x1 + 1.0f ? static_cast<int>(low) : x1 + 1;
+		}
+		else if (edge[0] < 0.0f) {
+			float high = -value / edge[0] + 1.0f;
+			if (high < x1) x1 = high > x0 - 1.0f ? static_cast<int>(high) : x0 - 1;
+		}
+		else if (value < 0.0f) {
+			x1 = x0 - 1;
+		}
+	}
+}
+
+// Projects, culls back faces and off-screen triangles, and fills in the
+// edges and planes. Counter-clockwise is front facing, as with GL_CULL_FACE.
+bool SetupTriangle(const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2, int width, int height,
+	const SoftTexture* texture, SoftTriangle& triangle) {
+	const ClipVertex* v[3] = { &v0, &v1, &v2 };
+	float x[3], y[3], z[3], q[3];
+	for (int k = 0; k < 3; ++k) {
+		if (v[k]->position.w <= 0.0f) return false;
+		q[k] = 1.0f / v[k]->position.w;
+		// Snapped to 1/16 pixel so shared edges rasterize the same from both sides
+		x[k] = std::round((v[k]->position.x * q[k] * 0.5f + 0.5f) * width * 16.0f) / 16.0f;
+		y[k] = std::round((v[k]->position.y * q[k] * 0.5f + 0.5f) * height * 16.0f) / 16.0f;
+		z[k] = v[k]->position.z * q[k] * 0.5f + 0.5f;
+	}
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (!(area > 0.0f)) return false;
+
+	// Pixels whose centres can be inside
+	float lowX = std::min(x[0], std::min(x[1], x[2])), highX = std::max(x[0], std::max(x[1], x[2]));
+	float lowY = std::min(y[0], std::min(y[1], y[2])), highY = std::max(y[0], std::max(y[1], y[2]));
+	triangle.minX = static_cast<int>(std::ceil(std::max(lowX - 0.5f, 0.0f)));
+	triangle.minY = static_cast<int>(std::ceil(std::max(lowY - 0.5f, 0.0f)));
+	triangle.maxX = static_cast<int>(std::floor(std::min(highX - 0.5f, width - 1.0f)));
+	triangle.maxY = static_cast<int>(std::floor(std::min(highY - 0.5f, height - 1.0f)));
+	if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) return false;
+
+	triangle.topLeft = 0;
+	for (int i = 0; i < 3; ++i) {
+		int j = (i + 1) % 3;
+		float a = y[i] - y[j];
+		float b = x[j] - x[i];
+		triangle.edges[i][0] = a;
+		triangle.edges[i][1] = b;
+		triangle.edges[i][2] = -(a * x[i] + b * y[i]) + 0.5f * (a + b);
+		// Left edges run down the screen, top edges run left
+		if (a > 0.0f || (a == 0.0f && b < 0.0f)) triangle.topLeft |= 1u << i;
+	}
+
+	float inverseArea = 1.0f / area;
+	SetPlane(x, y, z[0], z[1], z[2], inverseArea, triangle.depth);
+	SetPlane(x, y, q[0], q[1], q[2], inverseArea, triangle.inverseW);
+	for (int k = 0; k < kSoftAttributes; ++k) {
+		SetPlane(x, y, v0.attributes[k] * q[0], v1.attributes[k] * q[1], v2.attributes[k] * q[2], inverseArea,
+			triangle.attributes[k]);
+	}
+	triangle.texture = texture;
+	return true;
+}
+
+// Sets up every triangle of a draw into out, returning how many survived
+size_t SetupDraw(const SoftDraw& draw, int width, int height, SoftTriangle* out) {
+	const MeshData& mesh = *draw.mesh;
+	size_t written = 0;
+	ClipVertex corners[3], clipped[4];
+	for (uint32_t i = draw.firstIndex; i + 2 < draw.firstIndex + draw.indexCount; i += 3) {
+		unsigned int outside = 0x3f;
+		bool needsClip = false;
+		for (int k = 0; k < 3; ++k) {
+			const MeshVertex& vertex = mesh.vertices[mesh.indices[i + k]];
+			glm::vec4 position(vertex.position, 1.0f);
+			ClipVertex& corner = corners[k];
+			corner.position = draw.mvp * position;
+			glm::vec3 world(draw.world * position);
+			// As in box.vert the normal stays in mesh space, which the city's
+			// translate and scale transforms leave pointing the same way for boxes
+			corner.attributes[0] = vertex.uv.x;
+			corner.attributes[1] = vertex.uv.y;
+			corner.attributes[2] = world.x;
+			corner.attributes[3] = world.y;
+			corner.attributes[4] = world.z;
+			corner.attributes[5] = vertex.normal.x;
+			corner.attributes[6] = vertex.normal.y;
+			corner.attributes[7] = vertex.normal.z;
+
+			const glm::vec4& p = corner.position;
+			unsigned int planes = (p.x < -p.w) | (p.x > p.w) << 1 | (p.y < -p.w) << 2 | (p.y > p.w) << 3 |
+				(p.z < -p.w) << 4 | (p.z > p.w) << 5;
+			outside &= planes;
+			needsClip |= (planes & 0x10) != 0;
+		}
+		// All corners outside one plane
+		if (outside) continue;
+
+		if (!needsClip) {
+			if (SetupTriangle(corners[0], corners[1], corners[2], width, height, draw.texture, out[written])) ++written;
+			continue;
+		}
+		int count = ClipNear(corners, clipped);
+		for (int k = 1; k + 1 < count; ++k) {
+			if (SetupTriangle(clipped[0], clipped[k], clipped[k + 1], width, height, draw.texture, out[written])) {
+				++written;
+			}
+		}
+	}
+	return written;
+}
+
+uint32_t ShadePixel(const SoftTriangle& triangle, int px, int py, const SoftShading& shading) {
+	float x = static_cast<float>(px), y = static_cast<float>(py);
+	float q = EvaluatePlane(triangle.inverseW, x, y);
+	float w = 1.0f / q;
+	float values[kSoftAttributes];
+	for (int k = 0; k < kSoftAttributes; ++k) {
+		values[k] = EvaluatePlane(triangle.attributes[k], x, y) * w;
+	}
+
+	glm::vec3 albedo(1.0f);
+	if (triangle.texture) {
+		// Screen derivatives of perspective-correct uv: d(f) = (d(f / w) - f d(1 / w)) w
+		glm::vec2 uv(values[0], values[1]);
+		const float* u = triangle.attributes[0];
+		const float* v = triangle.attributes[1];
+		const float* iw = triangle.inverseW;
+		glm::vec2 ddx((u[0] - uv.x * iw[0]) * w, (v[0] - uv.y * iw[0]) * w);
+		glm::vec2 ddy((u[1] - uv.x * iw[1]) * w, (v[1] - uv.y * iw[1]) * w);
+		const SoftTexture::Level& base = triangle.texture->levels[0];
+		glm::vec2 size(static_cast<float>(base.width), static_cast<float>(base.height));
+		float footprint = std::max(glm::length(ddx * size), glm::length(ddy * size));
+		albedo = triangle.texture->sample(uv, footprint > 1.0f ? std::log2(footprint) : 0.0f);
+	}
+
+	glm::vec3 position(values[2], values[3], values[4]);
+	glm::vec3 normal = glm::normalize(glm::vec3(values[5], values[6], values[7]));
+	glm::vec3 toLight = shading.lightPosition - position;
+	float distanceSquared = std::max(glm::dot(toLight, toLight), 1e-6f);
+	float cosine = std::max(glm::dot(normal, toLight) / std::sqrt(distanceSquared), 0.0f);
+	glm::vec3 irradiance = shading.lightIntensity / (4.0f * kPi * distanceSquared);
+	glm::vec3 radiance = albedo / kPi * cosine * irradiance + albedo * shading.ambientLight;
+
+	glm::vec3 mapped = radiance * shading.exposure;
+	return PackDisplay(mapped / (1.0f + mapped));
+}
+
+// Depth test and coverage of one tile into its visibility buffer, in bin
+// order so equal depths resolve as the draws were submitted
+void RasterTile(const SoftTriangle* triangles, const std::vector<uint32_t>& bin, int tileX, int tileY, int tileWidth,
+	int tileHeight, float* depth, uint32_t* ids) {
+	for (uint32_t slot : bin) {
+		const SoftTriangle& triangle = triangles[slot];
+		int boundsX0 = std::max(triangle.minX, tileX), boundsX1 = std::min(triangle.maxX, tileX + tileWidth - 1);
+		int y0 = std::max(triangle.minY, tileY), y1 = std::min(triangle.maxY, tileY + tileHeight - 1);
+		const float* e0 = triangle.edges[0];
+		const float* e1 = triangle.edges[1];
+		const float* e2 = triangle.edges[2];
+		const float* z = triangle.depth;
+
+#if LAB2_RASTER_SSE
+		const __m128 lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 step0 = _mm_set1_ps(e0[0] * 4.0f), step1 = _mm_set1_ps(e1[0] * 4.0f);
+		const __m128 step2 = _mm_set1_ps(e2[0] * 4.0f), stepZ = _mm_set1_ps(z[0] * 4.0f);
+		const __m128 lane0 = _mm_mul_ps(_mm_set1_ps(e0[0]), lane), lane1 = _mm_mul_ps(_mm_set1_ps(e1[0]), lane);
+		const __m128 lane2 = _mm_mul_ps(_mm_set1_ps(e2[0]), lane), laneZ = _mm_mul_ps(_mm_set1_ps(z[0]), lane);
+		const __m128 topLeft0 = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft & 1 ? -1 : 0));
+		const __m128 topLeft1 = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft & 2 ? -1 : 0));
+		const __m128 topLeft2 = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft & 4 ? -1 : 0));
+		const __m128i slots = _mm_set1_epi32(static_cast<int>(slot));
+		for (int y = y0; y <= y1; ++y) {
+			int x0 = boundsX0, x1 = boundsX1;
+			RowSpan(triangle, static_cast<float>(y), x0, x1);
+			if (x0 > x1) continue;
+			// Tiles start on multiples of four, so whole groups stay inside the tile
+			x0 &= ~3;
+			float fx = static_cast<float>(x0), fy = static_cast<float>(y);
+			__m128 w0 = _mm_add_ps(_mm_set1_ps(EvaluatePlane(e0, fx, fy)), lane0);
+			__m128 w1 = _mm_add_ps(_mm_set1_ps(EvaluatePlane(e1, fx, fy)), lane1);
+			__m128 w2 = _mm_add_ps(_mm_set1_ps(EvaluatePlane(e2, fx, fy)), lane2);
+			__m128 depths = _mm_add_ps(_mm_set1_ps(EvaluatePlane(z, fx, fy)), laneZ);
+			size_t offset = (y - tileY) * kSoftTileSize + (x0 - tileX);
+			float* depthRow = depth + offset;
+			uint32_t* idRow = ids + offset;
+			for (int x = x0; x <= x1; x += 4, depthRow += 4, idRow += 4) {
+				// Inside every edge, or on one that owns its pixels
+				__m128 in0 = _mm_or_ps(_mm_cmpgt_ps(w0, zero), _mm_and_ps(_mm_cmpeq_ps(w0, zero), topLeft0));
+				__m128 in1 = _mm_or_ps(_mm_cmpgt_ps(w1, zero), _mm_and_ps(_mm_cmpeq_ps(w1, zero), topLeft1));
+				__m128 in2 = _mm_or_ps(_mm_cmpgt_ps(w2, zero), _mm_and_ps(_mm_cmpeq_ps(w2, zero), topLeft2));
+				__m128 inside = _mm_and_ps(in0, _mm_and_ps(in1, in2));
+				if (_mm_movemask_ps(inside)) {
+					__m128 stored = _mm_load_ps(depthRow);
+					__m128 pass = _mm_and_ps(inside, _mm_cmplt_ps(depths, stored));
+					if (_mm_movemask_ps(pass)) {
+						_mm_store_ps(depthRow, _mm_or_ps(_mm_and_ps(pass, depths), _mm_andnot_ps(pass, stored)));
+						__m128i passMask = _mm_castps_si128(pass);
+						__m128i previous = _mm_load_si128(reinterpret_cast<const __m128i*>(idRow));
+						_mm_store_si128(reinterpret_cast<__m128i*>(idRow),
+							_mm_or_si128(_mm_and_si128(passMask, slots), _mm_andnot_si128(passMask, previous)));
+					}
+				}
+				w0 = _mm_add_ps(w0, step0);
+				w1 = _mm_add_ps(w1, step1);
+				w2 = _mm_add_ps(w2, step2);
+				depths = _mm_add_ps(depths, stepZ);
+			}
+		}
+#else
+		for (int y = y0; y <= y1; ++y) {
+			int x0 = boundsX0, x1 = boundsX1;
+			RowSpan(triangle, static_cast<float>(y), x0, x1);
+			size_t offset = (y - tileY) * kSoftTileSize;
+			for (int x = x0; x <= x1; ++x) {
+				float fx = static_cast<float>(x), fy = static_cast<float>(y);
+				float w[3] = { EvaluatePlane(e0, fx, fy), EvaluatePlane(e1, fx, fy), EvaluatePlane(e2, fx, fy) };
+				bool inside = true;
+				for (int i = 0; i < 3; ++i) {
+					inside = inside && (w[i] > 0.0f || (w[i] == 0.0f && (triangle.topLeft >> i & 1)));
+				}
+				float d = EvaluatePlane(z, fx, fy);
+				size_t index = offset + (x - tileX);
+				if (inside && d < depth[index]) {
+					depth[index] = d;
+					ids[index] = slot;
+				}
+			}
+		}
+#endif
+	}
+}
+
+} // namespace
+
+void SoftTexture::initialize(const uint8_t* rgba, int width, int height) {
+	levels.clear();
+	levels.emplace_back();
+	levels[0].width = width;
+	levels[0].height = height;
+	levels[0].texels.resize(static_cast<size_t>(width) * height);
+	for (size_t i = 0; i < levels[0].texels.size(); ++i) {
+		const uint8_t* texel = rgba + i * 4;
+		levels[0].texels[i] = texel[0] | texel[1] << 8 | texel[2] << 16 | static_cast<uint32_t>(texel[3]) << 24;
+	}
+
+	// Box filtered down to 1 x 1, odd sizes repeating their last row or column
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		const Level& source = levels.back();
+		Level level;
+		level.width = std::max(1, source.width / 2);
+		level.height = std::max(1, source.height / 2);
+		level.texels.resize(static_cast<size_t>(level.width) * level.height);
+		for (int y = 0; y < level.height; ++y) {
+			for (int x = 0; x < level.width; ++x) {
+				int sx0 = std::min(2 * x, source.width - 1), sx1 = std::min(2 * x + 1, source.width - 1);
+				int sy0 = std::min(2 * y, source.height - 1), sy1 = std::min(2 * y + 1, source.height - 1);
+				uint32_t corners[4] = {
+					source.texels[sy0 * source.width + sx0], source.texels[sy0 * source.width + sx1],
+					source.texels[sy1 * source.width + sx0], source.texels[sy1 * source.width + sx1]
+				};
+				uint32_t packed = 0;
+				for (int channel = 0; channel < 4; ++channel) {
+					uint32_t sum = 2;
+					for (uint32_t corner : corners) sum += corner >> (8 * channel) & 0xff;
+					packed |= (sum / 4) << (8 * channel);
+				}
+				level.texels[y * level.width + x] = packed;
+			}
+		}
+		levels.push_back(std::move(level));
+	}
+}
+
+glm::vec3 SoftTexture::sample(const glm::vec2& uv, float lod) const {
+	const Level& level = levels[std::min(static_cast<int>(lod + 0.5f), static_cast<int>(levels.size()) - 1)];
+	float x = uv.x * level.width - 0.5f;
+	float y = uv.y * level.height - 0.5f;
+	float fx = std::floor(x), fy = std::floor(y);
+	float tx = x - fx, ty = y - fy;
+	int x0 = Wrap(static_cast<int>(fx), level.width), y0 = Wrap(static_cast<int>(fy), level.height);
+	int x1 = x0 + 1 == level.width ? 0 : x0 + 1;
+	int y1 = y0 + 1 == level.height ? 0 : y0 + 1;
+
+	const float* linear = Srgb().linear;
+	uint32_t texels[4] = {
+		level.texels[y0 * level.width + x0], level.texels[y0 * level.width + x1],
+		level.texels[y1 * level.width + x0], level.texels[y1 * level.width + x1]
+	};
+	float weights[4] = { (1.0f - tx) * (1.0f - ty), tx * (1.0f - ty), (1.0f - tx) * ty, tx * ty };
+	glm::vec3 c(0.0f);
+	for (int i = 0; i < 4; ++i) {
+		c += weights[i] * glm::vec3(linear[texels[i] & 0xff], linear[texels[i] >> 8 & 0xff], linear[texels[i] >> 16 & 0xff]);
+	}
+	return c;
+}
+
+void SoftRasterizer::resize(int width, int height) {
+	this->width = width;
+	this->height = height;
+	tilesX = (width + kSoftTileSize - 1) / kSoftTileSize;
+	tilesY = (height + kSoftTileSize - 1) / kSoftTileSize;
+	color.assign(static_cast<size_t>(width) * height, 0);
+	bins.resize(static_cast<size_t>(tilesX) * tilesY);
+}
+
+void SoftRasterizer::render() {
+	stats = SoftRasterStats();
+
+	// Each draw gets two slots per triangle, as clipping can split one in two
+	uint64_t start = ProfilerNow();
+	drawTriangles.resize(draws.size());
+	drawSetUp.assign(draws.size(), 0);
+	size_t slots = 0;
+	for (size_t d = 0; d < draws.size(); ++d) {
+		drawTriangles[d] = slots;
+		slots += draws[d].indexCount / 3 * 2;
+		stats.trianglesSubmitted += draws[d].indexCount / 3;
+	}
+	if (slots > triangleCapacity) {
+		triangleCapacity = slots + slots / 2;
+		triangles.reset(new SoftTriangle[triangleCapacity]);
+	}
+	JobCounter setup;
+	JobParallelFor(draws.size(), 64, [&](size_t begin, size_t end) {
+		for (size_t d = begin; d < end; ++d) {
+			drawSetUp[d] = SetupDraw(draws[d], width, height, triangles.get() + drawTriangles[d]);
+		}
+	}, &setup);
+	JobWait(&setup);
+	uint64_t setupEnd = ProfilerNow();
+	stats.setupMs = (setupEnd - start) * 1e-6;
+
+	for (std::vector<uint32_t>& bin : bins) {
+		bin.clear();
+	}
+	for (size_t d = 0; d < draws.size(); ++d) {
+		stats.trianglesSetUp += drawSetUp[d];
+		for (size_t slot = drawTriangles[d]; slot < drawTriangles[d] + drawSetUp[d]; ++slot) {
+			const SoftTriangle& triangle = triangles[slot];
+			for (int ty = triangle.minY / kSoftTileSize; ty <= triangle.maxY / kSoftTileSize; ++ty) {
+				for (int tx = triangle.minX / kSoftTileSize; tx <= triangle.maxX / kSoftTileSize; ++tx) {
+					bins[ty * tilesX + tx].push_back(static_cast<uint32_t>(slot));
+					++stats.binEntries;
+				}
+			}
+		}
+	}
+	uint64_t binEnd = ProfilerNow();
+	stats.binMs = (binEnd - setupEnd) * 1e-6;
+
+	uint32_t clear = PackDisplay(shading.clearColor);
+	JobCounter raster;
+	JobParallelFor(bins.size(), 1, [&](size_t begin, size_t end) {
+		alignas(16) float depth[kSoftTileSize * kSoftTileSize];
+		alignas(16) uint32_t ids[kSoftTileSize * kSoftTileSize];
+		for (size_t tile = begin; tile < end; ++tile) {
+			int tileX = static_cast<int>(tile % tilesX) * kSoftTileSize;
+			int tileY = static_cast<int>(tile / tilesX) * kSoftTileSize;
+			int tileWidth = std::min(kSoftTileSize, width - tileX);
+			int tileHeight = std::min(kSoftTileSize, height - tileY);
+			std::fill(depth, depth + kSoftTileSize * kSoftTileSize, 1.0f);
+			std::fill(ids, ids + kSoftTileSize * kSoftTileSize, kNoTriangle);
+			RasterTile(triangles.get(), bins[tile], tileX, tileY, tileWidth, tileHeight, depth, ids);
+
+			// Shading once per pixel, after visibility is settled
+			for (int y = 0; y < tileHeight; ++y) {
+				uint32_t* row = color.data() + static_cast<size_t>(tileY + y) * width + tileX;
+				for (int x = 0; x < tileWidth; ++x) {
+					uint32_t slot = ids[y * kSoftTileSize + x];
+					row[x] = slot == kNoTriangle ? clear : ShadePixel(triangles[slot], tileX + x, tileY + y, shading);
+				}
+			}
+		}
+	}, &raster);
+	JobWait(&raster);
+	stats.rasterMs = (ProfilerNow() - binEnd) * 1e-6;
+
+	draws.clear();
+}
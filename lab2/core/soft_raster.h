@@ -0,0 +1,111 @@
+#ifndef _SOFT_RASTER_H_
+#define _SOFT_RASTER_H_
+
+#include <glm/glm.hpp>
+#include "mesh_loader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Software rasterizer for machines without a usable GPU, drawing the
+// buildings with box.frag's material and lighting on the job system.
+//
+// A frame goes through three stages:
+//   setup transforms each draw's triangles in parallel, clips them against
+//   the near plane, culls back faces and turns the rest into edge functions
+//   and screen-space planes of depth, 1/w and attributes over w;
+//   binning files every triangle under the 64 x 64 pixel tiles its bounds
+//   touch, in submission order;
+//   tiles are rasterized in parallel, testing edges and depth four pixels at
+//   a time with SSE into a visibility buffer local to the tile, after which
+//   each covered pixel is shaded once, for its nearest triangle, with
+//   perspective-correct attributes.
+//
+// Output is display-referred RGBA8, tone mapped like the post pass, bottom
+// row first as glReadPixels would return it.
+
+const int kSoftTileSize = 64;
+const int kSoftAttributes = 8;		// uv, world position, normal
+
+// Mip chain of an RGBA8 sRGB texture, sampled bilinearly with repeat wrapping
+struct SoftTexture {
+	struct Level {
+		int width = 0;
+		int height = 0;
+		std::vector<uint32_t> texels;
+	};
+	std::vector<Level> levels;
+
+	void initialize(const uint8_t* rgba, int width, int height);
+
+	// Linear colour, filtered within the level nearest to lod
+	glm::vec3 sample(const glm::vec2& uv, float lod) const;
+};
+
+// One indexed range of a mesh with its transforms
+struct SoftDraw {
+	const MeshData* mesh;
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	glm::mat4 mvp;
+	glm::mat4 world;
+	const SoftTexture* texture;
+};
+
+// box.frag's point light with inverse square falloff plus ambient, then the
+// post pass's exposure, Reinhard tone mapping and gamma
+struct SoftShading {
+	glm::vec3 lightPosition = glm::vec3(0.0f);
+	glm::vec3 lightIntensity = glm::vec3(0.0f);
+	glm::vec3 ambientLight = glm::vec3(0.0f);
+	float exposure = 36.0f;
+	glm::vec3 clearColor = glm::vec3(0.0f);		// Display-referred, where nothing is drawn
+};
+
+struct SoftRasterStats {
+	size_t trianglesSubmitted = 0;
+	size_t trianglesSetUp = 0;		// After clipping and culling
+	size_t binEntries = 0;
+	double setupMs = 0.0;
+	double binMs = 0.0;
+	double rasterMs = 0.0;
+};
+
+// A triangle ready to rasterize. Planes are f(x, y) = a x + b y + c over
+// integer pixel coordinates, already offset to the pixel centres.
+struct SoftTriangle {
+	float edges[3][3];					// Positive inside
+	float depth[3];						// Window depth, affine in screen space
+	float inverseW[3];
+	float attributes[kSoftAttributes][3];	// Each attribute over w
+	int minX, minY, maxX, maxY;			// Pixel bounds, inclusive and on screen
+	uint32_t topLeft;					// Bit per edge that owns the pixels exactly on it
+	const SoftTexture* texture;
+};
+
+struct SoftRasterizer {
+	int width = 0;
+	int height = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+	std::vector<uint32_t> color;		// RGBA8 as bytes in memory
+	SoftShading shading;
+	SoftRasterStats stats;				// Of the last render
+
+	std::vector<SoftDraw> draws;
+	std::unique_ptr<SoftTriangle[]> triangles;	// Two slots per submitted triangle, for near clipping
+	size_t triangleCapacity = 0;
+	std::vector<size_t> drawTriangles;	// Per draw: first slot, then triangles set up
+	std::vector<size_t> drawSetUp;
+	std::vector<std::vector<uint32_t>> bins;	// Triangle slots per tile
+
+	void resize(int width, int height);
+	void submit(const SoftDraw& draw) { draws.push_back(draw); }
+
+	// Draws everything submitted into color and clears the draw list
+	void render();
+};
+
+#endif
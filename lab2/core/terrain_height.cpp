@@ -0,0 +1,51 @@
+#include "terrain_height.h"
+
+#include <cmath>
+#include <cstdint>
+
+namespace {
+
+const float kGroundLevel = -50.0f;		// Base of the buildings
+const float kCityRadius = 250.0f;		// Flat inside this
+const float kHillsRadius = 700.0f;		// Full height beyond this
+const float kHillHeight = 140.0f;
+const float kFeatureSize = 400.0f;		// Wavelength of the largest hills
+const int kOctaves = 5;
+
+float Lattice(int32_t x, int32_t z) {
+	uint32_t h = (uint32_t)x * 0x8da6b343u ^ (uint32_t)z * 0xd8163841u;
+	h ^= h >> 13;
+	h *= 0x85ebca6bu;
+	h ^= h >> 16;
+	return (h & 0xffffff) / (float)0xffffff;
+}
+
+// Value noise in [0, 1] with smooth interpolation between lattice points
+float ValueNoise(float x, float z) {
+	float fx = std::floor(x), fz = std::floor(z);
+	int32_t ix = (int32_t)fx, iz = (int32_t)fz;
+	float tx = x - fx, tz = z - fz;
+	tx = tx * tx * (3.0f - 2.0f * tx);
+	tz = tz * tz * (3.0f - 2.0f * tz);
+	float a = Lattice(ix, iz) + (Lattice(ix + 1, iz) - Lattice(ix, iz)) * tx;
+	float b = Lattice(ix, iz + 1) + (Lattice(ix + 1, iz + 1) - Lattice(ix, iz + 1)) * tx;
+	return a + (b - a) * tz;
+}
+
+} // namespace
+
+float TerrainHeight(float x, float z) {
+	float distance = std::sqrt(x * x + z * z);
+	float blend = (distance - kCityRadius) / (kHillsRadius - kCityRadius);
+	if (blend <= 0.0f) return kGroundLevel;
+	if (blend > 1.0f) blend = 1.0f;
+	blend = blend * blend * (3.0f - 2.0f * blend);
+
+	float sum = 0.0f, amplitude = 0.5f, frequency = 1.0f / kFeatureSize;
+	for (int i = 0; i < kOctaves; ++i) {
+		sum += ValueNoise(x * frequency, z * frequency) * amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+	}
+	return kGroundLevel + blend * sum * kHillHeight;
+}
@@ -0,0 +1,12 @@
+#ifndef _TERRAIN_HEIGHT_H_
+#define _TERRAIN_HEIGHT_H_
+
+// Procedural heightfield standing in for streamed terrain data. Any point of
+// an unbounded world can be evaluated on its own, so the clipmap only ever
+// computes the texels that have just come into range.
+//
+// The ground is flat at the base of the buildings inside the city and rises
+// into rolling hills beyond it.
+float TerrainHeight(float x, float z);
+
+#endif
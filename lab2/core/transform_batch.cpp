@@ -0,0 +1,72 @@
+#include "transform_batch.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX__)
+#define LAB2_TRANSFORM_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define LAB2_TRANSFORM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+void TransformBatchMVP(const glm::mat4& viewProjection, const glm::mat4* world, const unsigned int* indices,
+	size_t count, float* out) {
+#if LAB2_TRANSFORM_AVX
+	// Two output columns per iteration: each 256-bit register holds the same
+	// view-projection column twice, scaled by the entries of two world columns.
+	const __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[0][0]));
+	const __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[1][0]));
+	const __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[2][0]));
+	const __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&viewProjection[3][0]));
+	const bool aligned = (reinterpret_cast<uintptr_t>(out) & 31) == 0;
+
+	for (size_t n = 0; n < count; ++n) {
+		const float* w = &world[indices ? indices[n] : n][0][0];
+		float* o = out + n * 16;
+		for (int j = 0; j < 4; j += 2) {
+			const float* a = w + j * 4;
+			const float* b = a + 4;
+			__m256 r = _mm256_mul_ps(c0, _mm256_setr_ps(a[0], a[0], a[0], a[0], b[0], b[0], b[0], b[0]));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c1, _mm256_setr_ps(a[1], a[1], a[1], a[1], b[1], b[1], b[1], b[1])));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c2, _mm256_setr_ps(a[2], a[2], a[2], a[2], b[2], b[2], b[2], b[2])));
+			r = _mm256_add_ps(r, _mm256_mul_ps(c3, _mm256_setr_ps(a[3], a[3], a[3], a[3], b[3], b[3], b[3], b[3])));
+			if (aligned) _mm256_stream_ps(o + j * 4, r);
+			else _mm256_storeu_ps(o + j * 4, r);
+		}
+	}
+	if (aligned) _mm_sfence();
+#elif LAB2_TRANSFORM_SSE
+	const __m128 c0 = _mm_loadu_ps(&viewProjection[0][0]);
+	const __m128 c1 = _mm_loadu_ps(&viewProjection[1][0]);
+	const __m128 c2 = _mm_loadu_ps(&viewProjection[2][0]);
+	const __m128 c3 = _mm_loadu_ps(&viewProjection[3][0]);
+	const bool aligned = (reinterpret_cast<uintptr_t>(out) & 15) == 0;
+
+	for (size_t n = 0; n < count; ++n) {
+		const float* w = &world[indices ? indices[n] : n][0][0];
+		float* o = out + n * 16;
+		for (int j = 0; j < 4; ++j) {
+			const float* column = w + j * 4;
+			__m128 r = _mm_mul_ps(c0, _mm_set1_ps(column[0]));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_set1_ps(column[1])));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, _mm_set1_ps(column[2])));
+			r = _mm_add_ps(r, _mm_mul_ps(c3, _mm_set1_ps(column[3])));
+			if (aligned) _mm_stream_ps(o + j * 4, r);
+			else _mm_storeu_ps(o + j * 4, r);
+		}
+	}
+	if (aligned) _mm_sfence();
+#else
+	TransformBatchMVPReference(viewProjection, world, indices, count, out);
+#endif
+}
+
+void TransformBatchMVPReference(const glm::mat4& viewProjection, const glm::mat4* world, const unsigned int* indices,
+	size_t count, float* out) {
+	for (size_t n = 0; n < count; ++n) {
+		glm::mat4 mvp = viewProjection * world[indices ? indices[n] : n];
+		memcpy(out + n * 16, &mvp[0][0], sizeof(mvp));
+	}
+}
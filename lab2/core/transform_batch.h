@@ -0,0 +1,18 @@
+#ifndef _TRANSFORM_BATCH_H_
+#define _TRANSFORM_BATCH_H_
+
+#include <glm/glm.hpp>
+#include <cstddef>
+
+// Writes viewProjection * world[indices[i]] for i in [0, count) as 16 column-
+// major floats per instance. indices may be null to take world in order. The
+// output may be a mapped GL buffer: with SSE it is written with streaming
+// stores when 16-byte aligned, which suits write-combined memory.
+void TransformBatchMVP(const glm::mat4& viewProjection, const glm::mat4* world, const unsigned int* indices,
+	size_t count, float* out);
+
+// Plain glm version of the same, for reference and benchmarking
+void TransformBatchMVPReference(const glm::mat4& viewProjection, const glm::mat4* world, const unsigned int* indices,
+	size_t count, float* out);
+
+#endif
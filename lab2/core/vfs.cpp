@@ -0,0 +1,85 @@
+#include "vfs.h"
+#include "asset_archive.h"
+#include "profiler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+std::vector<std::unique_ptr<AssetArchive>> archives;
+std::vector<std::string> searchPaths;
+std::atomic<unsigned long long> archiveReadCount(0);
+std::atomic<unsigned long long> looseReadCount(0);
+
+bool ReadLooseFile(const std::string& path, AssetView& view) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+	auto storage = std::make_shared<std::vector<uint8_t>>();
+	if (fseek(file, 0, SEEK_END) == 0) {
+		long size = ftell(file);
+		if (size > 0) {
+			storage->resize((size_t)size);
+			fseek(file, 0, SEEK_SET);
+			storage->resize(fread(storage->data(), 1, (size_t)size, file));
+		}
+	}
+	fclose(file);
+
+	view.storage = storage;
+	view.data = storage->data();
+	view.size = storage->size();
+	view.fromArchive = false;
+	return true;
+}
+
+} // namespace
+
+bool VfsMount(const char* archivePath) {
+	std::unique_ptr<AssetArchive> archive(new AssetArchive());
+	if (!archive->open(archivePath)) return false;
+	printf("Mounted asset archive %s, %u files\n", archivePath, archive->header->entryCount);
+	archives.push_back(std::move(archive));
+	return true;
+}
+
+void VfsAddSearchPath(const char* directory) {
+	std::string path = directory;
+	if (!path.empty() && path.back() != '/' && path.back() != '\\') path += '/';
+	searchPaths.push_back(path);
+}
+
+void VfsShutdown() {
+	archives.clear();
+	searchPaths.clear();
+}
+
+bool VfsRead(const char* name, AssetView& view) {
+	PROFILE_ZONE("Asset read");
+	view = AssetView();
+	for (size_t i = archives.size(); i-- > 0;) {
+		if (archives[i]->find(name, view.data, view.size)) {
+			view.fromArchive = true;
+			++archiveReadCount;
+			return true;
+		}
+	}
+	for (const std::string& directory : searchPaths) {
+		if (ReadLooseFile(directory + name, view)) {
+			++looseReadCount;
+			return true;
+		}
+	}
+	// Last, the name as a path of its own, for files given on the command line
+	if (ReadLooseFile(name, view)) {
+		++looseReadCount;
+		return true;
+	}
+	return false;
+}
+
+void VfsStats(unsigned long long& archiveReads, unsigned long long& looseReads) {
+	archiveReads = archiveReadCount.load();
+	looseReads = looseReadCount.load();
+}
@@ -0,0 +1,40 @@
+#ifndef _VFS_H_
+#define _VFS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Read-only asset lookup by logical name, such as "box.vert" or
+// "facade0.jpg".
+//
+// Mounted archives are searched first, the most recently mounted first, and
+// a hit is a view straight into the archive's mapping with no copy. Names not
+// in any archive fall back to loose files under the search paths, in the
+// order they were added, then under the working directory, read into memory
+// the view owns. Development builds run from loose files alone; an install
+// ships one archive and opens nothing else.
+//
+// Mount archives and add search paths before other threads start reading;
+// lookups themselves are safe from any thread.
+
+struct AssetView {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+	bool fromArchive = false;
+	std::shared_ptr<std::vector<uint8_t>> storage;		// Loose files only
+};
+
+// Returns false if the archive cannot be mapped or is invalid
+bool VfsMount(const char* archivePath);
+void VfsAddSearchPath(const char* directory);
+void VfsShutdown();
+
+// Returns false, with an empty view, if no archive or search path has the name
+bool VfsRead(const char* name, AssetView& view);
+
+// Lookups served so far from archives and from loose files
+void VfsStats(unsigned long long& archiveReads, unsigned long long& looseReads);
+
+#endif
@@ -0,0 +1,153 @@
+#include "virtual_page_table.h"
+
+#include <algorithm>
+
+void VirtualPageTable::initialize(int pagesPerSide) {
+	physicalPagesPerSide = pagesPerSide;
+	physical.assign(pagesPerSide * pagesPerSide, PhysicalPage());
+	resident.clear();
+	for (int mip = 0; mip < kVirtualMipCount; ++mip) {
+		int size = kVirtualPages >> mip;
+		indirection[mip].assign(size * size, 0);
+		dirty[mip] = { 0, 0, size, size };
+	}
+	frame = 0;
+}
+
+uint32_t VirtualPageTable::entryFor(int physicalPage, int mip) const {
+	uint32_t x = physicalPage % physicalPagesPerSide;
+	uint32_t y = physicalPage / physicalPagesPerSide;
+	return x | (y << 8) | ((uint32_t)mip << 16) | 0xff000000u;
+}
+
+void VirtualPageTable::rewriteSubtree(int mip, int x, int y, uint32_t from, uint32_t to) {
+	for (int level = mip; level >= 0; --level) {
+		int shift = mip - level;
+		int size = kVirtualPages >> level;
+		int x0 = x << shift, y0 = y << shift;
+		int x1 = (x + 1) << shift, y1 = (y + 1) << shift;
+		bool changed = false;
+		for (int row = y0; row < y1; ++row) {
+			uint32_t* entry = &indirection[level][row * size];
+			for (int column = x0; column < x1; ++column) {
+				bool match = from == kNoPage ? (int)((entry[column] >> 16) & 0xff) > mip || entry[column] == 0 :
+					entry[column] == from;
+				if (match) {
+					entry[column] = to;
+					changed = true;
+				}
+			}
+		}
+		if (changed) {
+			DirtyRect& rect = dirty[level];
+			if (rect.x0 >= rect.x1) {
+				rect = { x0, y0, x1, y1 };
+			}
+			else {
+				rect.x0 = std::min(rect.x0, x0);
+				rect.y0 = std::min(rect.y0, y0);
+				rect.x1 = std::max(rect.x1, x1);
+				rect.y1 = std::max(rect.y1, y1);
+			}
+		}
+	}
+}
+
+void VirtualPageTable::map(uint32_t key, int physicalPage, bool pinned) {
+	PhysicalPage& page = physical[physicalPage];
+	page.key = key;
+	page.lastUsed = frame;
+	page.pinned = pinned;
+	resident[key] = physicalPage;
+
+	int mip = VirtualPageMip(key);
+	rewriteSubtree(mip, VirtualPageX(key), VirtualPageY(key), kNoPage, entryFor(physicalPage, mip));
+}
+
+void VirtualPageTable::unmap(int physicalPage) {
+	PhysicalPage& page = physical[physicalPage];
+	uint32_t key = page.key;
+	int mip = VirtualPageMip(key), x = VirtualPageX(key), y = VirtualPageY(key);
+	resident.erase(key);
+	page.key = kNoPage;
+	++pagesEvicted;
+
+	// Fall back to the nearest resident ancestor; the slot's root is pinned
+	uint32_t fallback = 0;
+	for (int level = mip + 1; level < kVirtualMipCount; ++level) {
+		int shift = level - mip;
+		auto found = resident.find(VirtualPageKey(level, x >> shift, y >> shift));
+		if (found != resident.end()) {
+			fallback = entryFor(found->second, level);
+			break;
+		}
+	}
+	rewriteSubtree(mip, x, y, entryFor(physicalPage, mip), fallback);
+}
+
+int VirtualPageTable::allocate() {
+	int victim = -1;
+	for (int i = 0; i < (int)physical.size(); ++i) {
+		const PhysicalPage& page = physical[i];
+		if (page.key == kNoPage) return i;
+		if (page.pinned || page.lastUsed >= frame) continue;
+		if (victim < 0 || page.lastUsed < physical[victim].lastUsed) victim = i;
+	}
+	if (victim >= 0) unmap(victim);
+	return victim;
+}
+
+void VirtualPageTable::processFeedback(const uint8_t* pixels, size_t pixelCount, std::vector<uint32_t>& wanted) {
+	++frame;
+
+	requestKeys.clear();
+	for (size_t i = 0; i < pixelCount; ++i) {
+		const uint8_t* pixel = pixels + i * 4;
+		if (pixel[3] == 0 || pixel[2] >= kVirtualMipCount) continue;
+		requestKeys.push_back(VirtualPageKey(pixel[2], pixel[0], pixel[1]));
+	}
+	// Neighbouring pixels mostly ask for the same page, so count runs
+	std::sort(requestKeys.begin(), requestKeys.end());
+
+	wantedCounts.clear();
+	pagesRequested = 0;
+	for (size_t i = 0; i < requestKeys.size();) {
+		uint32_t key = requestKeys[i];
+		size_t end = i;
+		while (end < requestKeys.size() && requestKeys[end] == key) ++end;
+		unsigned int count = (unsigned int)(end - i);
+		i = end;
+		++pagesRequested;
+
+		int mip = VirtualPageMip(key), x = VirtualPageX(key), y = VirtualPageY(key);
+		int finestResident = kVirtualMipCount;
+		for (int level = mip; level < kVirtualMipCount; ++level) {
+			int shift = level - mip;
+			auto found = resident.find(VirtualPageKey(level, x >> shift, y >> shift));
+			if (found == resident.end()) continue;
+			physical[found->second].lastUsed = frame;
+			finestResident = std::min(finestResident, level);
+		}
+		if (finestResident == mip || finestResident == kVirtualMipCount) continue;
+
+		int level = finestResident - 1;
+		int shift = level - mip;
+		wantedCounts[VirtualPageKey(level, x >> shift, y >> shift)] += count;
+	}
+
+	wanted.clear();
+	for (const auto& entry : wantedCounts) {
+		wanted.push_back(entry.first);
+	}
+	std::sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b) {
+		if (VirtualPageMip(a) != VirtualPageMip(b)) return VirtualPageMip(a) > VirtualPageMip(b);
+		unsigned int countA = wantedCounts[a], countB = wantedCounts[b];
+		return countA != countB ? countA > countB : a < b;
+	});
+}
+
+void VirtualPageTable::clearDirty() {
+	for (int mip = 0; mip < kVirtualMipCount; ++mip) {
+		dirty[mip] = { 0, 0, 0, 0 };
+	}
+}
@@ -0,0 +1,101 @@
+#ifndef _VIRTUAL_PAGE_TABLE_H_
+#define _VIRTUAL_PAGE_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Page residency for the virtual texture.
+//
+// The virtual address space is kVirtualPages pages square at mip 0, each page
+// kPageTexels texels of content. It is split into slots of kSlotPages square,
+// one per object with unique texturing, so mip kVirtualMipCount - 1 holds a
+// single page per slot. That page is pinned when its slot is in use, so every
+// lookup always finds a resident ancestor to fall back to.
+//
+// Resident pages live in a fixed grid of physical pages, each kPageBorder
+// texels wider on every side than its content so bilinear filtering never
+// reads a neighbour. The indirection mirror holds, for every virtual page of
+// every mip, the physical page of its finest resident ancestor as RGBA8:
+// physical x and y, the mip of that page, and 255. Changes are tracked as one
+// dirty rectangle per mip for upload.
+//
+// Pages are evicted least recently used first. A page counts as used in a
+// frame when feedback asked for it or for any page below it.
+
+const int kVirtualPages = 256;
+const int kSlotPages = 16;
+const int kSlotsPerSide = kVirtualPages / kSlotPages;
+const int kMaxVirtualSlots = kSlotsPerSide * kSlotsPerSide;
+const int kVirtualMipCount = 5;			// 2 ^ (kVirtualMipCount - 1) == kSlotPages
+const int kPageTexels = 120;
+const int kPageBorder = 4;
+const int kPhysicalPageSize = kPageTexels + 2 * kPageBorder;
+
+inline uint32_t VirtualPageKey(int mip, int x, int y) {
+	return ((uint32_t)mip << 16) | ((uint32_t)y << 8) | (uint32_t)x;
+}
+inline int VirtualPageMip(uint32_t key) { return (int)(key >> 16); }
+inline int VirtualPageY(uint32_t key) { return (int)((key >> 8) & 0xff); }
+inline int VirtualPageX(uint32_t key) { return (int)(key & 0xff); }
+
+struct VirtualPageTable {
+	static const uint32_t kNoPage = 0xffffffffu;
+
+	struct PhysicalPage {
+		uint32_t key = kNoPage;
+		unsigned long long lastUsed = 0;
+		bool pinned = false;
+	};
+
+	struct DirtyRect {
+		int x0, y0, x1, y1;				// Exclusive max, empty when x0 >= x1
+	};
+
+	int physicalPagesPerSide = 0;
+	std::vector<PhysicalPage> physical;
+	std::unordered_map<uint32_t, int> resident;		// Virtual page key to physical page
+	std::vector<uint32_t> indirection[kVirtualMipCount];
+	DirtyRect dirty[kVirtualMipCount];
+	unsigned long long frame = 0;
+
+	unsigned long long pagesEvicted = 0;
+	unsigned int pagesRequested = 0;	// Distinct pages in the last feedback
+
+	// Scratch kept between calls
+	std::vector<uint32_t> requestKeys;
+	std::unordered_map<uint32_t, unsigned int> wantedCounts;
+
+	void initialize(int pagesPerSide);
+
+	// Reads one feedback image of RGBA8 page requests, as written by the
+	// feedback shader, with zero alpha where nothing was drawn. Marks the
+	// resident pages on the way to each request as used and returns the pages
+	// to load next: for each request, the child of its finest resident ancestor
+	// on the way down to it. Coarser pages come first, then the most requested.
+	void processFeedback(const uint8_t* pixels, size_t pixelCount, std::vector<uint32_t>& wanted);
+
+	// Frees a physical page for a new virtual page: an empty one if any, else
+	// the least recently used page not needed by the current feedback.
+	// Returns -1 when every page is pinned or in use.
+	int allocate();
+
+	// Makes a virtual page resident in a physical page from allocate
+	void map(uint32_t key, int physicalPage, bool pinned);
+
+	bool isResident(uint32_t key) const { return resident.count(key) != 0; }
+	int residentCount() const { return (int)resident.size(); }
+
+	void clearDirty();
+
+private:
+	void unmap(int physicalPage);
+	// Points every entry below the page, itself included, that currently
+	// resolves to from at to; from == kNoPage matches anything coarser than
+	// the page's own mip
+	void rewriteSubtree(int mip, int x, int y, uint32_t from, uint32_t to);
+	uint32_t entryFor(int physicalPage, int mip) const;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#version 330 core
+
+// GPU instance culling, one point per instance: frustum test against this
+// frame's planes, then an occlusion test against the Hi-Z pyramid of the last
+// frame, projected with that frame's camera. Survivors are kept by cull.geom.
+
+layout(location = 0) in vec3 instanceCenter;
+layout(location = 1) in uint instanceID;
+layout(location = 2) in vec3 instanceHalfExtent;
+
+uniform vec4 frustumPlanes[6];
+uniform vec3 eye;
+uniform float drawDistance;     // 0 for no limit
+
+uniform bool useHiZ;
+uniform sampler2D hiZ;
+uniform mat4 hiZViewProjection;
+uniform vec2 hiZRenderSize;     // Depth pixels the pyramid was built from
+uniform ivec2 hiZSize;          // Texels of its first level, half the above
+uniform int hiZLevels;
+
+flat out uint cullID;
+flat out int cullVisible;
+
+bool InsideView()
+{
+    for (int i = 0; i < 6; ++i) {
+        vec3 normal = frustumPlanes[i].xyz;
+        float radius = dot(instanceHalfExtent, abs(normal));
+        if (dot(normal, instanceCenter) + frustumPlanes[i].w < -radius) return false;
+    }
+    return drawDistance <= 0.0 || length(instanceCenter - eye) - length(instanceHalfExtent) < drawDistance;
+}
+
+// Farthest depth the pyramid holds under a rectangle of depth pixels. The
+// level is picked so the rectangle spans at most two texels each way.
+float FarthestDepth(vec2 low, vec2 high)
+{
+    vec2 extent = high - low;
+    int level = int(ceil(log2(max(max(extent.x, extent.y) * 0.5, 1.0))));
+    level = clamp(level, 0, hiZLevels - 1);
+    ivec2 levelSize = max(hiZSize >> level, ivec2(1));
+    float texelPixels = float(2 << level);
+    ivec2 a = clamp(ivec2(low / texelPixels), ivec2(0), levelSize - 1);
+    ivec2 b = clamp(ivec2(high / texelPixels), ivec2(0), levelSize - 1);
+    return max(max(texelFetch(hiZ, a, level).r, texelFetch(hiZ, ivec2(b.x, a.y), level).r),
+               max(texelFetch(hiZ, ivec2(a.x, b.y), level).r, texelFetch(hiZ, b, level).r));
+}
+
+bool Occluded()
+{
+    vec3 low = vec3(1e30);
+    vec3 high = vec3(-1e30);
+    for (int corner = 0; corner < 8; ++corner) {
+        vec3 side = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+        vec4 clip = hiZViewProjection * vec4(instanceCenter + instanceHalfExtent * side, 1.0);
+        // Reaching behind the last frame's eye: no depth to compare against
+        if (clip.w <= 0.0) return false;
+        vec3 window = clip.xyz / clip.w * 0.5 + 0.5;
+        low = min(low, window);
+        high = max(high, window);
+    }
+    // Off the last frame's screen, nothing there was drawn to occlude it
+    if (any(lessThan(low.xy, vec2(0.0))) || any(greaterThan(high.xy, vec2(1.0)))) return false;
+    return low.z > FarthestDepth(low.xy * hiZRenderSize, high.xy * hiZRenderSize);
+}
+
+void main()
+{
+    cullID = instanceID;
+    cullVisible = InsideView() && !(useHiZ && Occluded()) ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#version 330 core
+
+// Lighting pass of the deferred renderer. One fullscreen triangle shades every
+// pixel the geometry pass covered, using the same lighting code as box.frag.
+
+uniform sampler2D gbufferAlbedo;    // sRGB encoded
+uniform sampler2D gbufferNormal;    // Octahedral, world space
+uniform sampler2D gbufferDepth;
+uniform mat4 inverseViewMatrix;
+uniform mat4 lightSpaceTransformMatrix; // for shadow mapping
+
+out vec3 finalColor;
+
+#include "lighting.glsl"
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gbufferDepth, pixel, 0).r;
+    if (depth >= 1.0) discard;  // Background keeps the clear colour
+
+    vec3 albedo = pow(texelFetch(gbufferAlbedo, pixel, 0).rgb, vec3(2.2));
+    vec3 normal = DecodeOctahedral(texelFetch(gbufferNormal, pixel, 0).xy);
+
+    vec3 P = ViewPositionFromDepth(gl_FragCoord.xy / viewportSize, depth);
+    vec4 lightSpacePosition = lightSpaceTransformMatrix * (inverseViewMatrix * vec4(P, 1.0));
+    finalColor = ShadeSurface(albedo, normal, depth, lightSpacePosition);
+}
\ No newline at end of file
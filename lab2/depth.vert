@@ -0,0 +1,20 @@
+#version 330 core
+
+// Depth pre-pass: position stream and instance transform only
+layout(location = 0) in vec3 vertexPosition;
+#ifdef GPU_CULLED
+#include "gpu_culled.glsl"
+#else
+layout(location = 4) in mat4 instanceMVP;
+#endif
+
+// Must match box.vert bit for bit for the GL_EQUAL main pass
+invariant gl_Position;
+
+void main() {
+#ifdef GPU_CULLED
+    gl_Position = CulledInstancePosition(vertexPosition);
+#else
+    gl_Position = instanceMVP * vec4(vertexPosition, 1);
+#endif
+}
\ No newline at end of file
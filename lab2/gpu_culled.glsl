@@ -0,0 +1,22 @@
+// Instances culled on the GPU, see render/gpu_culling.h: the instance
+// attribute is a building index, and its world matrix and virtual texture
+// slot are looked up in buffer textures instead of streamed each frame.
+// box.vert and depth.vert both go through here so depth matches bit for bit.
+layout(location = 10) in uint instanceBuilding;
+
+uniform samplerBuffer worldMatrices;    // Four texels per building, the columns
+uniform samplerBuffer buildingSlots;
+uniform mat4 viewProjection;
+
+vec4 CulledInstancePosition(vec3 position)
+{
+    int base = int(instanceBuilding) * 4;
+    mat4 world = mat4(texelFetch(worldMatrices, base), texelFetch(worldMatrices, base + 1),
+                      texelFetch(worldMatrices, base + 2), texelFetch(worldMatrices, base + 3));
+    return viewProjection * (world * vec4(position, 1.0));
+}
+
+vec2 CulledInstanceSlot()
+{
+    return texelFetch(buildingSlots, int(instanceBuilding)).rg;
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#version 330 core
+
+// One level of the Hi-Z pyramid: the farthest depth of the texels below.
+// Levels halve rounding down, so the last row and column also take the odd
+// texel left over. The source's base level is the one to read.
+
+uniform sampler2D source;
+uniform ivec2 sourceSize;       // Valid texels of the source level
+uniform ivec2 targetSize;
+
+out float farthest;
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1, sourceSize - 1);
+    if (texel.x == targetSize.x - 1) last.x = sourceSize.x - 1;
+    if (texel.y == targetSize.y - 1) last.y = sourceSize.y - 1;
+
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; ++y) {
+        for (int x = first.x; x <= last.x; ++x) {
+            depth = max(depth, texelFetch(source, ivec2(x, y), 0).r);
+        }
+    }
+    farthest = depth;
+}
\ No newline at end of file
@@ -4,20 +4,58 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <render/shader.h>
+#include <render/gpu_profiler.h>
+#include <render/render_state.h>
+#include <render/hud.h>
+#include <render/frame_pacer.h>
+#include <render/scaled_target.h>
+#include <render/post_process.h>
+#include <render/clustered_lighting.h>
+#include <render/gbuffer.h>
+#include <render/overdraw_counter.h>
+#include <render/skybox.h>
+#include <render/clipmap_terrain.h>
+#include <render/texture_streamer.h>
+#include <render/virtual_texture.h>
+#include <render/hiz_pyramid.h>
+#include <render/gpu_culling.h>
+#include <render/software_view.h>
+#include <render/frame_capture.h>
+#include <core/profiler.h>
+#include <core/benchmark.h>
+#include <core/frame_pipeline.h>
+#include <core/frustum.h>
+#include <core/job_system.h>
+#include <core/transform_batch.h>
+#include <core/resolution_governor.h>
+#include <core/light_clusters.h>
+#include <core/depth_prepass_policy.h>
+#include <core/facade_pages.h>
+#include <core/vfs.h>
+#include <core/city_scene.h>
+#include <core/mesh_loader.h>
+#include <core/mesh_optimizer.h>
+#include <core/meshlets.h>
+#include <core/soft_raster.h>
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
 
 #include <vector>
 #include <iostream>
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <string>
+#include <atomic>
+#include <cstddef>
 
 static GLFWwindow* window;
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode);
+static void updateCameraFromHeldKeys(GLFWwindow* window, float deltaSeconds);
 
 // OpenGL camera view parameters
 static glm::vec3 eye_center;
@@ -28,6 +66,8 @@ static glm::vec3 up(0, 1, 0);
 static float viewAzimuth = 0.f;
 static float viewPolar = 0.f;
 static float viewDistance = 600.0f;
+static glm::vec3 cameraDirection;
+static glm::vec3 cameraRight;
 
 // Lighting control 
 const glm::vec3 wave500(0.0f, 255.0f, 146.0f);
@@ -35,51 +75,182 @@ const glm::vec3 wave600(255.0f, 190.0f, 0.0f);
 const glm::vec3 wave700(205.0f, 0.0f, 0.0f);
 static glm::vec3 lightIntensity = 5.0f * (8.0f * wave500 + 15.6f * wave600 + 18.4f * wave700);
 static glm::vec3 lightPosition = glm::vec3(100.0f, 50.0f, 1000.0f);
-
-static GLuint LoadTextureTileBox(const char* texture_file_path) {
-	int w, h, channels;
-	uint8_t* img = stbi_load(texture_file_path, &w, &h, &channels, 3);
-	GLuint texture;
-	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-
-	// To tile textures on a box, we set wrapping to repeat
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-	if (img) {
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, w, h, 0, GL_RGB, GL_UNSIGNED_BYTE, img);
-		glGenerateMipmap(GL_TEXTURE_2D);
+static glm::vec3 ambientLight = glm::vec3(0.05f, 0.055f, 0.06f);	// Sky fill so facades away from the light still read
+
+// Street lamps and lit windows, shaded through clustered forward lighting.
+// The first activeLightCount are used; N cycles through the counts.
+static std::vector<PointLight> cityLights;
+static ClusteredLighting clusteredLighting;
+static const unsigned int lightCountSteps[4] = { 0, 100, 1000, 10000 };
+static int lightCountIndex = 2;
+
+// Performance overlay, toggled with H
+static Hud hud;
+
+// Swap mode, frame limiter and frames in flight
+static FramePacer framePacer;
+static bool lowLatencyMode = false;
+static const float limiterTargets[4] = { 0.0f, 30.0f, 60.0f, 120.0f };
+static int limiterTargetIndex = 0;
+
+// Main pass into an HDR target at a governed fraction of the window
+// resolution, toggled with G, then tone mapped in one post pass
+static ScaledTarget sceneTarget;
+static PostProcess postProcess;
+static ResolutionGovernor governor;
+static int appliedQualityLevel = 0;
+
+// Deferred renderer, toggled with M. Shares box.frag's material and the light
+// clusters with the forward path.
+static GBuffer gbuffer;
+static bool deferredShading = false;
+
+// Optional depth-only pre-pass so the opaque pass shades each pixel once,
+// switched on and off by measured cost; Z cycles auto, off and on
+static DepthPrepassPolicy depthPrepass;
+static OverdrawCounter overdrawCounter;
+
+// Forward against deferred over light counts and render scales, started with
+// B or --lighting-sweep. Each configuration warms up, then averages GPU time.
+static const int kSweepWarmupFrames = 30;
+static const int kSweepMeasuredFrames = 60;
+static const float sweepScales[3] = { 0.5f, 0.75f, 1.0f };
+static int sweepConfig = -1;		// -1 when no sweep is running
+static int sweepFrame = 0;
+static double sweepSumMs = 0.0;
+static bool sweepExitWhenDone = false;
+static bool sweepSavedDeferred = false;
+static int sweepSavedLightCountIndex = 0;
+static bool sweepSavedGovernor = false;
+
+// Facade textures shared by all buildings
+static const char* facadeTextureFiles[6] = {
+	"facade0.jpg",
+	"facade1.jpg",
+	"facade2.jpg",
+	"facade3.jpg",
+	"facade4.jpg",
+	"facade5.jpg"
+};
+static GLuint facadeTextures[6];
+
+// Facade mips are streamed in and out to fit the budget, set with --texture-budget-mb
+static TextureStreamer textureStreamer;
+
+// Unique facades for every building, paged in from the virtual texture.
+// Toggled with T against the shared facade textures.
+static const int kVirtualTexturePagesPerSide = 24;	// 576 pages of 128 x 128, 36 MB
+static FacadePageSource facadePages;
+static VirtualTexture virtualTexture;
+static bool useVirtualTexture = true;
+
+// Sky cubemap faces, loaded in the background; a gradient stands in meanwhile
+static const char* skyFaceFiles[6] = {
+	"sky_px.jpg",
+	"sky_nx.jpg",
+	"sky_py.jpg",
+	"sky_ny.jpg",
+	"sky_pz.jpg",
+	"sky_nz.jpg"
+};
+static Skybox skybox;
+
+// Ground under and around the city, streamed as the camera moves
+static ClipmapTerrain terrain;
+
+// Registers the facades with the streamer. Only a grey placeholder exists at
+// first; the coarse mips follow within a few frames and finer ones as the
+// buildings come close enough to need them.
+static void LoadFacadeTextures() {
+	PROFILE_ZONE("Texture load");
+	textureStreamer.initialize();
+	for (int i = 0; i < 6; ++i) {
+		facadeTextures[i] = textureStreamer.textures[textureStreamer.add(facadeTextureFiles[i])].textureID;
 	}
-	else {
-		std::cout << "Failed to load texture " << texture_file_path << std::endl;
+}
+
+// Quality knob of the resolution governor: a positive bias samples smaller
+// mips, which saves texture bandwidth at the cost of some blur
+static void SetFacadeTextureLodBias(float bias) {
+	virtualTexture.mipBias = bias;
+	for (int i = 0; i < 6; ++i) {
+		glBindTexture(GL_TEXTURE_2D, facadeTextures[i]);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, bias);
 	}
-	stbi_image_free(img);
+	RenderStateInvalidate();
+}
 
-	return texture;
+static void CleanupFacadeTextures() {
+	textureStreamer.cleanup();
 }
 
 // Global Shader Program ID
 GLuint globalProgramID;
+// The same material compiled as the deferred geometry pass
+GLuint gbufferProgramID;
+// Position-only program of the depth pre-pass
+GLuint depthProgramID;
+// The three above for buildings culled on the GPU, reading their transforms
+// from buffer textures
+GLuint gpuCulledProgramID;
+GLuint gpuCulledGbufferProgramID;
+GLuint gpuCulledDepthProgramID;
+
+// Texture units of the GPU culled programs' buffer textures
+static const GLuint kWorldMatricesUnit = 9;
+static const GLuint kBuildingSlotsUnit = 10;
 
 void static initializeShaders() {
-	globalProgramID = LoadShadersFromFile("../../../lab2/box.vert", "../../../lab2/box.frag");
+	PROFILE_ZONE("Shader compile");
+	globalProgramID = LoadShadersFromFile("box.vert", "box.frag");
 	if (globalProgramID == 0) {
 		std::cerr << "Failed to load shaders." << std::endl;
 		exit(EXIT_FAILURE);
 	}
+	gbufferProgramID = LoadShadersFromFile("box.vert", "box.frag", "#define GBUFFER\n");
+	if (gbufferProgramID == 0) {
+		std::cerr << "Failed to load G-buffer shaders." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	glUseProgram(gbufferProgramID);
+	glUniform1i(glGetUniformLocation(gbufferProgramID, "textureSampler"), 0);
+	glUseProgram(0);
+	depthProgramID = LoadShadersFromFile("depth.vert", "depth.frag");
+	if (depthProgramID == 0) {
+		std::cerr << "Failed to load depth pre-pass shaders." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	gpuCulledProgramID = LoadShadersFromFile("box.vert", "box.frag", "#define GPU_CULLED\n");
+	gpuCulledGbufferProgramID = LoadShadersFromFile("box.vert", "box.frag", "#define GBUFFER\n#define GPU_CULLED\n");
+	gpuCulledDepthProgramID = LoadShadersFromFile("depth.vert", "depth.frag", "#define GPU_CULLED\n");
+	if (gpuCulledProgramID == 0 || gpuCulledGbufferProgramID == 0 || gpuCulledDepthProgramID == 0) {
+		std::cerr << "Failed to load GPU culled building shaders." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	GLuint gpuCulledPrograms[3] = { gpuCulledProgramID, gpuCulledGbufferProgramID, gpuCulledDepthProgramID };
+	for (GLuint programID : gpuCulledPrograms) {
+		glUseProgram(programID);
+		glUniform1i(glGetUniformLocation(programID, "worldMatrices"), kWorldMatricesUnit);
+		glUniform1i(glGetUniformLocation(programID, "buildingSlots"), kBuildingSlotsUnit);
+	}
+	glUseProgram(gpuCulledGbufferProgramID);
+	glUniform1i(glGetUniformLocation(gpuCulledGbufferProgramID, "textureSampler"), 0);
+	glUseProgram(0);
 }
 
 void static cleanupShaders() {
 	glDeleteProgram(globalProgramID);
+	glDeleteProgram(gbufferProgramID);
+	glDeleteProgram(depthProgramID);
+	glDeleteProgram(gpuCulledProgramID);
+	glDeleteProgram(gpuCulledGbufferProgramID);
+	glDeleteProgram(gpuCulledDepthProgramID);
 }
 
+// Geometry of the canonical box every building is drawn with. Placement,
+// facade and virtual texture slot come from the city scene.
 struct Building {
-	glm::vec3 position;		// Position of the box 
-	glm::vec3 scale;		// Size of the box in each axis
-
 	GLfloat vertex_buffer_data[72] = {	// Vertex definition for a canonical box
 		// Front face
 		-1.0f, -1.0f, 1.0f,
@@ -149,44 +320,6 @@ struct Building {
 		0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
 	};
 
-	GLfloat color_buffer_data[72] = {
-		// Front, red
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f, 0.0f,
-
-		// Back, yellow
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-		1.0f, 1.0f, 0.0f,
-
-		// Left, green
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-		0.0f, 1.0f, 0.0f,
-
-		// Right, cyan
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f,
-
-		// Top, blue
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-		0.0f, 0.0f, 1.0f,
-
-		// Bottom, magenta
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 1.0f,
-	};
-
 	GLuint index_buffer_data[36] = {		// 12 triangle faces of a box
 		0, 1, 2,
 		0, 2, 3,
@@ -244,144 +377,1195 @@ struct Building {
 		0.0f, 0.0f,
 	};
 
-	// OpenGL buffers
+	GLfloat slot_uv_buffer_data[48] = {	// Where each face sits in the building's virtual texture slot
+		// Front, back, left and right side by side over the top three quarters
+		0.0f, 0.75f,
+		0.25f, 0.75f,
+		0.25f, 0.0f,
+		0.0f, 0.0f,
+
+		0.25f, 0.75f,
+		0.5f, 0.75f,
+		0.5f, 0.0f,
+		0.25f, 0.0f,
+
+		0.5f, 0.75f,
+		0.75f, 0.75f,
+		0.75f, 0.0f,
+		0.5f, 0.0f,
+
+		0.75f, 0.75f,
+		1.0f, 0.75f,
+		1.0f, 0.0f,
+		0.75f, 0.0f,
+
+		// Top, the roof, in the bottom-left quarter
+		0.0f, 1.0f,
+		0.25f, 1.0f,
+		0.25f, 0.75f,
+		0.0f, 0.75f,
+
+		// Bottom, next to it
+		0.25f, 0.75f,
+		0.5f, 0.75f,
+		0.5f, 1.0f,
+		0.25f, 1.0f,
+	};
+
+	// OpenGL buffers: one interleaved vertex buffer of MeshVertex
 	GLuint vertexArrayID;
 	GLuint vertexBufferID;
 	GLuint indexBufferID;
-	GLuint colorBufferID;
-	GLuint uvBufferID;
-	GLuint textureID;
-	GLuint normalBufferID;
-	GLuint exposureID; // Uniform location for exposure
-
-	// Shader variable IDs
-	GLuint mvpMatrixID;
-	GLuint textureSamplerID;
-	GLuint lightPositionID;
-	GLuint lightIntensityID;
-
-	void initialize(glm::vec3 position, glm::vec3 scale) {
-		this->position = position;
-		this->scale = scale;
-
-		// List of texture file paths
-		const std::string textureFiles[6] = {
-			"../../../lab2/facade0.jpg",
-			"../../../lab2/facade1.jpg",
-			"../../../lab2/facade2.jpg",
-			"../../../lab2/facade3.jpg",
-			"../../../lab2/facade4.jpg",
-			"../../../lab2/facade5.jpg"
-		};
-
-		// Randomly select a texture from the list
-		int textureIndex = rand() % 6;
-		textureID = LoadTextureTileBox(textureFiles[textureIndex].c_str());
+	std::vector<MeshLod> lods;		// Ranges of the index buffer, full detail first
+	std::vector<Meshlet> meshlets;	// Of the full detail level
+
+	// The arrays above as a mesh, facades repeating five times up each wall
+	void boxMesh(MeshData& mesh) const {
+		mesh.vertices.resize(24);
+		for (int i = 0; i < 24; ++i) {
+			MeshVertex& vertex = mesh.vertices[i];
+			vertex.position = glm::vec3(vertex_buffer_data[3 * i], vertex_buffer_data[3 * i + 1], vertex_buffer_data[3 * i + 2]);
+			vertex.normal = glm::vec3(normal_buffer_data[3 * i], normal_buffer_data[3 * i + 1], normal_buffer_data[3 * i + 2]);
+			vertex.uv = glm::vec2(uv_buffer_data[2 * i], uv_buffer_data[2 * i + 1] * 5);
+			vertex.slotUV = glm::vec2(slot_uv_buffer_data[2 * i], slot_uv_buffer_data[2 * i + 1]);
+		}
+		mesh.indices.assign(index_buffer_data, index_buffer_data + 36);
+	}
 
-		// Create a vertex array object
-		glGenVertexArrays(1, &vertexArrayID);
-		glBindVertexArray(vertexArrayID);
+	// Uploads a mesh, first reordering it for the GPU and appending its
+	// levels of detail to the index buffer when optimize is set
+	void initialize(MeshData& mesh, bool optimize, MeshOptimizeStats* stats = NULL) {
+		if (optimize) {
+			MeshOptimize(mesh, lods, stats);
+		}
+		else {
+			MeshLod full = { 0, static_cast<uint32_t>(mesh.indices.size()), 0.0f };
+			lods.assign(1, full);
+		}
+		meshlets.clear();
+		MeshletBuild(mesh, lods[0].firstIndex, lods[0].indexCount, meshlets);
 
-		// Create a vertex buffer object to store the vertex data		
+		// Create a vertex buffer object to store the vertex data
 		glGenBuffers(1, &vertexBufferID);
 		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertex_buffer_data), vertex_buffer_data, GL_STATIC_DRAW);
-
-		// Create a vertex buffer object to store the color data
-		glGenBuffers(1, &colorBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		for (int i = 0; i < 72; ++i) color_buffer_data[i] = 1.0f;
-		glBufferData(GL_ARRAY_BUFFER, sizeof(color_buffer_data), color_buffer_data, GL_STATIC_DRAW);
-
-		for (int i = 0; i < 24; ++i) uv_buffer_data[2 * i + 1] *= 5;
-
-		// Create a vertex buffer object to store the UV data 
-		glGenBuffers(1, &uvBufferID);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(uv_buffer_data), uv_buffer_data, GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(MeshVertex), mesh.vertices.data(), GL_STATIC_DRAW);
 
 		// Create an index buffer object to store the index data that defines triangle faces
 		glGenBuffers(1, &indexBufferID);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(index_buffer_data), index_buffer_data, GL_STATIC_DRAW);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(),
+			GL_STATIC_DRAW);
 
-		// Use the global shader program
-		mvpMatrixID = glGetUniformLocation(globalProgramID, "MVP");
-		textureSamplerID = glGetUniformLocation(globalProgramID, "textureSampler");
-		lightPositionID = glGetUniformLocation(globalProgramID, "lightPosition");
-		lightIntensityID = glGetUniformLocation(globalProgramID, "lightIntensity");
-		exposureID = glGetUniformLocation(globalProgramID, "exposure"); // Get the uniform location
+		// Create a vertex array object
+		glGenVertexArrays(1, &vertexArrayID);
+		glBindVertexArray(vertexArrayID);
+		bindAttributes(false);
+		glBindVertexArray(0);
 	}
 
-	void render(glm::mat4 cameraMatrix) {
-		glUseProgram(globalProgramID);
-
-		glEnableVertexAttribArray(0);
+	// Points the bound VAO at the vertex and index buffers. The color is the
+	// constant white set by setConstantAttributes.
+	void bindAttributes(bool positionsOnly) const {
 		glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
-		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
-		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, colorBufferID);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, 0);
-
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+		if (!positionsOnly) {
+			glEnableVertexAttribArray(2);
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, uv));
+			glEnableVertexAttribArray(3);
+			glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+			glEnableVertexAttribArray(8);
+			glVertexAttribPointer(8, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, slotUV));
+		}
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	}
+
+	GLsizei indexCount(int lod) const {
+		return static_cast<GLsizei>(lods[lod].indexCount);
+	}
 
-		glm::mat4 modelMatrix = glm::mat4(1.0f);
-		modelMatrix = glm::translate(modelMatrix, position);
-		modelMatrix = glm::scale(modelMatrix, scale);
+	// Where a level of detail starts in the bound index buffer
+	const void* indexOffset(int lod) const {
+		return (const void*)(lods[lod].firstIndex * sizeof(uint32_t));
+	}
 
-		glm::mat4 mvp = cameraMatrix * modelMatrix;
-		glUniformMatrix4fv(mvpMatrixID, 1, GL_FALSE, &mvp[0][0]);
+	// Current values of attributes without arrays are context state, shared by every VAO
+	static void setConstantAttributes() {
+		glVertexAttrib3f(1, 1.0f, 1.0f, 1.0f);
+	}
 
-		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, uvBufferID);
-		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	// Draws one building with a model-view-projection matrix computed ahead
+	// of time. The program's shared uniforms must already be set.
+	void draw(const glm::mat4& mvp, GLuint programID, GLuint textureID, const glm::vec2& virtualSlot, int lod) {
+		RenderStateUseProgram(programID);
+		glBindVertexArray(vertexArrayID);
+		setConstantAttributes();
 
-		glEnableVertexAttribArray(3);
-		glBindBuffer(GL_ARRAY_BUFFER, normalBufferID);
-		glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 0, 0);
+		// With the instance arrays disabled the MVP is a constant vertex attribute
+		for (int column = 0; column < 4; ++column) {
+			glVertexAttrib4fv(4 + column, &mvp[column][0]);
+		}
+		glVertexAttrib2f(9, virtualSlot.x, virtualSlot.y);
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glUniform1i(textureSamplerID, 0);
+		RenderStateBindTexture(0, GL_TEXTURE_2D, textureID);
 
-		// Set light data 
-		glUniform3fv(lightPositionID, 1, &lightPosition[0]);
-		glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
+		glDrawElements(GL_TRIANGLES, indexCount(lod), GL_UNSIGNED_INT, indexOffset(lod));
+		++gRenderStats.drawCalls;
+		gRenderStats.triangles += indexCount(lod) / 3;
+		glBindVertexArray(0);
+	}
 
-		float exposure = 36.0f;
-		glUniform1f(exposureID, exposure); // Set the exposure uniform
+	// Depth pre-pass draw; the depth program reads positions only
+	void drawDepth(const glm::mat4& mvp, GLuint programID, int lod) {
+		RenderStateUseProgram(programID);
+		glBindVertexArray(vertexArrayID);
 
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, (void*)0);
+		for (int column = 0; column < 4; ++column) {
+			glVertexAttrib4fv(4 + column, &mvp[column][0]);
+		}
 
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
-		glDisableVertexAttribArray(3);
+		glDrawElements(GL_TRIANGLES, indexCount(lod), GL_UNSIGNED_INT, indexOffset(lod));
+		++gRenderStats.drawCalls;
+		gRenderStats.triangles += indexCount(lod) / 3;
+		glBindVertexArray(0);
 	}
 
 	void cleanup() {
 		glDeleteBuffers(1, &vertexBufferID);
-		glDeleteBuffers(1, &colorBufferID);
 		glDeleteBuffers(1, &indexBufferID);
 		glDeleteVertexArrays(1, &vertexArrayID);
-		glDeleteTextures(1, &textureID);
-		glDeleteBuffers(1, &normalBufferID);
+	}
+
+	// Uploads the lighting uniforms shared by every building to the bound
+	// forward program, CPU or GPU culled
+	static void setSharedUniforms(GLuint programID) {
+		glUniform1i(glGetUniformLocation(programID, "textureSampler"), 0);
+		glUniform3fv(glGetUniformLocation(programID, "lightPosition"), 1, &lightPosition[0]);
+		glUniform3fv(glGetUniformLocation(programID, "lightIntensity"), 1, &lightIntensity[0]);
+		glUniform3fv(glGetUniformLocation(programID, "ambientLight"), 1, &ambientLight[0]);
 	}
 };
 
-std::vector<Building> buildings;
+// One per mesh of the city scene: the built-in box or a model from --building-mesh or the scene
+static std::vector<Building> buildingMeshes;
+static const char* buildingMeshFile = NULL;
+static MeshLoadStats meshLoadTotals;
+
+// Buildings drawn on the CPU instead, chosen at startup with --software-raster,
+// which keeps a copy of every mesh as uploaded
+static bool softwareRaster = false;
+static std::vector<MeshData> softwareMeshes;		// Indexed like buildingMeshes
+
+// Meshes are reordered for the vertex cache, overdraw and fetching, and get
+// simplified levels of detail, unless --no-mesh-optimize asks for them as loaded
+static bool optimizeMeshes = true;
+static MeshOptimizeStats meshOptimizeTotals;
+
+// Screen pixels a level of detail may move the surface by before the next
+// finer one is drawn instead
+static const float kLodPixelError = 1.0f;
+
+// Buildings at full detail spanning more screen pixels than this are culled
+// meshlet by meshlet; smaller ones are cheaper to draw whole, instanced
+static const float kMeshletCullPixels = 256.0f;
+static bool useMeshletCulling = true;
+
+// Placement of every building, mapped from --city or generated at startup
+static CityScene city;
+static double cityLoadMs = 0.0;
+
+// Facade texture of each of the scene's materials
+static std::vector<int> materialFacades;
+
+static int BuildingFacade(const CityBuilding& building) {
+	return building.material < materialFacades.size() ? materialFacades[building.material] : 0;
+}
+
+static int BuildingMeshIndex(const CityBuilding& building) {
+	return building.mesh < buildingMeshes.size() ? static_cast<int>(building.mesh) : 0;
+}
+
+// Screen size of one unit of the canonical box at the nearest point of the
+// building, along its longest axis
+static float BuildingPixelsPerMeshUnit(const CityBuilding& building, const glm::vec3& eye, float pixelsPerUnitAtOne) {
+	glm::vec3 nearest = glm::clamp(eye, building.position - building.scale, building.position + building.scale);
+	float scale = glm::max(building.scale.x, glm::max(building.scale.y, building.scale.z));
+	return pixelsPerUnitAtOne * scale / glm::max(glm::length(nearest - eye), 1.0f);
+}
+
+// Coarsest level of detail whose error stays under kLodPixelError
+static int BuildingLod(const CityBuilding& building, float pixelsPerMeshUnit) {
+	const std::vector<MeshLod>& lods = buildingMeshes[BuildingMeshIndex(building)].lods;
+	int lod = 0;
+	while (lod + 1 < static_cast<int>(lods.size()) && lods[lod + 1].error * pixelsPerMeshUnit < kLodPixelError) {
+		++lod;
+	}
+	return lod;
+}
+
+// Batches are keyed by mesh, then level of detail, then whether they are
+// meshlet culled, then facade, so one mesh's batches are adjacent
+static unsigned int BuildingBatchKey(const CityBuilding& building, int lod, bool meshlets) {
+	int geometry = (BuildingMeshIndex(building) * kMaxMeshLods + lod) * 2 + (meshlets ? 1 : 0);
+	return static_cast<unsigned int>(geometry * 6 + BuildingFacade(building));
+}
+
+static int BatchMesh(unsigned int key) {
+	return static_cast<int>(key / 12 / kMaxMeshLods);
+}
+
+static int BatchLod(unsigned int key) {
+	return static_cast<int>(key / 12 % kMaxMeshLods);
+}
+
+static bool BatchMeshlets(unsigned int key) {
+	return key / 6 % 2 != 0;
+}
+
+// The built-in city: a 5 x 5 grid of towers without the middle column
+static void GenerateCity(CitySceneBuilder& builder) {
+	uint32_t box = builder.mesh(buildingMeshFile ? buildingMeshFile : "box");
+	for (int i = 0; i < 5; ++i) {
+		for (int j = 0; j < 5; ++j) {
+			// Skip the middle column
+			if (j == 2) continue;
+
+			// Create a height gradient and random variation
+			float baseHeight = 50.0f + (4 - abs(2 - j)) * 20.0f;
+			float heightVariation = static_cast<float>(rand() % 21) - 10.0f;
+			float randomHeight = baseHeight + heightVariation;
+
+			glm::vec3 scale(16.0f, randomHeight, 16.0f);
+
+			// Adjust position for a more scattered layout
+			glm::vec3 position(i * 60.0f - 120.0f, scale.y / 2.0f - 50.0f, j * 60.0f - 120.0f);
+
+			// Buildings past the last slot share it
+			int slot = glm::min(static_cast<int>(builder.buildings.size()), kMaxVirtualSlots - 1);
+
+			// Randomly select one of the shared facade textures
+			uint32_t material = builder.material(facadeTextureFiles[rand() % 6]);
+			builder.add(position, scale, material, box, glm::vec2(slot % kSlotsPerSide, slot / kSlotsPerSide));
+		}
+	}
+}
+
+// Maps the scene file, or generates the built-in city when there is none,
+// then resolves its materials to facades and gives every virtual texture
+// slot in use the facade of its first building
+static bool LoadCity(const char* path) {
+	PROFILE_ZONE("City load");
+	uint64_t start = ProfilerNow();
+	if (path) {
+		if (!city.open(path)) return false;
+	}
+	else {
+		CitySceneBuilder builder;
+		GenerateCity(builder);
+		std::vector<uint8_t> bytes;
+		builder.serialize(bytes);
+		city.adopt(std::move(bytes));
+	}
+	if (city.buildingCount == 0) {
+		std::cout << "The city has no buildings." << std::endl;
+		return false;
+	}
+	// Meshes other than the box are models loaded through the VFS. Buildings
+	// with no mesh of their own fall back to the first, so there must be one.
+	std::vector<std::string> meshNames = city.meshNames;
+	if (meshNames.empty()) {
+		std::cout << "The city names no meshes, drawing boxes." << std::endl;
+		meshNames.push_back("box");
+	}
+	buildingMeshes.resize(meshNames.size());
+	if (softwareRaster) softwareMeshes.resize(meshNames.size());
+	for (size_t m = 0; m < meshNames.size(); ++m) {
+		const std::string& name = meshNames[m];
+		MeshData mesh;
+		bool loaded = false;
+		if (name != "box") {
+			AssetView file;
+			MeshLoadStats stats;
+			if (!VfsRead(name.c_str(), file)) {
+				std::cout << "Mesh " << name << " not found, drawing a box." << std::endl;
+			}
+			else if (MeshLoad(file.data, file.size, name.c_str(), mesh, &stats)) {
+				loaded = true;
+				printf("Loaded mesh %s: %zu vertices, %zu triangles, %.1f MB in %.2f ms, %.0f MB/s\n", name.c_str(),
+					mesh.vertices.size(), mesh.indices.size() / 3, stats.bytes / 1048576.0, stats.milliseconds,
+					stats.megabytesPerSecond());
+				meshLoadTotals.bytes += stats.bytes;
+				meshLoadTotals.corners += stats.corners;
+				meshLoadTotals.milliseconds += stats.milliseconds;
+			}
+		}
+		if (!loaded) buildingMeshes[m].boxMesh(mesh);
+		MeshOptimizeStats stats;
+		buildingMeshes[m].initialize(mesh, optimizeMeshes, &stats);
+		if (softwareRaster) softwareMeshes[m] = mesh;
+		if (optimizeMeshes) {
+			printf("Optimized mesh %s in %.2f ms: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %zu levels of detail\n",
+				name.c_str(), stats.milliseconds, stats.before.acmr(), stats.after.acmr(), stats.before.atvr(),
+				stats.after.atvr(), buildingMeshes[m].lods.size());
+			meshOptimizeTotals.before.add(stats.before);
+			meshOptimizeTotals.after.add(stats.after);
+			meshOptimizeTotals.milliseconds += stats.milliseconds;
+		}
+	}
+
+	materialFacades.assign(city.materialNames.size(), 0);
+	for (size_t m = 0; m < city.materialNames.size(); ++m) {
+		int facade = 0;
+		while (facade < 6 && city.materialNames[m] != facadeTextureFiles[facade]) ++facade;
+		if (facade == 6) {
+			std::cout << "Unknown material " << city.materialNames[m] << ", using " << facadeTextureFiles[0] << "."
+				<< std::endl;
+			facade = 0;
+		}
+		materialFacades[m] = facade;
+	}
+
+	std::vector<int> slotFacades(kMaxVirtualSlots, -1);
+	int slotsUsed = 0;
+	for (size_t i = 0; i < city.buildingCount; ++i) {
+		int slot = static_cast<int>(city.slots[i].y) * kSlotsPerSide + static_cast<int>(city.slots[i].x);
+		if (slot < 0 || slot >= kMaxVirtualSlots || slotFacades[slot] >= 0) continue;
+		slotFacades[slot] = BuildingFacade(city.buildings[i]);
+		slotsUsed = glm::max(slotsUsed, slot + 1);
+	}
+	for (int slot = 0; slot < slotsUsed; ++slot) {
+		facadePages.addSlot(glm::max(slotFacades[slot], 0), static_cast<unsigned int>(rand()));
+	}
+
+	cityLoadMs = (ProfilerNow() - start) * 1e-6;
+	std::cout << "City of " << city.buildingCount << " buildings in " << city.chunkCount << " chunks, loaded in "
+		<< cityLoadMs << " ms" << std::endl;
+	return true;
+}
+
+// Draws all visible buildings with one instanced call per mesh, level of
+// detail and facade texture, except meshlet culled ones, which get a
+// multi-draw each. Each mesh gets a VAO over its own buffers plus a streamed
+// per-instance MVP at locations 4 to 7 and virtual texture slot at location 9.
+// A second VAO per mesh reads only positions and the MVPs for the depth
+// pre-pass.
+struct BuildingInstances {
+	std::vector<GLuint> vertexArrayIDs;			// Indexed like buildingMeshes
+	std::vector<GLuint> depthVertexArrayIDs;
+	GLuint instanceBufferID;
+	GLuint slotBufferID;
+	std::vector<glm::vec2> slots;		// Staging for slotBufferID
+	std::vector<GLsizei> rangeCounts;			// The packet's meshlet ranges as glMultiDrawElements takes them
+	std::vector<const void*> rangeOffsets;
+	size_t capacity;		// Instances the buffer has storage for
+	size_t uploaded;		// Instances written this frame
+
+	void initialize(const std::vector<Building>& meshes) {
+		capacity = 0;
+		uploaded = 0;
+		glGenBuffers(1, &slotBufferID);
+		glGenBuffers(1, &instanceBufferID);
+
+		vertexArrayIDs.resize(meshes.size());
+		depthVertexArrayIDs.resize(meshes.size());
+		glGenVertexArrays(static_cast<GLsizei>(meshes.size()), vertexArrayIDs.data());
+		glGenVertexArrays(static_cast<GLsizei>(meshes.size()), depthVertexArrayIDs.data());
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			glBindVertexArray(vertexArrayIDs[m]);
+			meshes[m].bindAttributes(false);
+			glEnableVertexAttribArray(9);
+			glVertexAttribDivisor(9, 1);
+			for (int column = 0; column < 4; ++column) {
+				glEnableVertexAttribArray(4 + column);
+				glVertexAttribDivisor(4 + column, 1);
+			}
+
+			glBindVertexArray(depthVertexArrayIDs[m]);
+			meshes[m].bindAttributes(true);
+			for (int column = 0; column < 4; ++column) {
+				glEnableVertexAttribArray(4 + column);
+				glVertexAttribDivisor(4 + column, 1);
+			}
+		}
+		glBindVertexArray(0);
+	}
+
+	// Points the MVP attributes at the instance range starting at first. GL 3.3
+	// has no base instance, so each batch offsets the attribute pointers instead.
+	void bindInstanceRange(size_t first) {
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+		for (int column = 0; column < 4; ++column) {
+			size_t offset = (first * 16 + column * 4) * sizeof(float);
+			glVertexAttribPointer(4 + column, 4, GL_FLOAT, GL_FALSE, 16 * sizeof(float), (void*)offset);
+		}
+	}
+
+	// The slots only exist in the shading VAO
+	void bindSlotRange(size_t first) {
+		glBindBuffer(GL_ARRAY_BUFFER, slotBufferID);
+		glVertexAttribPointer(9, 2, GL_FLOAT, GL_FALSE, 0, (void*)(first * sizeof(glm::vec2)));
+	}
+
+	// Writes this frame's MVPs, once for every pass that draws the instances
+	void upload(const FramePacket& packet) {
+		uploaded = 0;
+		size_t count = packet.visible.size();
+		if (count == 0) return;
+
+		slots.resize(count);
+		for (size_t i = 0; i < count; ++i) {
+			slots[i] = city.slots[packet.visible[i]];
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, slotBufferID);
+		glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec2), slots.data(), GL_STREAM_DRAW);
+
+		rangeCounts.resize(packet.meshletRanges.size());
+		rangeOffsets.resize(packet.meshletRanges.size());
+		for (size_t r = 0; r < packet.meshletRanges.size(); ++r) {
+			rangeCounts[r] = static_cast<GLsizei>(packet.meshletRanges[r].count);
+			rangeOffsets[r] = (const void*)(packet.meshletRanges[r].first * sizeof(uint32_t));
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+		if (count > capacity) {
+			capacity = count + count / 2;
+			glBufferData(GL_ARRAY_BUFFER, capacity * 16 * sizeof(float), NULL, GL_STREAM_DRAW);
+		}
+
+		// The transform kernel writes the MVPs straight into the mapped buffer
+		{
+			PROFILE_ZONE("Instance transforms");
+			float* instances = (float*)glMapBufferRange(GL_ARRAY_BUFFER, 0, count * 16 * sizeof(float),
+				GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+			if (!instances) return;
+			const glm::mat4* world = city.world;
+			const unsigned int* visible = packet.visible.data();
+			JobCounter transforms;
+			JobParallelFor(count, 4096, [&](size_t begin, size_t end) {
+				TransformBatchMVP(packet.viewProjection, world, visible + begin, end - begin, instances + begin * 16);
+			}, &transforms);
+			JobWait(&transforms);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		uploaded = count;
+	}
+
+	// Meshlet culled buildings are drawn one multi-draw each over their
+	// surviving index ranges. A non-instanced draw reads the instance
+	// attributes at the start of their range, so each building points them at
+	// its own entry.
+	void drawMeshletBatch(const FramePacket& packet, const FrameBatch& batch, bool shading) {
+		for (size_t i = batch.first; i < batch.first + batch.count; ++i) {
+			const FrameRange& draw = packet.meshletDraws[i];
+			if (draw.count == 0) continue;
+			bindInstanceRange(i);
+			if (shading) bindSlotRange(i);
+			glMultiDrawElements(GL_TRIANGLES, rangeCounts.data() + draw.first, GL_UNSIGNED_INT,
+				rangeOffsets.data() + draw.first, static_cast<GLsizei>(draw.count));
+			++gRenderStats.drawCalls;
+			for (size_t r = draw.first; r < draw.first + draw.count; ++r) {
+				gRenderStats.triangles += rangeCounts[r] / 3;
+			}
+		}
+	}
+
+	// Batches only matter for the facade textures, so each run of batches
+	// sharing a mesh and level of detail goes in one draw
+	void renderDepth(const FramePacket& packet, GLuint programID) {
+		if (uploaded == 0) return;
+		RenderStateUseProgram(programID);
+		for (size_t b = 0; b < packet.batches.size();) {
+			unsigned int key = packet.batches[b].key;
+			unsigned int first = packet.batches[b].first, count = 0;
+			for (; b < packet.batches.size() && packet.batches[b].key / 6 == key / 6; ++b) {
+				count += packet.batches[b].count;
+			}
+			glBindVertexArray(depthVertexArrayIDs[BatchMesh(key)]);
+			if (BatchMeshlets(key)) {
+				FrameBatch run = { key, first, count };
+				drawMeshletBatch(packet, run, false);
+				continue;
+			}
+			const Building& mesh = buildingMeshes[BatchMesh(key)];
+			int lod = BatchLod(key);
+			bindInstanceRange(first);
+			GLsizei indexCount = mesh.indexCount(lod);
+			glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, mesh.indexOffset(lod), count);
+			++gRenderStats.drawCalls;
+			gRenderStats.triangles += static_cast<unsigned long long>(indexCount / 3) * count;
+		}
+		glBindVertexArray(0);
+	}
+
+	// The program's shared uniforms must already be set
+	void render(const FramePacket& packet, GLuint programID) {
+		if (uploaded == 0) return;
+		RenderStateUseProgram(programID);
+		Building::setConstantAttributes();
+		for (const FrameBatch& batch : packet.batches) {
+			const Building& mesh = buildingMeshes[BatchMesh(batch.key)];
+			int lod = BatchLod(batch.key);
+			glBindVertexArray(vertexArrayIDs[BatchMesh(batch.key)]);
+			RenderStateBindTexture(0, GL_TEXTURE_2D, facadeTextures[batch.key % 6]);
+			if (BatchMeshlets(batch.key)) {
+				drawMeshletBatch(packet, batch, true);
+				continue;
+			}
+			bindInstanceRange(batch.first);
+			bindSlotRange(batch.first);
+			GLsizei indexCount = mesh.indexCount(lod);
+			glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, mesh.indexOffset(lod), batch.count);
+			++gRenderStats.drawCalls;
+			gRenderStats.triangles += static_cast<unsigned long long>(indexCount / 3) * batch.count;
+		}
+		glBindVertexArray(0);
+	}
+
+	void cleanup() {
+		glDeleteBuffers(1, &instanceBufferID);
+		glDeleteBuffers(1, &slotBufferID);
+		glDeleteVertexArrays(static_cast<GLsizei>(vertexArrayIDs.size()), vertexArrayIDs.data());
+		glDeleteVertexArrays(static_cast<GLsizei>(depthVertexArrayIDs.size()), depthVertexArrayIDs.data());
+	}
+};
+
+static BuildingInstances buildingInstances;
+
+// Instanced drawing, toggled with I to compare against one draw per building,
+// which always draws whole levels of detail and so skips meshlet culling
+static bool useInstancing = true;
+
+// Buildings culled on the GPU instead of by the scene stage. Every building is
+// uploaded once with its bounds, grouped by mesh and facade texture, and each
+// frame the culler packs the indices of the visible ones for one instanced
+// draw per group. The shaders fetch world matrices and slots from buffer
+// textures over the city's arrays, so nothing is streamed per frame. Levels
+// of detail and meshlets are chosen per building on the CPU, so this path
+// draws every building at full detail.
+struct GpuCulledBuildings {
+	GpuCuller culler;
+	HiZPyramid hiZ;
+	std::vector<unsigned int> rangeKeys;		// mesh * 6 + facade of each of the culler's ranges
+	std::vector<GLuint> vertexArrayIDs;			// Indexed like buildingMeshes
+	std::vector<GLuint> depthVertexArrayIDs;
+	GLuint worldBufferID = 0;
+	GLuint worldTextureID = 0;
+	GLuint slotBufferID = 0;
+	GLuint slotTextureID = 0;
+	bool ready = false;
+
+	bool initialize(const std::vector<Building>& meshes) {
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		if (city.buildingCount * 4 > static_cast<size_t>(maxTexels)) {
+			std::cout << "GPU culling unavailable, " << city.buildingCount << " buildings need "
+				<< city.buildingCount * 4 << " buffer texels of " << maxTexels << "." << std::endl;
+			return false;
+		}
+		if (!hiZ.initialize("fullscreen.vert", "hiz.frag")) return false;
+
+		// Counting sort of the buildings by range key
+		std::vector<unsigned int> keyCounts(meshes.size() * 6, 0), keyNext(meshes.size() * 6);
+		for (size_t i = 0; i < city.buildingCount; ++i) {
+			++keyCounts[BuildingMeshIndex(city.buildings[i]) * 6 + BuildingFacade(city.buildings[i])];
+		}
+		std::vector<unsigned int> rangeCounts;
+		unsigned int placed = 0;
+		for (unsigned int key = 0; key < keyCounts.size(); ++key) {
+			keyNext[key] = placed;
+			placed += keyCounts[key];
+			if (keyCounts[key] == 0) continue;
+			rangeKeys.push_back(key);
+			rangeCounts.push_back(keyCounts[key]);
+		}
+		std::vector<GpuCullInstance> instances(city.buildingCount);
+		for (size_t i = 0; i < city.buildingCount; ++i) {
+			const CityBuilding& building = city.buildings[i];
+			GpuCullInstance& instance = instances[keyNext[BuildingMeshIndex(building) * 6 + BuildingFacade(building)]++];
+			// The canonical box spans [-1, 1], so the scale is the half extent
+			instance.center = building.position;
+			instance.id = static_cast<uint32_t>(i);
+			instance.halfExtent = building.scale;
+			instance.padding = 0.0f;
+		}
+		if (!culler.initialize("cull.vert", "cull.geom", instances, rangeCounts)) {
+			hiZ.cleanup();
+			return false;
+		}
+
+		glGenBuffers(1, &worldBufferID);
+		glBindBuffer(GL_TEXTURE_BUFFER, worldBufferID);
+		glBufferData(GL_TEXTURE_BUFFER, city.buildingCount * sizeof(glm::mat4), city.world, GL_STATIC_DRAW);
+		glGenBuffers(1, &slotBufferID);
+		glBindBuffer(GL_TEXTURE_BUFFER, slotBufferID);
+		glBufferData(GL_TEXTURE_BUFFER, city.buildingCount * sizeof(glm::vec2), city.slots, GL_STATIC_DRAW);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		glGenTextures(1, &worldTextureID);
+		glBindTexture(GL_TEXTURE_BUFFER, worldTextureID);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, worldBufferID);
+		glGenTextures(1, &slotTextureID);
+		glBindTexture(GL_TEXTURE_BUFFER, slotTextureID);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32F, slotBufferID);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		RenderStateInvalidate();
+
+		// The building index is the only per-instance attribute, at location 10
+		vertexArrayIDs.resize(meshes.size());
+		depthVertexArrayIDs.resize(meshes.size());
+		glGenVertexArrays(static_cast<GLsizei>(meshes.size()), vertexArrayIDs.data());
+		glGenVertexArrays(static_cast<GLsizei>(meshes.size()), depthVertexArrayIDs.data());
+		for (size_t m = 0; m < meshes.size(); ++m) {
+			glBindVertexArray(vertexArrayIDs[m]);
+			meshes[m].bindAttributes(false);
+			glEnableVertexAttribArray(10);
+			glVertexAttribDivisor(10, 1);
+
+			glBindVertexArray(depthVertexArrayIDs[m]);
+			meshes[m].bindAttributes(true);
+			glEnableVertexAttribArray(10);
+			glVertexAttribDivisor(10, 1);
+		}
+		glBindVertexArray(0);
+		ready = true;
+		return true;
+	}
+
+	// Culls against this frame's camera and the pyramid built at the end of
+	// the last one
+	void cull(const FramePacket& packet, float drawDistance) {
+		glm::vec3 eye(glm::inverse(packet.viewMatrix)[3]);
+		culler.cull(packet.viewProjection, eye, drawDistance, hiZ);
+	}
+
+	// Each range's visible IDs, through the attribute pointer as GL 3.3 has no base instance
+	void bindRange(size_t range) {
+		glBindBuffer(GL_ARRAY_BUFFER, culler.visibleBufferID);
+		glVertexAttribIPointer(10, 1, GL_UNSIGNED_INT, 0, (void*)(culler.ranges[range].first * sizeof(uint32_t)));
+	}
+
+	void draw(const std::vector<GLuint>& vertexArrays, GLuint programID, const glm::mat4& viewProjection,
+		bool shading) {
+		RenderStateUseProgram(programID);
+		glUniformMatrix4fv(glGetUniformLocation(programID, "viewProjection"), 1, GL_FALSE, &viewProjection[0][0]);
+		RenderStateBindTexture(kWorldMatricesUnit, GL_TEXTURE_BUFFER, worldTextureID);
+		RenderStateBindTexture(kBuildingSlotsUnit, GL_TEXTURE_BUFFER, slotTextureID);
+		if (shading) Building::setConstantAttributes();
+		for (size_t r = 0; r < rangeKeys.size(); ++r) {
+			GLsizei count = culler.drawCount(r);
+			if (count == 0) continue;
+			const Building& mesh = buildingMeshes[rangeKeys[r] / 6];
+			glBindVertexArray(vertexArrays[rangeKeys[r] / 6]);
+			if (shading) RenderStateBindTexture(0, GL_TEXTURE_2D, facadeTextures[rangeKeys[r] % 6]);
+			bindRange(r);
+			glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount(0), GL_UNSIGNED_INT, mesh.indexOffset(0), count);
+			++gRenderStats.drawCalls;
+			gRenderStats.triangles += static_cast<unsigned long long>(mesh.indexCount(0) / 3) * count;
+		}
+		glBindVertexArray(0);
+	}
+
+	void renderDepth(GLuint programID, const glm::mat4& viewProjection) {
+		draw(depthVertexArrayIDs, programID, viewProjection, false);
+	}
+
+	// The program's shared uniforms must already be set
+	void render(GLuint programID, const glm::mat4& viewProjection) {
+		draw(vertexArrayIDs, programID, viewProjection, true);
+	}
+
+	void cleanup() {
+		if (!ready) return;
+		culler.cleanup();
+		hiZ.cleanup();
+		glDeleteTextures(1, &worldTextureID);
+		glDeleteTextures(1, &slotTextureID);
+		glDeleteBuffers(1, &worldBufferID);
+		glDeleteBuffers(1, &slotBufferID);
+		glDeleteVertexArrays(static_cast<GLsizei>(vertexArrayIDs.size()), vertexArrayIDs.data());
+		glDeleteVertexArrays(static_cast<GLsizei>(depthVertexArrayIDs.size()), depthVertexArrayIDs.data());
+	}
+};
+
+// Toggled with C, or on from the start with --gpu-culling
+static GpuCulledBuildings gpuBuildings;
+static bool useGpuCulling = false;
+
+// Scene stage of the frame pipeline: frustum culls the city, picks each
+// visible building's level of detail and groups them by mesh, level and
+// facade texture, then culls the meshlets of close-up buildings, unless the
+// buildings are culled on the GPU. Runs on the
+// pipeline's worker thread, so it only reads the city scene and meshes, which
+// never change after startup.
+static void BuildFramePacket(const CameraState& camera, FramePacket& packet) {
+	PROFILE_ZONE("Cull and transform");
+	packet.viewMatrix = glm::lookAt(camera.eye, camera.lookat, camera.up);
+	packet.projectionMatrix = camera.projectionMatrix;
+	packet.viewProjection = packet.projectionMatrix * packet.viewMatrix;
+	LightClustersBuild(packet.viewMatrix, packet.projectionMatrix, cityLights.data(), camera.lightCount, packet.lights);
+
+	packet.gpuCulled = camera.gpuCulling;
+	if (packet.gpuCulled) {
+		packet.visible.clear();
+		packet.batches.clear();
+		packet.culled = 0;
+		packet.meshletDraws.clear();
+		packet.meshletRanges.clear();
+		packet.meshletsTested = 0;
+		packet.meshletsCulled = 0;
+		// Without knowing which buildings are visible, every facade asks for
+		// full detail over the whole screen
+		TextureRequest fullDetail;
+		fullDetail.pixelsPerRepeat = camera.viewportHeight;
+		fullDetail.screenArea = camera.viewportHeight * camera.viewportHeight;
+		packet.textureRequests.assign(6, fullDetail);
+		return;
+	}
+
+	Frustum frustum(packet.viewProjection);
+	float drawDistance = camera.drawDistance;
+	glm::vec3 eye = camera.eye;
+	float pixelsPerUnitAtOne = camera.viewportHeight * packet.projectionMatrix[1][1] * 0.5f;
+	bool meshletCulling = camera.meshletCulling;
+
+	// Cull in parallel into per-building flags, then compact in order. Whole
+	// chunks outside the view are rejected without reading their buildings.
+	// The pipeline never builds two packets at once, so the scratch array can
+	// be shared between calls.
+	static std::vector<unsigned char> visibleFlags;
+	static std::vector<unsigned int> batchKeys;		// Of visible buildings only
+	size_t count = city.buildingCount;
+	visibleFlags.resize(count);
+	batchKeys.resize(count);
+
+	JobCounter culling;
+	JobParallelFor(city.chunkCount, 16, [&](size_t begin, size_t end) {
+		for (size_t c = begin; c < end; ++c) {
+			const CityChunk& chunk = city.chunks[c];
+			glm::vec3 chunkCenter = 0.5f * (chunk.boundsMin + chunk.boundsMax);
+			glm::vec3 chunkHalfExtent = 0.5f * (chunk.boundsMax - chunk.boundsMin);
+			bool chunkVisible = frustum.intersectsBox(chunkCenter, chunkHalfExtent);
+			if (chunkVisible && drawDistance > 0.0f) {
+				chunkVisible = glm::length(chunkCenter - eye) - glm::length(chunkHalfExtent) < drawDistance;
+			}
+			if (!chunkVisible) {
+				memset(&visibleFlags[chunk.first], 0, chunk.count);
+				continue;
+			}
+			for (size_t i = chunk.first; i < chunk.first + chunk.count; ++i) {
+				const CityBuilding& building = city.buildings[i];
+				// The canonical box spans [-1, 1], so the scale is the half extent
+				bool visible = frustum.intersectsBox(building.position, building.scale);
+				if (visible && drawDistance > 0.0f) {
+					visible = glm::length(building.position - eye) - glm::length(building.scale) < drawDistance;
+				}
+				visibleFlags[i] = visible;
+				if (!visible) continue;
+				float pixelsPerMeshUnit = BuildingPixelsPerMeshUnit(building, eye, pixelsPerUnitAtOne);
+				int lod = BuildingLod(building, pixelsPerMeshUnit);
+				bool meshlets = meshletCulling && lod == 0 && pixelsPerMeshUnit * 2.0f > kMeshletCullPixels &&
+					buildingMeshes[BuildingMeshIndex(building)].meshlets.size() > 1;
+				batchKeys[i] = BuildingBatchKey(building, lod, meshlets);
+			}
+		}
+	}, &culling);
+	JobWait(&culling);
+
+	// Bucket by batch key so each batch is one contiguous instance range:
+	// count each bucket's buildings, then place them in one more pass
+	static std::vector<unsigned int> bucketCounts, bucketNext;
+	bucketCounts.assign(buildingMeshes.size() * kMaxMeshLods * 2 * 6, 0);
+	bucketNext.resize(bucketCounts.size());
+	for (size_t i = 0; i < count; ++i) {
+		if (visibleFlags[i]) ++bucketCounts[batchKeys[i]];
+	}
+	packet.batches.clear();
+	unsigned int visibleCount = 0;
+	for (unsigned int key = 0; key < bucketCounts.size(); ++key) {
+		bucketNext[key] = visibleCount;
+		if (bucketCounts[key] > 0) {
+			FrameBatch batch = { key, visibleCount, bucketCounts[key] };
+			packet.batches.push_back(batch);
+		}
+		visibleCount += bucketCounts[key];
+	}
+	packet.visible.resize(visibleCount);
+	for (size_t i = 0; i < count; ++i) {
+		if (!visibleFlags[i]) continue;
+		packet.visible[bucketNext[batchKeys[i]]++] = static_cast<unsigned int>(i);
+	}
+	packet.culled = static_cast<unsigned int>(count - visibleCount);
+
+	// Meshlets of close-up buildings: each building gets room for one range
+	// per meshlet, then culls them against the frustum and by their normal
+	// cones in parallel, merging neighbours that both survive
+	packet.meshletDraws.assign(visibleCount, FrameRange());
+	packet.meshletRanges.clear();
+	static std::vector<unsigned int> meshletBuildings;		// Entries of visible
+	meshletBuildings.clear();
+	for (const FrameBatch& batch : packet.batches) {
+		if (!BatchMeshlets(batch.key)) continue;
+		const std::vector<Meshlet>& meshlets = buildingMeshes[BatchMesh(batch.key)].meshlets;
+		for (unsigned int v = batch.first; v < batch.first + batch.count; ++v) {
+			packet.meshletDraws[v].first = static_cast<unsigned int>(packet.meshletRanges.size());
+			packet.meshletRanges.resize(packet.meshletRanges.size() + meshlets.size());
+			meshletBuildings.push_back(v);
+		}
+	}
+	std::atomic<unsigned int> meshletsTested(0), meshletsCulled(0);
+	JobCounter meshletCullingDone;
+	JobParallelFor(meshletBuildings.size(), 1, [&](size_t begin, size_t end) {
+		unsigned int tested = 0, culled = 0;
+		for (size_t b = begin; b < end; ++b) {
+			unsigned int v = meshletBuildings[b];
+			const CityBuilding& building = city.buildings[packet.visible[v]];
+			const std::vector<Meshlet>& meshlets = buildingMeshes[BuildingMeshIndex(building)].meshlets;
+			// The world matrix only translates and scales, so the eye maps back
+			// into mesh space directly
+			glm::vec3 meshEye = (eye - building.position) / building.scale;
+			float scale = glm::max(building.scale.x, glm::max(building.scale.y, building.scale.z));
+			FrameRange& draw = packet.meshletDraws[v];
+			FrameRange* ranges = &packet.meshletRanges[draw.first];
+			for (const Meshlet& meshlet : meshlets) {
+				++tested;
+				glm::vec3 center = building.position + building.scale * meshlet.center;
+				if (!frustum.intersectsSphere(center, meshlet.radius * scale) || MeshletFacesAway(meshlet, meshEye)) {
+					++culled;
+					continue;
+				}
+				if (draw.count > 0 && ranges[draw.count - 1].first + ranges[draw.count - 1].count == meshlet.firstIndex) {
+					ranges[draw.count - 1].count += meshlet.indexCount;
+				}
+				else {
+					ranges[draw.count].first = meshlet.firstIndex;
+					ranges[draw.count].count = meshlet.indexCount;
+					++draw.count;
+				}
+			}
+		}
+		meshletsTested += tested;
+		meshletsCulled += culled;
+	}, &meshletCullingDone);
+	JobWait(&meshletCullingDone);
+	packet.meshletsTested = meshletsTested;
+	packet.meshletsCulled = meshletsCulled;
+
+	// Texture detail each facade needs: the largest on-screen size of one
+	// repeat and a rough covered area, both from the nearest point of the box
+	packet.textureRequests.assign(6, TextureRequest());
+	for (unsigned int i : packet.visible) {
+		const CityBuilding& building = city.buildings[i];
+		glm::vec3 nearest = glm::clamp(eye, building.position - building.scale, building.position + building.scale);
+		float pixelsPerUnit = pixelsPerUnitAtOne / glm::max(glm::length(nearest - eye), 1.0f);
+		// Faces repeat once across their width and five times up their height
+		float repeatSize = glm::max(2.0f * glm::max(building.scale.x, building.scale.z), 2.0f * building.scale.y / 5.0f);
+		float area = 4.0f * glm::max(building.scale.x, building.scale.z) * building.scale.y * pixelsPerUnit * pixelsPerUnit;
+
+		TextureRequest& request = packet.textureRequests[BuildingFacade(building)];
+		request.pixelsPerRepeat = glm::max(request.pixelsPerRepeat, repeatSize * pixelsPerUnit);
+		request.screenArea += glm::min(area, camera.viewportHeight * camera.viewportHeight * 2.0f);
+	}
+}
+
+// Places lamps along the streets between the buildings and fills the rest of
+// the budget with lights just outside random facades, then shuffles them so
+// any prefix of the list is a mix of both
+static void GenerateCityLights(size_t count) {
+	PROFILE_ZONE("Light generation");
+	cityLights.clear();
+	const glm::vec3 lampColor(12.0f, 9.0f, 5.0f);
+	for (int street = 0; street < 6 && cityLights.size() < count; ++street) {
+		float across = street * 60.0f - 150.0f;
+		for (float along = -160.0f; along <= 160.0f && cityLights.size() < count; along += 8.0f) {
+			cityLights.push_back({ glm::vec3(across, -40.0f, along), 25.0f, lampColor, 0.0f });
+			cityLights.push_back({ glm::vec3(along, -40.0f, across), 25.0f, lampColor, 0.0f });
+		}
+	}
+
+	const glm::vec3 windowColors[3] = {
+		glm::vec3(4.0f, 3.2f, 2.0f),
+		glm::vec3(3.0f, 3.2f, 4.0f),
+		glm::vec3(4.0f, 2.4f, 1.2f),
+	};
+	while (cityLights.size() < count) {
+		const CityBuilding& building = city.buildings[rand() % city.buildingCount];
+		int face = rand() % 4;
+		float u = (rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+		float v = (rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+		glm::vec3 offset;
+		if (face == 0) offset = glm::vec3(u, v, 1.05f);
+		else if (face == 1) offset = glm::vec3(u, v, -1.05f);
+		else if (face == 2) offset = glm::vec3(1.05f, v, u);
+		else offset = glm::vec3(-1.05f, v, u);
+		cityLights.push_back({ building.position + offset * building.scale, 12.0f, windowColors[rand() % 3], 0.0f });
+	}
 
-int main(void)
+	for (size_t i = cityLights.size(); i > 1; --i) {
+		std::swap(cityLights[i - 1], cityLights[rand() % i]);
+	}
+}
+
+static void StartLightingSweep() {
+	if (sweepConfig >= 0) return;
+	sweepSavedDeferred = deferredShading;
+	sweepSavedLightCountIndex = lightCountIndex;
+	sweepSavedGovernor = governor.enabled;
+	// Full quality throughout, only the scale varies
+	governor.enabled = false;
+	governor.reset();
+	SetFacadeTextureLodBias(0.0f);
+	appliedQualityLevel = 0;
+	sweepConfig = 0;
+	sweepFrame = 0;
+	sweepSumMs = 0.0;
+	std::cout << "Lighting sweep: renderer, lights, scale, GPU ms" << std::endl;
+}
+
+// Configurations run deferred-major: 2 renderers x 4 light counts x 3 scales
+static void ApplyLightingSweepConfig() {
+	if (sweepConfig < 0) return;
+	deferredShading = sweepConfig / 12 == 1;
+	lightCountIndex = (sweepConfig / 3) % 4;
+	governor.scale = sweepScales[sweepConfig % 3];
+}
+
+// Returns true on the frame the last configuration finishes
+static bool AdvanceLightingSweep(double gpuMs) {
+	if (sweepConfig < 0) return false;
+	if (++sweepFrame > kSweepWarmupFrames) sweepSumMs += gpuMs;
+	if (sweepFrame < kSweepWarmupFrames + kSweepMeasuredFrames) return false;
+
+	double averageMs = sweepSumMs / kSweepMeasuredFrames;
+	int scalePercent = (int)(sweepScales[sweepConfig % 3] * 100.0f + 0.5f);
+	char key[64];
+	snprintf(key, sizeof(key), "%s_%u_%d_ms", deferredShading ? "deferred" : "forward",
+		lightCountSteps[lightCountIndex], scalePercent);
+	BenchmarkSet("lighting_sweep", key, averageMs);
+	printf("  %-8s %6u %4d%% %8.3f\n", deferredShading ? "deferred" : "forward",
+		lightCountSteps[lightCountIndex], scalePercent, averageMs);
+
+	sweepFrame = 0;
+	sweepSumMs = 0.0;
+	if (++sweepConfig < 24) return false;
+
+	sweepConfig = -1;
+	deferredShading = sweepSavedDeferred;
+	lightCountIndex = sweepSavedLightCountIndex;
+	governor.enabled = sweepSavedGovernor;
+	governor.reset();
+	return true;
+}
+
+// Overlaps culling for the next frame with draw submission of this one
+static FramePipeline framePipeline;
+
+// The camera as the scene stage takes it
+static CameraState CurrentCamera(const glm::mat4& projectionMatrix, float zFar, float viewportHeight) {
+	CameraState camera;
+	camera.eye = eye_center;
+	camera.lookat = lookat;
+	camera.up = up;
+	camera.projectionMatrix = projectionMatrix;
+	camera.drawDistance = zFar * governor.drawDistanceScale();
+	camera.lightCount = lightCountSteps[lightCountIndex];
+	camera.viewportHeight = viewportHeight;
+	camera.meshletCulling = useMeshletCulling;
+	camera.gpuCulling = useGpuCulling;
+	return camera;
+}
+
+// The software rasterizer draws the same culled, batched buildings with the
+// facades decoded into memory and box.frag's sun and ambient light, and shows
+// the frame through a textured triangle. Terrain, sky, point lights, shadows
+// and the virtual texture stay GPU only. With --software-capture the window
+// stays hidden, a fixed number of frames is drawn and the last is written
+// to a PNG. Frame times land in the same benchmark entries as the GL path,
+// which runs on llvmpipe with LIBGL_ALWAYS_SOFTWARE=1 for comparison.
+static SoftRasterizer softwareRasterizer;
+static SoftTexture softwareFacades[6];
+static SoftwareView softwareView;
+static const char* softwareCapturePath = NULL;
+static const int kSoftwareCaptureFrames = 60;
+
+// Recording of the frames as shown, without the HUD, started with
+// --capture <file.y4m or numbered PNG pattern> and --capture-fps
+static FrameCapture frameCapture;
+
+static void AddCaptureStatusLine() {
+	if (!frameCapture.active()) return;
+	char status[128];
+	snprintf(status, sizeof(status), "Capture %llu frames  Dropped %llu  Queued %d", frameCapture.framesCaptured,
+		frameCapture.framesDropped, frameCapture.queuedFrames());
+	hud.addStatusLine(status);
+}
+
+static bool LoadSoftwareFacades() {
+	PROFILE_ZONE("Software texture load");
+	for (int i = 0; i < 6; ++i) {
+		AssetView file;
+		int width, height, channels;
+		stbi_uc* rgba = NULL;
+		if (VfsRead(facadeTextureFiles[i], file)) {
+			rgba = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 4);
+		}
+		if (!rgba) {
+			std::cout << "Failed to load " << facadeTextureFiles[i] << " for the software rasterizer." << std::endl;
+			return false;
+		}
+		softwareFacades[i].initialize(rgba, width, height);
+		stbi_image_free(rgba);
+	}
+	return true;
+}
+
+// One draw per visible building: its whole level of detail, or the index
+// ranges that survived meshlet culling
+static void SubmitSoftwareBuildings(const FramePacket& packet) {
+	for (const FrameBatch& batch : packet.batches) {
+		const MeshData& mesh = softwareMeshes[BatchMesh(batch.key)];
+		const MeshLod& lod = buildingMeshes[BatchMesh(batch.key)].lods[BatchLod(batch.key)];
+		for (size_t i = batch.first; i < batch.first + batch.count; ++i) {
+			SoftDraw draw;
+			draw.mesh = &mesh;
+			draw.world = city.world[packet.visible[i]];
+			draw.mvp = packet.viewProjection * draw.world;
+			draw.texture = &softwareFacades[batch.key % 6];
+			if (!BatchMeshlets(batch.key)) {
+				draw.firstIndex = lod.firstIndex;
+				draw.indexCount = lod.indexCount;
+				softwareRasterizer.submit(draw);
+				continue;
+			}
+			const FrameRange& ranges = packet.meshletDraws[i];
+			for (size_t r = ranges.first; r < ranges.first + ranges.count; ++r) {
+				draw.firstIndex = packet.meshletRanges[r].first;
+				draw.indexCount = packet.meshletRanges[r].count;
+				softwareRasterizer.submit(draw);
+			}
+		}
+	}
+}
+
+// Main loop of the software renderer. Returns the frames drawn.
+static unsigned long long RunSoftwareRaster(const glm::mat4& projectionMatrix, float zFar) {
+	SoftShading& shading = softwareRasterizer.shading;
+	shading.lightPosition = lightPosition;
+	shading.lightIntensity = lightIntensity;
+	shading.ambientLight = ambientLight;
+	shading.exposure = postProcess.exposure;
+	shading.clearColor = glm::vec3(0.68f, 0.85f, 0.90f);		// The sky's horizon
+
+	unsigned long long frameCount = 0;
+	double setupMs = 0.0, binMs = 0.0, rasterMs = 0.0, triangles = 0.0;
+	double lastFrameTime = glfwGetTime();
+	double lastInputTime = lastFrameTime;
+	while (!glfwWindowShouldClose(window)) {
+		ProfilerBeginFrame();
+		{
+			PROFILE_ZONE("Poll events");
+			glfwPollEvents();
+		}
+		double inputTime = glfwGetTime();
+		updateCameraFromHeldKeys(window, static_cast<float>(inputTime - lastInputTime));
+		lastInputTime = inputTime;
+		RenderStatsReset();
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		softwareRasterizer.resize(glm::max(width, 1), glm::max(height, 1));
+
+		CameraState camera = CurrentCamera(projectionMatrix, zFar, static_cast<float>(softwareRasterizer.height));
+		camera.gpuCulling = false;
+		const FramePacket& packet = framePipeline.beginFrame(camera);
+		{
+			PROFILE_ZONE("Software raster");
+			SubmitSoftwareBuildings(packet);
+			softwareRasterizer.render();
+		}
+		const SoftRasterStats& stats = softwareRasterizer.stats;
+		setupMs += stats.setupMs;
+		binMs += stats.binMs;
+		rasterMs += stats.rasterMs;
+		triangles += static_cast<double>(stats.trianglesSetUp);
+
+		{
+			PROFILE_ZONE("Present");
+			softwareView.present(softwareRasterizer.color.data(), softwareRasterizer.width, softwareRasterizer.height,
+				width, height);
+		}
+		frameCapture.capture(width, height);
+		{
+			PROFILE_ZONE("HUD");
+			if (hud.visible) {
+				char status[128];
+				snprintf(status, sizeof(status), "Software raster %dx%d  %d tiles  %d threads",
+					softwareRasterizer.width, softwareRasterizer.height, softwareRasterizer.tilesX * softwareRasterizer.tilesY,
+					JobSystemThreadCount());
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Triangles %zu / %zu  Bin entries %zu", stats.trianglesSetUp,
+					stats.trianglesSubmitted, stats.binEntries);
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Setup %.2f ms  Bin %.2f ms  Raster %.2f ms", stats.setupMs, stats.binMs,
+					stats.rasterMs);
+				hud.addStatusLine(status);
+				AddCaptureStatusLine();
+			}
+			hud.render(width, height);
+		}
+		{
+			PROFILE_ZONE("Swap buffers");
+			glfwSwapBuffers(window);
+		}
+
+		ProfilerEndFrame();
+		++frameCount;
+
+		double now = glfwGetTime();
+		hud.addFrameTime(static_cast<float>((now - lastFrameTime) * 1000.0));
+		lastFrameTime = now;
+
+		if (softwareCapturePath && frameCount >= kSoftwareCaptureFrames) {
+			glfwSetWindowShouldClose(window, GL_TRUE);
+		}
+	}
+
+	if (softwareCapturePath) {
+		// Rows are stored bottom first
+		stbi_flip_vertically_on_write(1);
+		if (stbi_write_png(softwareCapturePath, softwareRasterizer.width, softwareRasterizer.height, 4,
+			softwareRasterizer.color.data(), softwareRasterizer.width * 4)) {
+			std::cout << "Wrote " << softwareCapturePath << std::endl;
+		}
+		else {
+			std::cout << "Failed to write " << softwareCapturePath << std::endl;
+		}
+	}
+
+	double frames = frameCount ? static_cast<double>(frameCount) : 1.0;
+	BenchmarkSet("software_raster", "setup_ms", setupMs / frames);
+	BenchmarkSet("software_raster", "bin_ms", binMs / frames);
+	BenchmarkSet("software_raster", "raster_ms", rasterMs / frames);
+	BenchmarkSet("software_raster", "triangles_per_frame", triangles / frames);
+	return frameCount;
+}
+
+int main(int argc, char** argv)
 {
 	// Seed the random number generator with the current time
 	srand(static_cast<unsigned>(time(0)));
 
+	ProfilerSetThreadName("Main");
+
+	// Dump the last 8 frames whenever one takes longer than 50 ms
+	ProfilerSetFrameBudget(50.0f, 8);
+
 	// Initialise GLFW
-	if (!glfwInit())
 	{
-		std::cerr << "Failed to initialize GLFW." << std::endl;
-		return -1;
+		PROFILE_ZONE("GLFW init");
+		if (!glfwInit())
+		{
+			std::cerr << "Failed to initialize GLFW." << std::endl;
+			return -1;
+		}
 	}
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -411,35 +1595,78 @@ int main(void)
 		return -1;
 	}
 
-	// Background
-	glClearColor(0.68f, 0.85f, 0.90f, 1.0f);
-
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-
-	initializeShaders();
+	const char* assetArchive = "lab2_assets.pak";
+	const char* cityPath = NULL;
+	const char* capturePath = NULL;
+	int captureFps = 60;
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--lighting-sweep") == 0) sweepExitWhenDone = true;
+		if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc) assetArchive = argv[++i];
+		if (strcmp(argv[i], "--city") == 0 && i + 1 < argc) cityPath = argv[++i];
+		if (strcmp(argv[i], "--building-mesh") == 0 && i + 1 < argc) buildingMeshFile = argv[++i];
+		if (strcmp(argv[i], "--no-mesh-optimize") == 0) optimizeMeshes = false;
+		if (strcmp(argv[i], "--gpu-culling") == 0) useGpuCulling = true;
+		if (strcmp(argv[i], "--software-raster") == 0) softwareRaster = true;
+		if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) capturePath = argv[++i];
+		if (strcmp(argv[i], "--capture-fps") == 0 && i + 1 < argc) captureFps = atoi(argv[++i]);
+		if (strcmp(argv[i], "--software-capture") == 0 && i + 1 < argc) {
+			softwareRaster = true;
+			softwareCapturePath = argv[++i];
+		}
+		if (strcmp(argv[i], "--texture-budget-mb") == 0 && i + 1 < argc) {
+			textureStreamer.budgetBytes = (size_t)atoi(argv[++i]) << 20;
+		}
+	}
 
-	// Generate buildings in a new pattern without the middle column
-	for (int i = 0; i < 5; ++i) {
-		for (int j = 0; j < 5; ++j) {
-			// Skip the middle column
-			if (j == 2) continue;
+	if (softwareCapturePath) glfwHideWindow(window);
 
-			Building b;
+	// Assets come from the packed archive when there is one, otherwise loose
+	// from the source tree, as when running from the build directory
+	if (!VfsMount(assetArchive)) {
+		std::cout << "No asset archive " << assetArchive << ", reading loose files." << std::endl;
+	}
+	VfsAddSearchPath("../../../lab2");
+	VfsAddSearchPath("lab2");
 
-			// Create a height gradient and random variation
-			float baseHeight = 50.0f + (4 - abs(2 - j)) * 20.0f;
-			float heightVariation = static_cast<float>(rand() % 21) - 10.0f;
-			float randomHeight = baseHeight + heightVariation;
+	GpuProfilerInit();
+	framePacer.initialize();
+	JobSystemInit();
 
-			glm::vec3 scale(16.0f, randomHeight, 16.0f);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
 
-			// Adjust position for a more scattered layout
-			glm::vec3 position(i * 60.0f - 120.0f, scale.y / 2.0f - 50.0f, j * 60.0f - 120.0f);
+	initializeShaders();
+	hud.initialize();
+	sceneTarget.initialize();
+	overdrawCounter.initialize();
+	clusteredLighting.initialize();
+	if (!postProcess.initialize()) {
+		exit(EXIT_FAILURE);
+	}
+	if (!gbuffer.initialize("fullscreen.vert", "deferred.frag")) {
+		exit(EXIT_FAILURE);
+	}
+	if (!skybox.initialize("sky.vert", "sky.frag")) {
+		exit(EXIT_FAILURE);
+	}
+	skybox.loadAsync(skyFaceFiles);
+	if (!terrain.initialize("terrain.vert", "terrain.frag")) {
+		exit(EXIT_FAILURE);
+	}
+	LoadFacadeTextures();
+	facadePages.load(facadeTextureFiles, 6);
+	if (!virtualTexture.initialize(kVirtualTexturePagesPerSide, "box.vert",
+		"virtual_feedback.frag", [](int mip, int pageX, int pageY, uint8_t* rgba) {
+			facadePages.generate(mip, pageX, pageY, rgba);
+		})) {
+		exit(EXIT_FAILURE);
+	}
 
-			b.initialize(position, scale);
-			buildings.push_back(b);
-		}
+	if (softwareRaster && (!LoadSoftwareFacades() || !softwareView.initialize())) {
+		exit(EXIT_FAILURE);
+	}
+	if (!LoadCity(cityPath)) {
+		exit(EXIT_FAILURE);
 	}
 
 	// Camera setup
@@ -447,36 +1674,414 @@ int main(void)
 	eye_center.x = viewDistance * cos(viewAzimuth);
 	eye_center.z = viewDistance * sin(viewAzimuth);
 
-	glm::mat4 viewMatrix, projectionMatrix;
+	glm::mat4 projectionMatrix;
 	glm::float32 FoV = 45;
 	glm::float32 zNear = 0.1f;
 	glm::float32 zFar = 1000.0f;
 	projectionMatrix = glm::perspective(glm::radians(FoV), 4.0f / 3.0f, zNear, zFar);
 
-	do
+	cameraDirection = glm::normalize(lookat - eye_center);
+	cameraRight = glm::normalize(glm::cross(cameraDirection, up));
+
+	GenerateCityLights(lightCountSteps[3]);
+	buildingInstances.initialize(buildingMeshes);
+	if (!gpuBuildings.initialize(buildingMeshes)) {
+		useGpuCulling = false;
+	}
+	virtualTexture.pinSlots(static_cast<int>(facadePages.slots.size()));
+	framePipeline.start(BuildFramePacket, true);
+	if (capturePath && !frameCapture.start(capturePath, captureFps)) {
+		exit(EXIT_FAILURE);
+	}
+	if (sweepExitWhenDone) {
+		StartLightingSweep();
+	}
+
+	unsigned long long frameCount = 0;
+	uint64_t loopStart = ProfilerNow();
+	double lastFrameTime = glfwGetTime();
+	double lastInputTime = lastFrameTime;
+	double scaleSum = 0.0;
+	unsigned long long prepassFrames = 0;
+	unsigned long long meshletsTestedSum = 0, meshletsCulledSum = 0;
+	unsigned long long gpuCulledFrames = 0, gpuVisibleSum = 0;
+
+	if (softwareRaster) {
+		frameCount = RunSoftwareRaster(projectionMatrix, zFar);
+	}
+
+	while (!softwareRaster && !glfwWindowShouldClose(window))
 	{
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		ProfilerBeginFrame();
+
+		// Limiter and frames-in-flight waits happen before input is sampled, so
+		// the held keys are read as close to submission as possible
+		framePacer.beginFrame();
+		{
+			PROFILE_ZONE("Poll events");
+			glfwPollEvents();
+		}
+		double inputTime = glfwGetTime();
+		updateCameraFromHeldKeys(window, static_cast<float>(inputTime - lastInputTime));
+		lastInputTime = inputTime;
+		uint64_t inputSampled = ProfilerNow();
+
+		GpuProfilerBeginFrame();
+		bool overdrawCollected = overdrawCounter.beginFrame();
+		RenderStatsReset();
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		ApplyLightingSweepConfig();
+		sceneTarget.begin(width, height, governor.scale);
+		scaleSum += governor.scale;
+
+		// Depth only: every pixel is covered by a building or by the sky
+		{
+			PROFILE_ZONE("Clear");
+			glClear(GL_DEPTH_BUFFER_BIT);
+		}
+
+		// Hand the current camera to the scene stage and take the packet it built last frame
+		CameraState camera = CurrentCamera(projectionMatrix, zFar, static_cast<float>(sceneTarget.renderHeight));
+		camera.inputTime = inputSampled;
+		const FramePacket& packet = framePipeline.beginFrame(camera);
+		// What is drawn is what the packet's input saw, a frame older when pipelined
+		framePacer.markInputSampled(packet.inputTime);
+		textureStreamer.update(packet.textureRequests);
+		virtualTexture.update();
+
+		{
+			PROFILE_ZONE("Light upload");
+			clusteredLighting.upload(packet.lights);
+		}
+
+		// Packs the buildings visible to this frame's camera, before anything
+		// reads them. The pyramid is the last frame's, or absent after a toggle.
+		if (packet.gpuCulled) {
+			PROFILE_ZONE("GPU culling");
+			GPU_ZONE("GPU culling");
+			gpuBuildings.cull(packet, camera.drawDistance);
+		}
+		else {
+			gpuBuildings.hiZ.invalidate();
+		}
+
+		// Forward shades while drawing; deferred only writes the G-buffer here
+		GLuint opaqueProgramID = packet.gpuCulled ? gpuCulledProgramID : globalProgramID;
+		if (deferredShading) {
+			opaqueProgramID = packet.gpuCulled ? gpuCulledGbufferProgramID : gbufferProgramID;
+			gbuffer.begin(sceneTarget);
+		}
+		else {
+			clusteredLighting.bind(opaqueProgramID, packet.lights, packet.viewMatrix, packet.projectionMatrix,
+				sceneTarget.renderWidth, sceneTarget.renderHeight);
+			Building::setSharedUniforms(opaqueProgramID);
+		}
+		virtualTexture.bind(opaqueProgramID, useVirtualTexture);
+
+		// Render the visible buildings, batched or one draw each. With the
+		// pre-pass, depth is laid down first and only the front fragment of
+		// each pixel passes the GL_EQUAL test of the shading pass.
+		{
+			PROFILE_ZONE("Buildings");
+			GPU_ZONE("Opaque");
+			static std::vector<glm::mat4> mvps;
+			if (useInstancing) {
+				buildingInstances.upload(packet);
+			}
+			else {
+				mvps.resize(packet.visible.size());
+				TransformBatchMVP(packet.viewProjection, city.world, packet.visible.data(),
+					packet.visible.size(), &mvps.data()[0][0][0]);
+			}
+
+			if (depthPrepass.active) {
+				PROFILE_ZONE("Depth pre-pass");
+				GPU_ZONE("Depth pre-pass");
+				overdrawCounter.beginDepth();
+				glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+				if (packet.gpuCulled) {
+					gpuBuildings.renderDepth(gpuCulledDepthProgramID, packet.viewProjection);
+				}
+				else if (useInstancing) {
+					buildingInstances.renderDepth(packet, depthProgramID);
+				}
+				else {
+					for (const FrameBatch& batch : packet.batches) {
+						Building& mesh = buildingMeshes[BatchMesh(batch.key)];
+						for (size_t i = batch.first; i < batch.first + batch.count; ++i) {
+							mesh.drawDepth(mvps[i], depthProgramID, BatchLod(batch.key));
+						}
+					}
+				}
+				glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+				overdrawCounter.endDepth();
+				glDepthFunc(GL_EQUAL);
+				glDepthMask(GL_FALSE);
+			}
+
+			overdrawCounter.beginShading();
+			if (packet.gpuCulled) {
+				gpuBuildings.render(opaqueProgramID, packet.viewProjection);
+			}
+			else if (useInstancing) {
+				buildingInstances.render(packet, opaqueProgramID);
+			}
+			else {
+				for (const FrameBatch& batch : packet.batches) {
+					Building& mesh = buildingMeshes[BatchMesh(batch.key)];
+					for (size_t i = batch.first; i < batch.first + batch.count; ++i) {
+						mesh.draw(mvps[i], opaqueProgramID, facadeTextures[batch.key % 6], city.slots[packet.visible[i]],
+							BatchLod(batch.key));
+					}
+				}
+			}
+			overdrawCounter.endShading();
+
+			if (depthPrepass.active) {
+				glDepthFunc(GL_LESS);
+				glDepthMask(GL_TRUE);
+			}
+			gRenderStats.visibleObjects = static_cast<unsigned int>(packet.visible.size());
+			gRenderStats.culledObjects = packet.culled;
+			if (packet.gpuCulled) {
+				// As of the latest count read back
+				gRenderStats.visibleObjects = gpuBuildings.culler.visibleCount();
+				gRenderStats.culledObjects = static_cast<unsigned int>(city.buildingCount) - gRenderStats.visibleObjects;
+			}
+			gRenderStats.meshletsTested = packet.meshletsTested;
+			gRenderStats.meshletsCulled = packet.meshletsCulled;
+		}
+
+		// Ground, after the buildings so it is mostly rejected by depth. Levels
+		// follow the camera the packet was built for.
+		{
+			PROFILE_ZONE("Terrain");
+			GPU_ZONE("Terrain");
+			terrain.update(glm::vec3(glm::inverse(packet.viewMatrix)[3]));
+			if (!deferredShading) {
+				clusteredLighting.bind(terrain.forward.programID, packet.lights, packet.viewMatrix,
+					packet.projectionMatrix, sceneTarget.renderWidth, sceneTarget.renderHeight);
+				terrain.setLighting(lightPosition, lightIntensity, ambientLight);
+			}
+			terrain.render(deferredShading, packet.viewProjection);
+		}
+
+		if (deferredShading) {
+			PROFILE_ZONE("Deferred lighting");
+			GPU_ZONE("Deferred lighting");
+			clusteredLighting.bind(gbuffer.lightingProgramID, packet.lights, packet.viewMatrix, packet.projectionMatrix,
+				sceneTarget.renderWidth, sceneTarget.renderHeight);
+			gbuffer.light(sceneTarget, packet.viewMatrix, lightPosition, lightIntensity, ambientLight);
+		}
+
+		// After the opaque pass, so only pixels no building covered are shaded
+		{
+			PROFILE_ZONE("Sky");
+			GPU_ZONE("Sky");
+			skybox.poll();
+			skybox.render(packet.viewMatrix, packet.projectionMatrix, postProcess.exposure);
+		}
+
+		// Farthest depth of this frame for the next one's GPU culling
+		if (packet.gpuCulled) {
+			PROFILE_ZONE("Hi-Z");
+			GPU_ZONE("Hi-Z");
+			gpuBuildings.hiZ.build(sceneTarget, packet.viewProjection);
+		}
+
+		// Page requests for the virtual texture, read back a few frames later.
+		// Always instanced, as the feedback shader takes the slot per instance,
+		// and paused while the buildings are culled on the GPU.
+		if (useVirtualTexture && !packet.gpuCulled) {
+			PROFILE_ZONE("Virtual texture feedback");
+			GPU_ZONE("VT feedback");
+			virtualTexture.beginFeedback(width, height, sceneTarget.scale());
+			if (!useInstancing) {
+				buildingInstances.upload(packet);
+			}
+			buildingInstances.render(packet, virtualTexture.feedbackProgramID);
+			virtualTexture.endFeedback();
+		}
+
+		{
+			PROFILE_ZONE("Post");
+			GPU_ZONE("Post");
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			postProcess.render(sceneTarget, width, height);
+		}
+
+		// Before the HUD, so recordings show the scene alone
+		frameCapture.capture(width, height);
+
+		{
+			PROFILE_ZONE("HUD");
+			GPU_ZONE("HUD");
+			if (hud.visible) {
+				char status[128];
+				snprintf(status, sizeof(status), "Swap %s  Limit %s  %s", framePacer.swapModeName(),
+					framePacer.targetFps > 0.0f ? std::to_string((int)framePacer.targetFps).c_str() : "off",
+					lowLatencyMode ? "Low latency" : "Pipelined");
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Input to photon ~%.1f ms", framePacer.averageLatencyMs);
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Scale %d%% %dx%d  Quality %d  %s", (int)(governor.scale * 100.0f + 0.5f),
+					sceneTarget.renderWidth, sceneTarget.renderHeight, governor.qualityLevel,
+					governor.enabled ? "Governed" : "Fixed");
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Lights %u  In view %u  Cluster entries %u", lightCountSteps[lightCountIndex],
+					(unsigned int)packet.lights.viewLights.size(), (unsigned int)packet.lights.indices.size());
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "%s shading%s", deferredShading ? "Deferred" : "Forward",
+					sweepConfig >= 0 ? "  Sweep running" : "");
+				hud.addStatusLine(status);
+				if (packet.gpuCulled) {
+					snprintf(status, sizeof(status), "GPU culling  Hi-Z %s %dx%d, %d levels",
+						gpuBuildings.hiZ.valid ? "on" : "off", gpuBuildings.hiZ.width, gpuBuildings.hiZ.height,
+						gpuBuildings.hiZ.levels);
+				}
+				else {
+					snprintf(status, sizeof(status), "CPU culling%s", gpuBuildings.ready ? "" : "  GPU culling unavailable");
+				}
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Terrain %u vertices  %llu texels uploaded", terrain.verticesPerFrame,
+					terrain.texelsUploadedLastFrame);
+				hud.addStatusLine(status);
+				float pixels = (float)sceneTarget.renderWidth * sceneTarget.renderHeight;
+				snprintf(status, sizeof(status), "Pre-pass %s %s  Overdraw %.2f  Shaded/px %.2f", depthPrepass.modeName(),
+					depthPrepass.active ? "on" : "off", depthPrepass.overdraw,
+					pixels > 0.0f ? (float)overdrawCounter.shadedSamples / pixels : 0.0f);
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Virtual texture %s  Pages %d / %d  Requested %u  Loading %d",
+					useVirtualTexture ? "on" : "off", virtualTexture.table.residentCount(), virtualTexture.physicalPageCount(),
+					virtualTexture.table.pagesRequested, (int)virtualTexture.loads.size());
+				hud.addStatusLine(status);
+				snprintf(status, sizeof(status), "Textures %.1f / %.0f MB  Loads %llu  Evicted %llu",
+					textureStreamer.residentBytes / 1048576.0, textureStreamer.budgetBytes / 1048576.0,
+					textureStreamer.loadsCompleted, textureStreamer.mipsEvicted);
+				hud.addStatusLine(status);
+				AddCaptureStatusLine();
+			}
+			hud.render(width, height);
+		}
+
+		GpuProfilerEndFrame();
+		overdrawCounter.endFrame();
+
+		prepassFrames += depthPrepass.active ? 1 : 0;
+		meshletsTestedSum += gRenderStats.meshletsTested;
+		meshletsCulledSum += gRenderStats.meshletsCulled;
+		if (packet.gpuCulled) {
+			++gpuCulledFrames;
+			gpuVisibleSum += gRenderStats.visibleObjects;
+		}
+		depthPrepass.update(static_cast<float>(GpuProfilerPassMs("Opaque")),
+			overdrawCollected ? overdrawCounter.overdraw : 0.0f);
 
-		// Recalculate the camera view matrix
-		viewMatrix = glm::lookAt(eye_center, lookat, up);
-		glm::mat4 vp = projectionMatrix * viewMatrix;
+		if (AdvanceLightingSweep(GpuProfilerFrameMs()) && sweepExitWhenDone) {
+			glfwSetWindowShouldClose(window, GL_TRUE);
+		}
 
-		// Render each building in the vector
-		for (auto& building : buildings) {
-			building.render(vp); // Pass the updated VP matrix
+		// Results are a few frames old, which the governor allows for
+		if (governor.update(static_cast<float>(GpuProfilerFrameMs())) &&
+			governor.qualityLevel != appliedQualityLevel) {
+			SetFacadeTextureLodBias(governor.textureLodBias());
+			appliedQualityLevel = governor.qualityLevel;
 		}
 
 		// Swap buffers
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		{
+			PROFILE_ZONE("Swap buffers");
+			glfwSwapBuffers(window);
+		}
+		framePacer.endFrame();
+
+		ProfilerEndFrame();
+		++frameCount;
 
-	} while (!glfwWindowShouldClose(window));
+		double now = glfwGetTime();
+		hud.addFrameTime(static_cast<float>((now - lastFrameTime) * 1000.0));
+		lastFrameTime = now;
+	}
 
-	for (auto& building : buildings) {
-		building.cleanup();
+	framePipeline.stop();
+	frameCapture.finish();
+
+	double loopSeconds = (ProfilerNow() - loopStart) * 1e-9;
+	BenchmarkSet("frame", "count", static_cast<double>(frameCount));
+	BenchmarkSet("frame", "average_ms", frameCount ? loopSeconds * 1000.0 / frameCount : 0.0);
+	GpuProfilerReport();
+	BenchmarkSet("latency", "input_to_photon_ms", framePacer.averageLatencyMs);
+	BenchmarkSet("resolution", "average_scale", frameCount ? scaleSum / frameCount : 1.0);
+	BenchmarkSet("resolution", "final_quality_level", static_cast<double>(governor.qualityLevel));
+	BenchmarkSet("lighting", "point_lights", static_cast<double>(lightCountSteps[lightCountIndex]));
+	BenchmarkSet("terrain", "vertices_per_frame", static_cast<double>(terrain.verticesPerFrame));
+	BenchmarkSet("terrain", "average_texels_uploaded_per_frame",
+		frameCount ? terrain.texelsUploadedTotal / (double)frameCount : 0.0);
+	BenchmarkSet("depth_prepass", "active_fraction", frameCount ? prepassFrames / (double)frameCount : 0.0);
+	BenchmarkSet("depth_prepass", "overdraw", depthPrepass.overdraw);
+	BenchmarkSet("depth_prepass", "fragments_saved_fraction",
+		depthPrepass.overdraw > 0.0f ? 1.0 - 1.0 / depthPrepass.overdraw : 0.0);
+	BenchmarkSet("depth_prepass", "cost_without_ms", depthPrepass.costMs[0]);
+	BenchmarkSet("depth_prepass", "cost_with_ms", depthPrepass.costMs[1]);
+	BenchmarkSet("virtual_texture", "unique_slots", static_cast<double>(facadePages.slots.size()));
+	BenchmarkSet("virtual_texture", "physical_mb", virtualTexture.physicalBytes() / 1048576.0);
+	BenchmarkSet("virtual_texture", "pages_loaded", static_cast<double>(virtualTexture.pagesLoaded));
+	BenchmarkSet("virtual_texture", "pages_evicted", static_cast<double>(virtualTexture.table.pagesEvicted));
+	BenchmarkSet("textures", "budget_mb", textureStreamer.budgetBytes / 1048576.0);
+	BenchmarkSet("textures", "peak_resident_mb", textureStreamer.peakResidentBytes / 1048576.0);
+	BenchmarkSet("textures", "loads", static_cast<double>(textureStreamer.loadsCompleted));
+	BenchmarkSet("textures", "mips_evicted", static_cast<double>(textureStreamer.mipsEvicted));
+	unsigned long long archiveReads, looseReads;
+	VfsStats(archiveReads, looseReads);
+	BenchmarkSet("city", "buildings", static_cast<double>(city.buildingCount));
+	BenchmarkSet("city", "chunks", static_cast<double>(city.chunkCount));
+	BenchmarkSet("city", "load_ms", cityLoadMs);
+	BenchmarkSet("meshes", "bytes", static_cast<double>(meshLoadTotals.bytes));
+	BenchmarkSet("meshes", "load_ms", meshLoadTotals.milliseconds);
+	BenchmarkSet("meshes", "mb_per_s", meshLoadTotals.megabytesPerSecond());
+	BenchmarkSet("meshes", "optimize_ms", meshOptimizeTotals.milliseconds);
+	BenchmarkSet("meshes", "acmr_before", meshOptimizeTotals.before.acmr());
+	BenchmarkSet("meshes", "acmr_after", meshOptimizeTotals.after.acmr());
+	BenchmarkSet("meshes", "atvr_before", meshOptimizeTotals.before.atvr());
+	BenchmarkSet("meshes", "atvr_after", meshOptimizeTotals.after.atvr());
+	BenchmarkSet("meshlets", "tested_per_frame", frameCount ? meshletsTestedSum / (double)frameCount : 0.0);
+	BenchmarkSet("meshlets", "culled_fraction", meshletsTestedSum ? meshletsCulledSum / (double)meshletsTestedSum : 0.0);
+	BenchmarkSet("gpu_culling", "active_fraction", frameCount ? gpuCulledFrames / (double)frameCount : 0.0);
+	BenchmarkSet("gpu_culling", "visible_per_frame", gpuCulledFrames ? gpuVisibleSum / (double)gpuCulledFrames : 0.0);
+	if (capturePath) {
+		BenchmarkSet("capture", "frames", static_cast<double>(frameCapture.framesCaptured));
+		BenchmarkSet("capture", "dropped", static_cast<double>(frameCapture.framesDropped));
+		BenchmarkSet("capture", "main_thread_ms_per_frame", frameCount ? frameCapture.captureMs / frameCount : 0.0);
+	}
+	BenchmarkSet("assets", "archive_reads", static_cast<double>(archiveReads));
+	BenchmarkSet("assets", "loose_reads", static_cast<double>(looseReads));
+	BenchmarkWriteJson("benchmark.json");
+
+	buildingInstances.cleanup();
+	gpuBuildings.cleanup();
+	for (auto& mesh : buildingMeshes) {
+		mesh.cleanup();
 	}
+	city.close();
+	hud.cleanup();
+	sceneTarget.cleanup();
+	overdrawCounter.cleanup();
+	skybox.cleanup();
+	terrain.cleanup();
+	clusteredLighting.cleanup();
+	gbuffer.cleanup();
+	postProcess.cleanup();
+	if (softwareRaster) softwareView.cleanup();
+	CleanupFacadeTextures();
+	virtualTexture.cleanup();
 	cleanupShaders();
+	GpuProfilerCleanup();
+	framePacer.cleanup();
 	glfwTerminate();
+	JobSystemShutdown();
+	VfsShutdown();
 
 	return 0;
 }
@@ -484,39 +2089,163 @@ int main(void)
 // Is called whenever a key is pressed/released via GLFW
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode)
 {
-	static glm::vec3 cameraDirection = glm::normalize(lookat - eye_center);
-	static glm::vec3 right = glm::normalize(glm::cross(cameraDirection, up));
-
+	// Camera motion from held keys is applied once per frame in
+	// updateCameraFromHeldKeys, not here at the OS key-repeat rate
 	if (key == GLFW_KEY_R && action == GLFW_PRESS)
 	{
 		// Reset the camera view
 		viewAzimuth = 0.f;
 		eye_center = glm::vec3(0, 100, viewDistance);
 		cameraDirection = glm::normalize(lookat - eye_center);
-		right = glm::normalize(glm::cross(cameraDirection, up));
+		cameraRight = glm::normalize(glm::cross(cameraDirection, up));
 		lookat = eye_center + cameraDirection;
 	}
 
-	if ((key == GLFW_KEY_UP))
+	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
+	{
+		glfwSetWindowShouldClose(window, GL_TRUE);
+	}
+
+	if (key == GLFW_KEY_P && action == GLFW_PRESS)
+	{
+		// Write everything the profiler has buffered so far
+		if (ProfilerDumpTrace("trace.json")) {
+			std::cout << "Profiler trace written to trace.json" << std::endl;
+		}
+	}
+
+	if (key == GLFW_KEY_H && action == GLFW_PRESS)
+	{
+		hud.visible = !hud.visible;
+	}
+
+	if (key == GLFW_KEY_I && action == GLFW_PRESS)
+	{
+		useInstancing = !useInstancing;
+		std::cout << "Instanced buildings " << (useInstancing ? "on" : "off") << std::endl;
+	}
+
+	if (key == GLFW_KEY_O && action == GLFW_PRESS)
+	{
+		// Toggle zone recording
+		gProfilerEnabled = !gProfilerEnabled;
+		std::cout << "Profiler " << (gProfilerEnabled ? "enabled" : "disabled") << std::endl;
+	}
+
+	if (key == GLFW_KEY_V && action == GLFW_PRESS)
+	{
+		// Cycle vsync, adaptive vsync and uncapped
+		framePacer.setSwapMode(static_cast<SwapMode>((framePacer.swapMode + 1) % SWAP_MODE_COUNT));
+		std::cout << "Swap mode " << framePacer.swapModeName() << std::endl;
+	}
+
+	if (key == GLFW_KEY_F && action == GLFW_PRESS)
+	{
+		// Cycle the frame limiter target
+		limiterTargetIndex = (limiterTargetIndex + 1) % 4;
+		framePacer.targetFps = limiterTargets[limiterTargetIndex];
+		std::cout << "Frame limiter " << framePacer.targetFps << " fps" << std::endl;
+	}
+
+	if (key == GLFW_KEY_G && action == GLFW_PRESS)
+	{
+		// Toggle the resolution governor, back to full scale and quality when off
+		governor.enabled = !governor.enabled;
+		if (!governor.enabled) {
+			governor.reset();
+			SetFacadeTextureLodBias(0.0f);
+			appliedQualityLevel = 0;
+		}
+		std::cout << "Resolution governor " << (governor.enabled ? "on" : "off") << std::endl;
+	}
+
+	if (key == GLFW_KEY_K && action == GLFW_PRESS)
+	{
+		// Meshlet culling of close-up buildings against drawing them whole
+		useMeshletCulling = !useMeshletCulling;
+		std::cout << "Meshlet culling " << (useMeshletCulling ? "on" : "off") << std::endl;
+	}
+
+	if (key == GLFW_KEY_C && action == GLFW_PRESS && gpuBuildings.ready)
+	{
+		// Cull the buildings on the GPU against the scene stage on the CPU
+		useGpuCulling = !useGpuCulling;
+		std::cout << "GPU culling " << (useGpuCulling ? "on" : "off") << std::endl;
+	}
+
+	if (key == GLFW_KEY_M && action == GLFW_PRESS)
+	{
+		// Switch between forward and deferred shading
+		deferredShading = !deferredShading;
+		std::cout << (deferredShading ? "Deferred" : "Forward") << " shading" << std::endl;
+	}
+
+	if (key == GLFW_KEY_Z && action == GLFW_PRESS)
+	{
+		// Cycle the depth pre-pass between automatic, off and on
+		depthPrepass.setMode(static_cast<DepthPrepassMode>((depthPrepass.mode + 1) % DEPTH_PREPASS_MODE_COUNT));
+		std::cout << "Depth pre-pass " << depthPrepass.modeName() << std::endl;
+	}
+
+	if (key == GLFW_KEY_B && action == GLFW_PRESS)
+	{
+		// Benchmark forward against deferred, results go to benchmark.json on exit
+		StartLightingSweep();
+	}
+
+	if (key == GLFW_KEY_T && action == GLFW_PRESS)
+	{
+		// Unique virtual-textured facades against the shared facade textures
+		useVirtualTexture = !useVirtualTexture;
+		std::cout << "Virtual texture " << (useVirtualTexture ? "on" : "off") << std::endl;
+	}
+
+	if (key == GLFW_KEY_N && action == GLFW_PRESS)
+	{
+		// Cycle the number of street and window lights
+		lightCountIndex = (lightCountIndex + 1) % 4;
+		std::cout << "Point lights " << lightCountSteps[lightCountIndex] << std::endl;
+	}
+
+	if (key == GLFW_KEY_L && action == GLFW_PRESS)
+	{
+		// Low latency: build each frame packet inline and keep one frame in flight
+		lowLatencyMode = !lowLatencyMode;
+		framePipeline.setPipelined(!lowLatencyMode);
+		framePacer.maxFramesInFlight = lowLatencyMode ? 1 : 2;
+		std::cout << "Low latency mode " << (lowLatencyMode ? "on" : "off") << std::endl;
+	}
+}
+
+// Applies camera motion for every held key, sampled just before the view
+// matrix is built. Rates match the old per-repeat steps at about 30 repeats
+// per second, but are now independent of the OS key-repeat rate.
+static void updateCameraFromHeldKeys(GLFWwindow* window, float deltaSeconds)
+{
+	PROFILE_ZONE("Camera input");
+	// Clamp so a long stall does not teleport the camera
+	if (deltaSeconds > 0.1f) deltaSeconds = 0.1f;
+
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
 	{
 		// Move forward along the current direction
 		glm::vec3 forward = glm::normalize(cameraDirection);
-		eye_center += forward * 10.0f;
+		eye_center += forward * 300.0f * deltaSeconds;
 		lookat = eye_center + cameraDirection;
 	}
 
-	if ((key == GLFW_KEY_DOWN) && (action == GLFW_PRESS || action == GLFW_REPEAT))
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
 	{
 		// Move backward along the current direction
 		glm::vec3 backward = glm::normalize(cameraDirection);
-		eye_center -= backward * 10.0f;
+		eye_center -= backward * 300.0f * deltaSeconds;
 		lookat = eye_center + cameraDirection;
 	}
 
-	if (key == GLFW_KEY_LEFT && (action == GLFW_PRESS || action == GLFW_REPEAT))
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
 	{
 		// Rotate the view to the left
-		viewAzimuth -= 0.05f;
+		viewAzimuth -= 1.5f * deltaSeconds;
 
 		// Update camera direction based on the new azimuth angle
 		cameraDirection.x = cos(viewAzimuth);
@@ -526,10 +2255,10 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		lookat = eye_center + glm::normalize(cameraDirection);
 	}
 
-	if (key == GLFW_KEY_RIGHT && (action == GLFW_PRESS || action == GLFW_REPEAT))
+	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
 	{
 		// Rotate the view to the right
-		viewAzimuth += 0.05f;
+		viewAzimuth += 1.5f * deltaSeconds;
 
 		// Update camera direction based on the new azimuth angle
 		cameraDirection.x = cos(viewAzimuth);
@@ -539,33 +2268,28 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
 		lookat = eye_center + glm::normalize(cameraDirection);
 	}
 
-	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
-	{
-		glfwSetWindowShouldClose(window, GL_TRUE);
-	}
-
-	if (key == GLFW_KEY_W && (action == GLFW_REPEAT || action == GLFW_PRESS))
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
 	{
-		viewPolar -= 0.1f;
+		viewPolar -= 3.0f * deltaSeconds;
 		eye_center.y = viewDistance * cos(viewPolar);
 	}
 
-	if (key == GLFW_KEY_S && (action == GLFW_REPEAT || action == GLFW_PRESS))
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
 	{
-		viewPolar += 0.1f;
+		viewPolar += 3.0f * deltaSeconds;
 		eye_center.y = viewDistance * cos(viewPolar);
 	}
 
-	if (key == GLFW_KEY_A && (action == GLFW_REPEAT || action == GLFW_PRESS))
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
 	{
-		viewAzimuth -= 0.1f;
+		viewAzimuth -= 3.0f * deltaSeconds;
 		eye_center.x = viewDistance * cos(viewAzimuth);
 		eye_center.z = viewDistance * sin(viewAzimuth);
 	}
 
-	if (key == GLFW_KEY_D && (action == GLFW_REPEAT || action == GLFW_PRESS))
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 	{
-		viewAzimuth += 0.1f;
+		viewAzimuth += 3.0f * deltaSeconds;
 		eye_center.x = viewDistance * cos(viewAzimuth);
 		eye_center.z = viewDistance * sin(viewAzimuth);
 	}
@@ -0,0 +1,115 @@
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <render/skybox.h>
+#include <render/render_state.h>
+#include <core/profiler.h>
+#include <core/vfs.h>
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include <iostream>
+#include <math.h>
+
+// Standalone viewer for the sky: arrow keys look around, Escape quits
+
+static GLFWwindow* window;
+
+static const char* skyFaceFiles[6] = {
+	"sky_px.jpg",
+	"sky_nx.jpg",
+	"sky_py.jpg",
+	"sky_ny.jpg",
+	"sky_pz.jpg",
+	"sky_nz.jpg"
+};
+
+static Skybox skybox;
+static float viewAzimuth = 0.0f;
+static float viewPolar = 0.0f;
+
+static void updateViewFromHeldKeys(float deltaSeconds)
+{
+	const float turnRate = 1.5f;	// Radians per second
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) viewAzimuth -= turnRate * deltaSeconds;
+	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) viewAzimuth += turnRate * deltaSeconds;
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) viewPolar += turnRate * deltaSeconds;
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) viewPolar -= turnRate * deltaSeconds;
+	if (viewPolar > 1.5f) viewPolar = 1.5f;
+	if (viewPolar < -1.5f) viewPolar = -1.5f;
+}
+
+int main(void)
+{
+	if (!glfwInit())
+	{
+		std::cerr << "Failed to initialize GLFW." << std::endl;
+		return -1;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // For MacOS
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+	window = glfwCreateWindow(1024, 768, "Skybox", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cerr << "Failed to open a GLFW window." << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
+
+	int version = gladLoadGL(glfwGetProcAddress);
+	if (version == 0)
+	{
+		std::cerr << "Failed to initialize OpenGL context." << std::endl;
+		return -1;
+	}
+
+	glEnable(GL_DEPTH_TEST);
+	glfwSwapInterval(1);
+
+	VfsMount("lab2_assets.pak");
+	VfsAddSearchPath("../../../lab2");
+	VfsAddSearchPath("lab2");
+
+	if (!skybox.initialize("sky.vert", "sky.frag")) {
+		glfwTerminate();
+		return -1;
+	}
+	skybox.loadAsync(skyFaceFiles);
+
+	double lastTime = glfwGetTime();
+	do
+	{
+		glfwPollEvents();
+		double now = glfwGetTime();
+		updateViewFromHeldKeys(static_cast<float>(now - lastTime));
+		lastTime = now;
+
+		skybox.poll();
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		glViewport(0, 0, width, height);
+		glClear(GL_DEPTH_BUFFER_BIT);
+
+		glm::vec3 forward(cos(viewPolar) * sin(viewAzimuth), sin(viewPolar), -cos(viewPolar) * cos(viewAzimuth));
+		glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f), forward, glm::vec3(0, 1, 0));
+		glm::mat4 projectionMatrix = glm::perspective(glm::radians(60.0f), width / (float)(height > 0 ? height : 1),
+			0.1f, 10.0f);
+		skybox.render(viewMatrix, projectionMatrix, 0.0f);
+
+		glfwSwapBuffers(window);
+	} while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && !glfwWindowShouldClose(window));
+
+	skybox.cleanup();
+	glfwTerminate();
+	VfsShutdown();
+	return 0;
+}
@@ -0,0 +1,99 @@
+// Lighting shared by the forward pass (box.frag) and the deferred lighting
+// pass (deferred.frag), pulled in with #include by the shader loader.
+// Surfaces are lit in view space, with the position rebuilt from depth.
+
+uniform vec3 lightPosition;     // World space
+uniform vec3 lightIntensity;
+uniform vec3 ambientLight;
+
+uniform sampler2D shadowMap; // for shadow mapping
+
+// Clustered point lights, see ClusteredLighting
+uniform samplerBuffer clusterLights;        // View position and radius, then intensity, per light
+uniform usamplerBuffer clusterRanges;       // First index and light count per cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform ivec3 clusterGrid;
+uniform vec2 clusterDepthScaleBias;
+uniform vec2 viewportSize;
+uniform mat4 inverseProjection;
+uniform mat4 viewMatrix;
+
+float CalcShadowFactor(vec4 lightSpacePosition) {
+    vec3 Coords = lightSpacePosition.xyz / lightSpacePosition.w;
+
+    // Transform to [0, 1] range for all coordinates
+    Coords = Coords * 0.5 + 0.5;
+
+    // Early exit for fragments outside the light frustum
+    if (Coords.z > 1.0) return 1.0;
+
+    // Retrieve depth from shadow map
+    float Depth = texture(shadowMap, Coords.xy).r;
+    float bias = 0.0025;
+
+    // Compare depths with bias
+    return (Coords.z >= Depth + bias) ? 0.5 : 1.0;
+}
+
+// Octahedral normal packing for the G-buffer, two channels per normal
+vec2 SignNotZero(vec2 v) {
+    return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 EncodeOctahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * SignNotZero(n.xy);
+}
+
+vec3 DecodeOctahedral(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * SignNotZero(n.xy);
+    return normalize(n);
+}
+
+// View-space position from a position in the viewport (0 to 1) and window depth
+vec3 ViewPositionFromDepth(vec2 screen, float depth) {
+    vec4 view = inverseProjection * vec4(vec3(screen, depth) * 2.0 - 1.0, 1.0);
+    return view.xyz / view.w;
+}
+
+vec3 CalcClusteredLights(vec3 N, vec3 P, vec2 screen) {
+    // Only the lights listed for this fragment's cluster can reach it
+    float slice = log(-P.z) * clusterDepthScaleBias.x + clusterDepthScaleBias.y;
+    ivec3 cell = ivec3(clamp(screen, 0.0, 0.9999) * vec2(clusterGrid.xy), clamp(slice, 0.0, float(clusterGrid.z - 1)));
+    int cluster = (cell.z * clusterGrid.y + cell.y) * clusterGrid.x + cell.x;
+    uvec2 range = texelFetch(clusterRanges, cluster).xy;
+
+    vec3 irradiance = vec3(0);
+    for (uint i = 0u; i < range.y; ++i) {
+        int light = int(texelFetch(clusterLightIndices, int(range.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, light * 2);
+        vec3 intensity = texelFetch(clusterLights, light * 2 + 1).rgb;
+        vec3 toLight = positionRadius.xyz - P;
+        float distanceSquared = max(dot(toLight, toLight), 1.0);
+        // Inverse square falloff, windowed to reach zero at the light's radius
+        float window = clamp(1.0 - distanceSquared / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+        float cosine = max(dot(N, toLight * inversesqrt(distanceSquared)), 0.0);
+        irradiance += intensity * (cosine * window * window / distanceSquared);
+    }
+    return irradiance;
+}
+
+// Linear radiance leaving a diffuse surface at the current fragment
+vec3 ShadeSurface(vec3 albedo, vec3 worldNormal, float depth, vec4 lightSpacePosition) {
+    vec2 screen = gl_FragCoord.xy / viewportSize;
+    vec3 P = ViewPositionFromDepth(screen, depth);
+    vec3 N = normalize(mat3(viewMatrix) * worldNormal);
+
+    vec3 toLight = (viewMatrix * vec4(lightPosition, 1.0)).xyz - P;
+    vec3 L = normalize(toLight);
+    vec3 BRDF = albedo / 3.14159;
+    float cosine = max(dot(N, L), 0);
+    vec3 lightSourceIrradiance = lightIntensity / (4 * 3.14159 * dot(toLight, toLight));
+    vec3 diffuse = BRDF * cosine * lightSourceIrradiance;
+
+    // for shadow mapping
+    float shadow = CalcShadowFactor(lightSpacePosition);
+
+    return diffuse * shadow + albedo * ambientLight + BRDF * CalcClusteredLights(N, P, screen);
+}
\ No newline at end of file
@@ -0,0 +1,231 @@
+#include "clipmap_terrain.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <core/profiler.h>
+#include <core/terrain_height.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+
+const GLuint kHeightmapUnit = 6;		// 0 to 5 are taken by materials, clusters and the G-buffer
+const int kHalfGrid = ClipmapTerrain::kGridQuads / 2;
+const int kGridVertices = ClipmapTerrain::kGridQuads + 1;
+
+int WrapTexel(int coordinate) {
+	int wrapped = coordinate % ClipmapTerrain::kTextureSize;
+	return wrapped < 0 ? wrapped + ClipmapTerrain::kTextureSize : wrapped;
+}
+
+bool LoadProgram(ClipmapTerrain::Program& program, const char* vertexPath, const char* fragmentPath,
+	const char* defines) {
+	program.programID = LoadShadersFromFile(vertexPath, fragmentPath, defines);
+	if (program.programID == 0) return false;
+	program.heightmapID = glGetUniformLocation(program.programID, "heightmap");
+	program.viewProjectionID = glGetUniformLocation(program.programID, "viewProjection");
+	program.levelID = glGetUniformLocation(program.programID, "level");
+	program.levelCenterID = glGetUniformLocation(program.programID, "levelCenter");
+	program.levelSpacingID = glGetUniformLocation(program.programID, "levelSpacing");
+	program.lightPositionID = glGetUniformLocation(program.programID, "lightPosition");
+	program.lightIntensityID = glGetUniformLocation(program.programID, "lightIntensity");
+	program.ambientLightID = glGetUniformLocation(program.programID, "ambientLight");
+	return true;
+}
+
+} // namespace
+
+bool ClipmapTerrain::initialize(const char* vertexPath, const char* fragmentPath) {
+	if (!LoadProgram(forward, vertexPath, fragmentPath, NULL) ||
+		!LoadProgram(gbuffer, vertexPath, fragmentPath, "#define GBUFFER\n")) {
+		std::cerr << "Failed to load terrain shaders." << std::endl;
+		return false;
+	}
+
+	// One grid shared by every level, as offsets from the level's centre
+	std::vector<float> vertices;
+	vertices.reserve(kGridVertices * kGridVertices * 2);
+	for (int z = 0; z < kGridVertices; ++z) {
+		for (int x = 0; x < kGridVertices; ++x) {
+			vertices.push_back((float)(x - kHalfGrid));
+			vertices.push_back((float)(z - kHalfGrid));
+		}
+	}
+
+	// Row-major quads, so any rectangle is one contiguous index range per row
+	std::vector<GLuint> indices;
+	indices.reserve(kGridQuads * kGridQuads * 6);
+	for (int z = 0; z < kGridQuads; ++z) {
+		for (int x = 0; x < kGridQuads; ++x) {
+			GLuint v00 = z * kGridVertices + x;
+			GLuint v10 = v00 + 1;
+			GLuint v01 = v00 + kGridVertices;
+			GLuint v11 = v01 + 1;
+			// Counter-clockwise seen from above
+			indices.push_back(v00);
+			indices.push_back(v01);
+			indices.push_back(v10);
+			indices.push_back(v10);
+			indices.push_back(v01);
+			indices.push_back(v11);
+		}
+	}
+
+	glGenVertexArrays(1, &vertexArrayID);
+	glBindVertexArray(vertexArrayID);
+	glGenBuffers(1, &vertexBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, 0);
+	glGenBuffers(1, &indexBufferID);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBufferID);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+	glBindVertexArray(0);
+
+	glGenTextures(1, &heightTextureID);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, heightTextureID);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, kTextureSize, kTextureSize, kLevels, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	RenderStateInvalidate();
+	return true;
+}
+
+void ClipmapTerrain::cleanup() {
+	glDeleteTextures(1, &heightTextureID);
+	glDeleteBuffers(1, &vertexBufferID);
+	glDeleteBuffers(1, &indexBufferID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(forward.programID);
+	glDeleteProgram(gbuffer.programID);
+}
+
+void ClipmapTerrain::uploadRegion(int level, int x0, int z0, int width, int height) {
+	float spacing = baseSpacing * (float)(1 << level);
+	for (int z = z0; z < z0 + height;) {
+		int tz = WrapTexel(z);
+		int rows = std::min(z0 + height - z, kTextureSize - tz);
+		for (int x = x0; x < x0 + width;) {
+			int tx = WrapTexel(x);
+			int columns = std::min(x0 + width - x, kTextureSize - tx);
+
+			scratch.resize(columns * rows);
+			for (int j = 0; j < rows; ++j) {
+				for (int i = 0; i < columns; ++i) {
+					scratch[j * columns + i] = TerrainHeight((x + i) * spacing, (z + j) * spacing);
+				}
+			}
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, tx, tz, level, columns, rows, 1, GL_RED, GL_FLOAT, scratch.data());
+			texelsUploadedLastFrame += columns * rows;
+			x += columns;
+		}
+		z += rows;
+	}
+}
+
+void ClipmapTerrain::update(const glm::vec3& cameraPosition) {
+	PROFILE_ZONE("Terrain update");
+	texelsUploadedLastFrame = 0;
+	glBindTexture(GL_TEXTURE_2D_ARRAY, heightTextureID);
+	RenderStateInvalidate();
+
+	for (int level = 0; level < kLevels; ++level) {
+		// Snapped to every second vertex, which is a vertex of the next level
+		float doubleSpacing = 2.0f * baseSpacing * (float)(1 << level);
+		glm::ivec2 center(2 * (int)std::floor(cameraPosition.x / doubleSpacing + 0.5f),
+			2 * (int)std::floor(cameraPosition.z / doubleSpacing + 0.5f));
+		glm::ivec2 old = centers[level];
+		glm::ivec2 delta = center - old;
+
+		if (!resident[level] || std::abs(delta.x) >= kGridVertices || std::abs(delta.y) >= kGridVertices) {
+			uploadRegion(level, center.x - kHalfGrid, center.y - kHalfGrid, kGridVertices, kGridVertices);
+			resident[level] = true;
+		}
+		else if (delta != glm::ivec2(0)) {
+			// Newly exposed columns over the whole new window
+			if (delta.x > 0) {
+				uploadRegion(level, old.x + kHalfGrid + 1, center.y - kHalfGrid, delta.x, kGridVertices);
+			}
+			else if (delta.x < 0) {
+				uploadRegion(level, center.x - kHalfGrid, center.y - kHalfGrid, -delta.x, kGridVertices);
+			}
+			// Newly exposed rows over the columns that were already resident
+			int x0 = std::max(center.x, old.x) - kHalfGrid;
+			int width = kGridVertices - std::abs(delta.x);
+			if (delta.y > 0) {
+				uploadRegion(level, x0, old.y + kHalfGrid + 1, width, delta.y);
+			}
+			else if (delta.y < 0) {
+				uploadRegion(level, x0, center.y - kHalfGrid, width, -delta.y);
+			}
+		}
+		centers[level] = center;
+	}
+	texelsUploadedTotal += texelsUploadedLastFrame;
+}
+
+void ClipmapTerrain::drawRectangle(int level, int x0, int z0, int x1, int z1) {
+	if (x1 <= x0 || z1 <= z0) return;
+	GLsizei counts[kGridQuads];
+	const void* offsets[kGridQuads];
+	int originX = centers[level].x - kHalfGrid;
+	int originZ = centers[level].y - kHalfGrid;
+	int rows = z1 - z0;
+	for (int row = 0; row < rows; ++row) {
+		size_t firstQuad = (size_t)(z0 - originZ + row) * kGridQuads + (x0 - originX);
+		counts[row] = (x1 - x0) * 6;
+		offsets[row] = (const void*)(firstQuad * 6 * sizeof(GLuint));
+	}
+	glMultiDrawElements(GL_TRIANGLES, counts, GL_UNSIGNED_INT, offsets, rows);
+	++gRenderStats.drawCalls;
+	gRenderStats.triangles += 2ull * (x1 - x0) * rows;
+	verticesPerFrame += 6 * (x1 - x0) * rows;
+}
+
+void ClipmapTerrain::setLighting(const glm::vec3& lightPosition, const glm::vec3& lightIntensity,
+	const glm::vec3& ambientLight) {
+	RenderStateUseProgram(forward.programID);
+	glUniform3fv(forward.lightPositionID, 1, &lightPosition[0]);
+	glUniform3fv(forward.lightIntensityID, 1, &lightIntensity[0]);
+	glUniform3fv(forward.ambientLightID, 1, &ambientLight[0]);
+}
+
+void ClipmapTerrain::render(bool toGBuffer, const glm::mat4& viewProjection) {
+	const Program& program = toGBuffer ? gbuffer : forward;
+	RenderStateUseProgram(program.programID);
+	RenderStateBindTexture(kHeightmapUnit, GL_TEXTURE_2D_ARRAY, heightTextureID);
+	glUniform1i(program.heightmapID, kHeightmapUnit);
+	glUniformMatrix4fv(program.viewProjectionID, 1, GL_FALSE, &viewProjection[0][0]);
+
+	verticesPerFrame = 0;
+	glBindVertexArray(vertexArrayID);
+	for (int level = 0; level < kLevels; ++level) {
+		glm::ivec2 center = centers[level];
+		glUniform1i(program.levelID, level);
+		glUniform2i(program.levelCenterID, center.x, center.y);
+		glUniform1f(program.levelSpacingID, baseSpacing * (float)(1 << level));
+
+		int x0 = center.x - kHalfGrid, x1 = center.x + kHalfGrid;
+		int z0 = center.y - kHalfGrid, z1 = center.y + kHalfGrid;
+		if (level == 0) {
+			drawRectangle(level, x0, z0, x1, z1);
+			continue;
+		}
+
+		// The finer level covers a 32 x 32 quad hole, at most one quad off centre
+		glm::ivec2 finer = centers[level - 1] / 2;
+		int hx0 = finer.x - kHalfGrid / 2, hx1 = finer.x + kHalfGrid / 2;
+		int hz0 = finer.y - kHalfGrid / 2, hz1 = finer.y + kHalfGrid / 2;
+		drawRectangle(level, x0, z0, x1, hz0);
+		drawRectangle(level, x0, hz1, x1, z1);
+		drawRectangle(level, x0, hz0, hx0, hz1);
+		drawRectangle(level, hx1, hz0, x1, hz1);
+	}
+	glBindVertexArray(0);
+}
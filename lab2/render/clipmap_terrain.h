@@ -0,0 +1,80 @@
+#ifndef _CLIPMAP_TERRAIN_H_
+#define _CLIPMAP_TERRAIN_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Ground terrain drawn with geometry clipmaps.
+//
+// Level L is a grid of 64 x 64 quads spaced 2^L times the base spacing and
+// centred on the camera, snapped to every second vertex so the next coarser
+// level's grid lines up. Each level but the finest leaves out the footprint of
+// the one inside it. All levels share one vertex and index buffer; the ring
+// around the hole is drawn as four rectangles of index rows. Vertices near a
+// level's outer edge morph onto the coarser grid, so the levels meet without
+// cracks.
+//
+// Heights live in one R32F array layer per level, addressed toroidally: a
+// texel's position is its grid coordinate modulo the texture size, so when the
+// centre moves only the rows and columns that came into range are computed
+// and uploaded. Vertex count and upload bandwidth per frame depend on camera
+// speed and the level count, never on the size of the world.
+struct ClipmapTerrain {
+	static const int kLevels = 6;
+	static const int kGridQuads = 64;			// Per side of each level
+	static const int kTextureSize = 128;		// Toroidal, at least kGridQuads + 1
+
+	float baseSpacing = 2.0f;
+
+	GLuint vertexArrayID = 0;
+	GLuint vertexBufferID = 0;
+	GLuint indexBufferID = 0;
+	GLuint heightTextureID = 0;
+
+	// Forward and G-buffer variants of the terrain material
+	struct Program {
+		GLuint programID = 0;
+		GLuint heightmapID = 0;
+		GLuint viewProjectionID = 0;
+		GLuint levelID = 0;
+		GLuint levelCenterID = 0;
+		GLuint levelSpacingID = 0;
+		GLuint lightPositionID = 0;
+		GLuint lightIntensityID = 0;
+		GLuint ambientLightID = 0;
+	};
+	Program forward;
+	Program gbuffer;
+
+	// Per level, in grid units of that level
+	glm::ivec2 centers[kLevels];
+	bool resident[kLevels] = {};
+
+	// Streaming statistics
+	unsigned long long texelsUploadedLastFrame = 0;
+	unsigned long long texelsUploadedTotal = 0;
+	unsigned int verticesPerFrame = 0;
+
+	std::vector<float> scratch;
+
+	bool initialize(const char* vertexPath, const char* fragmentPath);
+	void cleanup();
+
+	// Recentres every level on the camera and uploads the newly exposed strips
+	void update(const glm::vec3& cameraPosition);
+
+	// Draws all levels. The forward program also needs the cluster uniforms
+	// bound, see ClusteredLighting, and setLighting.
+	void render(bool toGBuffer, const glm::mat4& viewProjection);
+	void setLighting(const glm::vec3& lightPosition, const glm::vec3& lightIntensity, const glm::vec3& ambientLight);
+
+	// Computes and uploads the heights of a rectangle of grid points, split
+	// where it wraps around the toroidal texture
+	void uploadRegion(int level, int x0, int z0, int width, int height);
+	// Draws the quads [x0, x1) x [z0, z1) of a level, one index range per row
+	void drawRectangle(int level, int x0, int z0, int x1, int z1);
+};
+
+#endif
@@ -0,0 +1,83 @@
+#include "clustered_lighting.h"
+#include "render_state.h"
+
+#include <core/light_clusters.h>
+
+namespace {
+
+void CreateBufferTexture(GLuint& bufferID, GLuint& textureID, GLenum format) {
+	glGenBuffers(1, &bufferID);
+	glBindBuffer(GL_TEXTURE_BUFFER, bufferID);
+	glBufferData(GL_TEXTURE_BUFFER, 16, NULL, GL_STREAM_DRAW);
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_BUFFER, textureID);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, bufferID);
+}
+
+void StreamBuffer(GLuint bufferID, const void* data, size_t size) {
+	glBindBuffer(GL_TEXTURE_BUFFER, bufferID);
+	// Never empty, so the buffer texture always has storage behind it
+	glBufferData(GL_TEXTURE_BUFFER, size > 0 ? size : 16, NULL, GL_STREAM_DRAW);
+	if (size > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+}
+
+} // namespace
+
+void ClusteredLighting::initialize() {
+	CreateBufferTexture(lightBufferID, lightTextureID, GL_RGBA32F);
+	CreateBufferTexture(rangeBufferID, rangeTextureID, GL_RG32UI);
+	CreateBufferTexture(indexBufferID, indexTextureID, GL_R32UI);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	RenderStateInvalidate();
+}
+
+void ClusteredLighting::cleanup() {
+	glDeleteTextures(1, &lightTextureID);
+	glDeleteTextures(1, &rangeTextureID);
+	glDeleteTextures(1, &indexTextureID);
+	glDeleteBuffers(1, &lightBufferID);
+	glDeleteBuffers(1, &rangeBufferID);
+	glDeleteBuffers(1, &indexBufferID);
+}
+
+void ClusteredLighting::upload(const LightClusters& clusters) {
+	StreamBuffer(lightBufferID, clusters.viewLights.data(), clusters.viewLights.size() * sizeof(PointLight));
+	StreamBuffer(rangeBufferID, clusters.ranges.data(), clusters.ranges.size() * sizeof(unsigned int));
+	StreamBuffer(indexBufferID, clusters.indices.data(), clusters.indices.size() * sizeof(unsigned int));
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::bind(GLuint programID, const LightClusters& clusters, const glm::mat4& viewMatrix,
+	const glm::mat4& projectionMatrix, int viewportWidth, int viewportHeight) {
+	ProgramUniforms* uniforms = NULL;
+	for (int i = 0; i < kMaxPrograms && i < programsSeen; ++i) {
+		if (programs[i].programID == programID) uniforms = &programs[i];
+	}
+	if (!uniforms) {
+		uniforms = &programs[programsSeen++ % kMaxPrograms];
+		uniforms->programID = programID;
+		uniforms->lightSamplerID = glGetUniformLocation(programID, "clusterLights");
+		uniforms->rangeSamplerID = glGetUniformLocation(programID, "clusterRanges");
+		uniforms->indexSamplerID = glGetUniformLocation(programID, "clusterLightIndices");
+		uniforms->clusterGridID = glGetUniformLocation(programID, "clusterGrid");
+		uniforms->depthScaleBiasID = glGetUniformLocation(programID, "clusterDepthScaleBias");
+		uniforms->viewportSizeID = glGetUniformLocation(programID, "viewportSize");
+		uniforms->inverseProjectionID = glGetUniformLocation(programID, "inverseProjection");
+		uniforms->viewMatrixID = glGetUniformLocation(programID, "viewMatrix");
+	}
+
+	RenderStateUseProgram(programID);
+	RenderStateBindTexture(kLightUnit, GL_TEXTURE_BUFFER, lightTextureID);
+	RenderStateBindTexture(kRangeUnit, GL_TEXTURE_BUFFER, rangeTextureID);
+	RenderStateBindTexture(kIndexUnit, GL_TEXTURE_BUFFER, indexTextureID);
+	glUniform1i(uniforms->lightSamplerID, kLightUnit);
+	glUniform1i(uniforms->rangeSamplerID, kRangeUnit);
+	glUniform1i(uniforms->indexSamplerID, kIndexUnit);
+	glUniform3i(uniforms->clusterGridID, kClusterX, kClusterY, kClusterZ);
+	glUniform2f(uniforms->depthScaleBiasID, clusters.depthScale, clusters.depthBias);
+	glUniform2f(uniforms->viewportSizeID, (float)viewportWidth, (float)viewportHeight);
+
+	glm::mat4 inverseProjection = glm::inverse(projectionMatrix);
+	glUniformMatrix4fv(uniforms->inverseProjectionID, 1, GL_FALSE, &inverseProjection[0][0]);
+	glUniformMatrix4fv(uniforms->viewMatrixID, 1, GL_FALSE, &viewMatrix[0][0]);
+}
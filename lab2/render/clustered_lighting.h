@@ -0,0 +1,55 @@
+#ifndef _CLUSTERED_LIGHTING_H_
+#define _CLUSTERED_LIGHTING_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+struct LightClusters;
+
+// GPU side of clustered forward lighting.
+//
+// The lights, the per-cluster ranges and the flat index list are streamed
+// into buffer textures every frame, which is what GL 3.3 offers for large
+// read-only arrays in a fragment shader. Units 2 to 4 are reserved for them.
+struct ClusteredLighting {
+	static const GLuint kLightUnit = 2;
+	static const GLuint kRangeUnit = 3;
+	static const GLuint kIndexUnit = 4;
+
+	GLuint lightBufferID = 0;
+	GLuint rangeBufferID = 0;
+	GLuint indexBufferID = 0;
+	GLuint lightTextureID = 0;
+	GLuint rangeTextureID = 0;
+	GLuint indexTextureID = 0;
+
+	// Uniform locations of each program bound so far, oldest replaced first
+	struct ProgramUniforms {
+		GLuint programID = 0;
+		GLuint lightSamplerID = 0;
+		GLuint rangeSamplerID = 0;
+		GLuint indexSamplerID = 0;
+		GLuint clusterGridID = 0;
+		GLuint depthScaleBiasID = 0;
+		GLuint viewportSizeID = 0;
+		GLuint inverseProjectionID = 0;
+		GLuint viewMatrixID = 0;
+	};
+	static const int kMaxPrograms = 4;
+	ProgramUniforms programs[kMaxPrograms];
+	int programsSeen = 0;
+
+	void initialize();
+	void cleanup();
+
+	// Streams this frame's clusters, orphaning the previous storage
+	void upload(const LightClusters& clusters);
+
+	// Binds the buffer textures and sets the cluster uniforms of a program
+	// that includes the clustered lighting code. The viewport is the scaled
+	// render rectangle the fragments are in.
+	void bind(GLuint programID, const LightClusters& clusters, const glm::mat4& viewMatrix,
+		const glm::mat4& projectionMatrix, int viewportWidth, int viewportHeight);
+};
+
+#endif
@@ -0,0 +1,279 @@
+#include "frame_capture.h"
+#include <core/profiler.h>
+
+#include <stb/stb_image_write.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+FrameCapture::~FrameCapture() {
+	finish();
+}
+
+bool FrameCapture::start(const char* path, int framesPerSecond) {
+	this->path = path;
+	this->framesPerSecond = framesPerSecond > 0 ? framesPerSecond : 60;
+	y4m = this->path.size() >= 4 && this->path.compare(this->path.size() - 4, 4, ".y4m") == 0;
+	if (y4m) {
+		stream = fopen(path, "wb");
+		if (!stream) {
+			std::cerr << "Failed to open " << path << " for capture." << std::endl;
+			return false;
+		}
+	}
+	else if (!parsePattern()) {
+		std::cerr << "Capture path " << path << " is neither a .y4m file nor a PNG pattern with one %d or %u."
+			<< std::endl;
+		return false;
+	}
+
+	glGenBuffers(kCaptureRingSize, pixelBufferIDs);
+
+	// One encoder keeps the stream in order; PNGs are independent files
+	int threads = 1;
+	if (!y4m) {
+		threads = static_cast<int>(std::thread::hardware_concurrency()) / 2;
+		threads = std::max(1, std::min(threads, 4));
+	}
+	quit = false;
+	for (int i = 0; i < threads; ++i) {
+		encoders.emplace_back(&FrameCapture::encoderLoop, this);
+	}
+	running = true;
+	std::cout << "Capturing to " << path << " with " << threads << " encoder thread" << (threads > 1 ? "s" : "")
+		<< std::endl;
+	return true;
+}
+
+// Splits a PNG pattern around its one conversion, %d or %u with an optional
+// 0 flag and width, and refuses any other %
+bool FrameCapture::parsePattern() {
+	size_t percent = path.find('%');
+	if (percent == std::string::npos) return false;
+	size_t at = percent + 1;
+	zeroPad = at < path.size() && path[at] == '0';
+	if (zeroPad) ++at;
+	numberWidth = 0;
+	while (at < path.size() && path[at] >= '0' && path[at] <= '9' && numberWidth < 100) {
+		numberWidth = numberWidth * 10 + (path[at++] - '0');
+	}
+	if (at >= path.size() || (path[at] != 'd' && path[at] != 'u')) return false;
+	if (path.find('%', at) != std::string::npos) return false;
+	namePrefix = path.substr(0, percent);
+	nameSuffix = path.substr(at + 1);
+	return true;
+}
+
+void FrameCapture::capture(int width, int height) {
+	if (!running) return;
+	PROFILE_ZONE("Capture");
+	uint64_t start = ProfilerNow();
+	collect(false);
+
+	if (this->width == 0) {
+		this->width = width;
+		this->height = height;
+	}
+	unsigned long long index = frameIndex++;
+	if (width != this->width || height != this->height) {
+		if (!sizeWarned) {
+			std::cout << "Capture is " << this->width << "x" << this->height << ", dropping frames of other sizes."
+				<< std::endl;
+			sizeWarned = true;
+		}
+		++framesDropped;
+	}
+	else if (pending == kCaptureRingSize) {
+		// The oldest readback has still not finished
+		++framesDropped;
+	}
+	else {
+		int slot = (oldest + pending) % kCaptureRingSize;
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glReadBuffer(GL_BACK);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBufferIDs[slot]);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)width * height * 4, NULL, GL_STREAM_READ);
+		glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		readbackFrame[slot] = index;
+		++pending;
+	}
+	captureMs += (ProfilerNow() - start) * 1e-6;
+}
+
+// Maps finished readbacks, oldest first, into encode buffers. Without wait
+// it stops at the first one the GPU has not finished.
+void FrameCapture::collect(bool wait) {
+	size_t bytes = (size_t)width * height * 4;
+	while (pending > 0) {
+		int slot = oldest;
+		GLenum status = glClientWaitSync(fences[slot], wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+			wait ? 1000000000ull : 0);
+		if (status == GL_TIMEOUT_EXPIRED && wait) continue;
+		if (status == GL_TIMEOUT_EXPIRED) break;
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+		oldest = (oldest + 1) % kCaptureRingSize;
+		--pending;
+
+		Frame frame;
+		frame.index = readbackFrame[slot];
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (buffersOut == kCaptureQueuedFrames) {
+				// The encoders are behind
+				++framesDropped;
+				continue;
+			}
+			++buffersOut;
+			if (!freeBuffers.empty()) {
+				frame.pixels = std::move(freeBuffers.back());
+				freeBuffers.pop_back();
+			}
+		}
+		frame.pixels.resize(bytes);
+
+		PROFILE_ZONE("Map capture");
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBufferIDs[slot]);
+		const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT);
+		bool mapped = pixels != NULL;
+		if (mapped) {
+			memcpy(frame.pixels.data(), pixels, bytes);
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!mapped) {
+			++framesDropped;
+			--buffersOut;
+			freeBuffers.push_back(std::move(frame.pixels));
+			continue;
+		}
+		queue.push_back(std::move(frame));
+		++framesCaptured;
+		wake.notify_one();
+	}
+}
+
+int FrameCapture::queuedFrames() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return buffersOut;
+}
+
+void FrameCapture::finish() {
+	if (!running) return;
+	collect(true);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (std::thread& encoder : encoders) {
+		encoder.join();
+	}
+	encoders.clear();
+	if (stream) {
+		fclose(stream);
+		stream = nullptr;
+	}
+	glDeleteBuffers(kCaptureRingSize, pixelBufferIDs);
+	running = false;
+	std::cout << "Captured " << framesWritten << " frames to " << path << ", dropped " << framesDropped << "."
+		<< std::endl;
+}
+
+void FrameCapture::encoderLoop() {
+	ProfilerSetThreadName("Capture encoder");
+	std::vector<uint8_t> scratch;
+	for (;;) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return quit || !queue.empty(); });
+			if (queue.empty()) return;
+			frame = std::move(queue.front());
+			queue.pop_front();
+		}
+		if (y4m) {
+			writeY4m(frame);
+		}
+		else {
+			writePng(frame, scratch);
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		freeBuffers.push_back(std::move(frame.pixels));
+		--buffersOut;
+		++framesWritten;
+	}
+}
+
+// Full-range BT.601, as C420jpeg declares, with chroma averaged over each
+// 2 x 2 block. 4:2:0 needs even sizes, so an odd last row or column is cut.
+void FrameCapture::writeY4m(const Frame& frame) {
+	PROFILE_ZONE("Encode Y4M");
+	int w = width & ~1, h = height & ~1;
+	if (nextStreamFrame == 0) {
+		fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", w, h, framesPerSecond);
+	}
+	// Frames dropped since the last one repeat it, keeping the stream's timing
+	for (; !yuv.empty() && nextStreamFrame < frame.index; ++nextStreamFrame) {
+		fputs("FRAME\n", stream);
+		fwrite(yuv.data(), 1, yuv.size(), stream);
+	}
+
+	size_t lumaSize = (size_t)w * h, chromaSize = lumaSize / 4;
+	yuv.resize(lumaSize + chromaSize * 2);
+	uint8_t* luma = yuv.data();
+	uint8_t* cb = luma + lumaSize;
+	uint8_t* cr = cb + chromaSize;
+	size_t stride = (size_t)width * 4;
+	for (int y = 0; y < h; y += 2) {
+		// Rows arrive bottom first
+		const uint8_t* rows[2] = {
+			frame.pixels.data() + (height - 1 - y) * stride,
+			frame.pixels.data() + (height - 2 - y) * stride
+		};
+		for (int x = 0; x < w; x += 2) {
+			int sumR = 0, sumG = 0, sumB = 0;
+			for (int k = 0; k < 4; ++k) {
+				const uint8_t* p = rows[k >> 1] + (x + (k & 1)) * 4;
+				int r = p[0], g = p[1], b = p[2];
+				luma[(size_t)(y + (k >> 1)) * w + x + (k & 1)] = static_cast<uint8_t>((77 * r + 150 * g + 29 * b + 128) >> 8);
+				sumR += r;
+				sumG += g;
+				sumB += b;
+			}
+			size_t c = (size_t)(y / 2) * (w / 2) + x / 2;
+			cb[c] = static_cast<uint8_t>(std::min(std::max((-43 * sumR - 85 * sumG + 128 * sumB + 512) / 1024 + 128, 0), 255));
+			cr[c] = static_cast<uint8_t>(std::min(std::max((128 * sumR - 107 * sumG - 21 * sumB + 512) / 1024 + 128, 0), 255));
+		}
+	}
+	fputs("FRAME\n", stream);
+	fwrite(yuv.data(), 1, yuv.size(), stream);
+	nextStreamFrame = frame.index + 1;
+}
+
+void FrameCapture::writePng(const Frame& frame, std::vector<uint8_t>& rgb) {
+	PROFILE_ZONE("Encode PNG");
+	// Top row first and without the window's alpha, which need not be opaque
+	rgb.resize((size_t)width * height * 3);
+	for (int y = 0; y < height; ++y) {
+		const uint8_t* source = frame.pixels.data() + (size_t)(height - 1 - y) * width * 4;
+		uint8_t* target = rgb.data() + (size_t)y * width * 3;
+		for (int x = 0; x < width; ++x) {
+			target[x * 3] = source[x * 4];
+			target[x * 3 + 1] = source[x * 4 + 1];
+			target[x * 3 + 2] = source[x * 4 + 2];
+		}
+	}
+	std::string number = std::to_string(frame.index);
+	if (number.size() < (size_t)numberWidth) number.insert(0, numberWidth - number.size(), zeroPad ? '0' : ' ');
+	std::string name = namePrefix + number + nameSuffix;
+	if (!stbi_write_png(name.c_str(), width, height, 3, rgb.data(), width * 3)) {
+		std::cerr << "Failed to write " << name << std::endl;
+	}
+}
@@ -0,0 +1,100 @@
+#ifndef _FRAME_CAPTURE_H_
+#define _FRAME_CAPTURE_H_
+
+#include <glad/gl.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records frames from the window to disk without stalling rendering.
+//
+// Each captured frame is read with glReadPixels into the next of a ring of
+// pixel buffer objects, which returns at once, and fenced. A buffer is only
+// mapped once its fence has signalled, several frames later, so the copy out
+// never waits on the GPU. The pixels then go to encoder threads of their own,
+// kept off the job system so a slow encode cannot hold up the frame's
+// parallel work:
+//   a path ending in .y4m is one raw YUV 4:2:0 stream, written in order by a
+//   single encoder, which repeats the previous frame over dropped ones so
+//   the timing holds;
+//   any other path names numbered PNGs through one %d or %u, optionally
+//   with a zero-padded width as in frames/city_%05d.png, encoded by several
+//   threads. The number is put in by hand rather than through printf.
+// When the ring is still busy or every encode buffer is queued, the frame is
+// dropped and counted rather than waited for.
+
+const int kCaptureRingSize = 4;
+const int kCaptureQueuedFrames = 8;		// Frames mapped but not yet encoded, at most
+
+class FrameCapture {
+public:
+	~FrameCapture();
+
+	bool start(const char* path, int framesPerSecond);
+
+	// Queues the readback of the window's back buffer, after the frame is
+	// drawn, and hands earlier readbacks that have finished to the encoders
+	void capture(int width, int height);
+
+	// Waits for every readback and encode, then closes the output
+	void finish();
+
+	bool active() const { return running; }
+	int queuedFrames();
+
+	unsigned long long framesCaptured = 0;		// Read back and queued to encode
+	unsigned long long framesDropped = 0;
+	unsigned long long framesWritten = 0;
+	double captureMs = 0.0;						// Main thread time in capture()
+
+private:
+	struct Frame {
+		unsigned long long index;
+		std::vector<uint8_t> pixels;	// RGBA rows, bottom first
+	};
+
+	bool parsePattern();
+	void collect(bool wait);
+	void encoderLoop();
+	void writeY4m(const Frame& frame);
+	void writePng(const Frame& frame, std::vector<uint8_t>& rgb);
+
+	bool running = false;
+	bool y4m = false;
+	std::string path;
+	std::string namePrefix;				// Of a PNG pattern, around the number
+	std::string nameSuffix;
+	int numberWidth = 0;
+	bool zeroPad = false;
+	int framesPerSecond = 60;
+	int width = 0;						// Of the first frame; later sizes are dropped
+	int height = 0;
+	bool sizeWarned = false;
+
+	GLuint pixelBufferIDs[kCaptureRingSize] = {};
+	GLsync fences[kCaptureRingSize] = {};
+	unsigned long long readbackFrame[kCaptureRingSize] = {};
+	unsigned long long frameIndex = 0;
+	int oldest = 0;						// Ring slot to collect next
+	int pending = 0;					// Slots read into and not yet collected
+
+	FILE* stream = nullptr;				// The Y4M output
+	std::vector<uint8_t> yuv;			// Last frame written to the stream
+	unsigned long long nextStreamFrame = 0;
+
+	std::vector<std::thread> encoders;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<Frame> queue;
+	std::vector<std::vector<uint8_t>> freeBuffers;
+	int buffersOut = 0;					// Queued or being encoded
+	bool quit = false;
+};
+
+#endif
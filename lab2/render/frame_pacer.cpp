@@ -0,0 +1,120 @@
+#include "frame_pacer.h"
+
+#include <core/profiler.h>
+
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+// Sleep granularity is a millisecond or worse on most systems, so the last
+// stretch before a deadline is spent yielding instead
+const uint64_t kSpinWindowNs = 2000000;
+
+const uint64_t kFenceTimeoutNs = 100000000;
+
+} // namespace
+
+void FramePacer::initialize() {
+	hasAdaptive = glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+		glfwExtensionSupported("GLX_EXT_swap_control_tear");
+
+	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	if (mode && mode->refreshRate > 0) refreshPeriodMs = 1000.0 / mode->refreshRate;
+
+	setSwapMode(swapMode);
+}
+
+void FramePacer::setSwapMode(SwapMode mode) {
+	swapMode = mode;
+	int interval = 1;
+	if (mode == SWAP_ADAPTIVE) interval = hasAdaptive ? -1 : 1;
+	else if (mode == SWAP_UNCAPPED) interval = 0;
+	glfwSwapInterval(interval);
+}
+
+const char* FramePacer::swapModeName() const {
+	switch (swapMode) {
+	case SWAP_VSYNC: return "vsync";
+	case SWAP_ADAPTIVE: return hasAdaptive ? "adaptive" : "adaptive (unsupported, vsync)";
+	default: return "uncapped";
+	}
+}
+
+void FramePacer::beginFrame() {
+	if (targetFps > 0.0f) {
+		PROFILE_ZONE("Frame limiter");
+		uint64_t period = static_cast<uint64_t>(1e9 / targetFps);
+		uint64_t now = ProfilerNow();
+		if (nextDeadline > now) {
+			if (nextDeadline - now > kSpinWindowNs) {
+				std::this_thread::sleep_for(std::chrono::nanoseconds(nextDeadline - now - kSpinWindowNs));
+			}
+			while (ProfilerNow() < nextDeadline) std::this_thread::yield();
+			now = nextDeadline;
+		}
+		// A late frame restarts the schedule rather than bursting to catch up
+		nextDeadline = now + period;
+	}
+
+	PROFILE_ZONE("Frames in flight");
+	int limit = maxFramesInFlight;
+	if (limit < 1) limit = 1;
+	if (limit > kMaxFramesInFlight - 1) limit = kMaxFramesInFlight - 1;
+	retireFences(false);
+	while (frameIndex - oldestFrame >= static_cast<uint64_t>(limit)) {
+		// A lost or failed wait lets this frame through over the limit
+		if (!retireFences(true)) break;
+	}
+}
+
+void FramePacer::markInputSampled(uint64_t time) {
+	inputTime = time;
+}
+
+void FramePacer::endFrame() {
+	int slot = static_cast<int>(frameIndex % kMaxFramesInFlight);
+	// Only when waits keep failing can the ring fill; the oldest fence is
+	// then given up without a sample
+	if (frameIndex - oldestFrame >= static_cast<uint64_t>(kMaxFramesInFlight)) {
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+		++oldestFrame;
+	}
+	fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	inputTimes[slot] = inputTime;
+	++frameIndex;
+}
+
+// Retires signalled fences oldest first. With block set, waits for the oldest
+// pending fence and retires just that one. A fence that has not signalled,
+// or whose wait failed, stays pending and gives no latency sample.
+bool FramePacer::retireFences(bool block) {
+	while (oldestFrame < frameIndex) {
+		int slot = static_cast<int>(oldestFrame % kMaxFramesInFlight);
+		GLenum result = glClientWaitSync(fences[slot], block ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+			block ? kFenceTimeoutNs : 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) return !block;
+
+		double latency = (ProfilerNow() - inputTimes[slot]) * 1e-6;
+		if (swapMode != SWAP_UNCAPPED) latency += refreshPeriodMs * 0.5;
+		lastLatencyMs = latency;
+		averageLatencyMs = latencySamples == 0 ? latency : averageLatencyMs * 0.95 + latency * 0.05;
+		++latencySamples;
+
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+		++oldestFrame;
+		if (block) return true;
+	}
+	return true;
+}
+
+void FramePacer::cleanup() {
+	for (; oldestFrame < frameIndex; ++oldestFrame) {
+		int slot = static_cast<int>(oldestFrame % kMaxFramesInFlight);
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+	}
+}
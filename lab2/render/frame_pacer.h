@@ -0,0 +1,58 @@
+#ifndef _FRAME_PACER_H_
+#define _FRAME_PACER_H_
+
+#include <glad/gl.h>
+#include <cstdint>
+
+enum SwapMode {
+	SWAP_VSYNC,
+	SWAP_ADAPTIVE,		// Vsync, but tear instead of waiting a whole refresh when late
+	SWAP_UNCAPPED,
+	SWAP_MODE_COUNT
+};
+
+// Frame pacing around the main loop.
+//
+// beginFrame sleeps until the frame limiter's deadline and then blocks until
+// at most maxFramesInFlight earlier frames are still on the GPU, so the caller
+// can sample input as late as possible. endFrame, called right after the swap,
+// drops a fence for this frame. Input-to-photon latency is estimated as the
+// time from the input given to markInputSampled to the moment the frame's
+// fence is seen signalled, plus half a refresh for scanout when vsync is on.
+// With the frame pipeline the submitted frame was built from the previous
+// frame's input, so the caller passes the time carried in the packet.
+struct FramePacer {
+	static const int kMaxFramesInFlight = 8;
+
+	SwapMode swapMode = SWAP_VSYNC;
+	float targetFps = 0.0f;			// 0 disables the limiter
+	int maxFramesInFlight = 2;
+	double refreshPeriodMs = 1000.0 / 60.0;
+
+	GLsync fences[kMaxFramesInFlight] = {};
+	uint64_t inputTimes[kMaxFramesInFlight] = {};
+	uint64_t oldestFrame = 0;		// Oldest frame whose fence is still pending
+	uint64_t frameIndex = 0;
+	uint64_t inputTime = 0;
+	uint64_t nextDeadline = 0;
+	bool hasAdaptive = false;
+
+	double lastLatencyMs = 0.0;
+	double averageLatencyMs = 0.0;
+	unsigned long long latencySamples = 0;
+
+	void initialize();
+	void setSwapMode(SwapMode mode);
+	void beginFrame();
+	// ProfilerNow() when the input behind the frame being submitted was sampled
+	void markInputSampled(uint64_t time);
+	void endFrame();
+	void cleanup();
+
+	const char* swapModeName() const;
+
+	// Returns false when a blocking wait gave up, leaving the fence pending
+	bool retireFences(bool block);
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "gbuffer.h"
+#include "scaled_target.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <iostream>
+
+namespace {
+
+const GLuint kAlbedoUnit = 0;
+const GLuint kNormalUnit = 1;
+const GLuint kDepthUnit = 5;		// Units 2 to 4 hold the light clusters
+
+void AllocateTexture(GLuint textureID, GLint internalFormat, GLenum format, GLenum type, int width, int height) {
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+} // namespace
+
+bool GBuffer::initialize(const char* vertexPath, const char* fragmentPath) {
+	lightingProgramID = LoadShadersFromFile(vertexPath, fragmentPath);
+	if (lightingProgramID == 0) {
+		std::cerr << "Failed to load deferred lighting shaders." << std::endl;
+		return false;
+	}
+	albedoSamplerID = glGetUniformLocation(lightingProgramID, "gbufferAlbedo");
+	normalSamplerID = glGetUniformLocation(lightingProgramID, "gbufferNormal");
+	depthSamplerID = glGetUniformLocation(lightingProgramID, "gbufferDepth");
+	inverseViewMatrixID = glGetUniformLocation(lightingProgramID, "inverseViewMatrix");
+	lightPositionID = glGetUniformLocation(lightingProgramID, "lightPosition");
+	lightIntensityID = glGetUniformLocation(lightingProgramID, "lightIntensity");
+	ambientLightID = glGetUniformLocation(lightingProgramID, "ambientLight");
+
+	glGenFramebuffers(1, &framebufferID);
+	glGenFramebuffers(1, &lightingFramebufferID);
+	glGenTextures(1, &albedoTextureID);
+	glGenTextures(1, &normalTextureID);
+	glGenVertexArrays(1, &vertexArrayID);
+	return true;
+}
+
+void GBuffer::cleanup() {
+	glDeleteFramebuffers(1, &framebufferID);
+	glDeleteFramebuffers(1, &lightingFramebufferID);
+	glDeleteTextures(1, &albedoTextureID);
+	glDeleteTextures(1, &normalTextureID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(lightingProgramID);
+}
+
+void GBuffer::begin(const ScaledTarget& target) {
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	if (target.allocatedWidth != allocatedWidth || target.allocatedHeight != allocatedHeight) {
+		allocatedWidth = target.allocatedWidth;
+		allocatedHeight = target.allocatedHeight;
+		AllocateTexture(albedoTextureID, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, allocatedWidth, allocatedHeight);
+		AllocateTexture(normalTextureID, GL_RG16F, GL_RG, GL_HALF_FLOAT, allocatedWidth, allocatedHeight);
+		RenderStateInvalidate();
+
+		// The target reallocates its depth on resize too, so attach it again
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedoTextureID, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normalTextureID, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, target.depthTextureID, 0);
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "G-buffer is incomplete." << std::endl;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, lightingFramebufferID);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.colorTextureID, 0);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	}
+	// No clear: the target's depth was cleared, and the lighting pass skips
+	// every pixel the geometry pass did not write
+}
+
+void GBuffer::light(const ScaledTarget& target, const glm::mat4& viewMatrix, const glm::vec3& lightPosition,
+	const glm::vec3& lightIntensity, const glm::vec3& ambientLight) {
+	glBindFramebuffer(GL_FRAMEBUFFER, lightingFramebufferID);
+
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	glm::mat4 inverseView = glm::inverse(viewMatrix);
+	RenderStateUseProgram(lightingProgramID);
+	RenderStateBindTexture(kAlbedoUnit, GL_TEXTURE_2D, albedoTextureID);
+	RenderStateBindTexture(kNormalUnit, GL_TEXTURE_2D, normalTextureID);
+	RenderStateBindTexture(kDepthUnit, GL_TEXTURE_2D, target.depthTextureID);
+	glUniform1i(albedoSamplerID, kAlbedoUnit);
+	glUniform1i(normalSamplerID, kNormalUnit);
+	glUniform1i(depthSamplerID, kDepthUnit);
+	glUniformMatrix4fv(inverseViewMatrixID, 1, GL_FALSE, &inverseView[0][0]);
+	glUniform3fv(lightPositionID, 1, &lightPosition[0]);
+	glUniform3fv(lightIntensityID, 1, &lightIntensity[0]);
+	glUniform3fv(ambientLightID, 1, &ambientLight[0]);
+
+	glBindVertexArray(vertexArrayID);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	++gRenderStats.drawCalls;
+	++gRenderStats.triangles;
+	glBindVertexArray(0);
+
+	if (depthTest) glEnable(GL_DEPTH_TEST);
+	glBindFramebuffer(GL_FRAMEBUFFER, target.framebufferID);
+}
@@ -0,0 +1,49 @@
+#ifndef _GBUFFER_H_
+#define _GBUFFER_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+struct ScaledTarget;
+
+// Compact G-buffer for the deferred renderer, 12 bytes per pixel.
+//
+// RGBA8 sRGB-encoded albedo and an RG16F octahedral world-space normal.
+// Depth is the scene target's own depth texture, so the geometry pass fills
+// it for every later pass and positions are rebuilt from it instead of being
+// stored. The lighting pass shades each covered pixel once with a fullscreen
+// triangle, looking the point lights up in the same clusters as the forward
+// path.
+struct GBuffer {
+	GLuint framebufferID = 0;
+	GLuint lightingFramebufferID = 0;	// Target colour only, so depth can be sampled while shading
+	GLuint albedoTextureID = 0;
+	GLuint normalTextureID = 0;
+	GLuint vertexArrayID = 0;		// Empty, the triangle comes from gl_VertexID
+	int allocatedWidth = 0;
+	int allocatedHeight = 0;
+
+	GLuint lightingProgramID = 0;
+	GLuint albedoSamplerID = 0;
+	GLuint normalSamplerID = 0;
+	GLuint depthSamplerID = 0;
+	GLuint inverseViewMatrixID = 0;
+	GLuint lightPositionID = 0;
+	GLuint lightIntensityID = 0;
+	GLuint ambientLightID = 0;
+
+	bool initialize(const char* vertexPath, const char* fragmentPath);
+	void cleanup();
+
+	// Binds the G-buffer over the target's depth for the geometry pass. The
+	// target must already be bound for this frame, which sets the viewport.
+	void begin(const ScaledTarget& target);
+
+	// Shades the G-buffer into the target's colour and leaves the target
+	// bound. The lighting program's cluster uniforms must have been set for
+	// this frame.
+	void light(const ScaledTarget& target, const glm::mat4& viewMatrix, const glm::vec3& lightPosition,
+		const glm::vec3& lightIntensity, const glm::vec3& ambientLight);
+};
+
+#endif
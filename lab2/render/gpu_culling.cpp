@@ -0,0 +1,156 @@
+#include "gpu_culling.h"
+#include "hiz_pyramid.h"
+#include "shader.h"
+#include "render_state.h"
+#include <core/frustum.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+
+bool GpuCuller::initialize(const char* vertexPath, const char* geometryPath,
+	const std::vector<GpuCullInstance>& instances, const std::vector<unsigned int>& rangeCounts) {
+	const char* varyings[] = { "visibleID" };
+	programID = LoadTransformFeedbackShadersFromFile(vertexPath, geometryPath, varyings, 1);
+	if (programID == 0) {
+		std::cerr << "Failed to load GPU culling shaders." << std::endl;
+		return false;
+	}
+	frustumPlanesID = glGetUniformLocation(programID, "frustumPlanes");
+	eyeID = glGetUniformLocation(programID, "eye");
+	drawDistanceID = glGetUniformLocation(programID, "drawDistance");
+	useHiZID = glGetUniformLocation(programID, "useHiZ");
+	hiZID = glGetUniformLocation(programID, "hiZ");
+	hiZViewProjectionID = glGetUniformLocation(programID, "hiZViewProjection");
+	hiZRenderSizeID = glGetUniformLocation(programID, "hiZRenderSize");
+	hiZSizeID = glGetUniformLocation(programID, "hiZSize");
+	hiZLevelsID = glGetUniformLocation(programID, "hiZLevels");
+
+	glGenBuffers(1, &instanceBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceBufferID);
+	glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GpuCullInstance), instances.data(), GL_STATIC_DRAW);
+
+	glGenVertexArrays(1, &vertexArrayID);
+	glBindVertexArray(vertexArrayID);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GpuCullInstance), (void*)offsetof(GpuCullInstance, center));
+	glEnableVertexAttribArray(1);
+	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, sizeof(GpuCullInstance), (void*)offsetof(GpuCullInstance, id));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(GpuCullInstance),
+		(void*)offsetof(GpuCullInstance, halfExtent));
+	glBindVertexArray(0);
+
+	// Every entry starts out as an instance of its own range
+	std::vector<uint32_t> ids(instances.size());
+	for (size_t i = 0; i < instances.size(); ++i) {
+		ids[i] = instances[i].id;
+	}
+	glGenBuffers(1, &visibleBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, visibleBufferID);
+	glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(uint32_t), ids.data(), GL_DYNAMIC_COPY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	ranges.resize(rangeCounts.size());
+	unsigned int first = 0;
+	for (size_t r = 0; r < rangeCounts.size(); ++r) {
+		Range& range = ranges[r];
+		range.first = first;
+		range.count = rangeCounts[r];
+		range.visible = range.count;
+		range.lastVisible = range.count;
+		range.visibleFrame = 0;
+		glGenQueries(kLatency, range.queries);
+		std::fill(range.pending, range.pending + kLatency, false);
+		first += range.count;
+	}
+	return true;
+}
+
+void GpuCuller::cleanup() {
+	for (Range& range : ranges) {
+		glDeleteQueries(kLatency, range.queries);
+	}
+	ranges.clear();
+	glDeleteBuffers(1, &instanceBufferID);
+	glDeleteBuffers(1, &visibleBufferID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(programID);
+}
+
+void GpuCuller::cull(const glm::mat4& viewProjection, const glm::vec3& eye, float drawDistance,
+	const HiZPyramid& hiZ) {
+	// Newest completed counts, oldest frame first so later ones win. Results
+	// not back by the time a slot comes around again are dropped, not waited on.
+	for (unsigned long long age = kLatency - 1; age >= 1; --age) {
+		if (frameIndex < age) continue;
+		int slot = (frameIndex - age) % kLatency;
+		for (Range& range : ranges) {
+			if (!range.pending[slot]) continue;
+			GLuint available = 0;
+			glGetQueryObjectuiv(range.queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) continue;
+			range.lastVisible = range.visible;
+			glGetQueryObjectuiv(range.queries[slot], GL_QUERY_RESULT, &range.visible);
+			range.visibleFrame = frameIndex - age;
+			range.pending[slot] = false;
+		}
+	}
+
+	Frustum frustum(viewProjection);
+	RenderStateUseProgram(programID);
+	glUniform4fv(frustumPlanesID, 6, &frustum.planes[0][0]);
+	glUniform3fv(eyeID, 1, &eye[0]);
+	glUniform1f(drawDistanceID, drawDistance);
+	glUniform1i(useHiZID, hiZ.valid);
+	if (hiZ.valid) {
+		RenderStateBindTexture(0, GL_TEXTURE_2D, hiZ.textureID);
+		glUniform1i(hiZID, 0);
+		glUniformMatrix4fv(hiZViewProjectionID, 1, GL_FALSE, &hiZ.viewProjection[0][0]);
+		glUniform2f(hiZRenderSizeID, (float)hiZ.renderWidth, (float)hiZ.renderHeight);
+		glUniform2i(hiZSizeID, hiZ.width, hiZ.height);
+		glUniform1i(hiZLevelsID, hiZ.levels);
+	}
+
+	// Each range captures into its own part of the visible buffer, which can't
+	// be rebound while feedback is active, so each gets its own begin and end
+	int slot = frameIndex % kLatency;
+	glBindVertexArray(vertexArrayID);
+	glEnable(GL_RASTERIZER_DISCARD);
+	for (Range& range : ranges) {
+		if (range.count == 0) continue;
+		glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, visibleBufferID, range.first * sizeof(uint32_t),
+			range.count * sizeof(uint32_t));
+		glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, range.queries[slot]);
+		glBeginTransformFeedback(GL_POINTS);
+		glDrawArrays(GL_POINTS, range.first, range.count);
+		glEndTransformFeedback();
+		glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+		range.pending[slot] = true;
+		++gRenderStats.drawCalls;
+	}
+	glDisable(GL_RASTERIZER_DISCARD);
+	glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+	glBindVertexArray(0);
+	++frameIndex;
+}
+
+GLsizei GpuCuller::drawCount(size_t range) const {
+	const Range& r = ranges[range];
+	// The count is at best from the frame before the one just culled. Older,
+	// or rising fast, it says little about this frame, so draw everything.
+	bool stale = r.visibleFrame + 2 < frameIndex;
+	bool rising = r.visible > r.lastVisible + r.lastVisible / 8 + 16;
+	if (stale || rising) return static_cast<GLsizei>(r.count);
+	// Headroom for instances coming into view while the count catches up
+	unsigned int count = r.visible + r.visible / 4 + 64;
+	return static_cast<GLsizei>(std::min(count, r.count));
+}
+
+unsigned int GpuCuller::visibleCount() const {
+	unsigned int total = 0;
+	for (const Range& range : ranges) {
+		total += range.visible;
+	}
+	return total;
+}
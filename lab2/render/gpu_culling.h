@@ -0,0 +1,84 @@
+#ifndef _GPU_CULLING_H_
+#define _GPU_CULLING_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+struct HiZPyramid;
+
+// Bounds of one instance as the culling shader reads them
+struct GpuCullInstance {
+	glm::vec3 center;
+	uint32_t id;				// Written out when the instance survives
+	glm::vec3 halfExtent;
+	float padding;
+};
+
+// Instance culling on the GPU for GL 3.3, which has no compute shaders: one
+// point per instance goes through cull.vert, which tests its box against the
+// frustum and against a Hi-Z pyramid of the last frame, and cull.geom emits
+// only the survivors, so transform feedback packs their IDs into a buffer
+// that instanced draws read as a per-instance attribute.
+//
+// Instances are grouped into ranges, one per draw state, each culled into its
+// own part of the visible buffer. How many survived comes back through a
+// query a frame or two later rather than stalling; in the meantime draws use
+// the last count plus headroom, or the whole range when that count is older
+// than the last frame's or jumped up, as when the camera turns quickly.
+// Entries past this frame's survivors hold IDs from earlier frames, or the
+// range's own IDs from startup, so reading them draws real instances of the
+// range, only ones that may be hidden, and the whole range always holds every
+// survivor.
+//
+// glDrawTransformFeedbackInstanced would leave the count on the GPU, but it
+// takes the captured count as vertices rather than instances, and needs GL 4.2.
+struct GpuCuller {
+	static const int kLatency = 3;
+
+	struct Range {
+		unsigned int first;			// In the instance and visible buffers
+		unsigned int count;
+		unsigned int visible;		// Latest count read back
+		unsigned int lastVisible;	// The one before it
+		unsigned long long visibleFrame;	// Frame whose cull gave the latest count
+		GLuint queries[kLatency];
+		bool pending[kLatency];
+	};
+
+	GLuint programID = 0;
+	GLuint vertexArrayID = 0;
+	GLuint instanceBufferID = 0;
+	GLuint visibleBufferID = 0;		// uint IDs, capturing transform feedback
+	GLuint frustumPlanesID = 0;
+	GLuint eyeID = 0;
+	GLuint drawDistanceID = 0;
+	GLuint useHiZID = 0;
+	GLuint hiZID = 0;
+	GLuint hiZViewProjectionID = 0;
+	GLuint hiZRenderSizeID = 0;
+	GLuint hiZSizeID = 0;
+	GLuint hiZLevelsID = 0;
+
+	std::vector<Range> ranges;
+	unsigned long long frameIndex = 0;
+
+	// Instances are ordered by range, rangeCounts giving the size of each
+	bool initialize(const char* vertexPath, const char* geometryPath, const std::vector<GpuCullInstance>& instances,
+		const std::vector<unsigned int>& rangeCounts);
+	void cleanup();
+
+	// Culls every range for this frame. Without a valid pyramid only the
+	// frustum and draw distance are tested.
+	void cull(const glm::mat4& viewProjection, const glm::vec3& eye, float drawDistance, const HiZPyramid& hiZ);
+
+	// Instances to draw from the range's part of the visible buffer
+	GLsizei drawCount(size_t range) const;
+
+	// Sum of the latest counts read back
+	unsigned int visibleCount() const;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "gpu_profiler.h"
+
+#include <core/benchmark.h>
+
+#include <GLFW/glfw3.h>
+#include <cstring>
+#include <iostream>
+
+// KHR_debug and ARB_pipeline_statistics_query are not part of the GL 3.3
+// core loader, so their entry points and enums are declared here.
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+
+typedef void (GLAD_API_PTR *PFNGLPUSHDEBUGGROUPPROC_)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+typedef void (GLAD_API_PTR *PFNGLPOPDEBUGGROUPPROC_)(void);
+
+namespace {
+
+const int kQueryLatency = 4;		// Frames between issuing a query and reading it back
+const int kMaxZonesPerFrame = 32;
+const int kMaxPasses = 32;
+const int kMaxDepth = 16;
+const int kStatCount = 3;
+const GLenum kStatTargets[kStatCount] = {
+	GL_VERTICES_SUBMITTED_ARB,
+	GL_PRIMITIVES_SUBMITTED_ARB,
+	GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+};
+
+struct ZoneQueries {
+	GLuint begin;
+	GLuint end;
+	GLuint stats[kStatCount];
+	bool hasStats;
+	int pass;
+};
+
+struct FrameQueries {
+	ZoneQueries zones[kMaxZonesPerFrame];
+	int zoneCount;
+	bool pending;
+};
+
+bool initialized = false;
+bool hasPipelineStats = false;
+PFNGLPUSHDEBUGGROUPPROC_ pushDebugGroup = nullptr;
+PFNGLPOPDEBUGGROUPPROC_ popDebugGroup = nullptr;
+
+FrameQueries frames[kQueryLatency];
+unsigned long long frameIndex = 0;
+unsigned long long droppedFrames = 0;
+
+int zoneStack[kMaxDepth];
+int stackDepth = 0;
+int overflowDepth = 0;
+
+GpuPassStats passes[kMaxPasses];
+int passCount = 0;
+double lastFrameMs = 0.0;
+
+int FindPass(const char* name) {
+	for (int i = 0; i < passCount; ++i) {
+		if (passes[i].name == name || strcmp(passes[i].name, name) == 0) return i;
+	}
+	if (passCount == kMaxPasses) return -1;
+	GpuPassStats& pass = passes[passCount];
+	memset(&pass, 0, sizeof(pass));
+	pass.name = name;
+	return passCount++;
+}
+
+FrameQueries& CurrentFrame() {
+	return frames[frameIndex % kQueryLatency];
+}
+
+// Reads back a frame issued kQueryLatency frames ago, or skips it if the GPU
+// is even further behind than that.
+void CollectFrame(FrameQueries& frame) {
+	if (!frame.pending) return;
+	frame.pending = false;
+	if (frame.zoneCount == 0) return;
+
+	GLuint available = 0;
+	glGetQueryObjectuiv(frame.zones[frame.zoneCount - 1].end, GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		++droppedFrames;
+		return;
+	}
+
+	GLuint64 frameBegin = 0, frameEnd = 0;
+	for (int i = 0; i < frame.zoneCount; ++i) {
+		ZoneQueries& zone = frame.zones[i];
+		GLuint64 begin = 0, end = 0;
+		glGetQueryObjectui64v(zone.begin, GL_QUERY_RESULT, &begin);
+		glGetQueryObjectui64v(zone.end, GL_QUERY_RESULT, &end);
+		if (i == 0) frameBegin = begin;
+		if (end > frameEnd) frameEnd = end;
+
+		GpuPassStats& pass = passes[zone.pass];
+		pass.lastMs = (end - begin) * 1e-6;
+		pass.averageMs = pass.samples == 0 ? pass.lastMs : pass.averageMs * 0.95 + pass.lastMs * 0.05;
+		++pass.samples;
+
+		if (zone.hasStats) {
+			GLuint64 counts[kStatCount];
+			for (int s = 0; s < kStatCount; ++s) {
+				glGetQueryObjectui64v(zone.stats[s], GL_QUERY_RESULT, &counts[s]);
+			}
+			pass.verticesSubmitted = static_cast<double>(counts[0]);
+			pass.primitivesSubmitted = static_cast<double>(counts[1]);
+			pass.fragmentInvocations = static_cast<double>(counts[2]);
+		}
+	}
+	lastFrameMs = frameEnd > frameBegin ? (frameEnd - frameBegin) * 1e-6 : 0.0;
+}
+
+} // namespace
+
+void GpuProfilerInit() {
+	for (int f = 0; f < kQueryLatency; ++f) {
+		for (int z = 0; z < kMaxZonesPerFrame; ++z) {
+			ZoneQueries& zone = frames[f].zones[z];
+			glGenQueries(1, &zone.begin);
+			glGenQueries(1, &zone.end);
+			glGenQueries(kStatCount, zone.stats);
+		}
+		frames[f].zoneCount = 0;
+		frames[f].pending = false;
+	}
+
+	if (glfwExtensionSupported("GL_KHR_debug")) {
+		pushDebugGroup = (PFNGLPUSHDEBUGGROUPPROC_)glfwGetProcAddress("glPushDebugGroup");
+		popDebugGroup = (PFNGLPOPDEBUGGROUPPROC_)glfwGetProcAddress("glPopDebugGroup");
+		if (!pushDebugGroup || !popDebugGroup) pushDebugGroup = nullptr;
+	}
+	hasPipelineStats = glfwExtensionSupported("GL_ARB_pipeline_statistics_query") != 0;
+
+	std::cout << "GPU profiler: debug groups " << (pushDebugGroup ? "on" : "off")
+		<< ", pipeline statistics " << (hasPipelineStats ? "on" : "off") << std::endl;
+	initialized = true;
+}
+
+void GpuProfilerCleanup() {
+	if (!initialized) return;
+	for (int f = 0; f < kQueryLatency; ++f) {
+		for (int z = 0; z < kMaxZonesPerFrame; ++z) {
+			ZoneQueries& zone = frames[f].zones[z];
+			glDeleteQueries(1, &zone.begin);
+			glDeleteQueries(1, &zone.end);
+			glDeleteQueries(kStatCount, zone.stats);
+		}
+	}
+	initialized = false;
+}
+
+void GpuProfilerBeginFrame() {
+	if (!initialized) return;
+	FrameQueries& frame = CurrentFrame();
+	CollectFrame(frame);
+	frame.zoneCount = 0;
+	stackDepth = 0;
+	overflowDepth = 0;
+}
+
+void GpuProfilerEndFrame() {
+	if (!initialized) return;
+	CurrentFrame().pending = true;
+	++frameIndex;
+}
+
+void GpuZoneBegin(const char* name) {
+	if (pushDebugGroup) pushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+	if (!initialized) return;
+	if (stackDepth == kMaxDepth) {
+		++overflowDepth;
+		return;
+	}
+
+	// Zones past the per-frame limit still balance the stack but are not timed
+	FrameQueries& frame = CurrentFrame();
+	int pass = FindPass(name);
+	int zoneIndex = -1;
+	if (frame.zoneCount < kMaxZonesPerFrame && pass >= 0) {
+		zoneIndex = frame.zoneCount++;
+		ZoneQueries& zone = frame.zones[zoneIndex];
+		zone.pass = pass;
+		// Statistics queries of one target cannot be nested, so only outermost zones count
+		zone.hasStats = hasPipelineStats && stackDepth == 0;
+
+		glQueryCounter(zone.begin, GL_TIMESTAMP);
+		if (zone.hasStats) {
+			for (int s = 0; s < kStatCount; ++s) glBeginQuery(kStatTargets[s], zone.stats[s]);
+		}
+	}
+	zoneStack[stackDepth++] = zoneIndex;
+}
+
+void GpuZoneEnd() {
+	if (initialized) {
+		if (overflowDepth > 0) {
+			--overflowDepth;
+		}
+		else if (stackDepth > 0) {
+			int zoneIndex = zoneStack[--stackDepth];
+			if (zoneIndex >= 0) {
+				ZoneQueries& zone = CurrentFrame().zones[zoneIndex];
+				if (zone.hasStats) {
+					for (int s = 0; s < kStatCount; ++s) glEndQuery(kStatTargets[s]);
+				}
+				glQueryCounter(zone.end, GL_TIMESTAMP);
+			}
+		}
+	}
+	if (pushDebugGroup) popDebugGroup();
+}
+
+double GpuProfilerFrameMs() {
+	return lastFrameMs;
+}
+
+int GpuProfilerPassCount() {
+	return passCount;
+}
+
+const GpuPassStats& GpuProfilerPass(int index) {
+	return passes[index];
+}
+
+double GpuProfilerPassMs(const char* name) {
+	for (int i = 0; i < passCount; ++i) {
+		if (strcmp(passes[i].name, name) == 0) return passes[i].lastMs;
+	}
+	return 0.0;
+}
+
+void GpuProfilerReport() {
+	for (int i = 0; i < passCount; ++i) {
+		const GpuPassStats& pass = passes[i];
+		std::string section = std::string("gpu.") + pass.name;
+		BenchmarkSet(section, "average_ms", pass.averageMs);
+		BenchmarkSet(section, "samples", static_cast<double>(pass.samples));
+		if (hasPipelineStats) {
+			BenchmarkSet(section, "vertices_submitted", pass.verticesSubmitted);
+			BenchmarkSet(section, "primitives_submitted", pass.primitivesSubmitted);
+			BenchmarkSet(section, "fragment_invocations", pass.fragmentInvocations);
+		}
+	}
+	BenchmarkSet("gpu", "frames_not_ready", static_cast<double>(droppedFrames));
+}
@@ -0,0 +1,59 @@
+#ifndef _GPU_PROFILER_H_
+#define _GPU_PROFILER_H_
+
+#include <glad/gl.h>
+
+// GPU timing per render pass.
+//
+// Each zone brackets its commands with a pair of GL_TIMESTAMP queries, so
+// zones may nest. Queries live in a ring several frames deep and are read
+// back only once GL_QUERY_RESULT_AVAILABLE says they are done, so the CPU
+// never waits on the GPU. Zones also push a KHR_debug group when the driver
+// has it, which makes the passes show up by name in RenderDoc and Nsight.
+// With ARB_pipeline_statistics_query, outermost zones additionally count
+// vertices, primitives and fragment shader invocations.
+
+struct GpuPassStats {
+	const char* name;
+	double lastMs;
+	double averageMs;			// Exponential moving average
+	double verticesSubmitted;
+	double primitivesSubmitted;
+	double fragmentInvocations;
+	unsigned long long samples;
+};
+
+// Must be called after the GL context is current and glad is loaded
+void GpuProfilerInit();
+void GpuProfilerCleanup();
+
+// Frame boundaries, once per frame around all the zones
+void GpuProfilerBeginFrame();
+void GpuProfilerEndFrame();
+
+void GpuZoneBegin(const char* name);
+void GpuZoneEnd();
+
+// Time from the first zone's start to the last zone's end in the most recent
+// frame read back, or 0 before any frame has been
+double GpuProfilerFrameMs();
+
+int GpuProfilerPassCount();
+const GpuPassStats& GpuProfilerPass(int index);
+
+// Last read-back time of the named zone, or 0 if it has none yet
+double GpuProfilerPassMs(const char* name);
+
+// Pushes the per-pass averages into the benchmark report
+void GpuProfilerReport();
+
+struct GpuScope {
+	explicit GpuScope(const char* name) { GpuZoneBegin(name); }
+	~GpuScope() { GpuZoneEnd(); }
+};
+
+#define GPU_ZONE_CONCAT_INNER(a, b) a##b
+#define GPU_ZONE_CONCAT(a, b) GPU_ZONE_CONCAT_INNER(a, b)
+#define GPU_ZONE(name) GpuScope GPU_ZONE_CONCAT(gpuZone, __LINE__)(name)
+
+#endif
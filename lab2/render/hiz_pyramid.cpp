@@ -0,0 +1,113 @@
+#include "hiz_pyramid.h"
+#include "scaled_target.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <algorithm>
+#include <iostream>
+
+bool HiZPyramid::initialize(const char* vertexPath, const char* fragmentPath) {
+	programID = LoadShadersFromFile(vertexPath, fragmentPath);
+	if (programID == 0) {
+		std::cerr << "Failed to load Hi-Z shaders." << std::endl;
+		return false;
+	}
+	sourceSamplerID = glGetUniformLocation(programID, "source");
+	sourceSizeID = glGetUniformLocation(programID, "sourceSize");
+	targetSizeID = glGetUniformLocation(programID, "targetSize");
+
+	glGenVertexArrays(1, &vertexArrayID);
+	glGenTextures(1, &textureID);
+	return true;
+}
+
+void HiZPyramid::cleanup() {
+	if (!framebufferIDs.empty()) glDeleteFramebuffers((GLsizei)framebufferIDs.size(), framebufferIDs.data());
+	glDeleteTextures(1, &textureID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(programID);
+}
+
+void HiZPyramid::build(const ScaledTarget& target, const glm::mat4& viewProjection) {
+	int firstWidth = std::max(1, target.allocatedWidth / 2);
+	int firstHeight = std::max(1, target.allocatedHeight / 2);
+	if (firstWidth != allocatedWidth || firstHeight != allocatedHeight) {
+		allocatedWidth = firstWidth;
+		allocatedHeight = firstHeight;
+
+		int allocatedLevels = 1;
+		while ((std::max(allocatedWidth, allocatedHeight) >> allocatedLevels) > 0) ++allocatedLevels;
+
+		RenderStateBindTexture(0, GL_TEXTURE_2D, textureID);
+		for (int level = 0; level < allocatedLevels; ++level) {
+			glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, std::max(1, allocatedWidth >> level),
+				std::max(1, allocatedHeight >> level), 0, GL_RED, GL_FLOAT, NULL);
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, allocatedLevels - 1);
+
+		if (!framebufferIDs.empty()) glDeleteFramebuffers((GLsizei)framebufferIDs.size(), framebufferIDs.data());
+		framebufferIDs.assign(allocatedLevels, 0);
+		glGenFramebuffers(allocatedLevels, framebufferIDs.data());
+		for (int level = 0; level < allocatedLevels; ++level) {
+			glBindFramebuffer(GL_FRAMEBUFFER, framebufferIDs[level]);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textureID, level);
+			if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+				std::cerr << "Hi-Z level " << level << " is incomplete." << std::endl;
+			}
+		}
+	}
+
+	renderWidth = target.renderWidth;
+	renderHeight = target.renderHeight;
+	width = std::max(1, renderWidth / 2);
+	height = std::max(1, renderHeight / 2);
+	levels = 1;
+	while (std::max(width, height) >> levels > 0) ++levels;
+	this->viewProjection = viewProjection;
+
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+	RenderStateUseProgram(programID);
+	glUniform1i(sourceSamplerID, 0);
+	glBindVertexArray(vertexArrayID);
+
+	// Each level reads the one above it. Limiting the sampled range to that
+	// level keeps the level being written out of it, so the texture is never
+	// read and rendered to at once.
+	int sourceWidth = renderWidth, sourceHeight = renderHeight;
+	int targetWidth = width, targetHeight = height;
+	for (int level = 0; level < levels; ++level) {
+		if (level == 0) {
+			RenderStateBindTexture(0, GL_TEXTURE_2D, target.depthTextureID);
+		}
+		else {
+			RenderStateBindTexture(0, GL_TEXTURE_2D, textureID);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+		}
+		glBindFramebuffer(GL_FRAMEBUFFER, framebufferIDs[level]);
+		glViewport(0, 0, targetWidth, targetHeight);
+		glUniform2i(sourceSizeID, sourceWidth, sourceHeight);
+		glUniform2i(targetSizeID, targetWidth, targetHeight);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		++gRenderStats.drawCalls;
+		++gRenderStats.triangles;
+
+		sourceWidth = targetWidth;
+		sourceHeight = targetHeight;
+		targetWidth = std::max(1, targetWidth / 2);
+		targetHeight = std::max(1, targetHeight / 2);
+	}
+
+	RenderStateBindTexture(0, GL_TEXTURE_2D, textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)framebufferIDs.size() - 1);
+	glBindVertexArray(0);
+	if (depthTest) glEnable(GL_DEPTH_TEST);
+	valid = true;
+}
@@ -0,0 +1,52 @@
+#ifndef _HIZ_PYRAMID_H_
+#define _HIZ_PYRAMID_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct ScaledTarget;
+
+// Hierarchical depth: a mip chain over the scene depth where each texel holds
+// the farthest depth of the area below it, for occlusion tests that read a
+// couple of texels per box instead of every pixel it covers.
+//
+// Level 0 is half the rendered size. Storage follows the scene target's
+// allocation and only the sub-rectangle of the last render is valid, sizes
+// halving and rounding down from there. Built at the end of a frame, it is
+// tested against with that frame's camera during the next.
+struct HiZPyramid {
+	GLuint programID = 0;
+	GLuint vertexArrayID = 0;		// Empty, the triangle comes from gl_VertexID
+	GLuint textureID = 0;			// R32F with the full mip chain
+	std::vector<GLuint> framebufferIDs;	// One per level
+	GLuint sourceSamplerID = 0;
+	GLuint sourceSizeID = 0;
+	GLuint targetSizeID = 0;
+
+	int allocatedWidth = 0;
+	int allocatedHeight = 0;
+
+	// Of the last build
+	bool valid = false;
+	int width = 0;					// Valid texels of level 0
+	int height = 0;
+	int levels = 0;					// Down to 1x1
+	int renderWidth = 0;
+	int renderHeight = 0;
+	glm::mat4 viewProjection;
+
+	bool initialize(const char* vertexPath, const char* fragmentPath);
+	void cleanup();
+
+	// Reduces the target's depth, rendered with the given camera. Leaves the
+	// framebuffer and viewport for the caller to set.
+	void build(const ScaledTarget& target, const glm::mat4& viewProjection);
+
+	// For frames whose depth can't stand in for the next, such as the first
+	// after a jump
+	void invalidate() { valid = false; }
+};
+
+#endif
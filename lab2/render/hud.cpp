@@ -0,0 +1,317 @@
+#include "hud.h"
+#include "hud_font.h"
+#include "shader.h"
+#include "render_state.h"
+#include "gpu_profiler.h"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+
+// Memory info extensions, not exposed by the GL 3.3 core loader
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+
+namespace {
+
+const int kAtlasColumns = 16;
+const int kAtlasRows = 6;
+const int kAtlasWidth = kAtlasColumns * kHudFontCellWidth;
+const int kAtlasHeight = kAtlasRows * kHudFontCellHeight;
+const int kSolidCell = kHudFontCharCount;		// Fully covered cell used for panels and bars
+
+const int kMemoryNone = 0;
+const int kMemoryNvx = 1;
+const int kMemoryAti = 2;
+
+const float kGraphBudgetMs = 33.3f;
+
+const char* hudVertexShader = R"(
+#version 330 core
+layout(location = 0) in vec2 vertexPosition;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec4 vertexColor;
+
+uniform vec2 screenSize;
+
+out vec2 uv;
+out vec4 color;
+
+void main() {
+	// Pixel coordinates with the origin at the top left
+	vec2 ndc = vertexPosition / screenSize * 2.0 - 1.0;
+	gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+	uv = vertexUV;
+	color = vertexColor;
+}
+)";
+
+const char* hudFragmentShader = R"(
+#version 330 core
+in vec2 uv;
+in vec4 color;
+
+uniform sampler2D atlas;
+
+out vec4 finalColor;
+
+void main() {
+	finalColor = vec4(color.rgb, color.a * texture(atlas, uv).r);
+}
+)";
+
+const unsigned char kPanelColor[4] = { 0, 0, 0, 160 };
+const unsigned char kTextColor[4] = { 255, 255, 255, 255 };
+const unsigned char kDimColor[4] = { 180, 180, 180, 255 };
+const unsigned char kGoodColor[4] = { 80, 220, 80, 255 };
+const unsigned char kWarnColor[4] = { 240, 200, 40, 255 };
+const unsigned char kBadColor[4] = { 240, 60, 60, 255 };
+
+void CellUV(int cell, float& u0, float& v0, float& u1, float& v1) {
+	int column = cell % kAtlasColumns;
+	int row = cell / kAtlasColumns;
+	u0 = column * kHudFontCellWidth / (float)kAtlasWidth;
+	v0 = row * kHudFontCellHeight / (float)kAtlasHeight;
+	u1 = (column + 1) * kHudFontCellWidth / (float)kAtlasWidth;
+	v1 = (row + 1) * kHudFontCellHeight / (float)kAtlasHeight;
+}
+
+} // namespace
+
+void Hud::initialize() {
+	programID = LoadShadersFromString(hudVertexShader, hudFragmentShader);
+	screenSizeID = glGetUniformLocation(programID, "screenSize");
+	atlasSamplerID = glGetUniformLocation(programID, "atlas");
+
+	// Expand the 1-bit font into a single channel atlas, plus one solid cell
+	std::vector<unsigned char> pixels(kAtlasWidth * kAtlasHeight, 0);
+	for (int cell = 0; cell <= kSolidCell; ++cell) {
+		int originX = (cell % kAtlasColumns) * kHudFontCellWidth;
+		int originY = (cell / kAtlasColumns) * kHudFontCellHeight;
+		for (int y = 0; y < kHudFontCellHeight; ++y) {
+			unsigned char bits = cell == kSolidCell ? 0xff : kHudFont[cell][y];
+			for (int x = 0; x < kHudFontCellWidth; ++x) {
+				if (bits & (0x80 >> x)) pixels[(originY + y) * kAtlasWidth + originX + x] = 255;
+			}
+		}
+	}
+
+	glGenTextures(1, &atlasID);
+	glBindTexture(GL_TEXTURE_2D, atlasID);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, kAtlasWidth, kAtlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	RenderStateInvalidate();
+
+	glGenVertexArrays(1, &vertexArrayID);
+	glBindVertexArray(vertexArrayID);
+	glGenBuffers(1, &vertexBufferID);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(HudVertex), (void*)offsetof(HudVertex, u));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(HudVertex), (void*)offsetof(HudVertex, color));
+	glBindVertexArray(0);
+
+	if (glfwExtensionSupported("GL_NVX_gpu_memory_info")) memoryQuery = kMemoryNvx;
+	else if (glfwExtensionSupported("GL_ATI_meminfo")) memoryQuery = kMemoryAti;
+
+	vertices.reserve(4096);
+}
+
+void Hud::addFrameTime(float milliseconds) {
+	frameTimes[frameTimeHead] = milliseconds;
+	frameTimeHead = (frameTimeHead + 1) % kHistory;
+}
+
+void Hud::addStatusLine(const std::string& text) {
+	statusLines.push_back(text);
+}
+
+void Hud::addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const unsigned char color[4]) {
+	HudVertex corners[4] = {
+		{ x0, y0, u0, v0, { color[0], color[1], color[2], color[3] } },
+		{ x1, y0, u1, v0, { color[0], color[1], color[2], color[3] } },
+		{ x1, y1, u1, v1, { color[0], color[1], color[2], color[3] } },
+		{ x0, y1, u0, v1, { color[0], color[1], color[2], color[3] } },
+	};
+	vertices.push_back(corners[0]);
+	vertices.push_back(corners[1]);
+	vertices.push_back(corners[2]);
+	vertices.push_back(corners[0]);
+	vertices.push_back(corners[2]);
+	vertices.push_back(corners[3]);
+}
+
+void Hud::addRect(float x0, float y0, float x1, float y1, const unsigned char color[4]) {
+	float u0, v0, u1, v1;
+	CellUV(kSolidCell, u0, v0, u1, v1);
+	// Sample the middle of the solid cell so filtering never reaches a neighbour
+	float uc = (u0 + u1) * 0.5f, vc = (v0 + v1) * 0.5f;
+	addQuad(x0, y0, x1, y1, uc, vc, uc, vc, color);
+}
+
+void Hud::addText(float x, float y, const char* text, const unsigned char color[4]) {
+	for (const char* c = text; *c; ++c) {
+		int cell = *c - kHudFontFirstChar;
+		if (cell > 0 && cell < kHudFontCharCount) {
+			float u0, v0, u1, v1;
+			CellUV(cell, u0, v0, u1, v1);
+			addQuad(x, y, x + kHudFontCellWidth, y + kHudFontCellHeight, u0, v0, u1, v1, color);
+		}
+		x += kHudFontCellWidth;
+	}
+}
+
+void Hud::render(int width, int height) {
+	if (!visible) {
+		statusLines.clear();
+		return;
+	}
+
+	if (memoryQuery != kMemoryNone && framesSinceMemoryQuery-- <= 0) {
+		framesSinceMemoryQuery = 30;
+		GLint values[4] = { 0, 0, 0, 0 };
+		if (memoryQuery == kMemoryNvx) {
+			glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, values);
+			gpuMemoryTotal = values[0] / 1024.0f;
+			glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, values);
+			gpuMemoryAvailable = values[0] / 1024.0f;
+		}
+		else {
+			glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, values);
+			gpuMemoryAvailable = values[0] / 1024.0f;
+		}
+	}
+
+	float averageMs = 0.0f;
+	for (int i = 0; i < kHistory; ++i) averageMs += frameTimes[i];
+	averageMs /= kHistory;
+
+	vertices.clear();
+	const float margin = 8.0f;
+	const float line = (float)kHudFontCellHeight;
+	const float minPanelWidth = 300.0f;
+	const float graphHeight = 60.0f;
+	int passCount = GpuProfilerPassCount();
+
+	// The panel is drawn under the text, so its quad goes first; its right
+	// and bottom edges are moved out to the widest and last lines once every
+	// line is laid out
+	size_t panelFirst = vertices.size();
+	addRect(margin, margin, margin, margin, kPanelColor);
+
+	char text[128];
+	float x = margin * 2, y = margin * 2;
+	snprintf(text, sizeof(text), "FPS %.1f  (%.2f ms)", averageMs > 0.0f ? 1000.0f / averageMs : 0.0f, averageMs);
+	addText(x, y, text, kTextColor);
+	y += line;
+
+	// Room for the frame-time graph, drawn once the panel's width is known
+	float graphBottom = y + graphHeight;
+	y = graphBottom + margin;
+
+	snprintf(text, sizeof(text), "Draw calls %u  Triangles %llu", gRenderStats.drawCalls, gRenderStats.triangles);
+	addText(x, y, text, kTextColor);
+	y += line;
+	snprintf(text, sizeof(text), "State changes elided %u", gRenderStats.stateChangesElided);
+	addText(x, y, text, kTextColor);
+	y += line;
+	snprintf(text, sizeof(text), "Visible %u  Culled %u", gRenderStats.visibleObjects, gRenderStats.culledObjects);
+	addText(x, y, text, kTextColor);
+	y += line;
+	if (gRenderStats.meshletsTested > 0) {
+		snprintf(text, sizeof(text), "Meshlets %u  Culled %u", gRenderStats.meshletsTested, gRenderStats.meshletsCulled);
+		addText(x, y, text, kTextColor);
+		y += line;
+	}
+	if (memoryQuery == kMemoryNvx) {
+		snprintf(text, sizeof(text), "GPU memory %.0f / %.0f MB free", gpuMemoryAvailable, gpuMemoryTotal);
+	}
+	else if (memoryQuery == kMemoryAti) {
+		snprintf(text, sizeof(text), "GPU memory %.0f MB free", gpuMemoryAvailable);
+	}
+	else {
+		snprintf(text, sizeof(text), "GPU memory n/a");
+	}
+	addText(x, y, text, kTextColor);
+	y += line;
+
+	for (int i = 0; i < passCount; ++i) {
+		const GpuPassStats& pass = GpuProfilerPass(i);
+		snprintf(text, sizeof(text), "GPU %-12s %6.3f ms", pass.name, pass.averageMs);
+		addText(x, y, text, kDimColor);
+		y += line;
+	}
+	for (const std::string& status : statusLines) {
+		addText(x, y, status.c_str(), kTextColor);
+		y += line;
+	}
+	statusLines.clear();
+	// Right edge of the widest line's last glyph. The panel starts a margin in
+	// and ends a margin past it, so that edge is also the panel's width.
+	float textRight = 0.0f;
+	for (size_t i = panelFirst + 6; i < vertices.size(); ++i) {
+		textRight = std::max(textRight, vertices[i].x);
+	}
+	float panelWidth = std::max(minPanelWidth, textRight);
+	// Corners 1 and 2 of the quad, then corners 2 and 3, see addQuad
+	const size_t rightVertices[3] = { 1, 2, 4 };
+	for (size_t i : rightVertices) {
+		vertices[panelFirst + i].x = margin + panelWidth;
+	}
+	const size_t bottomVertices[3] = { 2, 4, 5 };
+	for (size_t i : bottomVertices) {
+		vertices[panelFirst + i].y = y + margin;
+	}
+
+	// Frame-time graph across the panel, newest sample on the right
+	float barWidth = (panelWidth - 2 * margin) / kHistory;
+	addRect(x, graphBottom - graphHeight * (16.7f / kGraphBudgetMs), x + panelWidth - 2 * margin,
+		graphBottom - graphHeight * (16.7f / kGraphBudgetMs) + 1.0f, kDimColor);
+	for (int i = 0; i < kHistory; ++i) {
+		float ms = frameTimes[(frameTimeHead + i) % kHistory];
+		float h = graphHeight * (ms < kGraphBudgetMs ? ms : kGraphBudgetMs) / kGraphBudgetMs;
+		const unsigned char* color = ms < 16.7f ? kGoodColor : (ms < kGraphBudgetMs ? kWarnColor : kBadColor);
+		addRect(x + i * barWidth, graphBottom - h, x + (i + 1) * barWidth, graphBottom, color);
+	}
+
+	// Stream the vertices, orphaning last frame's storage so the driver never waits on it
+	glBindVertexArray(vertexArrayID);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBufferID);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(HudVertex), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(HudVertex), vertices.data());
+
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean cullFace = glIsEnabled(GL_CULL_FACE);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	RenderStateUseProgram(programID);
+	RenderStateBindTexture(0, GL_TEXTURE_2D, atlasID);
+	glUniform1i(atlasSamplerID, 0);
+	glUniform2f(screenSizeID, (float)width, (float)height);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertices.size());
+
+	glDisable(GL_BLEND);
+	if (depthTest) glEnable(GL_DEPTH_TEST);
+	if (cullFace) glEnable(GL_CULL_FACE);
+	glBindVertexArray(0);
+}
+
+void Hud::cleanup() {
+	glDeleteBuffers(1, &vertexBufferID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteTextures(1, &atlasID);
+	glDeleteProgram(programID);
+}
@@ -0,0 +1,53 @@
+#ifndef _HUD_H_
+#define _HUD_H_
+
+#include <glad/gl.h>
+#include <string>
+#include <vector>
+
+// Performance overlay drawn on top of the frame.
+//
+// All text and the frame-time graph are quads into one glyph atlas, built on
+// the CPU into a single streamed vertex buffer and drawn with one call.
+
+struct HudVertex {
+	float x, y;
+	float u, v;
+	unsigned char color[4];
+};
+
+struct Hud {
+	static const int kHistory = 120;
+
+	bool visible = false;
+
+	GLuint programID = 0;
+	GLuint vertexArrayID = 0;
+	GLuint vertexBufferID = 0;
+	GLuint atlasID = 0;
+	GLuint screenSizeID = 0;
+	GLuint atlasSamplerID = 0;
+
+	std::vector<HudVertex> vertices;
+	std::vector<std::string> statusLines;		// Extra lines for this frame only
+	float frameTimes[kHistory] = {};
+	int frameTimeHead = 0;
+
+	// GPU memory in MB, queried every so often since the query can be slow
+	int memoryQuery = 0;
+	float gpuMemoryTotal = 0.0f;
+	float gpuMemoryAvailable = 0.0f;
+	int framesSinceMemoryQuery = 0;
+
+	void initialize();
+	void addFrameTime(float milliseconds);
+	void addStatusLine(const std::string& text);
+	void render(int width, int height);
+	void cleanup();
+
+	void addQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1, const unsigned char color[4]);
+	void addRect(float x0, float y0, float x1, float y1, const unsigned char color[4]);
+	void addText(float x, float y, const char* text, const unsigned char color[4]);
+};
+
+#endif
@@ -0,0 +1,110 @@
+#ifndef _HUD_FONT_H_
+#define _HUD_FONT_H_
+
+// 8x16 bitmap glyphs for printable ASCII (32-126), one byte per row with the
+// most significant bit on the left. Rasterized from Source Code Pro (SIL OFL).
+
+const int kHudFontFirstChar = 32;
+const int kHudFontCharCount = 95;
+const int kHudFontCellWidth = 8;
+const int kHudFontCellHeight = 16;
+
+static const unsigned char kHudFont[kHudFontCharCount][kHudFontCellHeight] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// space
+	{ 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x10, 0x10, 0x10, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 },	// !
+	{ 0x00, 0x00, 0x00, 0x00, 0x24, 0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// "
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x14, 0x04, 0x7e, 0x24, 0x7e, 0x28, 0x28, 0x28, 0x00, 0x00, 0x00 },	// #
+	{ 0x00, 0x00, 0x00, 0x10, 0x10, 0x3c, 0x64, 0x20, 0x1c, 0x06, 0x66, 0x3c, 0x10, 0x10, 0x00, 0x00 },	// $
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x62, 0x96, 0xd4, 0x60, 0x0e, 0x2a, 0x4a, 0x4e, 0x00, 0x00, 0x00 },	// %
+	{ 0x00, 0x00, 0x00, 0x00, 0x38, 0x28, 0x28, 0x30, 0x32, 0x52, 0xce, 0x4e, 0x7a, 0x00, 0x00, 0x00 },	// &
+	{ 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// '
+	{ 0x00, 0x00, 0x00, 0x04, 0x08, 0x18, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x08, 0x04, 0x00 },	// (
+	{ 0x00, 0x00, 0x00, 0x20, 0x30, 0x10, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x10, 0x30, 0x20, 0x00 },	// )
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x3c, 0x18, 0x38, 0x24, 0x00, 0x00, 0x00, 0x00 },	// *
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x7e, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00 },	// +
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x08, 0x18, 0x10 },	// ,
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// -
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 },	// .
+	{ 0x00, 0x00, 0x00, 0x00, 0x04, 0x04, 0x0c, 0x08, 0x08, 0x18, 0x10, 0x10, 0x20, 0x20, 0x60, 0x00 },	// /
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x64, 0x42, 0x5a, 0x5a, 0x42, 0x64, 0x3c, 0x00, 0x00, 0x00 },	// 0
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x18, 0x08, 0x08, 0x08, 0x08, 0x08, 0x7e, 0x00, 0x00, 0x00 },	// 1
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x44, 0x04, 0x04, 0x08, 0x10, 0x20, 0x7e, 0x00, 0x00, 0x00 },	// 2
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x44, 0x04, 0x18, 0x04, 0x06, 0x46, 0x3c, 0x00, 0x00, 0x00 },	// 3
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x1c, 0x14, 0x24, 0x44, 0xfe, 0x04, 0x04, 0x00, 0x00, 0x00 },	// 4
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x60, 0x60, 0x7c, 0x06, 0x02, 0x46, 0x3c, 0x00, 0x00, 0x00 },	// 5
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x1c, 0x20, 0x40, 0x5c, 0x66, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 },	// 6
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x04, 0x0c, 0x08, 0x18, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 },	// 7
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x26, 0x3c, 0x6c, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 },	// 8
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x38, 0x64, 0x42, 0x46, 0x3e, 0x06, 0x44, 0x38, 0x00, 0x00, 0x00 },	// 9
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 },	// :
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x18, 0x18, 0x08, 0x18, 0x10 },	// ;
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x0c, 0x30, 0x60, 0x30, 0x0c, 0x04, 0x00, 0x00, 0x00, 0x00 },	// <
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x00, 0x7e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// =
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x40, 0x30, 0x0c, 0x04, 0x0c, 0x30, 0x40, 0x00, 0x00, 0x00, 0x00 },	// >
+	{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x24, 0x04, 0x0c, 0x18, 0x10, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00 },	// ?
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x62, 0x42, 0x4e, 0x5a, 0x52, 0x5e, 0x40, 0x20, 0x1c, 0x00 },	// @
+	{ 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x38, 0x24, 0x24, 0x7c, 0x46, 0x42, 0xc2, 0x00, 0x00, 0x00 },	// A
+	{ 0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x66, 0x64, 0x7c, 0x66, 0x62, 0x66, 0x7c, 0x00, 0x00, 0x00 },	// B
+	{ 0x00, 0x00, 0x00, 0x00, 0x1c, 0x22, 0x60, 0x40, 0x40, 0x40, 0x60, 0x22, 0x1c, 0x00, 0x00, 0x00 },	// C
+	{ 0x00, 0x00, 0x00, 0x00, 0x78, 0x44, 0x46, 0x42, 0x42, 0x42, 0x46, 0x44, 0x78, 0x00, 0x00, 0x00 },	// D
+	{ 0x00, 0x00, 0x00, 0x00, 0x7e, 0x60, 0x60, 0x60, 0x7c, 0x60, 0x60, 0x60, 0x7e, 0x00, 0x00, 0x00 },	// E
+	{ 0x00, 0x00, 0x00, 0x00, 0x3e, 0x20, 0x20, 0x20, 0x3c, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00 },	// F
+	{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x62, 0x40, 0x40, 0x4e, 0x42, 0x42, 0x62, 0x3c, 0x00, 0x00, 0x00 },	// G
+	{ 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x7e, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 },	// H
+	{ 0x00, 0x00, 0x00, 0x00, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7e, 0x00, 0x00, 0x00 },	// I
+	{ 0x00, 0x00, 0x00, 0x00, 0x3e, 0x06, 0x06, 0x06, 0x06, 0x06, 0x04, 0x44, 0x38, 0x00, 0x00, 0x00 },	// J
+	{ 0x00, 0x00, 0x00, 0x00, 0x46, 0x44, 0x48, 0x78, 0x78, 0x6c, 0x44, 0x46, 0x42, 0x00, 0x00, 0x00 },	// K
+	{ 0x00, 0x00, 0x00, 0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x3e, 0x00, 0x00, 0x00 },	// L
+	{ 0x00, 0x00, 0x00, 0x00, 0x66, 0x66, 0x66, 0x6e, 0x5a, 0x5a, 0x52, 0x42, 0x42, 0x00, 0x00, 0x00 },	// M
+	{ 0x00, 0x00, 0x00, 0x00, 0x62, 0x62, 0x72, 0x52, 0x52, 0x4a, 0x4e, 0x46, 0x46, 0x00, 0x00, 0x00 },	// N
+	{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x42, 0x42, 0x42, 0x64, 0x3c, 0x00, 0x00, 0x00 },	// O
+	{ 0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x62, 0x66, 0x7c, 0x60, 0x60, 0x60, 0x60, 0x00, 0x00, 0x00 },	// P
+	{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x42, 0x42, 0x42, 0x64, 0x3c, 0x08, 0x0e, 0x00 },	// Q
+	{ 0x00, 0x00, 0x00, 0x00, 0x7c, 0x46, 0x42, 0x46, 0x7c, 0x48, 0x44, 0x46, 0x42, 0x00, 0x00, 0x00 },	// R
+	{ 0x00, 0x00, 0x00, 0x00, 0x3c, 0x64, 0x60, 0x30, 0x1c, 0x06, 0x02, 0x66, 0x3c, 0x00, 0x00, 0x00 },	// S
+	{ 0x00, 0x00, 0x00, 0x00, 0xfe, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 },	// T
+	{ 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x46, 0x64, 0x3c, 0x00, 0x00, 0x00 },	// U
+	{ 0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x66, 0x64, 0x24, 0x24, 0x38, 0x18, 0x18, 0x00, 0x00, 0x00 },	// V
+	{ 0x00, 0x00, 0x00, 0x00, 0x83, 0xc3, 0xc2, 0x5a, 0x5a, 0x5a, 0x6e, 0x66, 0x66, 0x00, 0x00, 0x00 },	// W
+	{ 0x00, 0x00, 0x00, 0x00, 0x46, 0x24, 0x2c, 0x18, 0x18, 0x38, 0x2c, 0x64, 0x42, 0x00, 0x00, 0x00 },	// X
+	{ 0x00, 0x00, 0x00, 0x00, 0x42, 0x46, 0x24, 0x2c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00 },	// Y
+	{ 0x00, 0x00, 0x00, 0x00, 0x7e, 0x06, 0x04, 0x08, 0x18, 0x10, 0x20, 0x60, 0x7e, 0x00, 0x00, 0x00 },	// Z
+	{ 0x00, 0x00, 0x00, 0x00, 0x1e, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x00 },	// [
+	{ 0x00, 0x00, 0x00, 0x00, 0x60, 0x20, 0x20, 0x10, 0x10, 0x18, 0x08, 0x08, 0x0c, 0x04, 0x04, 0x00 },	// backslash
+	{ 0x00, 0x00, 0x00, 0x00, 0x78, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x78, 0x00 },	// ]
+	{ 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x28, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// ^
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x00 },	// _
+	{ 0x00, 0x00, 0x00, 0x00, 0x10, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// `
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x06, 0x3e, 0x66, 0x46, 0x3e, 0x00, 0x00, 0x00 },	// a
+	{ 0x00, 0x00, 0x00, 0x00, 0x40, 0x40, 0x40, 0x7c, 0x66, 0x42, 0x42, 0x66, 0x7c, 0x00, 0x00, 0x00 },	// b
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x62, 0x40, 0x40, 0x62, 0x3c, 0x00, 0x00, 0x00 },	// c
+	{ 0x00, 0x00, 0x00, 0x00, 0x06, 0x06, 0x06, 0x3e, 0x66, 0x46, 0x46, 0x66, 0x3e, 0x00, 0x00, 0x00 },	// d
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x62, 0x7e, 0x40, 0x60, 0x3c, 0x00, 0x00, 0x00 },	// e
+	{ 0x00, 0x00, 0x00, 0x00, 0x0e, 0x18, 0x10, 0x7e, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00 },	// f
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x64, 0x64, 0x3c, 0x60, 0x3e, 0x42, 0x42, 0x3c },	// g
+	{ 0x00, 0x00, 0x00, 0x00, 0x40, 0x40, 0x40, 0x5c, 0x66, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 },	// h
+	{ 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x00, 0x78, 0x08, 0x08, 0x08, 0x08, 0x08, 0x00, 0x00, 0x00 },	// i
+	{ 0x00, 0x00, 0x00, 0x00, 0x08, 0x08, 0x00, 0x78, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x70 },	// j
+	{ 0x00, 0x00, 0x00, 0x00, 0x60, 0x60, 0x60, 0x66, 0x6c, 0x78, 0x6c, 0x64, 0x62, 0x00, 0x00, 0x00 },	// k
+	{ 0x00, 0x00, 0x00, 0x00, 0x70, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x0e, 0x00, 0x00, 0x00 },	// l
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x5a, 0x5a, 0x5a, 0x5a, 0x5a, 0x00, 0x00, 0x00 },	// m
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5c, 0x66, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00 },	// n
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x66, 0x42, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00 },	// o
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7c, 0x66, 0x42, 0x42, 0x66, 0x7c, 0x40, 0x40, 0x40 },	// p
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3e, 0x66, 0x46, 0x46, 0x66, 0x3e, 0x06, 0x06, 0x06 },	// q
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x2e, 0x30, 0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00 },	// r
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x64, 0x30, 0x0e, 0x46, 0x3c, 0x00, 0x00, 0x00 },	// s
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x10, 0x7e, 0x10, 0x10, 0x10, 0x10, 0x1e, 0x00, 0x00, 0x00 },	// t
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46, 0x46, 0x46, 0x46, 0x66, 0x3e, 0x00, 0x00, 0x00 },	// u
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x66, 0x24, 0x2c, 0x18, 0x18, 0x00, 0x00, 0x00 },	// v
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x9b, 0xda, 0x5a, 0x5a, 0x66, 0x66, 0x00, 0x00, 0x00 },	// w
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x66, 0x2c, 0x18, 0x18, 0x2c, 0x46, 0x00, 0x00, 0x00 },	// x
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x42, 0x66, 0x24, 0x24, 0x18, 0x18, 0x18, 0x10, 0x60 },	// y
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7e, 0x04, 0x08, 0x10, 0x20, 0x7e, 0x00, 0x00, 0x00 },	// z
+	{ 0x00, 0x00, 0x00, 0x00, 0x0e, 0x18, 0x10, 0x10, 0x10, 0x70, 0x10, 0x10, 0x10, 0x18, 0x0e, 0x00 },	// {
+	{ 0x00, 0x00, 0x00, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10 },	// |
+	{ 0x00, 0x00, 0x00, 0x00, 0x70, 0x18, 0x18, 0x18, 0x18, 0x0c, 0x18, 0x10, 0x18, 0x18, 0x70, 0x00 },	// }
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x32, 0x4c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	// ~
+};
+
+#endif
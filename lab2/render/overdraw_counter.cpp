@@ -0,0 +1,62 @@
+#include "overdraw_counter.h"
+
+void OverdrawCounter::initialize() {
+	glGenQueries(kLatency, depthQueries);
+	glGenQueries(kLatency, shadingQueries);
+}
+
+void OverdrawCounter::cleanup() {
+	glDeleteQueries(kLatency, depthQueries);
+	glDeleteQueries(kLatency, shadingQueries);
+}
+
+bool OverdrawCounter::beginFrame() {
+	int slot = frameIndex % kLatency;
+	bool collected = false;
+	if (pending[slot]) {
+		pending[slot] = false;
+
+		// Skip the frame rather than stall if the GPU is further behind than that
+		GLuint available = 0;
+		glGetQueryObjectuiv(shadingQueries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 shaded = 0;
+			glGetQueryObjectui64v(shadingQueries[slot], GL_QUERY_RESULT, &shaded);
+			shadedSamples = static_cast<double>(shaded);
+			depthSamples = 0.0;
+			overdraw = 0.0f;
+			if (hasDepth[slot]) {
+				GLuint64 depth = 0;
+				glGetQueryObjectui64v(depthQueries[slot], GL_QUERY_RESULT, &depth);
+				depthSamples = static_cast<double>(depth);
+				if (shaded > 0) overdraw = static_cast<float>(depthSamples / shadedSamples);
+			}
+			collected = true;
+		}
+	}
+	hasDepth[slot] = false;
+	return collected;
+}
+
+void OverdrawCounter::beginDepth() {
+	int slot = frameIndex % kLatency;
+	hasDepth[slot] = true;
+	glBeginQuery(GL_SAMPLES_PASSED, depthQueries[slot]);
+}
+
+void OverdrawCounter::endDepth() {
+	glEndQuery(GL_SAMPLES_PASSED);
+}
+
+void OverdrawCounter::beginShading() {
+	glBeginQuery(GL_SAMPLES_PASSED, shadingQueries[frameIndex % kLatency]);
+}
+
+void OverdrawCounter::endShading() {
+	glEndQuery(GL_SAMPLES_PASSED);
+}
+
+void OverdrawCounter::endFrame() {
+	pending[frameIndex % kLatency] = true;
+	++frameIndex;
+}
@@ -0,0 +1,39 @@
+#ifndef _OVERDRAW_COUNTER_H_
+#define _OVERDRAW_COUNTER_H_
+
+#include <glad/gl.h>
+
+// Counts the samples that pass the depth test in the depth pre-pass and in
+// the shading pass with GL_SAMPLES_PASSED occlusion queries.
+//
+// With the pre-pass on, its count is what the shading pass would cost without
+// it, so the ratio of the two is the overdraw the pre-pass removes. Queries
+// are read back a few frames later, once available, like the GPU profiler's.
+struct OverdrawCounter {
+	static const int kLatency = 4;
+
+	GLuint depthQueries[kLatency] = {};
+	GLuint shadingQueries[kLatency] = {};
+	bool hasDepth[kLatency] = {};
+	bool pending[kLatency] = {};
+	unsigned long long frameIndex = 0;
+
+	// Most recent frame read back
+	double depthSamples = 0.0;
+	double shadedSamples = 0.0;
+	float overdraw = 0.0f;			// 0 when that frame had no pre-pass
+
+	void initialize();
+	void cleanup();
+
+	// Collects the frame that last used this slot. Returns true when it had
+	// completed and the counts above were updated.
+	bool beginFrame();
+	void beginDepth();
+	void endDepth();
+	void beginShading();
+	void endShading();
+	void endFrame();
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "post_process.h"
+#include "scaled_target.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const char* postVertexShader = R"(
+#version 330 core
+out vec2 uv;
+
+void main() {
+	// One triangle covering the screen, uv 0 to 1 across the visible part
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	uv = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* postFragmentShader = R"(
+#version 330 core
+in vec2 uv;
+
+uniform sampler2D source;
+uniform vec2 uvScale;		// Rendered rectangle over allocated size
+uniform vec2 texelSize;
+uniform float exposure;
+uniform float sharpness;
+uniform float vignette;
+
+out vec4 finalColor;
+
+vec3 ToneMap(vec3 radiance) {
+	vec3 mapped = radiance * exposure;
+	return mapped / (1.0 + mapped);
+}
+
+void main() {
+	// Clamp to the rendered rectangle so filtering never reads stale texels
+	vec2 st = clamp(uv * uvScale, texelSize * 0.5, uvScale - texelSize * 0.5);
+	vec3 c = ToneMap(texture(source, st).rgb);
+
+	// Contrast-adaptive sharpen after the bilinear upscale: the neighbours are
+	// subtracted with a weight that shrinks where local contrast is already
+	// high, so edges get crisper without ringing
+	if (sharpness > 0.0) {
+		vec3 n = ToneMap(texture(source, st + vec2(0.0, texelSize.y)).rgb);
+		vec3 s = ToneMap(texture(source, st - vec2(0.0, texelSize.y)).rgb);
+		vec3 e = ToneMap(texture(source, st + vec2(texelSize.x, 0.0)).rgb);
+		vec3 w = ToneMap(texture(source, st - vec2(texelSize.x, 0.0)).rgb);
+
+		vec3 low = min(c, min(min(n, s), min(e, w)));
+		vec3 high = max(c, max(max(n, s), max(e, w)));
+		vec3 amount = sqrt(clamp(min(low, 1.0 - high) / max(high, vec3(1e-4)), 0.0, 1.0));
+		vec3 weight = -amount * (0.2 * sharpness);
+		c = clamp((c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight), 0.0, 1.0);
+	}
+
+	if (vignette > 0.0) {
+		vec2 d = uv - 0.5;
+		c *= 1.0 - vignette * dot(d, d) * 2.0;
+	}
+
+	finalColor = vec4(pow(c, vec3(1.0 / 2.2)), 1.0);
+}
+)";
+
+} // namespace
+
+bool PostProcess::initialize() {
+	programID = LoadShadersFromString(postVertexShader, postFragmentShader);
+	if (programID == 0) {
+		std::cerr << "Failed to load post-process shaders." << std::endl;
+		return false;
+	}
+	sourceSamplerID = glGetUniformLocation(programID, "source");
+	uvScaleID = glGetUniformLocation(programID, "uvScale");
+	texelSizeID = glGetUniformLocation(programID, "texelSize");
+	exposureID = glGetUniformLocation(programID, "exposure");
+	sharpnessID = glGetUniformLocation(programID, "sharpness");
+	vignetteID = glGetUniformLocation(programID, "vignette");
+
+	glGenVertexArrays(1, &vertexArrayID);
+	return true;
+}
+
+void PostProcess::cleanup() {
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(programID);
+}
+
+void PostProcess::render(const ScaledTarget& source, int width, int height) {
+	glViewport(0, 0, width, height);
+
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	// Sharpen in proportion to how much detail the upscale has to recover
+	float strength = (1.0f - source.scale()) * 2.0f;
+	if (strength > 1.0f) strength = 1.0f;
+
+	RenderStateUseProgram(programID);
+	RenderStateBindTexture(0, GL_TEXTURE_2D, source.colorTextureID);
+	glUniform1i(sourceSamplerID, 0);
+	glUniform2f(uvScaleID, source.renderWidth / (float)source.allocatedWidth,
+		source.renderHeight / (float)source.allocatedHeight);
+	glUniform2f(texelSizeID, 1.0f / source.allocatedWidth, 1.0f / source.allocatedHeight);
+	glUniform1f(exposureID, exposure);
+	glUniform1f(sharpnessID, sharpness * strength);
+	glUniform1f(vignetteID, vignette);
+	glBindVertexArray(vertexArrayID);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	++gRenderStats.drawCalls;
+	++gRenderStats.triangles;
+	glBindVertexArray(0);
+
+	if (depthTest) glEnable(GL_DEPTH_TEST);
+}
+
+glm::vec3 PostProcess::toSceneReferred(const glm::vec3& display) const {
+	glm::vec3 radiance;
+	for (int i = 0; i < 3; ++i) {
+		// Undo gamma, then invert x / (1 + x), staying short of white
+		float mapped = std::pow(display[i], 2.2f);
+		if (mapped > 0.99f) mapped = 0.99f;
+		radiance[i] = mapped / (1.0f - mapped) / exposure;
+	}
+	return radiance;
+}
@@ -0,0 +1,40 @@
+#ifndef _POST_PROCESS_H_
+#define _POST_PROCESS_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+struct ScaledTarget;
+
+// The single full-screen pass between the HDR scene and the window.
+//
+// One triangle reads the scaled scene target and, per output pixel, upscales
+// it, applies exposure, Reinhard tone mapping and gamma, and runs whichever
+// optional effects are switched on. New screen-space effects belong in this
+// shader rather than in passes of their own.
+struct PostProcess {
+	GLuint programID = 0;
+	GLuint vertexArrayID = 0;		// Empty, the triangle comes from gl_VertexID
+	GLuint sourceSamplerID = 0;
+	GLuint uvScaleID = 0;
+	GLuint texelSizeID = 0;
+	GLuint exposureID = 0;
+	GLuint sharpnessID = 0;
+	GLuint vignetteID = 0;
+
+	float exposure = 36.0f;
+	float sharpness = 0.5f;			// 0 to 1, scaled up as the render scale drops
+	float vignette = 0.0f;			// Darkening at the corners, 0 disables
+
+	bool initialize();
+	void cleanup();
+
+	// Draws the scene target to the bound framebuffer at the given size
+	void render(const ScaledTarget& source, int width, int height);
+
+	// Scene-referred radiance that comes out of the post pass as the given
+	// display colour, for clear colours and other constants picked on screen
+	glm::vec3 toSceneReferred(const glm::vec3& display) const;
+};
+
+#endif
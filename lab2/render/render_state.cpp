@@ -0,0 +1,57 @@
+#include "render_state.h"
+
+#include <cstring>
+
+RenderStats gRenderStats;
+
+namespace {
+
+const int kTextureUnits = 16;
+
+GLuint currentProgram = 0;
+GLuint activeUnit = 0;
+GLuint currentTextures[kTextureUnits];
+bool cacheValid = false;
+
+void ValidateCache() {
+	if (cacheValid) return;
+	currentProgram = ~0u;
+	activeUnit = ~0u;
+	for (int i = 0; i < kTextureUnits; ++i) currentTextures[i] = ~0u;
+	cacheValid = true;
+}
+
+} // namespace
+
+void RenderStatsReset() {
+	memset(&gRenderStats, 0, sizeof(gRenderStats));
+}
+
+void RenderStateInvalidate() {
+	cacheValid = false;
+}
+
+void RenderStateUseProgram(GLuint programID) {
+	ValidateCache();
+	if (currentProgram == programID) {
+		++gRenderStats.stateChangesElided;
+		return;
+	}
+	glUseProgram(programID);
+	currentProgram = programID;
+}
+
+void RenderStateBindTexture(GLuint unit, GLenum target, GLuint textureID) {
+	ValidateCache();
+	// Only the texture matters for elision, all our units hold one target each
+	if (unit < kTextureUnits && currentTextures[unit] == textureID) {
+		++gRenderStats.stateChangesElided;
+		return;
+	}
+	if (activeUnit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		activeUnit = unit;
+	}
+	glBindTexture(target, textureID);
+	if (unit < kTextureUnits) currentTextures[unit] = textureID;
+}
@@ -0,0 +1,28 @@
+#ifndef _RENDER_STATE_H_
+#define _RENDER_STATE_H_
+
+#include <glad/gl.h>
+
+// Per-frame counters shown by the HUD and written to the benchmark report
+struct RenderStats {
+	unsigned int drawCalls;
+	unsigned long long triangles;
+	unsigned int stateChangesElided;
+	unsigned int visibleObjects;
+	unsigned int culledObjects;
+	unsigned int meshletsTested;
+	unsigned int meshletsCulled;
+};
+
+extern RenderStats gRenderStats;
+
+void RenderStatsReset();
+
+// Cached binds that skip the GL call when the state is already current.
+// Anything that binds programs or textures behind the cache's back must call
+// RenderStateInvalidate afterwards.
+void RenderStateUseProgram(GLuint programID);
+void RenderStateBindTexture(GLuint unit, GLenum target, GLuint textureID);
+void RenderStateInvalidate();
+
+#endif
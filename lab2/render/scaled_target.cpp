@@ -0,0 +1,54 @@
+#include "scaled_target.h"
+#include "render_state.h"
+
+#include <iostream>
+
+void ScaledTarget::initialize() {
+	glGenFramebuffers(1, &framebufferID);
+	glGenTextures(1, &colorTextureID);
+	glGenTextures(1, &depthTextureID);
+}
+
+void ScaledTarget::cleanup() {
+	glDeleteFramebuffers(1, &framebufferID);
+	glDeleteTextures(1, &colorTextureID);
+	glDeleteTextures(1, &depthTextureID);
+}
+
+void ScaledTarget::begin(int windowWidth, int windowHeight, float scale) {
+	if (windowWidth != allocatedWidth || windowHeight != allocatedHeight) {
+		allocatedWidth = windowWidth;
+		allocatedHeight = windowHeight;
+
+		glBindTexture(GL_TEXTURE_2D, colorTextureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, allocatedWidth, allocatedHeight, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glBindTexture(GL_TEXTURE_2D, depthTextureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, allocatedWidth, allocatedHeight, 0,
+			GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		RenderStateInvalidate();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTextureID, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTextureID, 0);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "Scaled render target is incomplete." << std::endl;
+		}
+	}
+
+	renderWidth = (int)(allocatedWidth * scale + 0.5f);
+	renderHeight = (int)(allocatedHeight * scale + 0.5f);
+	if (renderWidth < 1) renderWidth = 1;
+	if (renderHeight < 1) renderHeight = 1;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, framebufferID);
+	glViewport(0, 0, renderWidth, renderHeight);
+}
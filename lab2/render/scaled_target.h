@@ -0,0 +1,35 @@
+#ifndef _SCALED_TARGET_H_
+#define _SCALED_TARGET_H_
+
+#include <glad/gl.h>
+
+// Offscreen HDR colour and depth target for the main pass, at a fraction of
+// the window resolution.
+//
+// Colour is RGBA16F and holds scene-referred radiance; exposure and tone
+// mapping happen once per pixel in the post pass. Depth is a texture so later
+// passes, such as deferred lighting, can read it. Storage is allocated at the
+// full window size and the scene renders into the bottom-left sub-rectangle,
+// so changing the scale every few frames costs a viewport change rather than
+// a reallocation.
+struct ScaledTarget {
+	GLuint framebufferID = 0;
+	GLuint colorTextureID = 0;
+	GLuint depthTextureID = 0;
+
+	int allocatedWidth = 0;
+	int allocatedHeight = 0;
+	int renderWidth = 0;
+	int renderHeight = 0;
+
+	void initialize();
+	void cleanup();
+
+	// Binds the target for the main pass and sets the viewport to the scaled
+	// rectangle. Reallocates only when the window size changes.
+	void begin(int windowWidth, int windowHeight, float scale);
+
+	float scale() const { return allocatedWidth > 0 ? renderWidth / (float)allocatedWidth : 1.0f; }
+};
+
+#endif
@@ -1,12 +1,55 @@
 #include "shader.h"
 
+#include <core/vfs.h>
+
 #include <string> 
 #include <iostream> 
-#include <fstream>
 #include <sstream> 
 #include <vector>
 
-GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path)
+static bool ReadShaderFile(const std::string& path, std::string& code, int depth = 0)
+{
+	AssetView file;
+	if (depth > 4 || !VfsRead(path.c_str(), file)) return false;
+	std::istringstream stream(std::string((const char*)file.data, file.size));
+
+	std::string directory;
+	size_t slash = path.find_last_of("/\\");
+	if (slash != std::string::npos) directory = path.substr(0, slash + 1);
+
+	code.clear();
+	std::string line;
+	while (std::getline(stream, line)) {
+		size_t open = line.find("#include \"");
+		size_t close = open == std::string::npos ? open : line.find('"', open + 10);
+		if (open != std::string::npos && close != std::string::npos) {
+			std::string included;
+			std::string includePath = directory + line.substr(open + 10, close - open - 10);
+			if (!ReadShaderFile(includePath, included, depth + 1)) {
+				printf("Shader include not found %s.\n", includePath.c_str());
+				return false;
+			}
+			code += included;
+		}
+		else {
+			code += line;
+		}
+		code += "\n";
+	}
+	return true;
+}
+
+static void InsertDefines(std::string& code, const char* defines)
+{
+	if (!defines) return;
+	size_t version = code.find("#version");
+	size_t lineEnd = version == std::string::npos ? 0 : code.find('\n', version);
+	if (lineEnd == std::string::npos) lineEnd = code.size();
+	else if (version != std::string::npos) ++lineEnd;
+	code.insert(lineEnd, std::string(defines) + "\n");
+}
+
+GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path, const char *defines)
 {
 	// Create the shaders
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
@@ -14,35 +57,21 @@ GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_fi
 
 	// Read the Vertex Shader code from the file
 	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if (VertexShaderStream.is_open())
-	{
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}
-	else
+	if (!ReadShaderFile(vertex_file_path, VertexShaderCode))
 	{
 		printf("Vertex shader not found %s.\n", vertex_file_path);
 		return 0;
 	}
+	InsertDefines(VertexShaderCode, defines);
 
 	// Read the Fragment Shader code from the file
 	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if (FragmentShaderStream.is_open())
-	{
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
-	}
-	else
+	if (!ReadShaderFile(fragment_file_path, FragmentShaderCode))
 	{
 		printf("Fragment shader not found %s.\n", fragment_file_path);
 		return 0;
 	}
+	InsertDefines(FragmentShaderCode, defines);
 
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
@@ -193,3 +222,78 @@ GLuint LoadShadersFromString(std::string VertexShaderCode, std::string FragmentS
 
 	return ProgramID;
 }
+
+static GLuint CompileShaderFile(GLenum type, const char *path, const char *defines)
+{
+	std::string code;
+	if (!ReadShaderFile(path, code))
+	{
+		printf("Shader not found %s.\n", path);
+		return 0;
+	}
+	InsertDefines(code, defines);
+
+	printf("Compiling shader : %s\n", path);
+	GLuint ShaderID = glCreateShader(type);
+	char const *SourcePointer = code.c_str();
+	glShaderSource(ShaderID, 1, &SourcePointer, NULL);
+	glCompileShader(ShaderID);
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	glGetShaderiv(ShaderID, GL_COMPILE_STATUS, &Result);
+	if (!Result) {
+		printf("Error compiling shader : %s\n", path);
+		glGetShaderiv(ShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 0) {
+			std::vector<char> ErrorMessage(InfoLogLength + 1);
+			glGetShaderInfoLog(ShaderID, InfoLogLength, NULL, &ErrorMessage[0]);
+			printf("%s\n", &ErrorMessage[0]);
+		}
+		glDeleteShader(ShaderID);
+		return 0;
+	}
+	return ShaderID;
+}
+
+GLuint LoadTransformFeedbackShadersFromFile(const char *vertex_file_path, const char *geometry_file_path,
+	const char *const *varyings, int varyingCount, const char *defines)
+{
+	GLuint VertexShaderID = CompileShaderFile(GL_VERTEX_SHADER, vertex_file_path, defines);
+	GLuint GeometryShaderID = VertexShaderID ? CompileShaderFile(GL_GEOMETRY_SHADER, geometry_file_path, defines) : 0;
+	if (!GeometryShaderID) {
+		glDeleteShader(VertexShaderID);
+		return 0;
+	}
+
+	// Link the program, the varyings have to be named before linking
+	printf("Linking program\n");
+	GLuint ProgramID = glCreateProgram();
+	glAttachShader(ProgramID, VertexShaderID);
+	glAttachShader(ProgramID, GeometryShaderID);
+	glTransformFeedbackVaryings(ProgramID, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+	glLinkProgram(ProgramID);
+
+	glDetachShader(ProgramID, VertexShaderID);
+	glDetachShader(ProgramID, GeometryShaderID);
+	glDeleteShader(VertexShaderID);
+	glDeleteShader(GeometryShaderID);
+
+	GLint Result = GL_FALSE;
+	int InfoLogLength;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (!Result) {
+		printf("Error linking program\n");
+		glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
+		if (InfoLogLength > 0)
+		{
+			std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
+			glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
+			printf("%s\n", &ProgramErrorMessage[0]);
+		}
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+
+	return ProgramID;
+}
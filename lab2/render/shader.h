@@ -4,8 +4,16 @@
 #include <glad/gl.h>
 #include <string>
 
-GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path);
+// Lines of the form #include "file" are replaced by that file, looked up next
+// to the including shader. Defines, if given, are inserted after #version so
+// one source can be compiled into several variants.
+GLuint LoadShadersFromFile(const char *vertex_file_path, const char *fragment_file_path, const char *defines = NULL);
 
 GLuint LoadShadersFromString(std::string VertexShaderCode, std::string FragmentShaderCode);
 
+// Vertex and geometry shaders with no fragment stage, linked so the named
+// outputs are captured interleaved by transform feedback
+GLuint LoadTransformFeedbackShadersFromFile(const char *vertex_file_path, const char *geometry_file_path,
+	const char *const *varyings, int varyingCount, const char *defines = NULL);
+
 #endif
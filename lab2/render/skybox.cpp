@@ -0,0 +1,171 @@
+#include "skybox.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <core/profiler.h>
+#include <core/vfs.h>
+
+#include <stb/stb_image.h>
+
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const int kGradientSize = 32;
+
+// Zenith to horizon blue with a darker haze below, in display colours
+void FillGradientFace(int face, uint8_t* pixels) {
+	const glm::vec3 zenith(0.33f, 0.55f, 0.85f);
+	const glm::vec3 horizon(0.68f, 0.85f, 0.90f);
+	const glm::vec3 ground(0.42f, 0.46f, 0.48f);
+	for (int y = 0; y < kGradientSize; ++y) {
+		for (int x = 0; x < kGradientSize; ++x) {
+			float s = (x + 0.5f) / kGradientSize * 2.0f - 1.0f;
+			float t = (y + 0.5f) / kGradientSize * 2.0f - 1.0f;
+			// Cube face conventions of the GL spec, only the height matters here
+			glm::vec3 direction;
+			switch (face) {
+			case 0: direction = glm::vec3(1.0f, -t, -s); break;
+			case 1: direction = glm::vec3(-1.0f, -t, s); break;
+			case 2: direction = glm::vec3(s, 1.0f, t); break;
+			case 3: direction = glm::vec3(s, -1.0f, -t); break;
+			case 4: direction = glm::vec3(s, -t, 1.0f); break;
+			default: direction = glm::vec3(-s, -t, -1.0f); break;
+			}
+			float height = glm::normalize(direction).y;
+			glm::vec3 color = height >= 0.0f
+				? glm::mix(horizon, zenith, std::sqrt(height))
+				: glm::mix(horizon, ground, std::sqrt(-height));
+			uint8_t* texel = pixels + (y * kGradientSize + x) * 3;
+			for (int c = 0; c < 3; ++c) texel[c] = (uint8_t)(color[c] * 255.0f + 0.5f);
+		}
+	}
+}
+
+void SetCubemapParameters() {
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
+
+} // namespace
+
+bool Skybox::initialize(const char* vertexPath, const char* fragmentPath) {
+	programID = LoadShadersFromFile(vertexPath, fragmentPath);
+	if (programID == 0) {
+		std::cerr << "Failed to load sky shaders." << std::endl;
+		return false;
+	}
+	skySamplerID = glGetUniformLocation(programID, "skyCubemap");
+	inverseViewProjectionID = glGetUniformLocation(programID, "inverseViewProjection");
+	exposureID = glGetUniformLocation(programID, "exposure");
+
+	glGenVertexArrays(1, &vertexArrayID);
+
+	uint8_t pixels[kGradientSize * kGradientSize * 3];
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+	for (int face = 0; face < 6; ++face) {
+		FillGradientFace(face, pixels);
+		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8, kGradientSize, kGradientSize, 0,
+			GL_RGB, GL_UNSIGNED_BYTE, pixels);
+	}
+	SetCubemapParameters();
+	RenderStateInvalidate();
+	return true;
+}
+
+void Skybox::cleanup() {
+	if (loader.joinable()) loader.join();
+	for (int face = 0; face < 6; ++face) {
+		stbi_image_free(facePixels[face]);
+		facePixels[face] = NULL;
+	}
+	glDeleteTextures(1, &textureID);
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteProgram(programID);
+}
+
+void Skybox::loadAsync(const char* const faceFiles[6]) {
+	if (loading) return;
+	loading = true;
+	decoded = false;
+	const char* files[6];
+	for (int face = 0; face < 6; ++face) files[face] = faceFiles[face];
+	loader = std::thread([this, files]() {
+		ProfilerSetThreadName("Sky loader");
+		PROFILE_ZONE("Decode sky");
+		for (int face = 0; face < 6; ++face) {
+			int channels;
+			AssetView file;
+			facePixels[face] = NULL;
+			if (VfsRead(files[face], file)) {
+				facePixels[face] = stbi_load_from_memory(file.data, (int)file.size, &faceWidths[face], &faceHeights[face],
+					&channels, 3);
+			}
+		}
+		decoded.store(true, std::memory_order_release);
+	});
+}
+
+bool Skybox::poll() {
+	if (!loading || !decoded.load(std::memory_order_acquire)) return false;
+	loader.join();
+	loading = false;
+
+	// All six faces must be present and square with one size, or none are used
+	bool complete = true;
+	for (int face = 0; face < 6; ++face) {
+		complete = complete && facePixels[face] && faceWidths[face] == faceHeights[face] &&
+			faceWidths[face] == faceWidths[0];
+	}
+	if (complete) {
+		PROFILE_ZONE("Sky upload");
+		glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+		// Rows of RGB faces are packed, whatever their width
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int face = 0; face < 6; ++face) {
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, 0, GL_RGB8, faceWidths[face], faceHeights[face], 0,
+				GL_RGB, GL_UNSIGNED_BYTE, facePixels[face]);
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		SetCubemapParameters();
+		RenderStateInvalidate();
+	}
+	else {
+		std::cout << "Sky cubemap faces missing or mismatched, keeping the procedural sky" << std::endl;
+	}
+
+	for (int face = 0; face < 6; ++face) {
+		stbi_image_free(facePixels[face]);
+		facePixels[face] = NULL;
+	}
+	return complete;
+}
+
+void Skybox::render(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float exposure) {
+	// Rotation only, the sky is infinitely far away
+	glm::mat4 rotation = glm::mat4(glm::mat3(viewMatrix));
+	glm::mat4 inverseViewProjection = glm::inverse(projectionMatrix * rotation);
+
+	glDepthFunc(GL_LEQUAL);
+	glDepthMask(GL_FALSE);
+
+	RenderStateUseProgram(programID);
+	RenderStateBindTexture(0, GL_TEXTURE_CUBE_MAP, textureID);
+	glUniform1i(skySamplerID, 0);
+	glUniformMatrix4fv(inverseViewProjectionID, 1, GL_FALSE, &inverseViewProjection[0][0]);
+	glUniform1f(exposureID, exposure);
+
+	glBindVertexArray(vertexArrayID);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	++gRenderStats.drawCalls;
+	++gRenderStats.triangles;
+	glBindVertexArray(0);
+
+	glDepthMask(GL_TRUE);
+	glDepthFunc(GL_LESS);
+}
@@ -0,0 +1,49 @@
+#ifndef _SKYBOX_H_
+#define _SKYBOX_H_
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Cubemap sky drawn after the opaque geometry.
+//
+// One fullscreen triangle sits exactly on the far plane and is drawn with a
+// GL_LEQUAL test and depth writes off, so early depth rejects every pixel a
+// building already covers and only the uncovered sky is shaded. Face images
+// are decoded on a loader thread and uploaded once they are all in; until then,
+// or if they cannot be read, a small procedural gradient stands in.
+struct Skybox {
+	GLuint textureID = 0;
+	GLuint vertexArrayID = 0;		// Empty, the triangle comes from gl_VertexID
+	GLuint programID = 0;
+	GLuint skySamplerID = 0;
+	GLuint inverseViewProjectionID = 0;
+	GLuint exposureID = 0;
+
+	// Faces in GL order: +X, -X, +Y, -Y, +Z, -Z
+	uint8_t* facePixels[6] = {};
+	int faceWidths[6] = {};
+	int faceHeights[6] = {};
+	std::thread loader;
+	std::atomic<bool> decoded{ false };
+	bool loading = false;
+
+	bool initialize(const char* vertexPath, const char* fragmentPath);
+	void cleanup();
+
+	// Starts decoding the six face images off the GL thread
+	void loadAsync(const char* const faceFiles[6]);
+
+	// Uploads the faces once decoded. Returns true on the frame they appear.
+	bool poll();
+
+	// Draws into the bound framebuffer over whatever was left at the far
+	// plane. With exposure above 0 the output is radiance for the post pass,
+	// which tone maps back to the image colours; with 0 it is the colours as is.
+	void render(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix, float exposure);
+};
+
+#endif
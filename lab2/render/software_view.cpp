@@ -0,0 +1,89 @@
+#include "software_view.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <iostream>
+
+namespace {
+
+const char* viewVertexShader = R"(
+#version 330 core
+out vec2 uv;
+
+void main() {
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	uv = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+const char* viewFragmentShader = R"(
+#version 330 core
+in vec2 uv;
+
+uniform sampler2D source;
+
+out vec4 finalColor;
+
+void main() {
+	finalColor = vec4(texture(source, uv).rgb, 1.0);
+}
+)";
+
+} // namespace
+
+bool SoftwareView::initialize() {
+	programID = LoadShadersFromString(viewVertexShader, viewFragmentShader);
+	if (programID == 0) {
+		std::cerr << "Failed to load software view shaders." << std::endl;
+		return false;
+	}
+	sourceSamplerID = glGetUniformLocation(programID, "source");
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	RenderStateInvalidate();
+
+	glGenVertexArrays(1, &vertexArrayID);
+	return true;
+}
+
+void SoftwareView::cleanup() {
+	glDeleteVertexArrays(1, &vertexArrayID);
+	glDeleteTextures(1, &textureID);
+	glDeleteProgram(programID);
+}
+
+void SoftwareView::present(const uint32_t* rgba, int frameWidth, int frameHeight, int windowWidth, int windowHeight) {
+	RenderStateBindTexture(0, GL_TEXTURE_2D, textureID);
+	// Rows of any width are tightly packed
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (frameWidth != width || frameHeight != height) {
+		width = frameWidth;
+		height = frameHeight;
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	}
+	else {
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, windowWidth, windowHeight);
+	GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+	glDisable(GL_DEPTH_TEST);
+
+	RenderStateUseProgram(programID);
+	glUniform1i(sourceSamplerID, 0);
+	glBindVertexArray(vertexArrayID);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	++gRenderStats.drawCalls;
+	++gRenderStats.triangles;
+	glBindVertexArray(0);
+
+	if (depthTest) glEnable(GL_DEPTH_TEST);
+}
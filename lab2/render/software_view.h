@@ -0,0 +1,27 @@
+#ifndef _SOFTWARE_VIEW_H_
+#define _SOFTWARE_VIEW_H_
+
+#include <glad/gl.h>
+
+#include <cstdint>
+
+// Shows frames from the software rasterizer: each one is uploaded to a
+// texture and stretched over the window by one full-screen triangle. The
+// frames are already tone mapped, so the shader only copies texels.
+struct SoftwareView {
+	GLuint programID = 0;
+	GLuint vertexArrayID = 0;		// Empty, the triangle comes from gl_VertexID
+	GLuint textureID = 0;
+	GLuint sourceSamplerID = 0;
+	int width = 0;					// Of the texture's storage
+	int height = 0;
+
+	bool initialize();
+	void cleanup();
+
+	// Uploads RGBA8 rows, bottom first, and draws them to the bound
+	// framebuffer at the given size
+	void present(const uint32_t* rgba, int frameWidth, int frameHeight, int windowWidth, int windowHeight);
+};
+
+#endif
@@ -0,0 +1,293 @@
+#include "texture_streamer.h"
+#include "render_state.h"
+
+#include <core/frame_pipeline.h>
+#include <core/profiler.h>
+#include <core/vfs.h>
+
+#include <stb/stb_image.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const int kTailSize = 64;			// Mips this size and below are never evicted
+const int kMaxLoadsInFlight = 2;
+const size_t kBytesPerTexel = 4;	// Drivers pad RGB8 to four bytes
+
+int MipExtent(int size, int mip) {
+	return std::max(1, size >> mip);
+}
+
+// Halves an RGB8 image with a 2 x 2 box filter, repeating the last row or
+// column of odd sizes
+void Downsample(const std::vector<uint8_t>& source, int width, int height, std::vector<uint8_t>& out) {
+	int outWidth = std::max(1, width / 2);
+	int outHeight = std::max(1, height / 2);
+	out.resize((size_t)outWidth * outHeight * 3);
+	for (int y = 0; y < outHeight; ++y) {
+		int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+		for (int x = 0; x < outWidth; ++x) {
+			int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+			for (int c = 0; c < 3; ++c) {
+				int sum = source[((size_t)y0 * width + x0) * 3 + c] + source[((size_t)y0 * width + x1) * 3 + c] +
+					source[((size_t)y1 * width + x0) * 3 + c] + source[((size_t)y1 * width + x1) * 3 + c];
+				out[((size_t)y * outWidth + x) * 3 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+} // namespace
+
+void TextureStreamer::initialize() {
+	quit = false;
+	loader = std::thread(&TextureStreamer::loaderLoop, this);
+}
+
+void TextureStreamer::cleanup() {
+	if (loader.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_one();
+		loader.join();
+	}
+	for (Texture& texture : textures) {
+		glDeleteTextures(1, &texture.textureID);
+	}
+	textures.clear();
+}
+
+int TextureStreamer::add(const char* path) {
+	Texture texture;
+	texture.path = path;
+	int channels;
+	AssetView file;
+	if (!VfsRead(path, file) ||
+		!stbi_info_from_memory(file.data, (int)file.size, &texture.width, &texture.height, &channels)) {
+		std::cout << "Failed to load texture " << path << std::endl;
+		texture.width = texture.height = 1;
+		texture.failed = true;
+	}
+	int largest = std::max(texture.width, texture.height);
+	texture.mipCount = 1;
+	while ((largest >> texture.mipCount) > 0) ++texture.mipCount;
+	while (std::max(MipExtent(texture.width, texture.tailMip), MipExtent(texture.height, texture.tailMip)) > kTailSize) {
+		++texture.tailMip;
+	}
+	texture.residentBase = texture.mipCount - 1;
+	texture.wantedMip = texture.tailMip;
+
+	// Mid grey 1 x 1 until the tail arrives, so the texture is complete from the start
+	const uint8_t grey[3] = { 128, 128, 128 };
+	glGenTextures(1, &texture.textureID);
+	glBindTexture(GL_TEXTURE_2D, texture.textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, texture.residentBase, GL_RGB8, MipExtent(texture.width, texture.residentBase),
+		MipExtent(texture.height, texture.residentBase), 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, texture.residentBase);
+	RenderStateInvalidate();
+
+	residentBytes += textureBytes(texture, texture.residentBase, texture.residentBase);
+	textures.push_back(texture);
+	return (int)textures.size() - 1;
+}
+
+size_t TextureStreamer::textureBytes(const Texture& texture, int firstMip, int lastMip) const {
+	size_t bytes = 0;
+	for (int mip = firstMip; mip <= lastMip; ++mip) {
+		bytes += (size_t)MipExtent(texture.width, mip) * MipExtent(texture.height, mip) * kBytesPerTexel;
+	}
+	return bytes;
+}
+
+void TextureStreamer::evictFinestMip(Texture& texture) {
+	int mip = texture.residentBase;
+	// Move the base up before releasing the level, so the texture stays complete
+	glBindTexture(GL_TEXTURE_2D, texture.textureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, mip + 1);
+	glTexImage2D(GL_TEXTURE_2D, mip, GL_RGB8, 0, 0, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	residentBytes -= textureBytes(texture, mip, mip);
+	texture.residentBase = mip + 1;
+	++mipsEvicted;
+}
+
+bool TextureStreamer::isEvictable(int index, int forTexture) const {
+	const Texture& texture = textures[index];
+	if (index == forTexture || texture.loadingMip >= 0 || texture.residentBase >= texture.tailMip) return false;
+	// Detail nobody currently needs can always go, the rest only to something more visible
+	return texture.residentBase < texture.wantedMip || texture.priority < textures[forTexture].priority;
+}
+
+bool TextureStreamer::makeRoom(size_t bytes, int forTexture) {
+	// Evict nothing unless the load will fit afterwards, or two textures
+	// can take turns evicting each other's mips
+	size_t evictable = 0;
+	for (int i = 0; i < (int)textures.size(); ++i) {
+		if (isEvictable(i, forTexture)) {
+			evictable += textureBytes(textures[i], textures[i].residentBase, textures[i].tailMip - 1);
+		}
+	}
+	if (residentBytes + inFlightBytes + bytes > budgetBytes + evictable) return false;
+
+	while (residentBytes + inFlightBytes + bytes > budgetBytes) {
+		// Detail nobody currently needs goes first, then the least visible
+		int victim = -1;
+		float victimKey = FLT_MAX;
+		for (int i = 0; i < (int)textures.size(); ++i) {
+			if (!isEvictable(i, forTexture)) continue;
+			const Texture& texture = textures[i];
+			bool surplus = texture.residentBase < texture.wantedMip;
+			float key = surplus ? texture.priority - FLT_MAX : texture.priority;
+			if (key < victimKey) {
+				victimKey = key;
+				victim = i;
+			}
+		}
+		if (victim < 0) return false;
+		evictFinestMip(textures[victim]);
+	}
+	return true;
+}
+
+void TextureStreamer::update(const std::vector<TextureRequest>& requests) {
+	PROFILE_ZONE("Texture streaming");
+
+	std::vector<LoadResult> finished;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		finished.swap(completed);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (LoadResult& result : finished) {
+		Texture& texture = textures[result.texture];
+		inFlightBytes -= result.bytes;
+		--loadsInFlight;
+		texture.loadingMip = -1;
+		if (result.pixels.empty()) {
+			std::cout << "Failed to load texture " << result.path << std::endl;
+			texture.failed = true;
+			continue;
+		}
+
+		PROFILE_ZONE("Upload mip");
+		glBindTexture(GL_TEXTURE_2D, texture.textureID);
+		size_t offset = 0;
+		for (int mip = result.firstMip; mip <= result.lastMip; ++mip) {
+			int width = MipExtent(texture.width, mip), height = MipExtent(texture.height, mip);
+			glTexImage2D(GL_TEXTURE_2D, mip, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, &result.pixels[offset]);
+			offset += (size_t)width * height * 3;
+		}
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, result.firstMip);
+		residentBytes += result.bytes;
+		texture.residentBase = result.firstMip;
+		++loadsCompleted;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// Finest mip worth having: one texel per pixel over the largest repeat on screen
+	for (size_t i = 0; i < textures.size(); ++i) {
+		Texture& texture = textures[i];
+		texture.wantedMip = texture.tailMip;
+		texture.priority = 0.0f;
+		if (i < requests.size() && requests[i].screenArea > 0.0f && requests[i].pixelsPerRepeat > 0.0f) {
+			float mip = std::log2(std::max(texture.width, texture.height) / requests[i].pixelsPerRepeat);
+			texture.wantedMip = std::min(std::max((int)std::floor(mip), 0), texture.tailMip);
+			texture.priority = requests[i].screenArea;
+		}
+	}
+
+	// A texture whose next mip does not fit is passed over, so a smaller one
+	// further down the list can still use what is left of the budget
+	std::vector<bool> passed(textures.size(), false);
+	while (loadsInFlight < kMaxLoadsInFlight) {
+		// Every coarse tail before any detail, then the most visible first
+		int best = -1;
+		float bestKey = -1.0f;
+		for (int i = 0; i < (int)textures.size(); ++i) {
+			const Texture& texture = textures[i];
+			if (passed[i] || texture.failed || texture.loadingMip >= 0 || texture.residentBase <= texture.wantedMip) continue;
+			float key = texture.residentBase > texture.tailMip ? FLT_MAX : texture.priority;
+			if (key > bestKey) {
+				bestKey = key;
+				best = i;
+			}
+		}
+		if (best < 0) break;
+
+		Texture& texture = textures[best];
+		bool tail = texture.residentBase > texture.tailMip;
+		int firstMip = tail ? texture.tailMip : texture.residentBase - 1;
+		int lastMip = tail ? texture.mipCount - 1 : firstMip;
+		size_t bytes = textureBytes(texture, firstMip, texture.residentBase - 1);
+		// The tail is loaded even over budget, it is the floor everything falls back to
+		if (!makeRoom(bytes, best) && !tail) {
+			passed[best] = true;
+			continue;
+		}
+
+		texture.loadingMip = firstMip;
+		inFlightBytes += bytes;
+		++loadsInFlight;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			LoadResult load = { best, firstMip, lastMip, bytes, texture.path, std::vector<uint8_t>() };
+			queued.push_back(load);
+		}
+		wake.notify_one();
+	}
+
+	peakResidentBytes = std::max(peakResidentBytes, residentBytes);
+	RenderStateInvalidate();
+}
+
+void TextureStreamer::loaderLoop() {
+	ProfilerSetThreadName("Texture loader");
+	for (;;) {
+		LoadResult load;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return quit || !queued.empty(); });
+			if (quit) return;
+			load = queued.front();
+			queued.pop_front();
+		}
+
+		{
+			PROFILE_ZONE("Decode mips");
+			int width, height, channels;
+			AssetView file;
+			uint8_t* image = NULL;
+			if (VfsRead(load.path.c_str(), file)) {
+				image = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 3);
+			}
+			if (image) {
+				// Full decode, then halve down to the requested range
+				std::vector<uint8_t> level(image, image + (size_t)width * height * 3);
+				std::vector<uint8_t> next;
+				stbi_image_free(image);
+				for (int mip = 0; mip <= load.lastMip; ++mip) {
+					if (mip >= load.firstMip) load.pixels.insert(load.pixels.end(), level.begin(), level.end());
+					if (mip == load.lastMip) break;
+					Downsample(level, width, height, next);
+					level.swap(next);
+					width = std::max(1, width / 2);
+					height = std::max(1, height / 2);
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		completed.push_back(load);
+	}
+}
@@ -0,0 +1,87 @@
+#ifndef _TEXTURE_STREAMER_H_
+#define _TEXTURE_STREAMER_H_
+
+#include <glad/gl.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TextureRequest;
+
+// Mip residency for 2D textures under a memory budget.
+//
+// Each texture starts with only a 1 x 1 placeholder. Its coarse tail, every
+// mip of 64 x 64 and below, is loaded first and never evicted. Finer mips are
+// streamed one level at a time toward the mip the frame's requests call for.
+// The most visible textures go first, and a loader thread decodes and
+// downsamples each one. GL_TEXTURE_BASE_LEVEL sits on the finest resident mip,
+// so sampling never reaches levels that have not arrived. When a load does not
+// fit the budget, the finest mips of less visible textures are dropped to make
+// room, always finest first, so detail goes before the coarse fallback does.
+struct TextureStreamer {
+	struct Texture {
+		std::string path;
+		GLuint textureID = 0;
+		int width = 0;
+		int height = 0;
+		int mipCount = 0;
+		int tailMip = 0;			// Finest mip of the always-resident tail
+		int residentBase = 0;		// Finest mip resident
+		int loadingMip = -1;		// Finest mip in flight, -1 when none
+		int wantedMip = 0;
+		float priority = 0.0f;
+		bool failed = false;		// File could not be decoded, keeps the placeholder
+	};
+
+	// A queued load, filled in by the loader thread
+	struct LoadResult {
+		int texture;
+		int firstMip;
+		int lastMip;
+		size_t bytes;				// Reserved against the budget
+		std::string path;
+		std::vector<uint8_t> pixels;	// RGB8, mips firstMip to lastMip back to back
+	};
+
+	size_t budgetBytes = 16u << 20;
+	std::vector<Texture> textures;
+	size_t residentBytes = 0;
+	size_t inFlightBytes = 0;
+	int loadsInFlight = 0;
+
+	// Totals for the HUD and benchmark report
+	size_t peakResidentBytes = 0;
+	unsigned long long loadsCompleted = 0;
+	unsigned long long mipsEvicted = 0;
+
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<LoadResult> queued;		// Requests, with empty pixels
+	std::vector<LoadResult> completed;
+	bool quit = false;
+
+	void initialize();
+	void cleanup();
+
+	// Registers a texture file and returns its index. Only the header is read
+	// here; the GL texture is usable at once through its placeholder.
+	int add(const char* path);
+
+	// Uploads finished loads, then evicts and queues loads for this frame's
+	// requests, indexed like the textures
+	void update(const std::vector<TextureRequest>& requests);
+
+	size_t textureBytes(const Texture& texture, int firstMip, int lastMip) const;
+	bool isEvictable(int index, int forTexture) const;
+	bool makeRoom(size_t bytes, int forTexture);
+	void evictFinestMip(Texture& texture);
+	void loaderLoop();
+};
+
+#endif
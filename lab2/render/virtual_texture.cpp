@@ -0,0 +1,259 @@
+#include "virtual_texture.h"
+#include "shader.h"
+#include "render_state.h"
+
+#include <core/profiler.h>
+
+#include <cmath>
+#include <iostream>
+
+bool VirtualTexture::initialize(int physicalPagesPerSide, const char* feedbackVertexPath,
+	const char* feedbackFragmentPath, PageGenerator pageGenerator) {
+	feedbackProgramID = LoadShadersFromFile(feedbackVertexPath, feedbackFragmentPath);
+	if (feedbackProgramID == 0) {
+		std::cerr << "Failed to load virtual texture feedback shaders." << std::endl;
+		return false;
+	}
+	feedbackMipBiasID = glGetUniformLocation(feedbackProgramID, "virtualMipBias");
+
+	table.initialize(physicalPagesPerSide);
+	generator = pageGenerator;
+
+	int physicalSize = physicalPagesPerSide * kPhysicalPageSize;
+	glGenTextures(1, &physicalTextureID);
+	glBindTexture(GL_TEXTURE_2D, physicalTextureID);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, physicalSize, physicalSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// Entries are packed little-endian, so each uint32_t is one RGBA8 texel
+	glGenTextures(1, &indirectionTextureID);
+	glBindTexture(GL_TEXTURE_2D, indirectionTextureID);
+	for (int mip = 0; mip < kVirtualMipCount; ++mip) {
+		int size = kVirtualPages >> mip;
+		glTexImage2D(GL_TEXTURE_2D, mip, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, table.indirection[mip].data());
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, kVirtualMipCount - 1);
+	table.clearDirty();
+
+	glGenFramebuffers(1, &feedbackFramebufferID);
+	glGenRenderbuffers(1, &feedbackColorID);
+	glGenRenderbuffers(1, &feedbackDepthID);
+	glGenBuffers(kReadbackLatency, pixelBufferIDs);
+	RenderStateInvalidate();
+	return true;
+}
+
+void VirtualTexture::cleanup() {
+	// Workers may still be writing into pages in flight
+	for (auto& load : loads) {
+		JobWait(&load->done);
+	}
+	loads.clear();
+	for (int i = 0; i < kReadbackLatency; ++i) {
+		if (fences[i]) glDeleteSync(fences[i]);
+		fences[i] = 0;
+	}
+	glDeleteBuffers(kReadbackLatency, pixelBufferIDs);
+	glDeleteRenderbuffers(1, &feedbackColorID);
+	glDeleteRenderbuffers(1, &feedbackDepthID);
+	glDeleteFramebuffers(1, &feedbackFramebufferID);
+	glDeleteTextures(1, &physicalTextureID);
+	glDeleteTextures(1, &indirectionTextureID);
+	glDeleteProgram(feedbackProgramID);
+}
+
+void VirtualTexture::pinSlots(int slotCount) {
+	PROFILE_ZONE("Pin virtual texture slots");
+	if (slotCount > kMaxVirtualSlots) slotCount = kMaxVirtualSlots;
+
+	const int rootMip = kVirtualMipCount - 1;
+	const size_t pageBytes = kPhysicalPageSize * kPhysicalPageSize * 4;
+	std::vector<uint8_t> pixels(pageBytes * slotCount);
+	JobCounter generated;
+	JobParallelFor(slotCount, 1, [&](size_t begin, size_t end) {
+		for (size_t slot = begin; slot < end; ++slot) {
+			generator(rootMip, (int)slot % kSlotsPerSide, (int)slot / kSlotsPerSide, &pixels[slot * pageBytes]);
+		}
+	}, &generated);
+	JobWait(&generated);
+
+	glBindTexture(GL_TEXTURE_2D, physicalTextureID);
+	for (int slot = 0; slot < slotCount; ++slot) {
+		int page = table.allocate();
+		if (page < 0) {
+			std::cerr << "Virtual texture has too few physical pages for " << slotCount << " slots." << std::endl;
+			break;
+		}
+		glTexSubImage2D(GL_TEXTURE_2D, 0, (page % table.physicalPagesPerSide) * kPhysicalPageSize,
+			(page / table.physicalPagesPerSide) * kPhysicalPageSize, kPhysicalPageSize, kPhysicalPageSize,
+			GL_RGBA, GL_UNSIGNED_BYTE, &pixels[slot * pageBytes]);
+		table.map(VirtualPageKey(rootMip, slot % kSlotsPerSide, slot / kSlotsPerSide), page, true);
+	}
+	RenderStateInvalidate();
+}
+
+void VirtualTexture::beginFeedback(int windowWidth, int windowHeight, float renderScale) {
+	int width = windowWidth / kFeedbackDivisor, height = windowHeight / kFeedbackDivisor;
+	if (width < 1) width = 1;
+	if (height < 1) height = 1;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebufferID);
+	if (width != feedbackWidth || height != feedbackHeight) {
+		feedbackWidth = width;
+		feedbackHeight = height;
+		glBindRenderbuffer(GL_RENDERBUFFER, feedbackColorID);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepthID);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+		glBindRenderbuffer(GL_RENDERBUFFER, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackColorID);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepthID);
+		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cerr << "Virtual texture feedback target is incomplete." << std::endl;
+		}
+	}
+	glViewport(0, 0, width, height);
+
+	// Zero alpha marks pixels nothing was drawn to
+	const GLfloat noRequest[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	glClearBufferfv(GL_COLOR, 0, noRequest);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	// Derivatives here are larger than in the scaled target by the ratio of
+	// the two widths, which would ask for pages one mip too coarse per octave
+	RenderStateUseProgram(feedbackProgramID);
+	float ratio = windowWidth * renderScale / width;
+	glUniform1f(feedbackMipBiasID, mipBias - std::log2(ratio > 1.0f ? ratio : 1.0f));
+}
+
+void VirtualTexture::endFeedback() {
+	int slot = (int)(frameIndex % kReadbackLatency);
+	++frameIndex;
+	// The readback from kReadbackLatency frames ago has still not finished,
+	// so skip this one rather than wait for the buffer
+	if (fences[slot]) return;
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBufferIDs[slot]);
+	glBufferData(GL_PIXEL_PACK_BUFFER, (size_t)feedbackWidth * feedbackHeight * 4, NULL, GL_STREAM_READ);
+	glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	readbackWidth[slot] = feedbackWidth;
+	readbackHeight[slot] = feedbackHeight;
+	readbackFrame[slot] = frameIndex;
+}
+
+void VirtualTexture::readFeedback(int slot) {
+	PROFILE_ZONE("Read feedback");
+	size_t pixelCount = (size_t)readbackWidth[slot] * readbackHeight[slot];
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBufferIDs[slot]);
+	const uint8_t* pixels = (const uint8_t*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixelCount * 4, GL_MAP_READ_BIT);
+	if (pixels) {
+		table.processFeedback(pixels, pixelCount, wanted);
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool VirtualTexture::isLoading(uint32_t key) const {
+	for (const auto& load : loads) {
+		if (load->key == key) return true;
+	}
+	return false;
+}
+
+void VirtualTexture::update() {
+	PROFILE_ZONE("Virtual texture");
+
+	// Only the newest finished feedback is worth reading; older ones are retired
+	int newest = -1;
+	for (int slot = 0; slot < kReadbackLatency; ++slot) {
+		if (!fences[slot] || glClientWaitSync(fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) continue;
+		glDeleteSync(fences[slot]);
+		fences[slot] = 0;
+		if (newest < 0 || readbackFrame[slot] > readbackFrame[newest]) newest = slot;
+	}
+	if (newest >= 0) readFeedback(newest);
+
+	// Copy finished pages in. If every physical page is pinned or needed by
+	// the current view, the page is dropped and asked for again later.
+	glBindTexture(GL_TEXTURE_2D, physicalTextureID);
+	for (size_t i = 0; i < loads.size();) {
+		PageLoad& load = *loads[i];
+		if (!load.done.done()) {
+			++i;
+			continue;
+		}
+		int page = table.allocate();
+		if (page >= 0) {
+			PROFILE_ZONE("Upload page");
+			glTexSubImage2D(GL_TEXTURE_2D, 0, (page % table.physicalPagesPerSide) * kPhysicalPageSize,
+				(page / table.physicalPagesPerSide) * kPhysicalPageSize, kPhysicalPageSize, kPhysicalPageSize,
+				GL_RGBA, GL_UNSIGNED_BYTE, load.pixels.data());
+			table.map(load.key, page, false);
+			++pagesLoaded;
+		}
+		loads[i] = std::move(loads.back());
+		loads.pop_back();
+	}
+
+	for (uint32_t key : wanted) {
+		if ((int)loads.size() >= kMaxLoadsInFlight) break;
+		if (table.isResident(key) || isLoading(key)) continue;
+		std::unique_ptr<PageLoad> load(new PageLoad());
+		load->key = key;
+		load->pixels.resize(kPhysicalPageSize * kPhysicalPageSize * 4);
+		PageLoad* target = load.get();
+		JobRun([this, target]() {
+			PROFILE_ZONE("Generate page");
+			generator(VirtualPageMip(target->key), VirtualPageX(target->key), VirtualPageY(target->key),
+				target->pixels.data());
+		}, &target->done);
+		loads.push_back(std::move(load));
+	}
+
+	// Indirection changes, one sub-rectangle per mip
+	glBindTexture(GL_TEXTURE_2D, indirectionTextureID);
+	for (int mip = 0; mip < kVirtualMipCount; ++mip) {
+		const VirtualPageTable::DirtyRect& rect = table.dirty[mip];
+		if (rect.x0 >= rect.x1) continue;
+		glPixelStorei(GL_UNPACK_ROW_LENGTH, kVirtualPages >> mip);
+		glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x0);
+		glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y0);
+		glTexSubImage2D(GL_TEXTURE_2D, mip, rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0,
+			GL_RGBA, GL_UNSIGNED_BYTE, table.indirection[mip].data());
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+	glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+	table.clearDirty();
+	RenderStateInvalidate();
+}
+
+void VirtualTexture::bind(GLuint programID, bool enabled) {
+	ProgramUniforms* uniforms = NULL;
+	for (int i = 0; i < kMaxPrograms && i < programsSeen; ++i) {
+		if (programs[i].programID == programID) uniforms = &programs[i];
+	}
+	if (!uniforms) {
+		uniforms = &programs[programsSeen++ % kMaxPrograms];
+		uniforms->programID = programID;
+		uniforms->enabledID = glGetUniformLocation(programID, "useVirtualTexture");
+		uniforms->indirectionSamplerID = glGetUniformLocation(programID, "virtualIndirection");
+		uniforms->physicalSamplerID = glGetUniformLocation(programID, "virtualPhysical");
+		uniforms->mipBiasID = glGetUniformLocation(programID, "virtualMipBias");
+	}
+
+	RenderStateUseProgram(programID);
+	RenderStateBindTexture(kIndirectionUnit, GL_TEXTURE_2D, indirectionTextureID);
+	RenderStateBindTexture(kPhysicalUnit, GL_TEXTURE_2D, physicalTextureID);
+	glUniform1i(uniforms->enabledID, enabled ? 1 : 0);
+	glUniform1i(uniforms->indirectionSamplerID, kIndirectionUnit);
+	glUniform1i(uniforms->physicalSamplerID, kPhysicalUnit);
+	glUniform1f(uniforms->mipBiasID, mipBias);
+}
@@ -0,0 +1,110 @@
+#ifndef _VIRTUAL_TEXTURE_H_
+#define _VIRTUAL_TEXTURE_H_
+
+#include <glad/gl.h>
+#include <core/job_system.h>
+#include <core/virtual_page_table.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+// GPU side of the virtual texture.
+//
+// A feedback pass draws the scene at a fraction of the resolution with a
+// shader that writes the virtual page each pixel would sample. The image is
+// read back through a ring of pixel buffers a few frames later, once its
+// fence has signalled, so the GPU never stalls on it. The page table turns it
+// into page loads, which are generated on the job system into CPU memory and
+// copied into a fixed RGBA8 physical page texture when done. The indirection
+// texture, one mip per virtual mip, tells the material shaders which physical
+// page to read; see virtual_texture.glsl.
+//
+// Memory is fixed by the physical page count however many slots are used.
+// Units 7 and 8 are reserved for the indirection and physical textures.
+struct VirtualTexture {
+	static const GLuint kIndirectionUnit = 7;
+	static const GLuint kPhysicalUnit = 8;
+	static const int kFeedbackDivisor = 8;		// Feedback pixels are this many window pixels wide
+	static const int kReadbackLatency = 3;
+	static const int kMaxLoadsInFlight = 16;
+
+	// Fills one physical page of RGBA8, borders included. Called on worker
+	// threads, several at once.
+	typedef std::function<void(int mip, int pageX, int pageY, uint8_t* rgba)> PageGenerator;
+
+	VirtualPageTable table;
+	PageGenerator generator;
+
+	GLuint physicalTextureID = 0;
+	GLuint indirectionTextureID = 0;
+
+	GLuint feedbackProgramID = 0;
+	GLuint feedbackMipBiasID = 0;
+	GLuint feedbackFramebufferID = 0;
+	GLuint feedbackColorID = 0;
+	GLuint feedbackDepthID = 0;
+	int feedbackWidth = 0;
+	int feedbackHeight = 0;
+
+	GLuint pixelBufferIDs[kReadbackLatency] = {};
+	GLsync fences[kReadbackLatency] = {};
+	int readbackWidth[kReadbackLatency] = {};
+	int readbackHeight[kReadbackLatency] = {};
+	unsigned long long readbackFrame[kReadbackLatency] = {};
+	unsigned long long frameIndex = 0;
+
+	struct PageLoad {
+		uint32_t key;
+		JobCounter done;
+		std::vector<uint8_t> pixels;
+	};
+	std::vector<std::unique_ptr<PageLoad>> loads;
+	std::vector<uint32_t> wanted;		// From the latest feedback, coarse first
+
+	float mipBias = 0.0f;				// Positive samples coarser pages, like a texture LOD bias
+	unsigned long long pagesLoaded = 0;
+
+	// Uniform locations of each material program bound so far, oldest replaced first
+	struct ProgramUniforms {
+		GLuint programID = 0;
+		GLuint enabledID = 0;
+		GLuint indirectionSamplerID = 0;
+		GLuint physicalSamplerID = 0;
+		GLuint mipBiasID = 0;
+	};
+	static const int kMaxPrograms = 4;
+	ProgramUniforms programs[kMaxPrograms];
+	int programsSeen = 0;
+
+	bool initialize(int physicalPagesPerSide, const char* feedbackVertexPath, const char* feedbackFragmentPath,
+		PageGenerator pageGenerator);
+	void cleanup();
+
+	// Generates and pins the coarsest page of each slot in use, waiting for it
+	void pinSlots(int slotCount);
+
+	// Binds the feedback target for a window of the given size and the
+	// feedback program; the caller draws every textured object with it. The
+	// scene's render scale keeps the requested mips matched to the scaled
+	// target rather than to the feedback resolution.
+	void beginFeedback(int windowWidth, int windowHeight, float renderScale);
+	// Queues the asynchronous readback of the feedback image
+	void endFeedback();
+
+	// Reads back feedback that has arrived, copies finished pages into the
+	// physical texture, starts new loads and uploads indirection changes
+	void update();
+
+	// Binds the textures and sets the uniforms of a material program that
+	// includes virtual_texture.glsl, with virtual texturing on or off
+	void bind(GLuint programID, bool enabled);
+
+	int physicalPageCount() const { return table.physicalPagesPerSide * table.physicalPagesPerSide; }
+	size_t physicalBytes() const { return (size_t)physicalPageCount() * kPhysicalPageSize * kPhysicalPageSize * 4; }
+
+	void readFeedback(int slot);
+	bool isLoading(uint32_t key) const;
+};
+
+#endif
@@ -0,0 +1,22 @@
+#version 330 core
+
+in vec3 direction;
+
+uniform samplerCube skyCubemap;     // sRGB encoded
+uniform float exposure;             // Of the post pass, 0 to output the image colours directly
+
+out vec3 finalColor;
+
+void main()
+{
+    vec3 display = texture(skyCubemap, direction).rgb;
+    if (exposure <= 0.0) {
+        finalColor = display;
+        return;
+    }
+
+    // Inverse of the post pass, so the sky comes out as the image colours:
+    // undo gamma, then invert x / (1 + x), staying short of white
+    vec3 mapped = min(pow(display, vec3(2.2)), vec3(0.99));
+    finalColor = mapped / (1.0 - mapped) / exposure;
+}
\ No newline at end of file
@@ -0,0 +1,14 @@
+#version 330 core
+
+// One triangle covering the viewport on the far plane, see Skybox
+uniform mat4 inverseViewProjection;    // Rotation-only view
+
+out vec3 direction;
+
+void main() {
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    // z = w puts the sky at depth 1, which only uncovered pixels still hold
+    gl_Position = vec4(corner, 1.0, 1.0);
+    vec4 world = inverseViewProjection * gl_Position;
+    direction = world.xyz / world.w;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 330 core
+
+in vec3 worldNormal;
+in float worldHeight;
+in vec4 lightSpacePosition; // for shadow mapping
+
+// Compiled as the forward pass and, with GBUFFER defined, as the deferred
+// geometry pass, like box.frag
+#ifdef GBUFFER
+layout(location = 0) out vec4 gbufferAlbedo;
+layout(location = 1) out vec2 gbufferNormal;
+#else
+out vec3 finalColor;
+#endif
+
+#include "lighting.glsl"
+
+void main()
+{
+    vec3 N = normalize(worldNormal);
+
+    // Paving at street level, then grass, turning to rock on steep slopes
+    vec3 paving = vec3(0.08, 0.08, 0.09);
+    vec3 grass = vec3(0.05, 0.10, 0.02);
+    vec3 rock = vec3(0.13, 0.11, 0.09);
+    vec3 albedo = mix(grass, rock, smoothstep(0.9, 0.7, N.y));
+    albedo = mix(paving, albedo, smoothstep(-49.9, -48.0, worldHeight));
+
+#ifdef GBUFFER
+    gbufferAlbedo = vec4(pow(albedo, vec3(1.0 / 2.2)), 1.0);
+    gbufferNormal = EncodeOctahedral(N);
+#else
+    finalColor = ShadeSurface(albedo, N, gl_FragCoord.z, lightSpacePosition);
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#version 330 core
+
+// One geometry clipmap level, see ClipmapTerrain
+layout(location = 0) in vec2 gridOffset;    // -32 to 32 vertices from the level centre
+
+uniform sampler2DArray heightmap;   // Toroidal, one layer per level
+uniform mat4 viewProjection;
+uniform int level;
+uniform ivec2 levelCenter;          // In grid units of this level
+uniform float levelSpacing;
+
+uniform mat4 lightSpaceTransformMatrix; // for shadow mapping
+
+out vec3 worldNormal;
+out float worldHeight;
+out vec4 lightSpacePosition; // for shadow mapping
+
+const int kHalfGrid = 32;
+
+float FetchHeight(ivec2 grid) {
+    ivec2 size = textureSize(heightmap, 0).xy;
+    return texelFetch(heightmap, ivec3(grid & (size - 1), level), 0).r;
+}
+
+void main() {
+    // Across the outer few vertices odd vertices slide onto their even
+    // neighbour, so at the edge the level matches the coarser grid around it
+    float edge = max(abs(gridOffset.x), abs(gridOffset.y)) / float(kHalfGrid);
+    float morph = clamp((edge - 0.8) / 0.15, 0.0, 1.0);
+    vec2 grid = vec2(levelCenter) + gridOffset;
+    vec2 morphed = grid - mod(grid, 2.0) * morph;
+
+    ivec2 base = ivec2(floor(morphed));
+    vec2 f = morphed - vec2(base);
+    float h00 = FetchHeight(base);
+    float h10 = FetchHeight(base + ivec2(1, 0));
+    float h01 = FetchHeight(base + ivec2(0, 1));
+    float h11 = FetchHeight(base + ivec2(1, 1));
+    float height = mix(mix(h00, h10, f.x), mix(h01, h11, f.x), f.y);
+
+    // Central differences, kept inside the resident window
+    ivec2 nearest = ivec2(floor(morphed + 0.5));
+    ivec2 low = levelCenter - ivec2(kHalfGrid);
+    ivec2 high = levelCenter + ivec2(kHalfGrid);
+    float dx = FetchHeight(clamp(nearest + ivec2(1, 0), low, high)) - FetchHeight(clamp(nearest - ivec2(1, 0), low, high));
+    float dz = FetchHeight(clamp(nearest + ivec2(0, 1), low, high)) - FetchHeight(clamp(nearest - ivec2(0, 1), low, high));
+    worldNormal = normalize(vec3(-dx, 2.0 * levelSpacing, -dz));
+
+    vec3 worldPosition = vec3(morphed.x * levelSpacing, height, morphed.y * levelSpacing);
+    worldHeight = height;
+    gl_Position = viewProjection * vec4(worldPosition, 1.0);
+
+    lightSpacePosition = lightSpaceTransformMatrix * vec4(worldPosition, 1.0); // for shadow mapping
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+// Bundles asset files into one archive for the VFS, see core/asset_archive.h.
+//
+//   lab2_asset_packer <archive> <root directory> <file>...
+//
+// Each file is stored under its path relative to the root, which is the name
+// the application asks the VFS for. Backslashes become forward slashes.
+
+#include <core/asset_archive.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct InputFile {
+	std::string name;
+	std::vector<uint8_t> contents;
+	uint64_t hash;
+	uint64_t offset;
+	uint32_t nameOffset;
+};
+
+bool ReadFile(const std::string& path, std::vector<uint8_t>& contents) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file) return false;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	contents.resize(size > 0 ? (size_t)size : 0);
+	size_t read = contents.empty() ? 0 : fread(contents.data(), 1, contents.size(), file);
+	fclose(file);
+	return read == contents.size();
+}
+
+uint64_t AlignUp(uint64_t value) {
+	return (value + kAssetAlignment - 1) / kAssetAlignment * kAssetAlignment;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 4) {
+		printf("Usage: %s <archive> <root directory> <file>...\n", argv[0]);
+		return 1;
+	}
+	std::string root = argv[2];
+	if (!root.empty() && root.back() != '/' && root.back() != '\\') root += '/';
+
+	std::vector<InputFile> files;
+	for (int i = 3; i < argc; ++i) {
+		InputFile file;
+		file.name = argv[i];
+		std::replace(file.name.begin(), file.name.end(), '\\', '/');
+		if (!ReadFile(root + argv[i], file.contents)) {
+			printf("Failed to read %s%s\n", root.c_str(), argv[i]);
+			return 1;
+		}
+		file.hash = AssetNameHash(file.name.c_str(), file.name.size());
+		files.push_back(std::move(file));
+	}
+	std::sort(files.begin(), files.end(), [](const InputFile& a, const InputFile& b) {
+		return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+	});
+	for (size_t i = 1; i < files.size(); ++i) {
+		if (files[i].name == files[i - 1].name) {
+			printf("%s is listed twice\n", files[i].name.c_str());
+			return 1;
+		}
+	}
+
+	// Header, index, names, then each file on its own alignment boundary
+	AssetArchiveHeader header;
+	memcpy(header.magic, kAssetArchiveMagic, sizeof(header.magic));
+	header.version = kAssetArchiveVersion;
+	header.entryCount = (uint32_t)files.size();
+	header.indexOffset = sizeof(AssetArchiveHeader);
+	header.namesOffset = header.indexOffset + files.size() * sizeof(AssetArchiveEntry);
+
+	uint64_t namesSize = 0;
+	for (InputFile& file : files) {
+		file.nameOffset = (uint32_t)namesSize;
+		namesSize += file.name.size() + 1;
+	}
+	uint64_t offset = AlignUp(header.namesOffset + namesSize);
+	for (InputFile& file : files) {
+		file.offset = offset;
+		offset = AlignUp(offset + file.contents.size());
+	}
+	header.fileSize = offset;
+
+	std::vector<uint8_t> archive((size_t)header.fileSize, 0);
+	memcpy(&archive[0], &header, sizeof(header));
+	for (size_t i = 0; i < files.size(); ++i) {
+		const InputFile& file = files[i];
+		AssetArchiveEntry entry;
+		entry.nameHash = file.hash;
+		entry.offset = file.offset;
+		entry.size = file.contents.size();
+		entry.nameOffset = file.nameOffset;
+		entry.nameLength = (uint32_t)file.name.size();
+		memcpy(&archive[(size_t)(header.indexOffset + i * sizeof(AssetArchiveEntry))], &entry, sizeof(entry));
+		memcpy(&archive[(size_t)(header.namesOffset + file.nameOffset)], file.name.c_str(), file.name.size() + 1);
+		if (!file.contents.empty()) {
+			memcpy(&archive[(size_t)file.offset], file.contents.data(), file.contents.size());
+		}
+	}
+
+	FILE* output = fopen(argv[1], "wb");
+	if (!output || fwrite(archive.data(), 1, archive.size(), output) != archive.size()) {
+		printf("Failed to write %s\n", argv[1]);
+		if (output) fclose(output);
+		return 1;
+	}
+	fclose(output);
+	printf("Packed %u files, %llu bytes, into %s\n", header.entryCount, (unsigned long long)header.fileSize, argv[1]);
+	return 0;
+}
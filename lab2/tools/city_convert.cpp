@@ -0,0 +1,128 @@
+// Converts a text city layout into a binary scene, see core/city_scene.h.
+//
+//   lab2_city_convert <layout.txt> <scene.city>
+//   lab2_city_convert --generate <building count> <scene.city>
+//
+// The layout has one statement per line; # starts a comment:
+//
+//   chunk_size 512
+//   building <x> <y> <z> <half x> <half y> <half z> <material> [mesh]
+//
+// Materials are the facade texture names the viewer knows, such as
+// facade0.jpg, and the mesh defaults to box. Buildings take virtual texture
+// slots in file order, the ones past the last slot sharing it.
+// --generate writes a square grid of random towers instead, for load tests.
+
+#include <core/city_scene.h>
+#include <core/virtual_page_table.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace {
+
+glm::vec2 SlotFor(size_t building) {
+	int slot = (int)std::min(building, (size_t)kMaxVirtualSlots - 1);
+	return glm::vec2(slot % kSlotsPerSide, slot / kSlotsPerSide);
+}
+
+bool ReadLayout(const char* path, CitySceneBuilder& builder, float& chunkSize) {
+	std::ifstream stream(path);
+	if (!stream.is_open()) {
+		printf("Failed to open %s\n", path);
+		return false;
+	}
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(stream, line)) {
+		++lineNumber;
+		size_t comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+		std::istringstream words(line);
+		std::string statement;
+		if (!(words >> statement)) continue;
+
+		if (statement == "chunk_size") {
+			if (!(words >> chunkSize) || chunkSize <= 0.0f) {
+				printf("%s:%d: chunk_size needs a positive size\n", path, lineNumber);
+				return false;
+			}
+		}
+		else if (statement == "building") {
+			glm::vec3 position, scale;
+			std::string material, mesh = "box";
+			if (!(words >> position.x >> position.y >> position.z >> scale.x >> scale.y >> scale.z >> material)) {
+				printf("%s:%d: building needs a position, a half extent and a material\n", path, lineNumber);
+				return false;
+			}
+			words >> mesh;
+			builder.add(position, scale, builder.material(material), builder.mesh(mesh),
+				SlotFor(builder.buildings.size()));
+		}
+		else {
+			printf("%s:%d: unknown statement %s\n", path, lineNumber, statement.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+// Towers on a square grid of 60 unit blocks, like the built-in city
+void GenerateGrid(size_t count, CitySceneBuilder& builder) {
+	uint32_t box = builder.mesh("box");
+	uint32_t materials[6];
+	for (int i = 0; i < 6; ++i) {
+		char name[32];
+		snprintf(name, sizeof(name), "facade%d.jpg", i);
+		materials[i] = builder.material(name);
+	}
+	size_t side = (size_t)std::ceil(std::sqrt((double)count));
+	float origin = -0.5f * 60.0f * (side - 1);
+	builder.buildings.reserve(count);
+	builder.slots.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		float height = 40.0f + (float)(rand() % 121);
+		glm::vec3 scale(16.0f, height, 16.0f);
+		glm::vec3 position(origin + 60.0f * (i % side), height / 2.0f - 50.0f, origin + 60.0f * (i / side));
+		builder.add(position, scale, materials[rand() % 6], box, SlotFor(i));
+	}
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	CitySceneBuilder builder;
+	float chunkSize = 512.0f;
+	const char* output;
+	if (argc == 4 && strcmp(argv[1], "--generate") == 0) {
+		GenerateGrid((size_t)atol(argv[2]), builder);
+		output = argv[3];
+	}
+	else if (argc == 3) {
+		if (!ReadLayout(argv[1], builder, chunkSize)) return 1;
+		output = argv[2];
+	}
+	else {
+		printf("Usage: %s <layout.txt> <scene.city>\n", argv[0]);
+		printf("       %s --generate <building count> <scene.city>\n", argv[0]);
+		return 1;
+	}
+
+	if (!builder.write(output, chunkSize)) return 1;
+
+	// Time a load the way the viewer does it, to show it does not grow with the city
+	auto start = std::chrono::high_resolution_clock::now();
+	CityScene scene;
+	if (!scene.open(output)) return 1;
+	double loadMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	printf("Wrote %zu buildings in %zu chunks to %s, %.3f ms to open\n", scene.buildingCount, scene.chunkCount,
+		output, loadMs);
+	return 0;
+}
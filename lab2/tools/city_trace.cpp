@@ -0,0 +1,189 @@
+// Path traces a city scene on the CPU into a PNG, see core/path_tracer.h.
+//
+//   lab2_city_trace <scene.city> <image.png> [options]
+//
+//   --size <width> <height>    Default 1024 x 768, the viewer's window
+//   --samples <n>              Samples per pixel, default 256
+//   --checkpoint <n>           Rewrite the image every n samples, default 16
+//   --bounces <n>              Default 3
+//   --eye <x> <y> <z>          Default above the city, looking down on its centre
+//   --lookat <x> <y> <z>
+//   --threads <n>              Default every core
+//   --scaling                  First time a few samples on 1 to N threads
+//   --assets <archive>         Where the facade textures come from
+//
+// The image is rewritten as samples accumulate, so it can be watched
+// converging or the render stopped once it is clean enough. Rays per second
+// go to city_trace.json with the scaling runs.
+
+#include <glm/glm.hpp>
+
+#include <core/path_tracer.h>
+#include <core/city_scene.h>
+#include <core/terrain_height.h>
+#include <core/job_system.h>
+#include <core/benchmark.h>
+#include <core/vfs.h>
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#include <stb/stb_image_write.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Lighting of lab2_building
+const glm::vec3 kWave500(0.0f, 255.0f, 146.0f);
+const glm::vec3 kWave600(255.0f, 190.0f, 0.0f);
+const glm::vec3 kWave700(205.0f, 0.0f, 0.0f);
+const glm::vec3 kLightIntensity = 5.0f * (8.0f * kWave500 + 15.6f * kWave600 + 18.4f * kWave700);
+const glm::vec3 kLightPosition(100.0f, 50.0f, 1000.0f);
+const glm::vec3 kAmbientLight(0.05f, 0.055f, 0.06f);
+
+// Facades by material name, null where one cannot be loaded
+void LoadMaterials(const CityScene& city, std::vector<SoftTexture>& textures, PathTracer& tracer) {
+	textures.resize(city.materialNames.size());
+	for (size_t m = 0; m < city.materialNames.size(); ++m) {
+		AssetView file;
+		int width, height, channels;
+		stbi_uc* rgba = NULL;
+		if (VfsRead(city.materialNames[m].c_str(), file)) {
+			rgba = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channels, 4);
+		}
+		if (!rgba) {
+			printf("Material %s not found, tracing it grey\n", city.materialNames[m].c_str());
+			continue;
+		}
+		textures[m].initialize(rgba, width, height);
+		stbi_image_free(rgba);
+		tracer.materials[m] = &textures[m];
+	}
+}
+
+bool WriteImage(const PathTracer& tracer, const char* path) {
+	std::vector<uint8_t> rgb;
+	tracer.resolve(rgb);
+	int width = tracer.settings.width;
+	if (!stbi_write_png(path, width, tracer.settings.height, 3, rgb.data(), width * 3)) {
+		printf("Failed to write %s\n", path);
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printf("Usage: %s <scene.city> <image.png> [--size <width> <height>] [--samples <n>] [--checkpoint <n>]\n"
+			"       [--bounces <n>] [--eye <x> <y> <z>] [--lookat <x> <y> <z>] [--threads <n>] [--scaling]\n"
+			"       [--assets <archive>]\n", argv[0]);
+		return 1;
+	}
+	const char* scenePath = argv[1];
+	const char* imagePath = argv[2];
+	PathTraceSettings settings;
+	settings.lightPosition = kLightPosition;
+	settings.lightIntensity = kLightIntensity;
+	settings.skyRadiance = kAmbientLight;
+	settings.groundHeight = TerrainHeight(0.0f, 0.0f);
+	int samples = 256, checkpoint = 16, threads = 0;
+	bool scaling = false, eyeGiven = false, lookatGiven = false;
+	const char* assetArchive = "lab2_assets.pak";
+	for (int i = 3; i < argc; ++i) {
+		if (strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+			settings.width = atoi(argv[++i]);
+			settings.height = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc) samples = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc) checkpoint = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--bounces") == 0 && i + 1 < argc) settings.maxBounces = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) threads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--scaling") == 0) scaling = true;
+		else if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc) assetArchive = argv[++i];
+		else if (strcmp(argv[i], "--eye") == 0 && i + 3 < argc) {
+			for (int k = 0; k < 3; ++k) settings.eye[k] = (float)atof(argv[++i]);
+			eyeGiven = true;
+		}
+		else if (strcmp(argv[i], "--lookat") == 0 && i + 3 < argc) {
+			for (int k = 0; k < 3; ++k) settings.lookat[k] = (float)atof(argv[++i]);
+			lookatGiven = true;
+		}
+		else {
+			printf("Unknown option %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if (settings.width <= 0 || settings.height <= 0 || samples <= 0) {
+		printf("The size and sample count must be positive\n");
+		return 1;
+	}
+
+	CityScene city;
+	if (!city.open(scenePath)) return 1;
+	// A fixed default would land inside a building of some generated city
+	PathTraceSettings framed = settings;
+	PathTraceFrameCity(city, framed);
+	if (!eyeGiven) settings.eye = framed.eye;
+	if (!lookatGiven) settings.lookat = framed.lookat;
+
+	// Textures come from the same places as the viewer's
+	VfsMount(assetArchive);
+	VfsAddSearchPath("../../../lab2");
+	VfsAddSearchPath("lab2");
+	PathTracer tracer;
+	tracer.initialize(city, settings);
+	std::vector<SoftTexture> textures;
+	LoadMaterials(city, textures, tracer);
+	printf("%zu buildings, hierarchy of %zu nodes built in %.2f ms\n", city.buildingCount, tracer.bvh.nodes.size(),
+		tracer.buildMs);
+	BenchmarkSet("path_tracer", "buildings", static_cast<double>(city.buildingCount));
+	BenchmarkSet("path_tracer", "bvh_build_ms", tracer.buildMs);
+
+	// Same samples on every thread count, each on a fresh accumulation
+	int maxThreads = static_cast<int>(std::thread::hardware_concurrency());
+	if (maxThreads <= 0) maxThreads = 1;
+	if (scaling) {
+		const int scalingSamples = 4;
+		printf("threads   Mrays/s   speedup\n");
+		double baseline = 0.0;
+		for (int count = 1; count <= maxThreads; ++count) {
+			JobSystemInit(count);
+			tracer.reset();
+			for (int s = 0; s < scalingSamples; ++s) tracer.renderPass();
+			JobSystemShutdown();
+
+			double raysPerSecond = tracer.raysPerSecond();
+			if (count == 1) baseline = raysPerSecond;
+			printf("%7d   %7.2f   %6.2fx\n", count, raysPerSecond * 1e-6, raysPerSecond / baseline);
+			BenchmarkSet("path_tracer", "threads_" + std::to_string(count) + "_mrays_per_s", raysPerSecond * 1e-6);
+			BenchmarkSet("path_tracer", "threads_" + std::to_string(count) + "_speedup", raysPerSecond / baseline);
+		}
+	}
+
+	JobSystemInit(threads);
+	tracer.reset();
+	for (int s = 1; s <= samples; ++s) {
+		tracer.renderPass();
+		if (s % checkpoint == 0 || s == samples) {
+			if (!WriteImage(tracer, imagePath)) return 1;
+			printf("%d / %d samples, %.1f s, %.2f Mrays/s\n", s, samples, tracer.renderMs * 1e-3,
+				tracer.raysPerSecond() * 1e-6);
+		}
+	}
+	JobSystemShutdown();
+	VfsShutdown();
+
+	BenchmarkSet("path_tracer", "threads", static_cast<double>(threads > 0 ? threads : maxThreads));
+	BenchmarkSet("path_tracer", "samples", static_cast<double>(samples));
+	BenchmarkSet("path_tracer", "render_s", tracer.renderMs * 1e-3);
+	BenchmarkSet("path_tracer", "mrays_per_s", tracer.raysPerSecond() * 1e-6);
+	BenchmarkWriteJson("city_trace.json");
+	return 0;
+}
@@ -0,0 +1,18 @@
+#version 330 core
+
+// Virtual texture feedback: the page each pixel would sample, as mip-level
+// page x, page y and mip, with alpha 1 to tell it from the cleared background
+
+in vec2 slotUV;
+flat in vec2 slot;
+
+out vec4 feedback;
+
+#include "virtual_texture.glsl"
+
+void main()
+{
+    vec2 address = VirtualAddress(slotUV, slot);
+    int level = int(VirtualMip(address));
+    feedback = vec4(vec2(VirtualPage(address, level)) / 255.0, float(level) / 255.0, 1.0);
+}
\ No newline at end of file
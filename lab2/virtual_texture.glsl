@@ -0,0 +1,41 @@
+// Virtual texture lookup, see render/virtual_texture.h and
+// core/virtual_page_table.h for the layout. The constants must match.
+uniform sampler2D virtualIndirection;
+uniform sampler2D virtualPhysical;
+uniform float virtualMipBias;
+
+const float kVirtualPages = 256.0;
+const float kSlotPages = 16.0;
+const float kPageTexels = 120.0;
+const float kPageBorder = 4.0;
+const float kPhysicalPageSize = 128.0;
+const int kVirtualMipCount = 5;
+
+// Position in an object's slot, [0, 1] on each axis, to the virtual address
+// space. Clamped inside the slot so edges never reach the next one.
+vec2 VirtualAddress(vec2 slotUV, vec2 slot) {
+    return (slot + clamp(slotUV, 0.0, 0.99999)) * (kSlotPages / kVirtualPages);
+}
+
+// Mip of the virtual texture, from the screen-space rate of change
+float VirtualMip(vec2 address) {
+    vec2 texels = address * (kVirtualPages * kPageTexels);
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float lod = 0.5 * log2(max(dot(dx, dx), dot(dy, dy)));
+    return clamp(lod + virtualMipBias, 0.0, float(kVirtualMipCount - 1));
+}
+
+ivec2 VirtualPage(vec2 address, int level) {
+    return ivec2(address * kVirtualPages) >> level;
+}
+
+// Samples the finest resident page at or above the mip. The indirection
+// holds its physical page and its own mip, which may be coarser than asked.
+vec4 SampleVirtual(vec2 address, float mip) {
+    int level = int(mip);
+    vec4 entry = floor(texelFetch(virtualIndirection, VirtualPage(address, level), level) * 255.0 + 0.5);
+    vec2 pages = address * kVirtualPages / exp2(entry.z);
+    vec2 texel = entry.xy * kPhysicalPageSize + kPageBorder + fract(pages) * kPageTexels;
+    return textureLod(virtualPhysical, texel / vec2(textureSize(virtualPhysical, 0)), 0.0);
+}
\ No newline at end of file